@@ -0,0 +1,273 @@
+// This file provides implementation of the AABBTree class methods.
+
+#include "AABBTree.h"
+
+//--------------------------------------------------------------
+// Returns the surface area of a box
+static inline float surfaceArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	glm::vec3 extent = boundsMax - boundsMin;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+//--------------------------------------------------------------
+// Takes a node off the free list (growing the node array if
+//  the free list is empty)
+int AABBTree::allocateNode()
+{
+	int node;
+	if (freeList >= 0) {
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	else {
+		node = (int)nodes.size();
+		nodes.push_back(AABBTreeNode());
+	}
+	nodes[node] = AABBTreeNode();
+	return node;
+}
+
+//--------------------------------------------------------------
+// Puts a node on the free list
+void AABBTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	nodes[node].object = NULL;
+	freeList = node;
+}
+
+//--------------------------------------------------------------
+// Adds a leaf with the object's enlarged box
+int AABBTree::createProxy(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, SceneObject *object, int tag)
+{
+	int leaf = allocateNode();
+	nodes[leaf].boundsMin = boundsMin - glm::vec3(margin);
+	nodes[leaf].boundsMax = boundsMax + glm::vec3(margin);
+	nodes[leaf].object = object;
+	nodes[leaf].tag = tag;
+	nodes[leaf].height = 0;
+	insertLeaf(leaf);
+	proxyCount++;
+	return leaf;
+}
+
+//--------------------------------------------------------------
+// Removes a leaf from the tree and frees it
+void AABBTree::destroyProxy(int proxy)
+{
+	if (proxy < 0 || proxy >= nodes.size() || nodes[proxy].height != 0) return;
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxyCount--;
+}
+
+//--------------------------------------------------------------
+// Re-inserts the leaf with a new enlarged box if the object's
+//  box is no longer inside the old one
+bool AABBTree::moveProxy(int proxy, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	AABBTreeNode &leaf = nodes[proxy];
+	if (boundsMin.x >= leaf.boundsMin.x && boundsMin.y >= leaf.boundsMin.y && boundsMin.z >= leaf.boundsMin.z &&
+		boundsMax.x <= leaf.boundsMax.x && boundsMax.y <= leaf.boundsMax.y && boundsMax.z <= leaf.boundsMax.z) {
+		return false;
+	}
+	removeLeaf(proxy);
+	nodes[proxy].boundsMin = boundsMin - glm::vec3(margin);
+	nodes[proxy].boundsMax = boundsMax + glm::vec3(margin);
+	insertLeaf(proxy);
+	return true;
+}
+
+//--------------------------------------------------------------
+// Forgets every node
+void AABBTree::clear()
+{
+	nodes.clear();
+	root = -1;
+	freeList = -1;
+	proxyCount = 0;
+}
+
+//--------------------------------------------------------------
+// Inserts a leaf next to the sibling that adds the least surface
+//  area to the tree (the cost of a subtree is bounded below by
+//  the growth of its root, so descending stops once neither child
+//  can beat pairing with the current node)
+void AABBTree::insertLeaf(int leaf)
+{
+	if (root < 0) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// find the best sibling
+	glm::vec3 leafMin = nodes[leaf].boundsMin;
+	glm::vec3 leafMax = nodes[leaf].boundsMax;
+	int index = root;
+	while (!nodes[index].isLeaf()) {
+		const AABBTreeNode &node = nodes[index];
+		float area = surfaceArea(node.boundsMin, node.boundsMax);
+		float combinedArea = surfaceArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+
+		// cost of pairing the leaf with this node, and the growth every deeper choice adds to this node
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		// cost of descending into each child
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; c++) {
+			const AABBTreeNode &child = nodes[children[c]];
+			float grown = surfaceArea(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+			childCosts[c] = (child.isLeaf() ? grown : grown - surfaceArea(child.boundsMin, child.boundsMax)) + inheritanceCost;
+		}
+		if (cost < childCosts[0] && cost < childCosts[1]) break;
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+	int sibling = index;
+
+	// a new parent takes the sibling's place and holds the sibling and the leaf
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].boundsMin = glm::min(leafMin, nodes[sibling].boundsMin);
+	nodes[newParent].boundsMax = glm::max(leafMax, nodes[sibling].boundsMax);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent >= 0) {
+		if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else nodes[oldParent].child2 = newParent;
+	}
+	else {
+		root = newParent;
+	}
+
+	// fix the boxes and heights above the new parent
+	refitAncestors(nodes[leaf].parent);
+}
+
+//--------------------------------------------------------------
+// Removes a leaf; its sibling takes the place of their parent
+void AABBTree::removeLeaf(int leaf)
+{
+	if (leaf == root) {
+		root = -1;
+		return;
+	}
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	if (grandParent >= 0) {
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		refitAncestors(grandParent);
+	}
+	else {
+		root = sibling;
+		nodes[sibling].parent = -1;
+		freeNode(parent);
+	}
+}
+
+//--------------------------------------------------------------
+// Balances and refits every node from the given one up to the root
+void AABBTree::refitAncestors(int index)
+{
+	while (index >= 0) {
+		index = balance(index);
+		AABBTreeNode &node = nodes[index];
+		const AABBTreeNode &child1 = nodes[node.child1];
+		const AABBTreeNode &child2 = nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+		node.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+		index = node.parent;
+	}
+}
+
+//--------------------------------------------------------------
+// If one child of node a is more than one level taller than the
+//  other, rotates the taller child up into a's place and moves
+//  its shorter grandchild under a. Returns the node now at a's place.
+int AABBTree::balance(int iA)
+{
+	AABBTreeNode &a = nodes[iA];
+	if (a.isLeaf() || a.height < 2) return iA;
+	int iB = a.child1;
+	int iC = a.child2;
+	AABBTreeNode &b = nodes[iB];
+	AABBTreeNode &c = nodes[iC];
+	int difference = c.height - b.height;
+
+	if (difference > 1) {
+		// rotate c up
+		int iF = c.child1;
+		int iG = c.child2;
+		AABBTreeNode &f = nodes[iF];
+		AABBTreeNode &g = nodes[iG];
+		c.child1 = iA;
+		c.parent = a.parent;
+		a.parent = iC;
+		if (c.parent >= 0) {
+			if (nodes[c.parent].child1 == iA) nodes[c.parent].child1 = iC;
+			else nodes[c.parent].child2 = iC;
+		}
+		else {
+			root = iC;
+		}
+		// the taller grandchild stays under c, the other one moves under a
+		int iKeep = f.height > g.height ? iF : iG;
+		int iMove = f.height > g.height ? iG : iF;
+		c.child2 = iKeep;
+		a.child2 = iMove;
+		nodes[iMove].parent = iA;
+		a.boundsMin = glm::min(b.boundsMin, nodes[iMove].boundsMin);
+		a.boundsMax = glm::max(b.boundsMax, nodes[iMove].boundsMax);
+		c.boundsMin = glm::min(a.boundsMin, nodes[iKeep].boundsMin);
+		c.boundsMax = glm::max(a.boundsMax, nodes[iKeep].boundsMax);
+		a.height = 1 + std::max(b.height, nodes[iMove].height);
+		c.height = 1 + std::max(a.height, nodes[iKeep].height);
+		return iC;
+	}
+
+	if (difference < -1) {
+		// rotate b up
+		int iD = b.child1;
+		int iE = b.child2;
+		AABBTreeNode &d = nodes[iD];
+		AABBTreeNode &e = nodes[iE];
+		b.child1 = iA;
+		b.parent = a.parent;
+		a.parent = iB;
+		if (b.parent >= 0) {
+			if (nodes[b.parent].child1 == iA) nodes[b.parent].child1 = iB;
+			else nodes[b.parent].child2 = iB;
+		}
+		else {
+			root = iB;
+		}
+		// the taller grandchild stays under b, the other one moves under a
+		int iKeep = d.height > e.height ? iD : iE;
+		int iMove = d.height > e.height ? iE : iD;
+		b.child2 = iKeep;
+		a.child1 = iMove;
+		nodes[iMove].parent = iA;
+		a.boundsMin = glm::min(c.boundsMin, nodes[iMove].boundsMin);
+		a.boundsMax = glm::max(c.boundsMax, nodes[iMove].boundsMax);
+		b.boundsMin = glm::min(a.boundsMin, nodes[iKeep].boundsMin);
+		b.boundsMax = glm::max(a.boundsMax, nodes[iKeep].boundsMax);
+		a.height = 1 + std::max(c.height, nodes[iMove].height);
+		b.height = 1 + std::max(a.height, nodes[iKeep].height);
+		return iB;
+	}
+
+	return iA;
+}
@@ -0,0 +1,136 @@
+// This file provides the definition of the AABBTree class, a dynamic
+//  bounding volume tree over axis aligned boxes of scene objects (used to
+//  pick joints and meshes in the viewport).
+// Every object is a leaf (proxy) whose box is enlarged by a margin, so
+//  an object that moves a little stays inside its box and its proxy only
+//  needs to be re-inserted once it leaves it. Leaves are inserted next to
+//  the sibling that grows the tree's surface area least, and the tree is
+//  kept balanced with rotations on the way back up, so ray queries visit
+//  O(log n) nodes no matter in which order objects were added.
+
+#pragma once
+
+#include "ofMain.h"
+
+class SceneObject;
+
+// AABBTreeNode: a leaf (an object's enlarged box) or an inner node
+//
+struct AABBTreeNode {
+	glm::vec3 boundsMin, boundsMax;		// box of the node (enlarged for leaves)
+	int parent = -1;					// parent node (next free node while on the free list)
+	int child1 = -1, child2 = -1;		// children of an inner node (-1 for leaves)
+	int height = 0;						// 0 for leaves, -1 for free nodes
+	SceneObject *object = NULL;			// object of a leaf
+	int tag = 0;						// caller defined kind of a leaf's object
+
+	bool isLeaf() const { return child1 == -1; }
+};
+
+// AABBTree class
+//
+class AABBTree {
+public:
+	// Adds a leaf for the object with the given box and returns its proxy ID
+	int createProxy(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, SceneObject *object, int tag = 0);
+
+	// Removes a leaf
+	void destroyProxy(int proxy);
+
+	// Updates the box of a leaf. The leaf is only re-inserted if the box
+	//  left its enlarged box (returns true if it was).
+	bool moveProxy(int proxy, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+	// Removes every leaf
+	void clear();
+
+	// Returns the object and tag of a leaf
+	SceneObject *getObject(int proxy) const { return nodes[proxy].object; }
+	int getTag(int proxy) const { return nodes[proxy].tag; }
+
+	// Returns the number of leaves and the height of the tree
+	int size() const { return proxyCount; }
+	int getHeight() const { return root >= 0 ? nodes[root].height : 0; }
+
+	// Walks the leaves whose boxes the ray (origin + t * direction) enters
+	//  before tMax, nearest boxes first. hit(proxy, tMax) tests the leaf's
+	//  object and returns the distance of its hit (or tMax if it was
+	//  missed); boxes beyond the closest hit so far are skipped.
+	template<class Callback>
+	void raycast(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, Callback hit) const;
+
+	// Fields of AABBTree class
+	//
+	float margin = 0.1;					// added to every side of a leaf's box
+	vector<AABBTreeNode> nodes;			// all nodes (leaves, inner nodes and free nodes)
+	int root = -1;						// root node (-1 if the tree is empty)
+
+private:
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+	void refitAncestors(int node);
+
+	int freeList = -1;					// first free node
+	int proxyCount = 0;					// number of leaves
+};
+
+//--------------------------------------------------------------
+// Returns the distance along the ray to the box (slab test) or
+//  infinity if the ray misses it before tMax
+static inline float rayBoxEntry(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	const glm::vec3 &origin, const glm::vec3 &inverseDirection, float tMax)
+{
+	glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+	glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+	return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+//--------------------------------------------------------------
+// Walks the tree front to back with an explicit stack
+template<class Callback>
+void AABBTree::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, Callback hit) const
+{
+	if (root < 0) return;
+	glm::vec3 inverseDirection = 1.0f / direction;
+	const float miss = std::numeric_limits<float>::infinity();
+
+	// every level leaves at most one far child waiting, so the stack never
+	//  holds more than height + 1 nodes (a balanced tree fits the local
+	//  array, a taller one gets a stack of its own)
+	int localStack[128];
+	vector<int> tallStack;
+	int *stack = localStack;
+	if (getHeight() + 1 > 128) {
+		tallStack.resize(getHeight() + 1);
+		stack = tallStack.data();
+	}
+	int stackSize = 0;
+	if (rayBoxEntry(nodes[root].boundsMin, nodes[root].boundsMax, origin, inverseDirection, tMax) == miss) return;
+	stack[stackSize++] = root;
+	while (stackSize > 0) {
+		int index = stack[--stackSize];
+		const AABBTreeNode &node = nodes[index];
+		if (node.isLeaf()) {
+			tMax = std::min(tMax, (float)hit(index, tMax));
+			continue;
+		}
+
+		// visit the nearer child first (pushed last), skipping boxes beyond the closest hit
+		float t1 = rayBoxEntry(nodes[node.child1].boundsMin, nodes[node.child1].boundsMax, origin, inverseDirection, tMax);
+		float t2 = rayBoxEntry(nodes[node.child2].boundsMin, nodes[node.child2].boundsMax, origin, inverseDirection, tMax);
+		int near = node.child1, far = node.child2;
+		if (t2 < t1) {
+			std::swap(near, far);
+			std::swap(t1, t2);
+		}
+		if (t2 != miss) stack[stackSize++] = far;
+		if (t1 != miss) stack[stackSize++] = near;
+	}
+}
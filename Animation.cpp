@@ -0,0 +1,323 @@
+// This file provides implementation of the JointTrack and
+//  AnimationClip class methods.
+
+#include "Animation.h"
+
+//--------------------------------------------------------------
+// Returns the index i of the key segment [times[i], times[i + 1]]
+//  containing time. The search starts at the cursor (the segment
+//  used last) and walks forward a couple of keys, which covers
+//  normal playback; only jumps (scrubbing, looping) fall back to
+//  a binary search.
+static int findKey(const vector<float> &times, float time, int cursor)
+{
+	int last = (int)times.size() - 2;	// index of the last segment
+	if (last <= 0) return 0;
+
+	// try the cached segment and the next couple of segments
+	cursor = glm::clamp(cursor, 0, last);
+	if (time >= times[cursor]) {
+		for (int step = 0; step < 3; step++) {
+			if (cursor == last || time < times[cursor + 1]) return cursor;
+			cursor++;
+		}
+	}
+
+	// binary search for the segment
+	int i = (int)(upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+	return glm::clamp(i, 0, last);
+}
+
+//--------------------------------------------------------------
+// Returns the interpolation factor of time between the keys
+//  at index i and i + 1 (clamped to the segment)
+static float segmentAlpha(const vector<float> &times, int i, float time)
+{
+	float span = times[i + 1] - times[i];
+	if (span <= 0) return 0;
+	return glm::clamp((time - times[i]) / span, 0.0f, 1.0f);
+}
+
+//--------------------------------------------------------------
+// Adds a position key keeping the keys sorted by time
+void JointTrack::addPositionKey(float time, glm::vec3 position)
+{
+	int i = (int)(lower_bound(positionTimes.begin(), positionTimes.end(), time) - positionTimes.begin());
+	if (i < positionTimes.size() && positionTimes[i] == time) {
+		positionKeys[i] = position;
+	}
+	else {
+		positionTimes.insert(positionTimes.begin() + i, time);
+		positionKeys.insert(positionKeys.begin() + i, position);
+	}
+}
+
+//--------------------------------------------------------------
+// Adds a rotation key keeping the keys sorted by time
+void JointTrack::addRotationKey(float time, glm::quat rotation)
+{
+	int i = (int)(lower_bound(rotationTimes.begin(), rotationTimes.end(), time) - rotationTimes.begin());
+	if (i < rotationTimes.size() && rotationTimes[i] == time) {
+		rotationKeys[i] = rotation;
+	}
+	else {
+		rotationTimes.insert(rotationTimes.begin() + i, time);
+		rotationKeys.insert(rotationKeys.begin() + i, rotation);
+	}
+}
+
+//--------------------------------------------------------------
+// Linearly interpolates the position keys around time
+glm::vec3 JointTrack::samplePosition(float time, int &cursor) const
+{
+	if (positionKeys.size() == 1) return positionKeys[0];
+	cursor = findKey(positionTimes, time, cursor);
+	return glm::mix(positionKeys[cursor], positionKeys[cursor + 1], segmentAlpha(positionTimes, cursor, time));
+}
+
+//--------------------------------------------------------------
+// Spherically interpolates the rotation keys around time
+glm::quat JointTrack::sampleRotation(float time, int &cursor) const
+{
+	if (rotationKeys.size() == 1) return rotationKeys[0];
+	cursor = findKey(rotationTimes, time, cursor);
+	return glm::slerp(rotationKeys[cursor], rotationKeys[cursor + 1], segmentAlpha(rotationTimes, cursor, time));
+}
+
+//--------------------------------------------------------------
+// Returns the time of the last key of the track
+float JointTrack::getEndTime() const
+{
+	float end = 0;
+	if (positionTimes.size() > 0) end = std::max(end, positionTimes.back());
+	if (rotationTimes.size() > 0) end = std::max(end, rotationTimes.back());
+	return end;
+}
+
+//--------------------------------------------------------------
+// Converts a SceneObject rotation (degrees, applied in YXZ order)
+//  to a quaternion
+glm::quat AnimationClip::eulerToQuat(glm::vec3 rotation)
+{
+	return glm::quat_cast(glm::eulerAngleYXZ(glm::radians(rotation.y), glm::radians(rotation.x), glm::radians(rotation.z)));
+}
+
+//--------------------------------------------------------------
+// Converts a quaternion back to a SceneObject rotation
+glm::vec3 AnimationClip::quatToEuler(glm::quat rotation)
+{
+	float yaw, pitch, roll;
+	glm::extractEulerAngleYXZ(glm::mat4_cast(rotation), yaw, pitch, roll);
+	return glm::vec3(glm::degrees(pitch), glm::degrees(yaw), glm::degrees(roll));
+}
+
+//--------------------------------------------------------------
+// Adds a key for the named joint
+void AnimationClip::addKey(const string &jointName, float time, glm::vec3 position, glm::vec3 rotation)
+{
+	int t = findTrack(jointName);
+	if (t < 0) {
+		// create a new track for the joint
+		tracks.push_back(JointTrack());
+		tracks.back().jointName = jointName;
+		t = (int)tracks.size() - 1;
+		version++;
+	}
+	tracks[t].addPositionKey(time, position);
+	tracks[t].addRotationKey(time, eulerToQuat(rotation));
+	duration = std::max(duration, time);
+}
+
+//--------------------------------------------------------------
+// Adds a key for every joint of the skeleton at its current pose
+void AnimationClip::addPose(const Skeleton &skeleton, float time)
+{
+	for (int i = 0; i < skeleton.size(); i++) {
+		addKey(skeleton.names[i], time, glm::vec3(skeleton.posX[i], skeleton.posY[i], skeleton.posZ[i]),
+			glm::vec3(skeleton.rotX[i], skeleton.rotY[i], skeleton.rotZ[i]));
+	}
+}
+
+//--------------------------------------------------------------
+// Maps every track to its joint in the skeleton (if the skeleton or
+//  the clip's tracks changed since the cursors were resolved) and
+//  resets the cursors
+static void resolveJoints(const vector<JointTrack> &tracks, int clipVersion, const Skeleton &skeleton, ClipCursors &cursors)
+{
+	if (cursors.skeleton == &skeleton && cursors.skeletonVersion == skeleton.version &&
+		cursors.clipVersion == clipVersion && cursors.trackToJoint.size() == tracks.size()) return;
+
+	cursors.trackToJoint.resize(tracks.size());
+	for (int t = 0; t < tracks.size(); t++) {
+		cursors.trackToJoint[t] = skeleton.findJoint(tracks[t].jointName);
+	}
+	cursors.positionCursors.assign(tracks.size(), 0);
+	cursors.rotationCursors.assign(tracks.size(), 0);
+	cursors.skeleton = &skeleton;
+	cursors.skeletonVersion = skeleton.version;
+	cursors.clipVersion = clipVersion;
+}
+
+//--------------------------------------------------------------
+// Writes the tracks sampled at time into the local channels of
+//  a Skeleton or a SkeletonPose (both store posX..rotZ arrays)
+template<class Pose>
+static void sampleTracks(const vector<JointTrack> &tracks, float time, Pose &pose, ClipCursors &cursors)
+{
+	for (int t = 0; t < tracks.size(); t++) {
+		int j = cursors.trackToJoint[t];
+		if (j < 0) continue;	// joint is not part of the skeleton
+
+		const JointTrack &track = tracks[t];
+		if (track.positionKeys.size() > 0) {
+			glm::vec3 p = track.samplePosition(time, cursors.positionCursors[t]);
+			pose.posX[j] = p.x; pose.posY[j] = p.y; pose.posZ[j] = p.z;
+		}
+		if (track.rotationKeys.size() > 0) {
+			glm::vec3 r = AnimationClip::quatToEuler(track.sampleRotation(time, cursors.rotationCursors[t]));
+			pose.rotX[j] = r.x; pose.rotY[j] = r.y; pose.rotZ[j] = r.z;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Writes the pose at time into the local channels of the skeleton
+void AnimationClip::sample(float time, Skeleton &skeleton)
+{
+	resolveJoints(tracks, version, skeleton, cursors);
+	sampleTracks(tracks, wrapTime(time), skeleton, cursors);
+}
+
+//--------------------------------------------------------------
+// Writes the pose at time into an instance pose of the skeleton
+void AnimationClip::sample(float time, const Skeleton &skeleton, SkeletonPose &pose, ClipCursors &cursors) const
+{
+	resolveJoints(tracks, version, skeleton, cursors);
+	sampleTracks(tracks, wrapTime(time), pose, cursors);
+}
+
+//--------------------------------------------------------------
+// Wraps time into [0, duration] when looping, otherwise clamps it
+float AnimationClip::wrapTime(float time) const
+{
+	if (duration <= 0) return 0;
+	if (bLoop) {
+		time = fmod(time, duration);
+		if (time < 0) time += duration;
+		return time;
+	}
+	return glm::clamp(time, 0.0f, duration);
+}
+
+//--------------------------------------------------------------
+// Removes every track and key from the clip
+void AnimationClip::clear()
+{
+	tracks.clear();
+	duration = 0;
+	version++;
+}
+
+//--------------------------------------------------------------
+// Returns the index of the named joint's track or -1
+int AnimationClip::findTrack(const string &jointName) const
+{
+	for (int t = 0; t < tracks.size(); t++) {
+		if (tracks[t].jointName == jointName) return t;
+	}
+	return -1;
+}
+
+//--------------------------------------------------------------
+// Returns the total number of keys in the clip
+int AnimationClip::getNumKeys() const
+{
+	int count = 0;
+	for (int t = 0; t < tracks.size(); t++) {
+		count += (int)(tracks[t].positionKeys.size() + tracks[t].rotationKeys.size());
+	}
+	return count;
+}
+
+//--------------------------------------------------------------
+// Saves the clip to a text file with one line per key:
+//  "poskey -joint <name> -time <t> -translate <x, y, z>"
+//  "rotkey -joint <name> -time <t> -quat <w, x, y, z>"
+bool AnimationClip::save(const string &fileName) const
+{
+	ofstream outputStream;	// output stream for new file
+	outputStream.open(fileName);
+	if (!outputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	outputStream << "clip -name " << name << " -loop " << (bLoop ? 1 : 0) << "\n";
+	for (int t = 0; t < tracks.size(); t++) {
+		const JointTrack &track = tracks[t];
+		for (int k = 0; k < track.positionKeys.size(); k++) {
+			glm::vec3 p = track.positionKeys[k];
+			outputStream << "poskey -joint " << track.jointName << " -time " << track.positionTimes[k]
+				<< " -translate <" << p.x << ", " << p.y << ", " << p.z << ">\n";
+		}
+		for (int k = 0; k < track.rotationKeys.size(); k++) {
+			glm::quat q = track.rotationKeys[k];
+			outputStream << "rotkey -joint " << track.jointName << " -time " << track.rotationTimes[k]
+				<< " -quat <" << q.w << ", " << q.x << ", " << q.y << ", " << q.z << ">\n";
+		}
+	}
+	outputStream.close();
+	return true;
+}
+
+//--------------------------------------------------------------
+// Loads a clip saved by save()
+bool AnimationClip::load(const string &fileName)
+{
+	ifstream inputStream;	// input stream
+	string line;			// current line of the file
+	inputStream.open(fileName);
+	if (!inputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	clear();
+	while (getline(inputStream, line)) {
+		// treat vector punctuation as whitespace
+		for (int i = 0; i < line.size(); i++) {
+			if (line[i] == '<' || line[i] == '>' || line[i] == ',') line[i] = ' ';
+		}
+		istringstream lineStream(line);
+		string read, jointName;
+		float time = 0;
+		glm::vec3 p;
+		glm::quat q;
+		bool bPosKey = false;
+		bool bRotKey = false;
+
+		while (lineStream >> read) {
+			if (read == "-name") lineStream >> name;
+			else if (read == "-loop") lineStream >> bLoop;
+			else if (read == "-joint") lineStream >> jointName;
+			else if (read == "-time") lineStream >> time;
+			else if (read == "-translate") { lineStream >> p.x >> p.y >> p.z; bPosKey = true; }
+			else if (read == "-quat") { lineStream >> q.w >> q.x >> q.y >> q.z; bRotKey = true; }
+		}
+		if (jointName.empty() || !(bPosKey || bRotKey)) continue;
+
+		// add the key to the joint's track
+		int t = findTrack(jointName);
+		if (t < 0) {
+			tracks.push_back(JointTrack());
+			tracks.back().jointName = jointName;
+			t = (int)tracks.size() - 1;
+			version++;
+		}
+		if (bPosKey) tracks[t].addPositionKey(time, p);
+		if (bRotKey) tracks[t].addRotationKey(time, q);
+		duration = std::max(duration, time);
+	}
+	inputStream.close();
+	return true;
+}
@@ -0,0 +1,101 @@
+// This file provides definitions for the JointTrack and AnimationClip
+//  classes. A clip holds one keyframe track per animated joint; each track
+//  stores its keys in time sorted contiguous arrays and remembers the key
+//  it sampled last, so sampling a clip that plays forward is a constant
+//  time lookup per track.
+
+#pragma once
+
+#include "ofMain.h"
+#include "glm/gtx/euler_angles.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "Skeleton.h"
+
+// JointTrack class
+//
+class JointTrack {
+public:
+	// Adds a key at the given time (replaces an existing key at that time)
+	void addPositionKey(float time, glm::vec3 position);
+	void addRotationKey(float time, glm::quat rotation);
+
+	// Samples the track at the given time. cursor holds the index of the
+	//  key sampled last and is updated to the key used this time.
+	glm::vec3 samplePosition(float time, int &cursor) const;
+	glm::quat sampleRotation(float time, int &cursor) const;
+
+	// Returns the time of the last key of the track
+	float getEndTime() const;
+
+	// Fields of JointTrack class
+	//
+	string jointName;					// name of the joint animated by this track
+	vector<float> positionTimes;		// time of each position key (sorted)
+	vector<glm::vec3> positionKeys;		// local position of each key
+	vector<float> rotationTimes;		// time of each rotation key (sorted)
+	vector<glm::quat> rotationKeys;		// local rotation of each key
+};
+
+// ClipCursors: the playback state of one user of a clip (the joint each
+//  track maps to and the key each track sampled last). Every skeleton
+//  instance playing a shared clip keeps its own cursors.
+//
+struct ClipCursors {
+	vector<int> trackToJoint;				// skeleton index of each track's joint
+	vector<int> positionCursors;			// last position key sampled on each track
+	vector<int> rotationCursors;			// last rotation key sampled on each track
+	const Skeleton *skeleton = NULL;		// skeleton the tracks were resolved against
+	int skeletonVersion = -1;				// version of that skeleton when they were resolved
+	int clipVersion = -1;					// version of the clip's tracks when they were resolved
+};
+
+// AnimationClip class
+//
+class AnimationClip {
+public:
+	// Adds a key for the named joint (creates its track if needed)
+	void addKey(const string &jointName, float time, glm::vec3 position, glm::vec3 rotation);
+
+	// Adds a key for every joint of the skeleton at its current pose
+	void addPose(const Skeleton &skeleton, float time);
+
+	// Writes the pose of the clip at the given time into the local channels
+	//  of the skeleton (joints without a track are left untouched)
+	void sample(float time, Skeleton &skeleton);
+
+	// Writes the pose of the clip at the given time into an instance pose of
+	//  the skeleton. The clip is only read, so many instances can sample it
+	//  in parallel as long as each has its own cursors.
+	void sample(float time, const Skeleton &skeleton, SkeletonPose &pose, ClipCursors &cursors) const;
+
+	// Wraps or clamps time into the range of the clip
+	float wrapTime(float time) const;
+
+	// Removes every track and key from the clip
+	void clear();
+
+	// Returns the index of the track of the named joint (-1 if there is none)
+	int findTrack(const string &jointName) const;
+
+	// Returns the total number of position and rotation keys
+	int getNumKeys() const;
+
+	// Saves the clip to / loads the clip from a text file
+	bool save(const string &fileName) const;
+	bool load(const string &fileName);
+
+	// Converts between SceneObject euler rotations (degrees, YXZ order) and quaternions
+	static glm::quat eulerToQuat(glm::vec3 rotation);
+	static glm::vec3 quatToEuler(glm::quat rotation);
+
+	// Fields of AnimationClip class
+	//
+	string name = "clip";			// name of the clip
+	float duration = 0;				// time of the last key in seconds
+	bool bLoop = true;				// whether playback wraps around or holds the last key
+	vector<JointTrack> tracks;		// one track per animated joint
+	int version = 0;				// incremented whenever tracks are added or removed
+
+private:
+	ClipCursors cursors;	// playback state of sample(time, skeleton)
+};
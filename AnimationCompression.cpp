@@ -0,0 +1,609 @@
+// This file provides implementation of the CompressedClip class
+//  methods and the compression report tool.
+
+#include "AnimationCompression.h"
+
+// number of uint16 values stored per key (time + three components)
+static const int KEY_STRIDE = 4;
+// largest quantized value
+static const float QUANT_MAX = 65535.0f;
+
+//--------------------------------------------------------------
+// Maps v from [min, min + extent] to a 16 bit integer
+static uint16_t quantize(float v, float min, float extent)
+{
+	if (extent <= 0) return 0;
+	return (uint16_t)(glm::clamp((v - min) / extent, 0.0f, 1.0f) * QUANT_MAX + 0.5f);
+}
+
+//--------------------------------------------------------------
+// Maps a 16 bit integer back to [min, min + extent]
+static inline float dequantize(uint16_t q, float min, float extent)
+{
+	return min + q * (extent / QUANT_MAX);
+}
+
+//--------------------------------------------------------------
+// Decodes the position stored in a key
+static inline glm::vec3 decodePosition(const uint16_t *key, const CompressedTrack &track)
+{
+	return glm::vec3(dequantize(key[1], track.positionMin.x, track.positionExtent.x),
+		dequantize(key[2], track.positionMin.y, track.positionExtent.y),
+		dequantize(key[3], track.positionMin.z, track.positionExtent.z));
+}
+
+//--------------------------------------------------------------
+// Decodes the rotation stored in a key (w is always positive and
+//  reconstructed from the unit length of the quaternion)
+static inline glm::quat decodeRotation(const uint16_t *key, const CompressedTrack &track)
+{
+	float x = dequantize(key[1], track.rotationMin.x, track.rotationExtent.x);
+	float y = dequantize(key[2], track.rotationMin.y, track.rotationExtent.y);
+	float z = dequantize(key[3], track.rotationMin.z, track.rotationExtent.z);
+	float w = sqrt(std::max(0.0f, 1.0f - x * x - y * y - z * z));
+	return glm::normalize(glm::quat(w, x, y, z));
+}
+
+//--------------------------------------------------------------
+// Returns the index i of the key segment [key i, key i + 1]
+//  containing the quantized time. Keys are read in place from
+//  the stream; the search starts at the cursor like findKey in
+//  Animation.cpp.
+static int findStreamKey(const uint16_t *keys, int count, float timeQ, int cursor)
+{
+	int last = count - 2;	// index of the last segment
+	if (last <= 0) return 0;
+
+	// try the cached segment and the next couple of segments
+	cursor = glm::clamp(cursor, 0, last);
+	if (timeQ >= keys[cursor * KEY_STRIDE]) {
+		for (int step = 0; step < 3; step++) {
+			if (cursor == last || timeQ < keys[(cursor + 1) * KEY_STRIDE]) return cursor;
+			cursor++;
+		}
+	}
+
+	// binary search for the last key at or before timeQ
+	int low = 0;
+	int high = last;
+	while (low < high) {
+		int mid = (low + high + 1) / 2;
+		if (keys[mid * KEY_STRIDE] <= timeQ) low = mid;
+		else high = mid - 1;
+	}
+	return low;
+}
+
+//--------------------------------------------------------------
+// Returns the indices of the keys to keep: a key is dropped if
+//  interpolating between the kept keys around it reproduces it
+//  within budget, and a track whose keys all match the first key
+//  within budget collapses to that single key
+template<class T, class Interpolate, class Error>
+static vector<int> reduceKeys(const vector<float> &times, const vector<T> &keys,
+	Interpolate interpolate, Error error, float budget)
+{
+	vector<int> kept;
+	int n = (int)keys.size();
+	if (n == 0) return kept;
+
+	// constant track elimination
+	bool bConstant = true;
+	for (int k = 1; k < n && bConstant; k++) {
+		if (error(keys[0], keys[k]) > budget) bConstant = false;
+	}
+	kept.push_back(0);
+	if (bConstant) return kept;
+
+	// linear key elimination: grow a segment from the last kept key until
+	//  one of the keys it skips can no longer be reproduced
+	int anchor = 0;
+	for (int end = 2; end < n; end++) {
+		for (int k = anchor + 1; k < end; k++) {
+			float span = times[end] - times[anchor];
+			float alpha = span > 0 ? (times[k] - times[anchor]) / span : 0.0f;
+			if (error(interpolate(keys[anchor], keys[end], alpha), keys[k]) > budget) {
+				// keep the key before the segment failed
+				anchor = end - 1;
+				kept.push_back(anchor);
+				break;
+			}
+		}
+	}
+	kept.push_back(n - 1);
+	return kept;
+}
+
+//--------------------------------------------------------------
+// Computes for every joint the length of the longest chain below
+//  it (its reach, at least leafReach) and the number of joints on
+//  the longest root to leaf path through it. leafReach is the
+//  average bone length and stands in for the reach of end-effectors.
+static void computeChains(const Skeleton &skeleton, vector<float> &reach, vector<int> &depth, float &leafReach)
+{
+	int n = skeleton.size();
+
+	// average bone length
+	float totalLength = 0;
+	int numBones = 0;
+	for (int i = 0; i < n; i++) {
+		if (skeleton.parents[i] >= 0) {
+			totalLength += glm::length(glm::vec3(skeleton.posX[i], skeleton.posY[i], skeleton.posZ[i]));
+			numBones++;
+		}
+	}
+	leafReach = (numBones > 0 && totalLength > 0) ? totalLength / numBones : 1.0f;
+
+	// longest chain below each joint (children come after parents, so walk backwards)
+	reach.assign(n, 0.0f);
+	vector<int> below(n, 1);
+	for (int i = n - 1; i >= 0; i--) {
+		reach[i] = std::max(reach[i], leafReach);
+		int p = skeleton.parents[i];
+		if (p >= 0) {
+			float boneLength = glm::length(glm::vec3(skeleton.posX[i], skeleton.posY[i], skeleton.posZ[i]));
+			reach[p] = std::max(reach[p], reach[i] + boneLength);
+			below[p] = std::max(below[p], below[i] + 1);
+		}
+	}
+
+	// joints above each joint (parents come before children, so walk forwards)
+	vector<int> above(n, 1);
+	depth.assign(n, 1);
+	for (int i = 0; i < n; i++) {
+		int p = skeleton.parents[i];
+		if (p >= 0) above[i] = above[p] + 1;
+		depth[i] = above[i] + below[i] - 1;
+	}
+}
+
+//--------------------------------------------------------------
+// Returns the number of stream time units per second. If every key
+//  lies on the frame grid of a common frame rate, times are stored
+//  as exact frame numbers; otherwise the clip's duration is spread
+//  over the full 16 bit range.
+static float chooseTimeScale(const AnimationClip &clip)
+{
+	const float rates[] = { 24, 25, 30, 48, 50, 60, 100, 120, 240 };
+	for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		if (clip.duration * rates[r] > QUANT_MAX) break;
+		bool bOnGrid = true;
+		for (int t = 0; t < clip.tracks.size() && bOnGrid; t++) {
+			const JointTrack &track = clip.tracks[t];
+			for (int k = 0; k < track.positionTimes.size() && bOnGrid; k++) {
+				float frame = track.positionTimes[k] * rates[r];
+				bOnGrid = fabs(frame - round(frame)) < 1e-3f;
+			}
+			for (int k = 0; k < track.rotationTimes.size() && bOnGrid; k++) {
+				float frame = track.rotationTimes[k] * rates[r];
+				bOnGrid = fabs(frame - round(frame)) < 1e-3f;
+			}
+		}
+		if (bOnGrid) return rates[r];
+	}
+	return clip.duration > 0 ? QUANT_MAX / clip.duration : 0.0f;
+}
+
+//--------------------------------------------------------------
+// Compresses the clip within tolerance
+void CompressedClip::compress(const AnimationClip &clip, const Skeleton &skeleton, float tolerance)
+{
+	name = clip.name;
+	duration = clip.duration;
+	bLoop = clip.bLoop;
+	tracks.clear();
+	stream.clear();
+	lastSkeleton = NULL;
+
+	// per joint reach and chain depth
+	vector<float> reach;
+	vector<int> depth;
+	float leafReach;
+	computeChains(skeleton, reach, depth, leafReach);
+
+	// quantizes a key time to stream time units
+	timeScale = chooseTimeScale(clip);
+	auto quantizeTime = [&](float t) { return (uint16_t)glm::clamp(t * timeScale + 0.5f, 0.0f, QUANT_MAX); };
+
+	for (int t = 0; t < clip.tracks.size(); t++) {
+		const JointTrack &source = clip.tracks[t];
+		CompressedTrack track;
+		track.jointName = source.jointName;
+
+		// split the joint's share of the tolerance between position and rotation
+		int j = skeleton.findJoint(source.jointName);
+		float budget = tolerance / (j >= 0 ? depth[j] : 1);
+		float jointReach = j >= 0 ? reach[j] : leafReach;
+
+		// position keys
+		if (source.positionKeys.size() > 0) {
+			glm::vec3 minimum = source.positionKeys[0];
+			glm::vec3 maximum = source.positionKeys[0];
+			for (int k = 1; k < source.positionKeys.size(); k++) {
+				minimum = glm::min(minimum, source.positionKeys[k]);
+				maximum = glm::max(maximum, source.positionKeys[k]);
+			}
+			track.positionMin = minimum;
+			track.positionExtent = maximum - minimum;
+
+			// leave room in the budget for the quantization error
+			float quantError = 0.5f * glm::length(track.positionExtent) / QUANT_MAX;
+			float keyBudget = std::max(0.0f, 0.5f * budget - quantError);
+			vector<int> kept = reduceKeys(source.positionTimes, source.positionKeys,
+				[](const glm::vec3 &a, const glm::vec3 &b, float alpha) { return glm::mix(a, b, alpha); },
+				[](const glm::vec3 &a, const glm::vec3 &b) { return glm::distance(a, b); }, keyBudget);
+
+			track.positionOffset = (int)stream.size() / KEY_STRIDE;
+			track.positionCount = (int)kept.size();
+			for (int k = 0; k < kept.size(); k++) {
+				glm::vec3 p = source.positionKeys[kept[k]];
+				stream.push_back(quantizeTime(source.positionTimes[kept[k]]));
+				stream.push_back(quantize(p.x, minimum.x, track.positionExtent.x));
+				stream.push_back(quantize(p.y, minimum.y, track.positionExtent.y));
+				stream.push_back(quantize(p.z, minimum.z, track.positionExtent.z));
+			}
+		}
+
+		// rotation keys (flipped so w is positive, since w is not stored)
+		if (source.rotationKeys.size() > 0) {
+			vector<glm::quat> rotations = source.rotationKeys;
+			for (int k = 0; k < rotations.size(); k++) {
+				rotations[k] = glm::normalize(rotations[k]);
+				if (rotations[k].w < 0) rotations[k] = -rotations[k];
+			}
+			glm::vec3 minimum = glm::vec3(rotations[0].x, rotations[0].y, rotations[0].z);
+			glm::vec3 maximum = minimum;
+			for (int k = 1; k < rotations.size(); k++) {
+				glm::vec3 v = glm::vec3(rotations[k].x, rotations[k].y, rotations[k].z);
+				minimum = glm::min(minimum, v);
+				maximum = glm::max(maximum, v);
+			}
+			track.rotationMin = minimum;
+			track.rotationExtent = maximum - minimum;
+
+			// a quaternion error e moves a point at distance reach by about 2 * reach * e
+			float quantError = 2.0f * jointReach * glm::length(track.rotationExtent) / QUANT_MAX;
+			float keyBudget = std::max(0.0f, 0.5f * budget - quantError);
+			vector<int> kept = reduceKeys(source.rotationTimes, rotations,
+				[](const glm::quat &a, const glm::quat &b, float alpha) { return glm::slerp(a, b, alpha); },
+				[jointReach](const glm::quat &a, const glm::quat &b) {
+					// displacement at the end-effector: 2 * reach * sin(angle / 2). The sine
+					//  comes from the chord between the quaternions, since 1 - dot^2 cancels
+					//  to zero in float for small angles.
+					glm::quat d = glm::dot(a, b) < 0 ? a + b : a - b;
+					float chord = sqrt(d.w * d.w + d.x * d.x + d.y * d.y + d.z * d.z);
+					return 2.0f * jointReach * chord * sqrt(std::max(0.0f, 1.0f - 0.25f * chord * chord));
+				}, keyBudget);
+
+			track.rotationOffset = (int)stream.size() / KEY_STRIDE;
+			track.rotationCount = (int)kept.size();
+			for (int k = 0; k < kept.size(); k++) {
+				glm::quat q = rotations[kept[k]];
+				stream.push_back(quantizeTime(source.rotationTimes[kept[k]]));
+				stream.push_back(quantize(q.x, minimum.x, track.rotationExtent.x));
+				stream.push_back(quantize(q.y, minimum.y, track.rotationExtent.y));
+				stream.push_back(quantize(q.z, minimum.z, track.rotationExtent.z));
+			}
+		}
+		tracks.push_back(track);
+	}
+}
+
+//--------------------------------------------------------------
+// Maps every track to its joint in the skeleton and resets
+//  the cached cursors
+void CompressedClip::resolveJoints(const Skeleton &skeleton)
+{
+	trackToJoint.resize(tracks.size());
+	for (int t = 0; t < tracks.size(); t++) {
+		trackToJoint[t] = skeleton.findJoint(tracks[t].jointName);
+	}
+	positionCursors.assign(tracks.size(), 0);
+	rotationCursors.assign(tracks.size(), 0);
+	lastSkeleton = &skeleton;
+	lastSkeletonVersion = skeleton.version;
+}
+
+//--------------------------------------------------------------
+// Samples the clip straight from the compressed stream
+void CompressedClip::sample(float time, Skeleton &skeleton)
+{
+	// re-resolve the tracks if the skeleton changed
+	if (lastSkeleton != &skeleton || lastSkeletonVersion != skeleton.version || trackToJoint.size() != tracks.size()) {
+		resolveJoints(skeleton);
+	}
+
+	// time in the quantized units of the stream
+	time = wrapTime(time);
+	float timeQ = time * timeScale;
+
+	for (int t = 0; t < tracks.size(); t++) {
+		int j = trackToJoint[t];
+		if (j < 0) continue;	// joint is not part of the skeleton
+		const CompressedTrack &track = tracks[t];
+
+		// position: decode the two keys around time and interpolate linearly
+		if (track.positionCount > 0) {
+			const uint16_t *keys = &stream[track.positionOffset * KEY_STRIDE];
+			glm::vec3 p;
+			if (track.positionCount == 1) {
+				p = decodePosition(keys, track);
+			}
+			else {
+				int i = positionCursors[t] = findStreamKey(keys, track.positionCount, timeQ, positionCursors[t]);
+				const uint16_t *k0 = keys + i * KEY_STRIDE;
+				const uint16_t *k1 = k0 + KEY_STRIDE;
+				float span = (float)k1[0] - k0[0];
+				float alpha = span > 0 ? glm::clamp((timeQ - k0[0]) / span, 0.0f, 1.0f) : 0.0f;
+				p = glm::mix(decodePosition(k0, track), decodePosition(k1, track), alpha);
+			}
+			skeleton.posX[j] = p.x; skeleton.posY[j] = p.y; skeleton.posZ[j] = p.z;
+		}
+
+		// rotation: decode the two keys around time and slerp
+		if (track.rotationCount > 0) {
+			const uint16_t *keys = &stream[track.rotationOffset * KEY_STRIDE];
+			glm::quat q;
+			if (track.rotationCount == 1) {
+				q = decodeRotation(keys, track);
+			}
+			else {
+				int i = rotationCursors[t] = findStreamKey(keys, track.rotationCount, timeQ, rotationCursors[t]);
+				const uint16_t *k0 = keys + i * KEY_STRIDE;
+				const uint16_t *k1 = k0 + KEY_STRIDE;
+				float span = (float)k1[0] - k0[0];
+				float alpha = span > 0 ? glm::clamp((timeQ - k0[0]) / span, 0.0f, 1.0f) : 0.0f;
+				q = glm::slerp(decodeRotation(k0, track), decodeRotation(k1, track), alpha);
+			}
+			glm::vec3 r = AnimationClip::quatToEuler(q);
+			skeleton.rotX[j] = r.x; skeleton.rotY[j] = r.y; skeleton.rotZ[j] = r.z;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Wraps time into [0, duration] when looping, otherwise clamps it
+float CompressedClip::wrapTime(float time) const
+{
+	if (duration <= 0) return 0;
+	if (bLoop) {
+		time = fmod(time, duration);
+		if (time < 0) time += duration;
+		return time;
+	}
+	return glm::clamp(time, 0.0f, duration);
+}
+
+//--------------------------------------------------------------
+// Returns the size of the compressed keys, the track table and
+//  the joint names in bytes
+size_t CompressedClip::getSizeInBytes() const
+{
+	size_t size = stream.size() * sizeof(uint16_t);
+	for (int t = 0; t < tracks.size(); t++) {
+		size += 4 * sizeof(int) + 12 * sizeof(float) + tracks[t].jointName.size();
+	}
+	return size;
+}
+
+//--------------------------------------------------------------
+// Returns the size of the clip's float keys and joint names in bytes
+size_t CompressedClip::getRawSizeInBytes(const AnimationClip &clip)
+{
+	size_t size = 0;
+	for (int t = 0; t < clip.tracks.size(); t++) {
+		const JointTrack &track = clip.tracks[t];
+		size += track.positionTimes.size() * sizeof(float) + track.positionKeys.size() * sizeof(glm::vec3);
+		size += track.rotationTimes.size() * sizeof(float) + track.rotationKeys.size() * sizeof(glm::quat);
+		size += track.jointName.size();
+	}
+	return size;
+}
+
+//--------------------------------------------------------------
+// Returns the number of keys kept after compression
+int CompressedClip::getNumKeys() const
+{
+	return (int)stream.size() / KEY_STRIDE;
+}
+
+//--------------------------------------------------------------
+// Writes a string as its length followed by its characters
+static void writeString(ofstream &outputStream, const string &s)
+{
+	uint32_t length = (uint32_t)s.size();
+	outputStream.write((const char *)&length, sizeof(length));
+	outputStream.write(s.data(), length);
+}
+
+//--------------------------------------------------------------
+// Reads a string written by writeString
+static bool readString(ifstream &inputStream, string &s)
+{
+	uint32_t length = 0;
+	if (!inputStream.read((char *)&length, sizeof(length)) || length > (1 << 20)) return false;
+	s.resize(length);
+	return (bool)inputStream.read(&s[0], length);
+}
+
+//--------------------------------------------------------------
+// Saves the compressed clip as a binary file
+bool CompressedClip::save(const string &fileName) const
+{
+	ofstream outputStream(fileName, ios::binary);
+	if (!outputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	// header
+	outputStream.write("MACC", 4);
+	writeString(outputStream, name);
+	outputStream.write((const char *)&duration, sizeof(duration));
+	outputStream.write((const char *)&timeScale, sizeof(timeScale));
+	uint8_t loop = bLoop ? 1 : 0;
+	outputStream.write((const char *)&loop, sizeof(loop));
+
+	// track table
+	uint32_t numTracks = (uint32_t)tracks.size();
+	outputStream.write((const char *)&numTracks, sizeof(numTracks));
+	for (int t = 0; t < tracks.size(); t++) {
+		const CompressedTrack &track = tracks[t];
+		writeString(outputStream, track.jointName);
+		int32_t counts[4] = { track.positionOffset, track.positionCount, track.rotationOffset, track.rotationCount };
+		float ranges[12] = { track.positionMin.x, track.positionMin.y, track.positionMin.z,
+			track.positionExtent.x, track.positionExtent.y, track.positionExtent.z,
+			track.rotationMin.x, track.rotationMin.y, track.rotationMin.z,
+			track.rotationExtent.x, track.rotationExtent.y, track.rotationExtent.z };
+		outputStream.write((const char *)counts, sizeof(counts));
+		outputStream.write((const char *)ranges, sizeof(ranges));
+	}
+
+	// key stream
+	uint32_t streamSize = (uint32_t)stream.size();
+	outputStream.write((const char *)&streamSize, sizeof(streamSize));
+	outputStream.write((const char *)stream.data(), streamSize * sizeof(uint16_t));
+	return (bool)outputStream;
+}
+
+//--------------------------------------------------------------
+// Loads a compressed clip saved by save()
+bool CompressedClip::load(const string &fileName)
+{
+	ifstream inputStream(fileName, ios::binary);
+	char magic[4];
+	if (!inputStream || !inputStream.read(magic, 4) || strncmp(magic, "MACC", 4) != 0) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	// header
+	uint8_t loop = 1;
+	uint32_t numTracks = 0;
+	readString(inputStream, name);
+	inputStream.read((char *)&duration, sizeof(duration));
+	inputStream.read((char *)&timeScale, sizeof(timeScale));
+	inputStream.read((char *)&loop, sizeof(loop));
+	inputStream.read((char *)&numTracks, sizeof(numTracks));
+	bLoop = loop != 0;
+
+	// track table
+	tracks.clear();
+	for (uint32_t t = 0; t < numTracks && inputStream; t++) {
+		CompressedTrack track;
+		int32_t counts[4];
+		float ranges[12];
+		readString(inputStream, track.jointName);
+		inputStream.read((char *)counts, sizeof(counts));
+		inputStream.read((char *)ranges, sizeof(ranges));
+		track.positionOffset = counts[0]; track.positionCount = counts[1];
+		track.rotationOffset = counts[2]; track.rotationCount = counts[3];
+		track.positionMin = glm::vec3(ranges[0], ranges[1], ranges[2]);
+		track.positionExtent = glm::vec3(ranges[3], ranges[4], ranges[5]);
+		track.rotationMin = glm::vec3(ranges[6], ranges[7], ranges[8]);
+		track.rotationExtent = glm::vec3(ranges[9], ranges[10], ranges[11]);
+		tracks.push_back(track);
+	}
+
+	// key stream
+	uint32_t streamSize = 0;
+	inputStream.read((char *)&streamSize, sizeof(streamSize));
+	stream.resize(streamSize);
+	inputStream.read((char *)stream.data(), streamSize * sizeof(uint16_t));
+	lastSkeleton = NULL;
+
+	// reject files whose tracks point outside of the stream (a negative
+	//  offset or count, or a sum past its end, summed without overflowing)
+	for (int t = 0; t < tracks.size(); t++) {
+		const CompressedTrack &track = tracks[t];
+		if (track.positionOffset < 0 || track.positionCount < 0 || track.rotationOffset < 0 || track.rotationCount < 0 ||
+			((int64_t)track.positionOffset + track.positionCount) * KEY_STRIDE > (int64_t)stream.size() ||
+			((int64_t)track.rotationOffset + track.rotationCount) * KEY_STRIDE > (int64_t)stream.size()) {
+			inputStream.setstate(ios::failbit);
+		}
+	}
+	if (!inputStream) {
+		cout << "Compressed clip " << fileName << " is corrupt" << endl;
+		tracks.clear();
+		stream.clear();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Evaluates both clips at every key time and at sampleRate
+//  samples per second, and returns the largest distance between
+//  corresponding joints and leaf end-effectors in world space
+float measureCompressionError(AnimationClip &clip, CompressedClip &compressed,
+	const Skeleton &skeleton, float sampleRate)
+{
+	// sample times
+	vector<float> times;
+	for (int t = 0; t < clip.tracks.size(); t++) {
+		times.insert(times.end(), clip.tracks[t].positionTimes.begin(), clip.tracks[t].positionTimes.end());
+		times.insert(times.end(), clip.tracks[t].rotationTimes.begin(), clip.tracks[t].rotationTimes.end());
+	}
+	for (float t = 0; t < clip.duration; t += 1.0f / sampleRate) {
+		times.push_back(t);
+	}
+
+	// end-effector offset of every leaf joint (along its bone, one average bone length long)
+	vector<float> reach;
+	vector<int> depth;
+	float leafReach;
+	computeChains(skeleton, reach, depth, leafReach);
+	vector<bool> isLeaf(skeleton.size(), true);
+	for (int i = 0; i < skeleton.size(); i++) {
+		if (skeleton.parents[i] >= 0) isLeaf[skeleton.parents[i]] = false;
+	}
+
+	// pose both clips on their own copy of the skeleton and compare
+	Skeleton original = skeleton;
+	Skeleton decoded = skeleton;
+	float maxError = 0;
+	for (int n = 0; n < times.size(); n++) {
+		clip.sample(times[n], original);
+		compressed.sample(times[n], decoded);
+		original.evaluate();
+		decoded.evaluate();
+		for (int i = 0; i < skeleton.size(); i++) {
+			maxError = std::max(maxError, glm::distance(original.getWorldPosition(i), decoded.getWorldPosition(i)));
+			if (isLeaf[i]) {
+				glm::vec3 bone = glm::vec3(skeleton.posX[i], skeleton.posY[i], skeleton.posZ[i]);
+				glm::vec4 tip = glm::vec4(glm::length(bone) > 0 ? glm::normalize(bone) * leafReach : glm::vec3(0, leafReach, 0), 1);
+				maxError = std::max(maxError, glm::distance(glm::vec3(original.worldMatrices[i] * tip),
+					glm::vec3(decoded.worldMatrices[i] * tip)));
+			}
+		}
+	}
+	return maxError;
+}
+
+//--------------------------------------------------------------
+// Compresses each clip and prints its compression ratio and
+//  maximum end-effector error
+void printCompressionReport(vector<AnimationClip> &clips, const Skeleton &skeleton, float tolerance)
+{
+	cout << "Animation compression report (tolerance " << tolerance << ", " << skeleton.size() << " joints):" << endl;
+	size_t totalRaw = 0;
+	size_t totalCompressed = 0;
+	for (int c = 0; c < clips.size(); c++) {
+		CompressedClip compressed;
+		compressed.compress(clips[c], skeleton, tolerance);
+		float maxError = measureCompressionError(clips[c], compressed, skeleton);
+		size_t raw = CompressedClip::getRawSizeInBytes(clips[c]);
+		size_t packed = compressed.getSizeInBytes();
+		totalRaw += raw;
+		totalCompressed += packed;
+
+		cout << "  " << clips[c].name << ": " << clips[c].getNumKeys() << " -> " << compressed.getNumKeys() << " keys, "
+			<< raw << " -> " << packed << " bytes, ratio " << (packed > 0 ? (double)raw / packed : 0.0)
+			<< ":1, max error " << maxError << (maxError > tolerance ? " (EXCEEDS TOLERANCE)" : "") << endl;
+	}
+	if (clips.size() > 1) {
+		cout << "  total: " << totalRaw << " -> " << totalCompressed << " bytes, ratio "
+			<< (totalCompressed > 0 ? (double)totalRaw / totalCompressed : 0.0) << ":1" << endl;
+	}
+	cout << endl;
+}
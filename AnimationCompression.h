@@ -0,0 +1,84 @@
+// This file provides the definition of the CompressedClip class, a
+//  compact encoding of an AnimationClip that can be sampled directly.
+// Compression removes keys that interpolation reproduces within an error
+//  tolerance (constant tracks collapse to a single key), then stores the
+//  remaining keys as 16 bit values quantized over each track's own range.
+// The tolerance is a distance in world units measured at the joints'
+//  end-effectors: a rotation error is scaled by the length of the longest
+//  chain below the joint, and the budget is split along the chain.
+
+#pragma once
+
+#include "ofMain.h"
+#include "Animation.h"
+
+// CompressedTrack: location and range of one joint's keys in the stream
+//
+struct CompressedTrack {
+	string jointName;				// name of the joint animated by this track
+	int positionOffset = 0;			// index of the first position key in the stream
+	int positionCount = 0;			// number of position keys
+	int rotationOffset = 0;			// index of the first rotation key in the stream
+	int rotationCount = 0;			// number of rotation keys
+	glm::vec3 positionMin;			// minimum of each position component
+	glm::vec3 positionExtent;		// range of each position component
+	glm::vec3 rotationMin;			// minimum of each quaternion x, y, z component (w is reconstructed)
+	glm::vec3 rotationExtent;		// range of each quaternion x, y, z component
+};
+
+// CompressedClip class
+//
+class CompressedClip {
+public:
+	// Compresses the clip. The skeleton provides the hierarchy and bone
+	//  lengths used to turn the tolerance into per joint error budgets.
+	void compress(const AnimationClip &clip, const Skeleton &skeleton, float tolerance);
+
+	// Writes the pose at the given time into the local channels of the
+	//  skeleton, decoding only the keys around that time
+	void sample(float time, Skeleton &skeleton);
+
+	// Wraps or clamps time into the range of the clip
+	float wrapTime(float time) const;
+
+	// Returns the number of bytes used by the compressed keys and track table
+	size_t getSizeInBytes() const;
+
+	// Returns the number of bytes the clip's keys use uncompressed
+	static size_t getRawSizeInBytes(const AnimationClip &clip);
+
+	// Returns the number of keys kept after compression
+	int getNumKeys() const;
+
+	// Saves the compressed clip to / loads it from a binary file
+	bool save(const string &fileName) const;
+	bool load(const string &fileName);
+
+	// Fields of CompressedClip class
+	//
+	string name = "clip";				// name of the clip
+	float duration = 0;					// time of the last key in seconds
+	float timeScale = 0;				// stream time units per second (the key rate when keys lie on a frame grid)
+	bool bLoop = true;					// whether playback wraps around or holds the last key
+	vector<CompressedTrack> tracks;		// one track per animated joint
+	vector<uint16_t> stream;			// keys as (time, value, value, value) quadruples
+
+private:
+	// Maps every track to its joint in the skeleton (by name)
+	void resolveJoints(const Skeleton &skeleton);
+
+	vector<int> trackToJoint;				// skeleton index of each track's joint
+	vector<int> positionCursors;			// last position key sampled on each track
+	vector<int> rotationCursors;			// last rotation key sampled on each track
+	const Skeleton *lastSkeleton = NULL;	// skeleton the tracks were resolved against
+	int lastSkeletonVersion = -1;			// version of that skeleton when they were resolved
+};
+
+// Measures the largest distance between any joint's world position in the
+//  original and the compressed clip, sampled at every key time and at
+//  sampleRate samples per second
+float measureCompressionError(AnimationClip &clip, CompressedClip &compressed,
+	const Skeleton &skeleton, float sampleRate = 120);
+
+// Compresses each clip and prints its compression ratio and maximum error
+void printCompressionReport(vector<AnimationClip> &clips, const Skeleton &skeleton, float tolerance);
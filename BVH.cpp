@@ -0,0 +1,413 @@
+// This file provides implementation of the MeshBVH class methods.
+
+#include "BVH.h"
+#include <glm/gtx/intersect.hpp>
+
+// largest number of triangles stored in a leaf (leaves tested with the
+//  block kernel hold up to a whole block instead)
+static const int MAX_LEAF_TRIANGLES = 4;
+
+//--------------------------------------------------------------
+// Builds the hierarchy top down, splitting every node at the
+//  median triangle centroid along its longest axis
+void MeshBVH::build(const vector<glm::vec3> &verts, const vector<int> &indices, bool bTriangleBlocks)
+{
+	this->indices = indices;
+	int numTriangles = (int)indices.size() / 3;
+	nodes.clear();
+	height = 0;
+	triangleBlocks.clear();
+	leafBlocks.clear();
+	order.resize(numTriangles);
+	maxLeafTriangles = bTriangleBlocks ? TRIANGLE_BLOCK_SIZE : MAX_LEAF_TRIANGLES;
+	if (numTriangles == 0) return;
+
+	// bounds and centroid of every triangle
+	vector<glm::vec3> centroids(numTriangles);
+	triangleMin.resize(numTriangles);
+	triangleMax.resize(numTriangles);
+	for (int i = 0; i < numTriangles; i++) {
+		const glm::vec3 &v0 = verts[indices[3 * i]];
+		const glm::vec3 &v1 = verts[indices[3 * i + 1]];
+		const glm::vec3 &v2 = verts[indices[3 * i + 2]];
+		triangleMin[i] = glm::min(v0, glm::min(v1, v2));
+		triangleMax[i] = glm::max(v0, glm::max(v1, v2));
+		centroids[i] = (v0 + v1 + v2) / 3.0f;
+		order[i] = i;
+	}
+
+	// a binary tree with at most one leaf per triangle has fewer than 2n nodes
+	nodes.reserve(2 * numTriangles);
+	nodes.push_back(BVHNode());
+	buildNode(0, 0, numTriangles, 0, centroids);
+
+	// the per triangle bounds are only needed while building
+	triangleMin.clear();
+	triangleMax.clear();
+	triangleMin.shrink_to_fit();
+	triangleMax.shrink_to_fit();
+
+	if (bTriangleBlocks) packLeaves(verts);
+}
+
+//--------------------------------------------------------------
+// Gives every leaf its own blocks (a leaf's triangles are
+//  contiguous in the triangle order)
+void MeshBVH::packLeaves(const vector<glm::vec3> &verts)
+{
+	triangleBlocks.clear();
+	leafBlocks.assign(nodes.size(), -1);
+	for (int n = 0; n < nodes.size(); n++) {
+		if (nodes[n].count > 0) leafBlocks[n] = triangleBlocks.add(verts, indices, &order[nodes[n].first], nodes[n].count);
+	}
+}
+
+//--------------------------------------------------------------
+// Builds the subtree of the given node (depth levels below the root)
+void MeshBVH::buildNode(int node, int first, int count, int depth, const vector<glm::vec3> &centroids)
+{
+	height = std::max(height, depth);
+
+	// bounds of the node's triangles and of their centroids
+	glm::vec3 boundsMin = triangleMin[order[first]];
+	glm::vec3 boundsMax = triangleMax[order[first]];
+	glm::vec3 centroidMin = centroids[order[first]];
+	glm::vec3 centroidMax = centroidMin;
+	for (int i = first + 1; i < first + count; i++) {
+		boundsMin = glm::min(boundsMin, triangleMin[order[i]]);
+		boundsMax = glm::max(boundsMax, triangleMax[order[i]]);
+		centroidMin = glm::min(centroidMin, centroids[order[i]]);
+		centroidMax = glm::max(centroidMax, centroids[order[i]]);
+	}
+	nodes[node].boundsMin = boundsMin;
+	nodes[node].boundsMax = boundsMax;
+
+	// longest axis of the centroid bounds
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = 0;
+	if (extent.y > extent.x) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	// make a leaf if the node is small or its triangles can't be separated
+	if (count <= maxLeafTriangles || extent[axis] <= 0) {
+		nodes[node].first = first;
+		nodes[node].count = count;
+		return;
+	}
+
+	// split at the median centroid
+	int half = count / 2;
+	nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&centroids, axis](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	// children are allocated as a pair after all existing nodes
+	int left = (int)nodes.size();
+	nodes.push_back(BVHNode());
+	nodes.push_back(BVHNode());
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	buildNode(left, first, half, depth + 1, centroids);
+	buildNode(left + 1, first + half, count - half, depth + 1, centroids);
+}
+
+//--------------------------------------------------------------
+// Computes the bounds of a range of the triangle order
+void MeshBVH::computeBounds(const vector<glm::vec3> &verts, int first, int count,
+	glm::vec3 &boundsMin, glm::vec3 &boundsMax) const
+{
+	boundsMin = glm::vec3(std::numeric_limits<float>::infinity());
+	boundsMax = -boundsMin;
+	for (int i = first; i < first + count; i++) {
+		const int *tri = &indices[3 * order[i]];
+		for (int k = 0; k < 3; k++) {
+			boundsMin = glm::min(boundsMin, verts[tri[k]]);
+			boundsMax = glm::max(boundsMax, verts[tri[k]]);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Refits the bounds bottom up. Children are stored after their
+//  parent, so walking the nodes backwards visits children first.
+void MeshBVH::refit(const vector<glm::vec3> &verts)
+{
+	for (int n = (int)nodes.size() - 1; n >= 0; n--) {
+		BVHNode &node = nodes[n];
+		if (node.count > 0) {
+			computeBounds(verts, node.first, node.count, node.boundsMin, node.boundsMax);
+			if (!leafBlocks.empty()) triangleBlocks.pack(leafBlocks[n], verts, indices, &order[node.first], node.count);
+		}
+		else {
+			node.boundsMin = glm::min(nodes[node.first].boundsMin, nodes[node.first + 1].boundsMin);
+			node.boundsMax = glm::max(nodes[node.first].boundsMax, nodes[node.first + 1].boundsMax);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Returns the distance along the ray to the node's bounding box
+//  (slab test) or infinity if the ray misses it before tMax
+static inline float intersectBounds(const BVHNode &node, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float tMax)
+{
+	glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+	glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+	return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+//--------------------------------------------------------------
+// Walks the tree front to back with an explicit stack, skipping
+//  nodes whose boxes start beyond the closest hit found so far
+bool MeshBVH::intersect(const vector<glm::vec3> &verts, const glm::vec3 &origin, const glm::vec3 &direction,
+	float tMin, float tMax, int &triangle, glm::vec2 &barycentric, float &t) const
+{
+	if (nodes.empty()) return false;
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = tMax;		// distance to the closest hit so far
+	bool hit = false;			// tracks whether any triangle was hit
+
+	// nodes still to visit: every level leaves at most one far child
+	//  waiting, so the stack never holds more than height + 1 nodes
+	//  (median splits keep any mesh within the local array, but a
+	//  taller tree gets a stack of its own rather than losing nodes)
+	int localStack[64];
+	vector<int> tallStack;
+	int *stack = localStack;
+	if (height + 1 > 64) {
+		tallStack.resize(height + 1);
+		stack = tallStack.data();
+	}
+	int stackSize = 0;
+
+	if (intersectBounds(nodes[0], origin, inverseDirection, closest) == std::numeric_limits<float>::infinity()) return false;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		int index = stack[--stackSize];
+		const BVHNode &node = nodes[index];
+
+		if (node.count > 0 && !leafBlocks.empty()) {
+			// test the leaf's blocks of triangles together
+			glm::vec2 bary;
+			int closestTriangle = triangleBlocks.intersect(leafBlocks[index], TriangleBlocks::blocksFor(node.count),
+				origin, direction, tMin, closest, bary);
+			if (closestTriangle >= 0) {
+				triangle = closestTriangle;
+				barycentric = bary;
+				hit = true;
+			}
+			continue;
+		}
+		if (node.count > 0) {
+			// test the leaf's triangles
+			for (int i = node.first; i < node.first + node.count; i++) {
+				const int *tri = &indices[3 * order[i]];
+				glm::vec2 bary;
+				float distance;
+				if (glm::intersectRayTriangle(origin, direction, verts[tri[0]], verts[tri[1]], verts[tri[2]], bary, distance)
+					&& distance >= tMin && distance < closest) {
+					closest = distance;
+					triangle = order[i];
+					barycentric = bary;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first (pushed last)
+		float tLeft = intersectBounds(nodes[node.first], origin, inverseDirection, closest);
+		float tRight = intersectBounds(nodes[node.first + 1], origin, inverseDirection, closest);
+		int near = node.first, far = node.first + 1;
+		if (tRight < tLeft) {
+			std::swap(near, far);
+			std::swap(tLeft, tRight);
+		}
+		if (tRight != std::numeric_limits<float>::infinity()) stack[stackSize++] = far;
+		if (tLeft != std::numeric_limits<float>::infinity()) stack[stackSize++] = near;
+	}
+
+	if (hit) t = closest;
+	return hit;
+}
+
+//--------------------------------------------------------------
+// Gets the box around a box placed with the transformation: the placed
+//  box's half extent along each axis sums the absolute projections of
+//  the box's half extents
+static inline void placeBounds(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	glm::vec3 &placedMin, glm::vec3 &placedMax)
+{
+	glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1));
+	glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 placedExtent;
+	for (int i = 0; i < 3; i++) {
+		placedExtent[i] = fabs(transform[0][i]) * halfExtent.x + fabs(transform[1][i]) * halfExtent.y + fabs(transform[2][i]) * halfExtent.z;
+	}
+	placedMin = center - placedExtent;
+	placedMax = center + placedExtent;
+}
+
+//--------------------------------------------------------------
+// Places the root's box
+void MeshBVH::getPlacedBounds(const glm::mat4 &transform, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const
+{
+	placeBounds(transform, nodes[0].boundsMin, nodes[0].boundsMax, boundsMin, boundsMax);
+}
+
+//--------------------------------------------------------------
+// Gets the interval of the line where the planes meet (projected on
+//  direction) that the triangle covers, given the signed distances of
+//  its vertices to the other triangle's plane (some on either side):
+//  the vertices on the plane and the points where edges cross it
+static inline void planeCrossing(const glm::vec3 *v, const float *distance, const glm::vec3 &direction, float &low, float &high)
+{
+	low = std::numeric_limits<float>::infinity();
+	high = -low;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		float p;
+		if (distance[i] == 0) p = glm::dot(direction, v[i]);
+		else if ((distance[i] < 0) != (distance[j] < 0) && distance[j] != 0) {
+			p = glm::dot(direction, v[i] + (v[j] - v[i]) * (distance[i] / (distance[i] - distance[j])));
+		}
+		else continue;
+		low = std::min(low, p);
+		high = std::max(high, p);
+	}
+}
+
+//--------------------------------------------------------------
+// Möller's test: each triangle must have vertices on both sides of the
+//  other's plane, and then the intervals where they cross the line the
+//  planes meet in must overlap
+bool trianglesIntersect(const glm::vec3 *a, const glm::vec3 *b)
+{
+	glm::vec3 normalA = glm::cross(a[1] - a[0], a[2] - a[0]);
+	float distanceB[3];
+	for (int k = 0; k < 3; k++) distanceB[k] = glm::dot(normalA, b[k] - a[0]);
+	if ((distanceB[0] >= 0 && distanceB[1] >= 0 && distanceB[2] >= 0) || (distanceB[0] <= 0 && distanceB[1] <= 0 && distanceB[2] <= 0)) {
+		return false;
+	}
+	glm::vec3 normalB = glm::cross(b[1] - b[0], b[2] - b[0]);
+	float distanceA[3];
+	for (int k = 0; k < 3; k++) distanceA[k] = glm::dot(normalB, a[k] - b[0]);
+	if ((distanceA[0] >= 0 && distanceA[1] >= 0 && distanceA[2] >= 0) || (distanceA[0] <= 0 && distanceA[1] <= 0 && distanceA[2] <= 0)) {
+		return false;
+	}
+
+	glm::vec3 direction = glm::cross(normalA, normalB);
+	float lowA, highA, lowB, highB;
+	planeCrossing(a, distanceA, direction, lowA, highA);
+	planeCrossing(b, distanceB, direction, lowB, highB);
+	return std::max(lowA, lowB) < std::min(highA, highB);
+}
+
+//--------------------------------------------------------------
+// Returns true if the boxes overlap (boxes that only touch don't)
+static inline bool boundsOverlap(const glm::vec3 &min1, const glm::vec3 &max1, const glm::vec3 &min2, const glm::vec3 &max2)
+{
+	return min1.x < max2.x && min2.x < max1.x && min1.y < max2.y && min2.y < max1.y && min1.z < max2.z && min2.z < max1.z;
+}
+
+//--------------------------------------------------------------
+// Walks pairs of nodes with an explicit stack, opening the larger node
+//  of an overlapping pair (or the one that isn't a leaf). The other
+//  mesh's triangles are placed in this space once a pair of leaves is
+//  reached.
+bool MeshBVH::collide(const vector<glm::vec3> &verts, const MeshBVH &other, const vector<glm::vec3> &otherVerts,
+	const glm::mat4 &otherToThis, vector<pair<int, int>> *pairs) const
+{
+	if (nodes.empty() || other.nodes.empty()) return false;
+
+	// pairs of nodes still to visit, with the other node's box placed
+	//  in this space (kept between calls so it only grows when a pair
+	//  of trees is deeper than any before)
+	struct NodePair {
+		int node, otherNode;
+		glm::vec3 placedMin, placedMax;
+	};
+	thread_local vector<NodePair> stack;
+	stack.clear();
+	bool hit = false;			// tracks whether any triangles intersect
+	NodePair root;
+	root.node = 0;
+	root.otherNode = 0;
+	placeBounds(otherToThis, other.nodes[0].boundsMin, other.nodes[0].boundsMax, root.placedMin, root.placedMax);
+	if (!boundsOverlap(nodes[0].boundsMin, nodes[0].boundsMax, root.placedMin, root.placedMax)) return false;
+	stack.push_back(root);
+	while (!stack.empty()) {
+		NodePair current = stack.back();
+		stack.pop_back();
+		const BVHNode &node = nodes[current.node];
+		const BVHNode &otherNode = other.nodes[current.otherNode];
+
+		if (node.count > 0 && otherNode.count > 0) {
+			// test the leaves' triangles against each other (a few of this
+			//  leaf's at a time, those inside the other leaf's box), skipping
+			//  the pairs whose boxes are apart
+			for (int first = node.first; first < node.first + node.count; first += TRIANGLE_BLOCK_SIZE) {
+				int end = std::min(node.first + node.count, first + TRIANGLE_BLOCK_SIZE), count = 0;
+				glm::vec3 a[TRIANGLE_BLOCK_SIZE][3], aMin[TRIANGLE_BLOCK_SIZE], aMax[TRIANGLE_BLOCK_SIZE];
+				int aTriangle[TRIANGLE_BLOCK_SIZE];
+				for (int i = first; i < end; i++) {
+					const int *tri = &indices[3 * order[i]];
+					for (int k = 0; k < 3; k++) a[count][k] = verts[tri[k]];
+					aMin[count] = glm::min(a[count][0], glm::min(a[count][1], a[count][2]));
+					aMax[count] = glm::max(a[count][0], glm::max(a[count][1], a[count][2]));
+					aTriangle[count] = order[i];
+					if (boundsOverlap(aMin[count], aMax[count], current.placedMin, current.placedMax)) count++;
+				}
+				if (count == 0) continue;
+				for (int j = otherNode.first; j < otherNode.first + otherNode.count; j++) {
+					const int *otherTri = &other.indices[3 * other.order[j]];
+					glm::vec3 b[3];
+					for (int k = 0; k < 3; k++) b[k] = glm::vec3(otherToThis * glm::vec4(otherVerts[otherTri[k]], 1));
+					glm::vec3 bMin = glm::min(b[0], glm::min(b[1], b[2])), bMax = glm::max(b[0], glm::max(b[1], b[2]));
+					if (!boundsOverlap(node.boundsMin, node.boundsMax, bMin, bMax)) continue;
+					for (int i = 0; i < count; i++) {
+						if (!boundsOverlap(aMin[i], aMax[i], bMin, bMax) || !trianglesIntersect(a[i], b)) continue;
+						hit = true;
+						if (!pairs) return true;
+						pairs->push_back(make_pair(aTriangle[i], other.order[j]));
+					}
+				}
+			}
+			continue;
+		}
+
+		// open this node if the other one is a leaf or this one is larger,
+		//  and visit the children whose boxes overlap the node kept
+		glm::vec3 size = node.boundsMax - node.boundsMin;
+		glm::vec3 otherSize = otherNode.boundsMax - otherNode.boundsMin;
+		bool bOpenThis = otherNode.count > 0 ||
+			(node.count == 0 && size.x * size.y * size.z >= otherSize.x * otherSize.y * otherSize.z);
+		for (int child = (bOpenThis ? node.first : otherNode.first), c = 0; c < 2; child++, c++) {
+			NodePair next;
+			if (bOpenThis) {
+				if (!boundsOverlap(nodes[child].boundsMin, nodes[child].boundsMax, current.placedMin, current.placedMax)) continue;
+				next = current;
+				next.node = child;
+			}
+			else {
+				placeBounds(otherToThis, other.nodes[child].boundsMin, other.nodes[child].boundsMax, next.placedMin, next.placedMax);
+				if (!boundsOverlap(node.boundsMin, node.boundsMax, next.placedMin, next.placedMax)) continue;
+				next.node = current.node;
+				next.otherNode = child;
+			}
+			stack.push_back(next);
+		}
+	}
+	return hit;
+}
+
+//--------------------------------------------------------------
+// Returns the size of the nodes, triangle tables and blocks in bytes
+size_t MeshBVH::getSizeInBytes() const
+{
+	return nodes.capacity() * sizeof(BVHNode) + (order.capacity() + indices.capacity() + leafBlocks.capacity()) * sizeof(int)
+		+ triangleBlocks.getSizeInBytes();
+}
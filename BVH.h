@@ -0,0 +1,96 @@
+// This file provides the definition of the MeshBVH class, a bounding
+//  volume hierarchy over the triangles of a mesh in the mesh's own
+//  (object) space.
+// Because the hierarchy does not depend on where the mesh is placed,
+//  one hierarchy is shared by every placement of the mesh: rays are
+//  moved into object space instead of moving the triangles into world
+//  space. Meshes whose vertices move (skinned meshes) refit the bounds
+//  of the existing hierarchy instead of rebuilding it.
+// Optionally the triangles of every leaf are also packed into
+//  TriangleBlocks, so a leaf's triangles are tested together by the
+//  SIMD block kernel instead of one at a time through their indices.
+// Two placed hierarchies are tested against each other by descending
+//  both together: a pair of nodes is only opened if their boxes overlap
+//  (the other node's box placed in this one's space), so only the
+//  triangles of nearby leaves are tested against each other.
+
+#pragma once
+
+#include "ofMain.h"
+#include "TriangleBlocks.h"
+
+// BVHNode: one node of the hierarchy
+//
+struct BVHNode {
+	glm::vec3 boundsMin;	// corner of the node's bounding box with the smallest coordinates
+	glm::vec3 boundsMax;	// corner of the node's bounding box with the largest coordinates
+	int first = 0;			// leaf: index of the first triangle in the triangle order, inner node: index of the left child
+	int count = 0;			// number of triangles in a leaf (0 for inner nodes, whose right child is first + 1)
+};
+
+// Returns true if the triangles a[0..2] and b[0..2] intersect (triangles
+//  that only touch, along an edge, at a corner or lying flat on each
+//  other, don't)
+bool trianglesIntersect(const glm::vec3 *a, const glm::vec3 *b);
+
+// MeshBVH class
+//
+class MeshBVH {
+public:
+	// Builds the hierarchy over triangles given as three vertex indices each
+	//  (indices holds 3 * numTriangles values). With bTriangleBlocks, leaves
+	//  hold up to a block of triangles and are tested with the block kernel.
+	void build(const vector<glm::vec3> &verts, const vector<int> &indices, bool bTriangleBlocks = false);
+
+	// Recomputes the bounds of every node (and the leaves' triangle blocks)
+	//  after the vertices moved, keeping the tree structure
+	void refit(const vector<glm::vec3> &verts);
+
+	// Finds the closest triangle hit by the ray origin + t * direction with
+	//  t in [tMin, tMax). Returns the triangle (index into the indices given
+	//  to build), the barycentric coordinates of the hit, and t.
+	bool intersect(const vector<glm::vec3> &verts, const glm::vec3 &origin, const glm::vec3 &direction,
+		float tMin, float tMax, int &triangle, glm::vec2 &barycentric, float &t) const;
+
+	// Gets the box around the root's box placed with the given transformation
+	//  (the hierarchy must not be empty)
+	void getPlacedBounds(const glm::mat4 &transform, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+	// Finds the triangles that intersect triangles of another hierarchy's
+	//  mesh, placed in this one's object space by otherToThis. Appends each
+	//  pair (indices into the indices given to build, this hierarchy's
+	//  triangle first) to pairs, or stops at the first pair if pairs is
+	//  NULL. Returns true if any triangles intersect.
+	bool collide(const vector<glm::vec3> &verts, const MeshBVH &other, const vector<glm::vec3> &otherVerts,
+		const glm::mat4 &otherToThis, vector<pair<int, int>> *pairs = NULL) const;
+
+	// Returns true if the hierarchy has not been built
+	bool empty() const { return nodes.empty(); }
+
+	// Returns the number of bytes used by the hierarchy
+	size_t getSizeInBytes() const;
+
+	// Fields of MeshBVH class
+	//
+	vector<BVHNode> nodes;		// nodes of the tree (the root first, children always stored after their parent)
+	vector<int> order;			// triangle indices ordered so every leaf covers a contiguous range
+	vector<int> indices;		// three vertex indices per triangle
+	TriangleBlocks triangleBlocks;	// every leaf's triangles packed for the block kernel (empty if not used)
+	vector<int> leafBlocks;		// first block of each leaf's triangles (indexed by node, -1 for inner nodes)
+	int height = 0;				// number of levels below the root (0 for a single leaf)
+
+private:
+	// Builds the subtree for the triangles order[first, first + count) into nodes[node]
+	void buildNode(int node, int first, int count, int depth, const vector<glm::vec3> &centroids);
+
+	// Computes the bounds of the triangles order[first, first + count)
+	void computeBounds(const vector<glm::vec3> &verts, int first, int count, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+	// Packs the triangles of every leaf into triangleBlocks
+	void packLeaves(const vector<glm::vec3> &verts);
+
+	// bounds of every triangle during build
+	vector<glm::vec3> triangleMin, triangleMax;
+	// largest number of triangles in a leaf during build
+	int maxLeafTriangles = 4;
+};
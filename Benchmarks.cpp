@@ -0,0 +1,1329 @@
+// This file provides implementation of the benchmark routines.
+
+#include "Benchmarks.h"
+#include "SceneObjects.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "Animation.h"
+#include "AnimationCompression.h"
+#include "Crowd.h"
+#include "BVH.h"
+#include "TriangleBlocks.h"
+#include "Renderer.h"
+#include "IK.h"
+#include "Parallel.h"
+#include "SceneRegistry.h"
+#include "ObjectPool.h"
+#include "AABBTree.h"
+#include "Profiler.h"
+#include "MeshOrder.h"
+#include "ofApp.h"
+#include <glm/gtx/intersect.hpp>
+
+//--------------------------------------------------------------
+// Returns the number of seconds elapsed since start
+static double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+//--------------------------------------------------------------
+// Builds a random jointCount joint hierarchy, then times a full
+//  re-evaluation of every world matrix (as needed when an animation
+//  changes every joint each frame) through the pointer based
+//  SceneObject graph and through the compiled Skeleton
+void benchmarkPoseEvaluation(int jointCount, int iterations)
+{
+	// build the scene object graph (each joint is parented to a random earlier joint)
+	vector<Sphere> spheres(jointCount);
+	vector<SceneObject *> objects;
+	for (int i = 0; i < jointCount; i++) {
+		if (i > 0) {
+			spheres[(int)ofRandom(0, i - 1)].addChild(&spheres[i]);
+		}
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1)));
+		spheres[i].setRotation(glm::vec3(ofRandom(-180, 180), ofRandom(-180, 180), ofRandom(-180, 180)));
+		objects.push_back(&spheres[i]);
+	}
+
+	// compile the flat skeleton from the same graph
+	Skeleton skeleton;
+	skeleton.compile(objects);
+
+	// time the SceneObject graph (every joint rotated each iteration)
+	float checksum = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < jointCount; i++) {
+			spheres[i].setRotation(spheres[i].rotation + glm::vec3(0, 1, 0));
+		}
+		for (int i = 0; i < jointCount; i++) {
+			checksum += spheres[i].getMatrix()[3].x;
+		}
+	}
+	double graphTime = secondsSince(start);
+
+	// time the compiled skeleton (every joint rotated each iteration)
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < jointCount; i++) {
+			skeleton.rotY[i] += 1;
+		}
+		skeleton.evaluate();
+		checksum += skeleton.worldMatrices[jointCount - 1][3].x;
+	}
+	double skeletonTime = secondsSince(start);
+
+	// print results
+	cout << "Pose evaluation (" << jointCount << " joints, " << iterations << " poses):" << endl;
+	cout << "  SceneObject graph: " << graphTime / iterations * 1000.0 << " ms/pose, "
+		<< jointCount * iterations / graphTime / 1.0e6 << " M joints/s" << endl;
+	cout << "  Skeleton (SoA):    " << skeletonTime / iterations * 1000.0 << " ms/pose, "
+		<< jointCount * iterations / skeletonTime / 1.0e6 << " M joints/s" << endl;
+	cout << "  (checksum " << checksum << ")\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Binds a vertexCount vertex point cloud to a 15 joint chain with
+//  proximity weights, then times deforming it while the chain bends
+void benchmarkSkinning(int vertexCount, int iterations)
+{
+	// build a 15 joint chain standing along the y axis
+	const int numJoints = 15;
+	Skeleton skeleton;
+	skeleton.resize(numJoints);
+	for (int i = 0; i < numJoints; i++) {
+		skeleton.names[i] = "joint" + std::to_string(i);
+		skeleton.parents[i] = i - 1;
+		skeleton.posY[i] = i > 0 ? 0.5f : 0.0f;
+	}
+	skeleton.evaluate();
+
+	// scatter vertices (and one normal per vertex) around the chain
+	vector<glm::vec3> verts(vertexCount), nVerts(vertexCount);
+	vector<int> normalToVert(vertexCount);
+	for (int i = 0; i < vertexCount; i++) {
+		verts[i] = glm::vec3(ofRandom(-0.5, 0.5), ofRandom(0, numJoints * 0.5f), ofRandom(-0.5, 0.5));
+		nVerts[i] = glm::normalize(glm::vec3(verts[i].x, 0.01f, verts[i].z));
+		normalToVert[i] = i;
+	}
+
+	// bind and generate weights
+	Skin skin;
+	auto start = chrono::high_resolution_clock::now();
+	skin.bind(skeleton, verts, nVerts, normalToVert);
+	skin.generateWeights(skeleton);
+	double weightTime = secondsSince(start);
+
+	// time deforming the mesh with a new pose every iteration
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 1; i < numJoints; i++) {
+			skeleton.rotZ[i] = 10.0f * sin(n * 0.3f + i);
+		}
+		skeleton.evaluate();
+		skin.deform(skeleton, verts, nVerts);
+	}
+	double deformTime = secondsSince(start);
+
+	// print results
+	cout << "Linear blend skinning (" << vertexCount << " vertices, " << numJoints << " joints, "
+		<< std::thread::hardware_concurrency() << " threads):" << endl;
+	cout << "  Weight generation: " << weightTime * 1000.0 << " ms" << endl;
+	cout << "  Deform: " << deformTime / iterations * 1000.0 << " ms/pose, "
+		<< (double)vertexCount * iterations / deformTime / 1.0e6 << " M vertices/s\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Builds a clip with keysPerTrack keys (30 per second) for each
+//  joint, then times sampling it frame by frame at 60 fps and at
+//  random (scrubbed) times
+void benchmarkClipSampling(int jointCount, int keysPerTrack, int frames)
+{
+	// build the skeleton and the clip
+	Skeleton skeleton;
+	skeleton.resize(jointCount);
+	for (int i = 0; i < jointCount; i++) {
+		skeleton.names[i] = "joint" + std::to_string(i);
+		skeleton.parents[i] = i - 1;
+	}
+	AnimationClip clip;
+	for (int k = 0; k < keysPerTrack; k++) {
+		for (int i = 0; i < jointCount; i++) {
+			clip.addKey(skeleton.names[i], k / 30.0f, glm::vec3(0, 1, 0),
+				glm::vec3(ofRandom(-90, 90), ofRandom(-90, 90), ofRandom(-90, 90)));
+		}
+	}
+
+	// time forward playback
+	auto start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < frames; n++) {
+		clip.sample(n / 60.0f, skeleton);
+	}
+	double playTime = secondsSince(start);
+
+	// time random scrubbing
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < frames; n++) {
+		clip.sample(ofRandom(0, clip.duration), skeleton);
+	}
+	double scrubTime = secondsSince(start);
+
+	// time forward playback straight from the compressed stream
+	skeleton.evaluate();
+	CompressedClip compressed;
+	compressed.compress(clip, skeleton, 0.001f);
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < frames; n++) {
+		compressed.sample(n / 60.0f, skeleton);
+	}
+	double compressedTime = secondsSince(start);
+
+	// print results
+	cout << "Clip sampling (" << jointCount << " joints, " << keysPerTrack << " keys per track):" << endl;
+	cout << "  Playback: " << playTime / frames * 1.0e6 << " us/frame" << endl;
+	cout << "  Scrubbing: " << scrubTime / frames * 1.0e6 << " us/frame" << endl;
+	cout << "  Compressed playback: " << compressedTime / frames * 1.0e6 << " us/frame\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Builds a crowd of instanceCount instances of a jointCount joint
+//  skeleton playing a shared clip, then times posing every instance
+//  on the calling thread and across all hardware threads
+void benchmarkCrowdEvaluation(int instanceCount, int jointCount, int frames)
+{
+	// build the shared skeleton and clip (every joint parented to a random earlier joint)
+	Skeleton skeleton;
+	skeleton.resize(jointCount);
+	for (int i = 0; i < jointCount; i++) {
+		skeleton.names[i] = "joint" + std::to_string(i);
+		skeleton.parents[i] = i > 0 ? (int)ofRandom(0, i - 1) : -1;
+		skeleton.posY[i] = 0.5;
+	}
+	AnimationClip clip;
+	for (int k = 0; k < 90; k++) {
+		for (int i = 0; i < jointCount; i++) {
+			clip.addKey(skeleton.names[i], k / 30.0f, glm::vec3(0, 0.5, 0),
+				glm::vec3(ofRandom(-45, 45), ofRandom(-45, 45), ofRandom(-45, 45)));
+		}
+	}
+	Crowd crowd;
+	crowd.spawn(skeleton, instanceCount, 2.0f, glm::vec3(0, 0, 0), { &clip });
+
+	// time evaluation on the calling thread
+	auto start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < frames; n++) {
+		crowd.evaluate(n / 60.0f, instanceCount);
+	}
+	double serialTime = secondsSince(start);
+
+	// time evaluation across all hardware threads
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < frames; n++) {
+		crowd.evaluate(n / 60.0f);
+	}
+	double parallelTime = secondsSince(start);
+
+	// print results
+	cout << "Crowd evaluation (" << instanceCount << " instances of a " << jointCount << " joint skeleton, "
+		<< std::thread::hardware_concurrency() << " hardware threads):" << endl;
+	cout << "  One thread: " << serialTime / frames * 1000.0 << " ms/frame" << endl;
+	cout << "  All threads: " << parallelTime / frames * 1000.0 << " ms/frame (speedup " << serialTime / parallelTime << "x)" << endl;
+	cout << "  Memory per instance: " << crowd.getInstanceSizeInBytes() << " bytes\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Builds a mesh of triangleCount small random triangles, then times
+//  closest hit ray queries by testing every triangle (as the ray
+//  tracer did) and through the mesh's bounding volume hierarchy
+void benchmarkMeshIntersection(int triangleCount, int rayCount)
+{
+	// build the mesh
+	vector<glm::vec3> verts;
+	vector<int> indices;
+	for (int i = 0; i < triangleCount; i++) {
+		glm::vec3 center = glm::vec3(ofRandom(-5, 5), ofRandom(-5, 5), ofRandom(-5, 5));
+		for (int k = 0; k < 3; k++) {
+			indices.push_back((int)verts.size());
+			verts.push_back(center + glm::vec3(ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1)));
+		}
+	}
+	auto start = chrono::high_resolution_clock::now();
+	MeshBVH bvh;
+	bvh.build(verts, indices);
+	double buildTime = secondsSince(start);
+	MeshBVH blockBVH;
+	blockBVH.build(verts, indices, true);
+
+	// every triangle packed into blocks in their original order
+	vector<int> allTriangles(triangleCount);
+	for (int i = 0; i < triangleCount; i++) allTriangles[i] = i;
+	TriangleBlocks blocks;
+	blocks.add(verts, indices, allTriangles.data(), triangleCount);
+
+	// rays from a camera in front of the mesh
+	vector<glm::vec3> directions(rayCount);
+	glm::vec3 origin = glm::vec3(0, 0, 20);
+	for (int r = 0; r < rayCount; r++) {
+		directions[r] = glm::normalize(glm::vec3(ofRandom(-5, 5), ofRandom(-5, 5), 0) - origin);
+	}
+
+	// time testing every triangle (fewer rays, since it is slow)
+	int bruteRays = std::max(1, rayCount / 100);
+	int bruteHits = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < bruteRays; r++) {
+		float closest = std::numeric_limits<float>::infinity();
+		for (int i = 0; i < triangleCount; i++) {
+			glm::vec2 bary;
+			float distance;
+			if (glm::intersectRayTriangle(origin, directions[r], verts[indices[3 * i]], verts[indices[3 * i + 1]],
+				verts[indices[3 * i + 2]], bary, distance) && distance >= 0 && distance < closest) {
+				closest = distance;
+			}
+		}
+		if (closest != std::numeric_limits<float>::infinity()) bruteHits++;
+	}
+	double bruteTime = secondsSince(start);
+
+	// time the hierarchy
+	int bvhHits = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		int triangle;
+		glm::vec2 bary;
+		float t;
+		if (bvh.intersect(verts, origin, directions[r], 0, std::numeric_limits<float>::infinity(), triangle, bary, t)) bvhHits++;
+	}
+	double bvhTime = secondsSince(start);
+
+	// print results
+	cout << "Mesh intersection (" << triangleCount << " triangles):" << endl;
+	cout << "  Every triangle: " << bruteTime / bruteRays * 1.0e6 << " us/ray (" << bruteHits << " of " << bruteRays << " rays hit)" << endl;
+	cout << "  Hierarchy: " << bvhTime / rayCount * 1.0e6 << " us/ray (" << bvhHits << " of " << rayCount << " rays hit), built in "
+		<< buildTime * 1000.0 << " ms, " << bvh.getSizeInBytes() / 1024 << " KB" << endl;
+
+	// time every block kernel the CPU runs, testing every block and at the leaves of the hierarchy
+	TriangleKernel previousKernel = getTriangleKernel();
+	for (int k = TRIANGLE_KERNEL_SCALAR; k <= getBestTriangleKernel(); k++) {
+		setTriangleKernel((TriangleKernel)k);
+
+		int blockHits = 0;
+		start = chrono::high_resolution_clock::now();
+		for (int r = 0; r < bruteRays; r++) {
+			float closest = std::numeric_limits<float>::infinity();
+			glm::vec2 bary;
+			if (blocks.intersect(0, (int)blocks.blocks.size(), origin, directions[r], 0, closest, bary) >= 0) blockHits++;
+		}
+		double blockTime = secondsSince(start);
+
+		int blockBVHHits = 0;
+		start = chrono::high_resolution_clock::now();
+		for (int r = 0; r < rayCount; r++) {
+			int triangle;
+			glm::vec2 bary;
+			float t;
+			if (blockBVH.intersect(verts, origin, directions[r], 0, std::numeric_limits<float>::infinity(), triangle, bary, t)) blockBVHHits++;
+		}
+		double blockBVHTime = secondsSince(start);
+
+		cout << "  " << getTriangleKernelName((TriangleKernel)k) << " blocks: every triangle " << blockTime / bruteRays * 1.0e6
+			<< " us/ray (" << blockHits << " hit), hierarchy " << blockBVHTime / rayCount * 1.0e6 << " us/ray ("
+			<< blockBVHHits << " hit)" << endl;
+	}
+	setTriangleKernel(previousKernel);
+	cout << "  Hierarchy with blocks: " << blockBVH.getSizeInBytes() / 1024 << " KB\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Builds instanceCount poses of a small humanoid (pelvis, spine,
+//  two three joint legs and two three joint arms), then times
+//  solving its four limbs toward moving targets with FABRIK and
+//  with CCD, reporting the remaining distance to the targets
+void benchmarkInverseKinematics(int instanceCount, int frames)
+{
+	// build the humanoid: { name, parent, position relative to the parent }
+	struct { const char *name; int parent; glm::vec3 position; } rig[] = {
+		{ "pelvis", -1, glm::vec3(0, 2, 0) }, { "spine", 0, glm::vec3(0, 1, 0) },
+		{ "hipL", 0, glm::vec3(0.3, 0, 0) }, { "kneeL", 2, glm::vec3(0, -1, 0) }, { "footL", 3, glm::vec3(0, -1, 0) },
+		{ "hipR", 0, glm::vec3(-0.3, 0, 0) }, { "kneeR", 5, glm::vec3(0, -1, 0) }, { "footR", 6, glm::vec3(0, -1, 0) },
+		{ "shoulderL", 1, glm::vec3(0.5, 0, 0) }, { "elbowL", 8, glm::vec3(0.7, 0, 0) }, { "handL", 9, glm::vec3(0.7, 0, 0) },
+		{ "shoulderR", 1, glm::vec3(-0.5, 0, 0) }, { "elbowR", 11, glm::vec3(-0.7, 0, 0) }, { "handR", 12, glm::vec3(-0.7, 0, 0) } };
+	int jointCount = sizeof(rig) / sizeof(rig[0]);
+	Skeleton skeleton;
+	skeleton.resize(jointCount);
+	for (int i = 0; i < jointCount; i++) {
+		skeleton.names[i] = rig[i].name;
+		skeleton.parents[i] = rig[i].parent;
+		skeleton.posX[i] = rig[i].position.x;
+		skeleton.posY[i] = rig[i].position.y;
+		skeleton.posZ[i] = rig[i].position.z;
+	}
+	IKSolver solver;
+	int effectors[] = { 4, 7, 10, 13 };
+	for (int effector : effectors) solver.addChain(skeleton, effector, 2);
+
+	// one pose per instance, and a point within each limb's reach for the targets to orbit
+	vector<SkeletonPose> poses(instanceCount);
+	for (int n = 0; n < instanceCount; n++) {
+		skeleton.copyPose(poses[n]);
+		skeleton.evaluate(poses[n], glm::mat4(1.0));
+	}
+	vector<glm::vec3> rest(solver.getNumChains());
+	for (int c = 0; c < solver.getNumChains(); c++) {
+		glm::vec3 root = poses[0].getWorldPosition(solver.chainJoints[solver.chainStarts[c]]);
+		rest[c] = glm::mix(root, poses[0].getWorldPosition(solver.getEffector(c)), 0.7f);
+	}
+
+	IKSolver::Method methods[] = { IKSolver::FABRIK, IKSolver::CCD };
+	const char *methodNames[] = { "FABRIK", "CCD" };
+	cout << "Inverse kinematics (" << instanceCount << " poses x " << solver.getNumChains() << " chains, "
+		<< std::thread::hardware_concurrency() << " hardware threads):" << endl;
+	for (int m = 0; m < 2; m++) {
+		solver.method = methods[m];
+		double error = 0;
+		auto start = chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			parallelFor(instanceCount, [&](int begin, int end) {
+				vector<glm::vec3> targets(rest.size());
+				for (int n = begin; n < end; n++) {
+					// targets circle within reach of every limb
+					float angle = (f + n) * 0.1f;
+					for (int c = 0; c < targets.size(); c++) {
+						targets[c] = rest[c] + glm::vec3(0.2 * cos(angle), 0.2 * sin(angle), 0.2);
+					}
+					solver.solve(skeleton, poses[n], targets.data());
+					skeleton.evaluate(poses[n], glm::mat4(1.0));
+				}
+			}, 4);
+		}
+		double time = secondsSince(start);
+
+		// distance left between the effectors and the last frame's targets
+		for (int n = 0; n < instanceCount; n++) {
+			float angle = (frames - 1 + n) * 0.1f;
+			for (int c = 0; c < rest.size(); c++) {
+				glm::vec3 target = rest[c] + glm::vec3(0.2 * cos(angle), 0.2 * sin(angle), 0.2);
+				error = std::max(error, (double)glm::distance(poses[n].getWorldPosition(solver.getEffector(c)), target));
+			}
+		}
+		cout << "  " << methodNames[m] << ": " << time / frames * 1000.0 << " ms/frame, "
+			<< instanceCount * solver.getNumChains() * frames / time << " chains/s, max error " << error << endl;
+	}
+	cout << endl;
+}
+
+// sphere that reports its name like a Joint
+class NamedSphere : public Sphere {
+public:
+	string getName() { return name; }
+};
+
+//--------------------------------------------------------------
+// Creates jointCount named spheres, each parented to a random
+//  earlier sphere found by name, once through a SceneRegistry and
+//  once by scanning the names of every sphere created so far
+void benchmarkNameLookup(int jointCount, int scanCount)
+{
+	// names of the joints and of their parents
+	vector<string> names(jointCount), parentNames(jointCount);
+	for (int i = 0; i < jointCount; i++) {
+		names[i] = "joint" + std::to_string(i);
+		parentNames[i] = i > 0 ? names[(int)ofRandom(0, i - 1)] : "";
+	}
+
+	// build through the registry
+	vector<NamedSphere> joints(jointCount);
+	SceneRegistry registry;
+	auto start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < jointCount; i++) {
+		joints[i].name = names[i];
+		registry.add(&joints[i]);
+		SceneObject *parent = registry.find(parentNames[i]);
+		if (parent) parent->childList.push_back(&joints[i]);
+	}
+	double registryTime = secondsSince(start);
+
+	// build by scanning every name (quadratic, so only scanCount joints)
+	scanCount = std::min(scanCount, jointCount);
+	vector<NamedSphere> scanned(scanCount);
+	start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < scanCount; i++) {
+		scanned[i].name = names[i];
+		for (int j = 0; j < i; j++) {
+			if (scanned[j].getName() == parentNames[i]) scanned[j].childList.push_back(&scanned[i]);
+		}
+	}
+	double scanTime = secondsSince(start);
+
+	// print results
+	cout << "Name lookup (parents given by name):" << endl;
+	cout << "  Registry: " << jointCount << " joints in " << registryTime * 1000.0 << " ms ("
+		<< registryTime / jointCount * 1e9 << " ns/joint)" << endl;
+	cout << "  Name scan: " << scanCount << " joints in " << scanTime * 1000.0 << " ms ("
+		<< scanTime / scanCount * 1e9 << " ns/joint, growing with the joint count)\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Saves a random jointCount joint hierarchy in both skeleton file
+//  formats and times loading each file back
+void benchmarkSkeletonLoading(int jointCount)
+{
+	// build the skeleton (every joint parented to a random earlier joint)
+	Skeleton skeleton;
+	skeleton.resize(jointCount);
+	for (int i = 0; i < jointCount; i++) {
+		skeleton.names[i] = "joint" + std::to_string(i);
+		skeleton.parents[i] = i > 0 ? (int)ofRandom(0, i - 1) : -1;
+		skeleton.posY[i] = ofRandom(0.1, 1);
+		skeleton.rotX[i] = ofRandom(-90, 90);
+	}
+	string scriptFile = "benchmark_skeleton.txt";
+	string binaryFile = "benchmark_skeleton.skb";
+	if (!skeleton.saveScript(scriptFile) || !skeleton.saveBinary(binaryFile)) return;
+
+	// time loading each format
+	Skeleton loaded;
+	auto start = chrono::high_resolution_clock::now();
+	bool bScriptLoaded = loaded.loadScript(scriptFile);
+	double scriptTime = secondsSince(start);
+	start = chrono::high_resolution_clock::now();
+	bool bBinaryLoaded = loaded.loadBinary(binaryFile);
+	double binaryTime = secondsSince(start);
+	remove(scriptFile.c_str());
+	remove(binaryFile.c_str());
+
+	// print results
+	cout << "Skeleton loading (" << jointCount << " joints):" << endl;
+	cout << "  Script file: " << scriptTime * 1000.0 << " ms" << (bScriptLoaded ? "" : " (failed)") << endl;
+	cout << "  Binary file: " << binaryTime * 1000.0 << " ms" << (bBinaryLoaded ? "" : " (failed)") << "\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Creates objectCount spheres chained into a hierarchy, then frees
+//  them all, reloads times: once allocating every sphere with new
+//  and deleting each one, once from a pool that is cleared
+void benchmarkSceneReload(int objectCount, int reloads)
+{
+	// allocate and delete every object
+	vector<Sphere *> objects(objectCount);
+	auto start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < reloads; r++) {
+		for (int i = 0; i < objectCount; i++) {
+			objects[i] = new Sphere();
+			if (i > 0) objects[i - 1]->addChild(objects[i]);
+		}
+		for (int i = 0; i < objectCount; i++) {
+			delete objects[i];
+		}
+	}
+	double heapTime = secondsSince(start);
+
+	// allocate from a pool and clear it
+	ObjectPool<Sphere> pool;
+	size_t firstSize = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < reloads; r++) {
+		for (int i = 0; i < objectCount; i++) {
+			objects[i] = pool.create();
+			if (i > 0) objects[i - 1]->addChild(objects[i]);
+		}
+		pool.clear();
+		if (r == 0) firstSize = pool.getSizeInBytes();
+	}
+	double poolTime = secondsSince(start);
+
+	// print results
+	cout << "Scene reload (" << objectCount << " objects, " << reloads << " reloads):" << endl;
+	cout << "  new/delete: " << heapTime / reloads * 1000.0 << " ms/reload" << endl;
+	cout << "  Object pool: " << poolTime / reloads * 1000.0 << " ms/reload, " << firstSize
+		<< " bytes after the first reload, " << pool.getSizeInBytes() << " after the last\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Scatters jointCount small spheres in a 20 unit cube, then times
+//  closest hit picking rays through every sphere (as mousePressed
+//  did) and through the picking tree, and times updating the tree
+//  after every sphere moved a little
+void benchmarkPicking(int jointCount, int rayCount)
+{
+	// scatter the spheres and add them to the tree
+	vector<Sphere> spheres(jointCount);
+	vector<int> proxies(jointCount);
+	AABBTree tree;
+	for (int i = 0; i < jointCount; i++) {
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-10, 10), ofRandom(-10, 10), ofRandom(-10, 10)));
+		spheres[i].radius = 0.1;
+		glm::vec3 center = spheres[i].getPosition();
+		proxies[i] = tree.createProxy(center - glm::vec3(0.1), center + glm::vec3(0.1), &spheres[i]);
+	}
+
+	// rays from in front of the cube toward random points in it
+	vector<Ray> rays(rayCount);
+	for (int r = 0; r < rayCount; r++) {
+		glm::vec3 origin(ofRandom(-10, 10), ofRandom(-10, 10), 30);
+		rays[r] = Ray(origin, glm::normalize(glm::vec3(ofRandom(-10, 10), ofRandom(-10, 10), ofRandom(-10, 10)) - origin));
+	}
+
+	// pick by testing every sphere
+	int linearHits = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		float closest = std::numeric_limits<float>::infinity();
+		for (int i = 0; i < jointCount; i++) {
+			glm::vec3 point, normal;
+			if (spheres[i].intersect(rays[r], point, normal)) closest = std::min(closest, glm::distance(point, rays[r].p));
+		}
+		if (closest != std::numeric_limits<float>::infinity()) linearHits++;
+	}
+	double linearTime = secondsSince(start);
+
+	// pick through the tree
+	int treeHits = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		bool bHit = false;
+		tree.raycast(rays[r].p, rays[r].d, std::numeric_limits<float>::infinity(), [&](int proxy, float tMax) {
+			glm::vec3 point, normal;
+			if (!tree.getObject(proxy)->intersect(rays[r], point, normal)) return tMax;
+			bHit = true;
+			return std::min(tMax, glm::distance(point, rays[r].p));
+		});
+		if (bHit) treeHits++;
+	}
+	double treeTime = secondsSince(start);
+
+	// move every sphere a little and update its box
+	start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < jointCount; i++) {
+		spheres[i].setLocalPosition(spheres[i].position + glm::vec3(ofRandom(-0.2, 0.2), ofRandom(-0.2, 0.2), ofRandom(-0.2, 0.2)));
+		glm::vec3 center = spheres[i].getPosition();
+		tree.moveProxy(proxies[i], center - glm::vec3(0.1), center + glm::vec3(0.1));
+	}
+	double moveTime = secondsSince(start);
+
+	// print results
+	cout << "Picking (" << jointCount << " joints, " << rayCount << " rays):" << endl;
+	cout << "  Every joint: " << linearTime / rayCount * 1e6 << " us/pick (" << linearHits << " hits)" << endl;
+	cout << "  AABB tree: " << treeTime / rayCount * 1e6 << " us/pick (" << treeHits << " hits, height "
+		<< tree.getHeight() << ")" << endl;
+	cout << "  Moving every joint: " << moveTime * 1000.0 << " ms\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Scatters spheres over a floor, then finds the closest hit and its
+//  normal for rays from a camera both ways, counting the hits that
+//  agree
+void benchmarkPrimaryRays(int sphereCount, int rayCount)
+{
+	// the scene: a floor and spheres above it
+	vector<SceneObject *> scene;
+	Plane floor(glm::vec3(0, -10, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 40, 40);
+	scene.push_back(&floor);
+	vector<Sphere> spheres(sphereCount);
+	for (int i = 0; i < sphereCount; i++) {
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-10, 10), ofRandom(-10, 10), ofRandom(-10, 10)));
+		spheres[i].radius = ofRandom(0.2, 1.0);
+		scene.push_back(&spheres[i]);
+	}
+
+	// rays from a camera in front of the scene toward random points in it
+	vector<Ray> rays(rayCount);
+	for (int r = 0; r < rayCount; r++) {
+		glm::vec3 origin(0, 0, 30);
+		rays[r] = Ray(origin, glm::normalize(glm::vec3(ofRandom(-12, 12), ofRandom(-12, 12), -10) - origin));
+	}
+
+	// closest object by comparing distances of every hit, then intersecting it again for its normal
+	vector<glm::vec3> normals(rayCount);
+	int twoPassHits = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		float shortestDistance = std::numeric_limits<float>::infinity();
+		SceneObject *closestObject = NULL;
+		for (int k = 0; k < scene.size(); k++) {
+			glm::vec3 point, normal;
+			if (scene[k]->intersect(rays[r], point, normal) && glm::distance(rays[r].p, point) < shortestDistance) {
+				shortestDistance = glm::distance(rays[r].p, point);
+				closestObject = scene[k];
+			}
+		}
+		if (closestObject) {
+			glm::vec3 point;
+			closestObject->intersect(rays[r], point, normals[r]);
+			twoPassHits++;
+		}
+	}
+	double twoPassTime = secondsSince(start);
+
+	// each ray traced once, with the normal computed for the closest hit only
+	int singlePassHits = 0, agreeing = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		HitRecord hit;
+		for (int k = 0; k < scene.size(); k++) scene[k]->intersect(rays[r], hit);
+		if (hit.object) {
+			glm::vec3 normal = hit.object->getHitNormal(rays[r], hit);
+			if (glm::dot(normal, normals[r]) > 0.999) agreeing++;
+			singlePassHits++;
+		}
+	}
+	double singlePassTime = secondsSince(start);
+
+	// print results
+	cout << "Primary rays (" << sphereCount << " spheres and a floor, " << rayCount << " rays):" << endl;
+	cout << "  Compare distances, intersect closest again: " << twoPassTime / rayCount * 1e6 << " us/ray ("
+		<< twoPassHits << " hits)" << endl;
+	cout << "  Hit record: " << singlePassTime / rayCount * 1e6 << " us/ray (" << singlePassHits << " hits, "
+		<< agreeing << " with matching normals)\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Keeps one renderer across the nudges (so it only re-traces what
+//  changed) and renders every nudge from scratch with a second one,
+//  counting the pixels where the two images differ
+void benchmarkIncrementalRender(int sphereCount, int width, int height, int nudges)
+{
+	// the scene: a floor, spheres above it, and three lights
+	Plane floor(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 20, 20);
+	vector<Sphere> spheres(sphereCount);
+	vector<SceneObject *> objects;
+	objects.push_back(&floor);
+	for (int i = 0; i < sphereCount; i++) {
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-5, 5), ofRandom(-2, 2), ofRandom(-3, 3)));
+		spheres[i].radius = ofRandom(0.2, 0.5);
+		objects.push_back(&spheres[i]);
+	}
+	PointLight light1(glm::vec3(0, 4, 0), 100, 0.1), light2(glm::vec3(-5, 2, 2), 100, 0.1), light3(glm::vec3(3, 5, -2), 100, 0.1);
+	vector<Light *> lights = { &light1, &light2, &light3 };
+	RenderCam camera;
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+
+	ofImage image, reference;
+	image.allocate(width, height, OF_IMAGE_COLOR);
+	reference.allocate(width, height, OF_IMAGE_COLOR);
+	Renderer renderer;
+	renderer.render(scene, image);
+	double firstTime = renderer.renderTime;
+
+	// nudge one sphere at a time
+	double incrementalTime = 0, fullTime = 0;
+	int tilesTraced = 0, differentPixels = 0;
+	for (int n = 0; n < nudges; n++) {
+		Sphere &sphere = spheres[(int)ofRandom(0, sphereCount) % sphereCount];
+		sphere.setLocalPosition(sphere.position + glm::vec3(ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1)));
+		tilesTraced += renderer.render(scene, image);
+		incrementalTime += renderer.renderTime;
+
+		Renderer full;
+		full.render(scene, reference);
+		fullTime += full.renderTime;
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				if (image.getColor(x, y) != reference.getColor(x, y)) differentPixels++;
+			}
+		}
+	}
+
+	// print results
+	cout << "Incremental render (" << sphereCount << " spheres, " << width << "x" << height << ", " << renderer.tiles.size()
+		<< " tiles):" << endl;
+	cout << "  First render: " << firstTime * 1000.0 << " ms" << endl;
+	cout << "  Full render: " << fullTime / nudges * 1000.0 << " ms/nudge" << endl;
+	cout << "  Changed tiles: " << incrementalTime / nudges * 1000.0 << " ms/nudge (" << (float)tilesTraced / nudges
+		<< " tiles traced, " << differentPixels << " pixels differ from the full render)\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Returns the root mean square difference of the color channels of
+//  two images of the same size
+static double imageError(const ofImage &image, const ofImage &reference)
+{
+	double sum = 0;
+	int width = (int)image.getWidth(), height = (int)image.getHeight();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			ofColor a = image.getColor(x, y), b = reference.getColor(x, y);
+			double dr = (double)a.r - b.r, dg = (double)a.g - b.g, db = (double)a.b - b.b;
+			sum += dr * dr + dg * dg + db * db;
+		}
+	}
+	return sqrt(sum / (3.0 * width * height));
+}
+
+//--------------------------------------------------------------
+// Renders a floor with spheres casting soft shadows from a rectangle
+//  light and a sphere light, with doubling numbers of light samples
+//  from each sampler, and measures each image's error against a
+//  reference rendered with many Sobol samples
+void benchmarkSoftShadows(int width, int height, int referenceSamples, float targetError)
+{
+	// the scene: a floor with a few spheres between it and the lights
+	Plane floor(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 20, 20);
+	vector<Sphere> spheres(6);
+	vector<SceneObject *> objects;
+	objects.push_back(&floor);
+	for (int i = 0; i < spheres.size(); i++) {
+		spheres[i].setLocalPosition(glm::vec3(-4 + 1.6 * i, -1 + 0.3 * (i % 3), -1 + 0.4 * (i % 2)));
+		spheres[i].radius = 0.5;
+		objects.push_back(&spheres[i]);
+	}
+	RectLight panel(glm::vec3(0, 4, 0), 100, glm::vec3(2, 0, 0), glm::vec3(0, 0, 2));
+	SphereLight bulb(glm::vec3(-5, 2, 2), 100, 0.5);
+	vector<Light *> lights = { &panel, &bulb };
+	RenderCam camera;
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+
+	// the reference
+	ofImage image, reference;
+	image.allocate(width, height, OF_IMAGE_COLOR);
+	reference.allocate(width, height, OF_IMAGE_COLOR);
+	Renderer renderer;
+	scene.sampler = SAMPLER_SOBOL;
+	scene.lightSamples = referenceSamples;
+	renderer.render(scene, reference);
+	cout << "Soft shadows (" << width << "x" << height << ", " << lights.size() << " area lights, reference of "
+		<< referenceSamples << " samples in " << renderer.renderTime * 1000.0 << " ms):" << endl;
+
+	// each sampler with doubling samples per light, until the error is below the target
+	SamplerType samplers[] = { SAMPLER_WHITE_NOISE, SAMPLER_SOBOL };
+	for (SamplerType sampler : samplers) {
+		scene.sampler = sampler;
+		cout << "  " << getSamplerName(sampler) << ":";
+		int reachedSamples = 0;
+		double reachedTime = 0;
+		for (int samples = 1; samples < referenceSamples; samples *= 2) {
+			scene.lightSamples = samples;
+			renderer.render(scene, image);
+			double error = imageError(image, reference);
+			cout << " " << samples << "spp=" << error;
+			if (error <= targetError) {
+				reachedSamples = samples;
+				reachedTime = renderer.renderTime;
+				break;
+			}
+		}
+		if (reachedSamples > 0) {
+			cout << "\n    reached error " << targetError << " with " << reachedSamples << " samples per light in "
+				<< reachedTime * 1000.0 << " ms" << endl;
+		}
+		else {
+			cout << "\n    did not reach error " << targetError << " below " << referenceSamples << " samples per light" << endl;
+		}
+	}
+	cout << endl;
+}
+
+//--------------------------------------------------------------
+// Scatters spheres and planes, then traces rays from a camera through
+//  the objects' virtual interface and through the flat arrays of a
+//  compiled scene, counting the hits that agree
+void benchmarkSceneCompilation(int sphereCount, int planeCount, int rayCount)
+{
+	// the scene: a floor, small planes and spheres
+	vector<SceneObject *> objects;
+	Plane floor(glm::vec3(0, -10, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 40, 40);
+	objects.push_back(&floor);
+	vector<Plane> planes(planeCount);
+	for (int i = 0; i < planeCount; i++) {
+		planes[i].position = glm::vec3(ofRandom(-10, 10), ofRandom(-10, 10), ofRandom(-10, 0));
+		planes[i].normal = glm::normalize(glm::vec3(ofRandom(-0.3, 0.3), ofRandom(-0.3, 0.3), 1));
+		planes[i].width = planes[i].height = ofRandom(1, 3);
+		objects.push_back(&planes[i]);
+	}
+	vector<Sphere> spheres(sphereCount);
+	for (int i = 0; i < sphereCount; i++) {
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-10, 10), ofRandom(-10, 10), ofRandom(-10, 10)));
+		spheres[i].radius = ofRandom(0.2, 1.0);
+		objects.push_back(&spheres[i]);
+	}
+	vector<Light *> lights;
+	RenderCam camera;
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+
+	// rays from a camera in front of the scene toward random points in it
+	vector<Ray> rays(rayCount);
+	for (int r = 0; r < rayCount; r++) {
+		glm::vec3 origin(0, 0, 30);
+		rays[r] = Ray(origin, glm::normalize(glm::vec3(ofRandom(-12, 12), ofRandom(-12, 12), -10) - origin));
+	}
+
+	// every object through its virtual intersect
+	vector<float> closest(rayCount);
+	int virtualHits = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		HitRecord hit;
+		for (int k = 0; k < objects.size(); k++) objects[k]->intersect(rays[r], hit);
+		closest[r] = hit.t;
+		if (hit.object) virtualHits++;
+	}
+	double virtualTime = secondsSince(start);
+
+	// compiling in full, then the compiled arrays
+	CompiledScene compiled;
+	start = chrono::high_resolution_clock::now();
+	compiled.update(scene);
+	double compileTime = secondsSince(start);
+	int compiledHits = 0, agreeing = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int r = 0; r < rayCount; r++) {
+		CompiledHit hit;
+		if (compiled.intersect(rays[r], hit)) {
+			if (hit.record.t == closest[r]) agreeing++;
+			compiledHits++;
+		}
+	}
+	double compiledTime = secondsSince(start);
+
+	// updating after moving one sphere at a time
+	int updates = 100, objectsCompiled = 0;
+	start = chrono::high_resolution_clock::now();
+	for (int n = 0; n < updates; n++) {
+		Sphere &sphere = spheres[(int)ofRandom(0, sphereCount) % sphereCount];
+		sphere.setLocalPosition(sphere.position + glm::vec3(ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1), ofRandom(-0.1, 0.1)));
+		compiled.update(scene);
+		objectsCompiled += compiled.objectsCompiled;
+	}
+	double updateTime = secondsSince(start) / updates;
+
+	// print results
+	cout << "Scene compilation (" << sphereCount << " spheres, " << planeCount + 1 << " planes, " << rayCount << " rays):" << endl;
+	cout << "  Virtual intersect: " << virtualTime / rayCount * 1e6 << " us/ray (" << virtualHits << " hits)" << endl;
+	cout << "  Compiled arrays: " << compiledTime / rayCount * 1e6 << " us/ray (" << compiledHits << " hits, "
+		<< agreeing << " at the same distance)" << endl;
+	cout << "  Full compile: " << compileTime * 1000.0 << " ms, update after moving a sphere: " << updateTime * 1000.0
+		<< " ms (" << (float)objectsCompiled / updates << " objects compiled)\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Renders every setting with both renderers (keeping each one's fastest
+//  of a few renders) and counts the pixels where their images differ
+void benchmarkShadingKernels(int sphereCount, int width, int height)
+{
+	// the scene: spheres over a checkered floor, lit by two point lights
+	vector<SceneObject *> objects;
+	Plane floor(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 40, 40);
+	ofImage checker;
+	checker.allocate(64, 64, OF_IMAGE_COLOR);
+	for (int y = 0; y < 64; y++) {
+		for (int x = 0; x < 64; x++) checker.setColor(x, y, (x / 8 + y / 8) % 2 ? ofColor::white : ofColor::gray);
+	}
+	floor.applyTexture(checker);
+	objects.push_back(&floor);
+	vector<Sphere> spheres(sphereCount);
+	for (int i = 0; i < sphereCount; i++) {
+		spheres[i].setLocalPosition(glm::vec3(ofRandom(-6, 6), ofRandom(-1, 3), ofRandom(-8, 0)));
+		spheres[i].radius = ofRandom(0.3, 1.0);
+		spheres[i].diffuseColor = ofColor(ofRandom(64, 255), ofRandom(64, 255), ofRandom(64, 255));
+		objects.push_back(&spheres[i]);
+	}
+	PointLight light1(glm::vec3(-4, 6, 4), 40, 0.1), light2(glm::vec3(5, 4, 2), 30, 0.1);
+	vector<Light *> lights = { &light1, &light2 };
+	RenderCam camera;
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+
+	struct Setting {
+		string name;
+		ShadingModel model;
+		float power;
+		bool bShadows;
+	};
+	vector<Setting> settings = {
+		{ "Phong, power 20", SHADING_PHONG, 20, true },
+		{ "Phong, power 20.5", SHADING_PHONG, 20.5, true },
+		{ "Lambert", SHADING_LAMBERT, 20, true },
+		{ "Phong, no shadows", SHADING_PHONG, 20, false },
+	};
+	cout << "Shading kernels (" << sphereCount << " spheres, " << width << "x" << height << "):" << endl;
+	ofImage specialized, general;
+	specialized.allocate(width, height, OF_IMAGE_COLOR);
+	general.allocate(width, height, OF_IMAGE_COLOR);
+	for (const Setting &setting : settings) {
+		scene.shadingModel = setting.model;
+		scene.phongPower = setting.power;
+		scene.bShadows = setting.bShadows;
+		double times[2] = { 1e9, 1e9 };
+		unsigned features = 0;
+		for (int run = 0; run < 3; run++) {
+			for (int k = 0; k < 2; k++) {
+				Renderer renderer;
+				renderer.bSpecialize = k == 0;
+				renderer.render(scene, k == 0 ? specialized : general);
+				times[k] = std::min(times[k], renderer.renderTime);
+				if (k == 0) features = renderer.getShadingFeatures();
+			}
+		}
+		int differing = 0;
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				if (specialized.getColor(x, y) != general.getColor(x, y)) differing++;
+			}
+		}
+		cout << "  " << setting.name << ": specialized " << times[0] * 1000.0 << " ms (features 0x" << std::hex << features
+			<< std::dec << "), per-pixel tests " << times[1] * 1000.0 << " ms, " << differing << " pixels differ" << endl;
+	}
+	cout << endl;
+}
+
+//--------------------------------------------------------------
+// Renders the scene with the shadow rays traced one at a time and in
+//  sorted streams (keeping each one's fastest of a few renders) and
+//  counts the pixels where the images differ
+void benchmarkShadowStreams(int meshTriangles, int lightSamples, int width, int height)
+{
+	// the scene: a sphere mesh and a few spheres over a floor, lit by a
+	//  rect light and a sphere light
+	vector<SceneObject *> objects;
+	Plane floor(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkOliveGreen, 40, 40);
+	objects.push_back(&floor);
+	Mesh ball;
+	int segments = std::max(3, (int)sqrt(meshTriangles / 2.0));
+	int rings = std::max(2, meshTriangles / (2 * segments));
+	for (int i = 0; i <= rings; i++) {
+		for (int j = 0; j <= segments; j++) {
+			float theta = glm::pi<float>() * i / rings, phi = 2 * glm::pi<float>() * j / segments;
+			glm::vec3 normal(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			ball.verts.push_back(1.5f * normal);
+			ball.nVerts.push_back(normal);
+		}
+	}
+	for (int i = 0; i < rings; i++) {
+		for (int j = 0; j < segments; j++) {
+			int a = i * (segments + 1) + j, b = a + 1, c = a + segments + 1, d = c + 1;
+			ball.triangles.push_back(Triangle(a, c, b, a, c, b));
+			ball.triangles.push_back(Triangle(b, c, d, b, c, d));
+		}
+	}
+	ball.maxYVal = 1.5;
+	ball.minYVal = -1.5;
+	ball.meshTransMatrix = glm::translate(glm::mat4(1.0), glm::vec3(0, -0.5, -2));
+	ball.inverseMeshTransMatrix = glm::inverse(ball.meshTransMatrix);
+	ball.buildBVH();
+	objects.push_back(&ball);
+	vector<Sphere> spheres(8);
+	for (int i = 0; i < spheres.size(); i++) {
+		spheres[i].setLocalPosition(glm::vec3(-5 + 1.4 * i, -1.4, 1 + 0.5 * (i % 2)));
+		spheres[i].radius = 0.6;
+		objects.push_back(&spheres[i]);
+	}
+	RectLight panel(glm::vec3(0, 5, 0), 150, glm::vec3(2, 0, 0), glm::vec3(0, 0, 2));
+	SphereLight bulb(glm::vec3(-5, 3, 3), 100, 0.5);
+	vector<Light *> lights = { &panel, &bulb };
+	RenderCam camera;
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+	scene.sampler = SAMPLER_SOBOL;
+	scene.lightSamples = lightSamples;
+
+	ofImage streams, interleaved;
+	streams.allocate(width, height, OF_IMAGE_COLOR);
+	interleaved.allocate(width, height, OF_IMAGE_COLOR);
+	double times[2] = { 1e9, 1e9 };
+	for (int run = 0; run < 3; run++) {
+		for (int k = 0; k < 2; k++) {
+			Renderer renderer;
+			renderer.bWavefront = k == 0;
+			renderer.render(scene, k == 0 ? streams : interleaved);
+			times[k] = std::min(times[k], renderer.renderTime);
+		}
+	}
+	int differing = 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (streams.getColor(x, y) != interleaved.getColor(x, y)) differing++;
+		}
+	}
+	cout << "Shadow ray streams (" << ball.triangles.size() << " triangle mesh, " << lightSamples << " samples per light, "
+		<< width << "x" << height << "):" << endl;
+	cout << "  interleaved " << times[1] * 1000.0 << " ms, sorted streams " << times[0] * 1000.0 << " ms ("
+		<< times[1] / times[0] << "x), " << differing << " pixels differ" << endl << endl;
+}
+
+//--------------------------------------------------------------
+// Sums the face normals of the triangles, reading their vertices in the
+//  order of the indices (as drawing the mesh or refitting its hierarchy
+//  does)
+static volatile float faceNormalSum = 0;		// keeps the passes from being optimized away
+static glm::vec3 sumFaceNormals(const vector<glm::vec3> &verts, const vector<int> &indices)
+{
+	glm::vec3 sum(0);
+	for (int i = 0; i < indices.size(); i += 3) {
+		const glm::vec3 &v0 = verts[indices[i]];
+		sum += glm::cross(verts[indices[i + 1]] - v0, verts[indices[i + 2]] - v0);
+	}
+	return sum;
+}
+
+//--------------------------------------------------------------
+// Returns the numbers 0 to count - 1 in random order
+static vector<int> shuffledNumbers(int count)
+{
+	vector<int> numbers(count);
+	for (int i = 0; i < count; i++) numbers[i] = i;
+	for (int i = count - 1; i > 0; i--) std::swap(numbers[i], numbers[(int)ofRandom(0, i + 1) % (i + 1)]);
+	return numbers;
+}
+
+//--------------------------------------------------------------
+// Shuffles a latitude and longitude sphere, then measures it in each
+//  order (renumbering the vertices by first use after reordering, as
+//  Mesh::optimizeOrder does)
+void benchmarkMeshOrder(int triangleCount)
+{
+	// the sphere: rings x segments quads of two triangles each
+	int segments = std::max(3, (int)sqrt(triangleCount / 2.0));
+	int rings = std::max(2, triangleCount / (2 * segments));
+	vector<glm::vec3> sphereVerts;
+	for (int i = 0; i <= rings; i++) {
+		for (int j = 0; j <= segments; j++) {
+			float theta = glm::pi<float>() * i / rings, phi = 2 * glm::pi<float>() * j / segments;
+			sphereVerts.push_back(glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+		}
+	}
+	vector<int> sphereIndices;
+	for (int i = 0; i < rings; i++) {
+		for (int j = 0; j < segments; j++) {
+			int a = i * (segments + 1) + j, b = a + 1, c = a + segments + 1, d = c + 1;
+			sphereIndices.insert(sphereIndices.end(), { a, c, b, b, c, d });
+		}
+	}
+
+	// file order: triangles and vertex numbers shuffled
+	vector<int> shuffle = shuffledNumbers((int)sphereIndices.size() / 3);
+	vector<int> renumber = shuffledNumbers((int)sphereVerts.size());
+	vector<glm::vec3> verts(sphereVerts.size());
+	for (int v = 0; v < verts.size(); v++) verts[renumber[v]] = sphereVerts[v];
+	vector<int> indices;
+	for (int t : shuffle) {
+		for (int k = 0; k < 3; k++) indices.push_back(renumber[sphereIndices[t * 3 + k]]);
+	}
+	int triangles = (int)indices.size() / 3;
+
+	cout << "Mesh order (" << triangles << " triangles, " << verts.size() << " vertices):" << endl;
+	for (int pass = 0; pass < 3; pass++) {
+		vector<glm::vec3> orderedVerts = verts;
+		vector<int> orderedIndices = indices;
+		double orderTime = 0;
+		if (pass > 0) {
+			// as one cluster, then in clusters of the default size
+			auto start = chrono::high_resolution_clock::now();
+			vector<int> order = orderTrianglesForCache(verts, indices, pass == 1 ? triangles : 256);
+			for (int t = 0; t < triangles; t++) {
+				for (int k = 0; k < 3; k++) orderedIndices[t * 3 + k] = indices[order[t] * 3 + k];
+			}
+			vector<int> remap = orderVerticesByFirstUse(orderedIndices, (int)verts.size());
+			for (int v = 0; v < verts.size(); v++) orderedVerts[remap[v]] = verts[v];
+			for (int &index : orderedIndices) index = remap[index];
+			orderTime = secondsSince(start);
+		}
+		float missRatio = getAverageCacheMissRatio(orderedIndices, 32);
+		int lineMisses = countCacheLineMisses(orderedIndices, sizeof(glm::vec3));
+
+		// best of a few passes over the triangles
+		double passTime = 1e9;
+		for (int run = 0; run < 5; run++) {
+			auto start = chrono::high_resolution_clock::now();
+			faceNormalSum = faceNormalSum + sumFaceNormals(orderedVerts, orderedIndices).x;
+			passTime = std::min(passTime, secondsSince(start));
+		}
+		const char *names[] = { "File order", "Vertex cache order", "Clustered order" };
+		cout << "  " << names[pass] << ": " << missRatio << " vertex cache misses/triangle, "
+			<< (float)lineMisses / triangles << " cache line misses/triangle, pass " << passTime * 1000.0 << " ms";
+		if (pass > 0) cout << " (ordered in " << orderTime * 1000.0 << " ms)";
+		cout << endl;
+	}
+	cout << endl;
+}
+
+//--------------------------------------------------------------
+// Returns true if any triangle of the first placed mesh intersects any
+//  triangle of the second (every pair tested)
+static bool meshesIntersect(const Mesh &a, const Mesh &b)
+{
+	vector<glm::vec3> aVerts, bVerts;
+	for (const glm::vec3 &v : a.verts) aVerts.push_back(a.meshTransMatrix * glm::vec4(v, 1));
+	for (const glm::vec3 &v : b.verts) bVerts.push_back(b.meshTransMatrix * glm::vec4(v, 1));
+	for (const Triangle &s : a.triangles) {
+		glm::vec3 sCorners[3] = { aVerts[s.vertInd[0]], aVerts[s.vertInd[1]], aVerts[s.vertInd[2]] };
+		for (const Triangle &t : b.triangles) {
+			glm::vec3 tCorners[3] = { bVerts[t.vertInd[0]], bVerts[t.vertInd[1]], bVerts[t.vertInd[2]] };
+			if (trianglesIntersect(sCorners, tCorners)) return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+// Builds the rig (limbs spread around a body bone, every bone a little
+//  longer than its mesh's joints are apart so neighbours overlap like
+//  the robot's parts), then poses every joint at random within 60
+//  degrees of rest and times ofApp::findCollisions on each pose
+void benchmarkMeshCollisions(int limbCount, int meshTriangles, int poseCount)
+{
+	// one unit sphere mesh per bone, scaled to the bone below
+	int segments = std::max(3, (int)sqrt(meshTriangles / 2.0));
+	int rings = std::max(2, meshTriangles / (2 * segments));
+	vector<Joint *> joints;
+	vector<Mesh *> meshes;
+	auto addJoint = [&](Joint *parent, glm::vec3 offset) {
+		Joint *joint = new Joint("joint" + std::to_string(joints.size()), offset, 0.1);
+		joints.push_back(joint);
+		if (parent == NULL) return joint;
+		joint->setParent(parent);
+		parent->addChild(joint);
+
+		// ellipsoid reaching a little past both joints
+		Mesh *mesh = new Mesh();
+		glm::vec3 scale(0.15, glm::length(offset) * 0.6, 0.15);
+		for (int i = 0; i <= rings; i++) {
+			for (int j = 0; j <= segments; j++) {
+				float theta = glm::pi<float>() * i / rings, phi = 2 * glm::pi<float>() * j / segments;
+				glm::vec3 normal(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+				mesh->verts.push_back(scale * normal);
+				mesh->nVerts.push_back(normal);
+			}
+		}
+		for (int i = 0; i < rings; i++) {
+			for (int j = 0; j < segments; j++) {
+				int a = i * (segments + 1) + j, b = a + 1, c = a + segments + 1, d = c + 1;
+				mesh->triangles.push_back(Triangle(a, c, b, a, c, b));
+				mesh->triangles.push_back(Triangle(b, c, d, b, c, d));
+			}
+		}
+		mesh->buildBVH();
+		joint->attatchMesh(mesh);
+		meshes.push_back(mesh);
+		return joint;
+	};
+	Joint *root = addJoint(NULL, glm::vec3(0));
+	addJoint(addJoint(root, glm::vec3(0, 1, 0)), glm::vec3(0, 0.5, 0));
+	for (int limb = 0; limb < limbCount; limb++) {
+		float angle = 2 * glm::pi<float>() * (limb + 0.5f) / limbCount;
+		glm::vec3 out(0.4f * cos(angle), -0.6f, 0.4f * sin(angle));
+		Joint *joint = root;
+		for (int bone = 0; bone < 3; bone++) joint = addJoint(joint, out);
+	}
+	int triangles = 0;
+	for (Mesh *mesh : meshes) triangles += (int)mesh->triangles.size();
+
+	// random poses, and every pair of triangles on the first few
+	vector<pair<Mesh *, Mesh *>> collisions;
+	double totalTime = 0, worstTime = 0;
+	int collidingPoses = 0, checkedPoses = std::min(poseCount, 5), mismatches = 0;
+	double bruteTime = 0;
+	for (int pose = 0; pose < poseCount; pose++) {
+		for (int i = 1; i < joints.size(); i++) {
+			joints[i]->setRotation(glm::vec3(ofRandom(-60, 60), ofRandom(-60, 60), ofRandom(-60, 60)));
+		}
+		auto start = chrono::high_resolution_clock::now();
+		ofApp::findCollisions(joints, collisions);
+		double time = secondsSince(start);
+		totalTime += time;
+		worstTime = std::max(worstTime, time);
+		if (!collisions.empty()) collidingPoses++;
+		if (pose >= checkedPoses) continue;
+
+		// the same pairs findCollisions tests (bones that don't share a joint)
+		start = chrono::high_resolution_clock::now();
+		for (int i = 1; i < joints.size(); i++) {
+			for (int j = i + 1; j < joints.size(); j++) {
+				Joint *a = joints[i], *b = joints[j];
+				if (a->parent == b || b->parent == a || a->parent == b->parent) continue;
+				bool bBrute = meshesIntersect(*a->attatchedMesh, *b->attatchedMesh);
+				bool bFound = std::find(collisions.begin(), collisions.end(), make_pair(a->attatchedMesh, b->attatchedMesh)) != collisions.end();
+				if (bBrute != bFound) mismatches++;
+			}
+		}
+		bruteTime += secondsSince(start);
+	}
+
+	// print results
+	cout << "Mesh collisions (" << meshes.size() << " meshes, " << triangles << " triangles, " << poseCount << " poses):" << endl;
+	cout << "  BVH pairs: " << totalTime / poseCount * 1000.0 << " ms/pose (worst " << worstTime * 1000.0 << " ms, "
+		<< collidingPoses << " poses colliding)" << endl;
+	cout << "  Every triangle pair: " << bruteTime / checkedPoses * 1000.0 << " ms/pose (" << mismatches
+		<< " pairs disagreeing over " << checkedPoses << " poses)\n" << endl;
+	for (Joint *joint : joints) delete joint;
+	for (Mesh *mesh : meshes) delete mesh;
+}
+
+//--------------------------------------------------------------
+// A tiny call to time, with and without a zone (called through a
+//  pointer so the loops below really call it)
+static volatile uint32_t profiledWork = 0;
+static void unprofiledCall(uint32_t i)
+{
+	profiledWork = profiledWork + i;
+}
+static void profiledCall(uint32_t i)
+{
+	PROFILE_ZONE("benchmark");
+	profiledWork = profiledWork + i;
+}
+
+//--------------------------------------------------------------
+// Times the calls with the profiler off and on (restoring its state)
+void benchmarkProfilerOverhead(int zoneCount)
+{
+	void (*volatile unprofiled)(uint32_t) = unprofiledCall;
+	void (*volatile profiled)(uint32_t) = profiledCall;
+	bool bWasEnabled = Profiler::isEnabled();
+	Profiler::setEnabled(false);
+	auto start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < zoneCount; i++) unprofiled(i);
+	double plainTime = secondsSince(start);
+	start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < zoneCount; i++) profiled(i);
+	double offTime = secondsSince(start);
+	Profiler::setEnabled(true);
+	start = chrono::high_resolution_clock::now();
+	for (int i = 0; i < zoneCount; i++) profiled(i);
+	double onTime = secondsSince(start);
+	Profiler::setEnabled(bWasEnabled);
+
+	// print results
+	cout << "Profiler overhead (" << zoneCount << " calls" << (PROFILER_ENABLED ? "" : ", zones compiled out") << "):" << endl;
+	cout << "  No zone: " << plainTime / zoneCount * 1e9 << " ns/call" << endl;
+	cout << "  Zone, profiler off: " << offTime / zoneCount * 1e9 << " ns/call" << endl;
+	cout << "  Zone, profiler on: " << onTime / zoneCount * 1e9 << " ns/call\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Runs every benchmark with its default settings
+void runBenchmarks()
+{
+	benchmarkPoseEvaluation();
+	benchmarkSkinning();
+	benchmarkClipSampling();
+	benchmarkCrowdEvaluation();
+	benchmarkMeshIntersection();
+	benchmarkInverseKinematics();
+	benchmarkNameLookup();
+	benchmarkSkeletonLoading();
+	benchmarkSceneReload();
+	benchmarkPicking();
+	benchmarkPrimaryRays();
+	benchmarkIncrementalRender();
+	benchmarkSoftShadows();
+	benchmarkSceneCompilation();
+	benchmarkShadingKernels();
+	benchmarkShadowStreams();
+	benchmarkMeshOrder();
+	benchmarkMeshCollisions();
+	benchmarkProfilerOverhead();
+}
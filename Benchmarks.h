@@ -0,0 +1,107 @@
+// This file provides declarations of benchmark routines that measure
+//  the throughput of the animation and rendering subsystems.
+// Results are printed to the console.
+
+#pragma once
+
+#include "ofMain.h"
+
+// Compares pose evaluation of a jointCount joint skeleton through the
+//  SceneObject graph against the flat Skeleton evaluator
+void benchmarkPoseEvaluation(int jointCount = 10000, int iterations = 100);
+
+// Times linear blend skinning of a vertexCount vertex mesh bound to a
+//  15 joint skeleton
+void benchmarkSkinning(int vertexCount = 1000000, int iterations = 20);
+
+// Times sampling a clip with keyframe tracks for every joint of a
+//  jointCount joint skeleton during forward playback and random scrubbing
+void benchmarkClipSampling(int jointCount = 100, int keysPerTrack = 300, int frames = 10000);
+
+// Times posing instanceCount instances of a jointCount joint skeleton
+//  sharing one clip on one thread and on all hardware threads
+void benchmarkCrowdEvaluation(int instanceCount = 500, int jointCount = 30, int frames = 100);
+
+// Compares closest hit ray queries against a triangleCount triangle mesh
+//  by testing every triangle and through a bounding volume hierarchy,
+//  one triangle at a time and with each triangle block kernel the CPU runs
+void benchmarkMeshIntersection(int triangleCount = 100000, int rayCount = 100000);
+
+// Times solving two leg and two arm chains on each of instanceCount
+//  humanoid poses with FABRIK and with CCD on all hardware threads
+void benchmarkInverseKinematics(int instanceCount = 500, int frames = 100);
+
+// Times building a jointCount joint hierarchy whose parents are given by
+//  name (as in a script file) through the hash indexed SceneRegistry
+//  against scanning every joint's name (on scanCount joints)
+void benchmarkNameLookup(int jointCount = 50000, int scanCount = 5000);
+
+// Writes a random jointCount joint skeleton as a joint script file and
+//  as a binary skeleton file, then times loading each of them
+void benchmarkSkeletonLoading(int jointCount = 50000);
+
+// Times reloading a scene of objectCount scene objects reloads times from
+//  an ObjectPool against new/delete, and reports the pool's memory after
+//  the first and the last reload
+void benchmarkSceneReload(int objectCount = 50000, int reloads = 20);
+
+// Compares picking one of jointCount joint spheres by testing every
+//  sphere against walking the dynamic AABB tree, and times moving every
+//  joint's box in the tree
+void benchmarkPicking(int jointCount = 10000, int rayCount = 10000);
+
+// Compares shading the closest hit of rayCount primary rays through a
+//  scene of sphereCount spheres and a floor by comparing distances and
+//  intersecting the closest object again (the old point and normal
+//  queries) against tracing each ray once with a HitRecord
+void benchmarkPrimaryRays(int sphereCount = 200, int rayCount = 100000);
+
+// Renders a width x height image of sphereCount spheres over a floor lit
+//  by three lights, then nudges one sphere at a time nudges times and
+//  compares re-rendering only the changed tiles against a full render
+void benchmarkIncrementalRender(int sphereCount = 50, int width = 600, int height = 400, int nudges = 10);
+
+// Renders a width x height image of spheres shadowed by a rectangle light
+//  and a sphere light with white noise and with Sobol light samples,
+//  doubling the samples per light until the root mean square error
+//  against a referenceSamples image falls to targetError, and reports
+//  the samples and time each sampler needed
+void benchmarkSoftShadows(int width = 240, int height = 160, int referenceSamples = 1024, float targetError = 2.0);
+
+// Compares finding the closest hit of rayCount rays through a scene of
+//  sphereCount spheres and planeCount planes by calling each object's
+//  intersect against the renderer's compiled scene, and times compiling
+//  the scene in full against updating it after moving one sphere
+void benchmarkSceneCompilation(int sphereCount = 200, int planeCount = 20, int rayCount = 100000);
+
+// Renders a width x height image of spheres on a textured floor with
+//  each shading setting (phong with a whole and a fractional power,
+//  lambert, phong without shadows), once with the kernel specialized for
+//  the setting and once with a kernel that tests the features per pixel
+void benchmarkShadingKernels(int sphereCount = 30, int width = 320, int height = 240);
+
+// Renders a width x height image of a sphere mesh of about meshTriangles
+//  triangles and a few spheres under two area lights of lightSamples
+//  samples each, tracing the shadow rays interleaved with the shading and
+//  in sorted streams per tile
+void benchmarkShadowStreams(int meshTriangles = 20000, int lightSamples = 16, int width = 320, int height = 240);
+
+// Builds a sphere of about triangleCount triangles with its triangles and
+//  vertices shuffled (like a file listing faces at random), then reports
+//  the vertex cache misses per triangle, the cache line misses of reading
+//  the vertices and the time of a pass over the triangles in file order,
+//  ordered for the vertex cache as one cluster and in spatial clusters
+void benchmarkMeshOrder(int triangleCount = 500000);
+
+// Builds a rig of a body and limbCount limbs of three bones, each bone
+//  covered by an ellipsoid mesh of about meshTriangles triangles, then
+//  times checking poseCount random poses for interpenetrating meshes and
+//  compares the first few poses against testing every pair of triangles
+void benchmarkMeshCollisions(int limbCount = 4, int meshTriangles = 1000, int poseCount = 500);
+
+// Times a loop of zoneCount tiny calls without a profiler zone, with a
+//  zone while the profiler is off and with a zone while it is on
+void benchmarkProfilerOverhead(int zoneCount = 10000000);
+
+// Runs every benchmark with its default settings
+void runBenchmarks();
@@ -0,0 +1,351 @@
+// This file provides implementation of the CompiledScene class methods.
+
+#include "CompiledScene.h"
+#include "Renderer.h"
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+// Returns the array an object is compiled into
+static CompiledKind kindOf(SceneObject *object)
+{
+	if (dynamic_cast<MeshInstance *>(object) || dynamic_cast<Mesh *>(object)) return COMPILED_MESH;
+	if (dynamic_cast<Plane *>(object)) return COMPILED_PLANE;
+	if (dynamic_cast<Sphere *>(object)) return COMPILED_SPHERE;
+	return COMPILED_OTHER;
+}
+
+//--------------------------------------------------------------
+// Drops the elements of objects that left the scene, keeping the rest
+//  in order and pointing their entries at their new places
+template <class T>
+void CompiledScene::removeUnseen(vector<T> &array, CompiledKind kind)
+{
+	vector<Entry *> kept;
+	for (auto &entry : entries) {
+		if (entry.second.kind == kind && entry.second.bSeen) kept.push_back(&entry.second);
+	}
+	std::sort(kept.begin(), kept.end(), [](const Entry *a, const Entry *b) { return a->index < b->index; });
+	for (int i = 0; i < kept.size(); i++) {
+		array[i] = array[kept[i]->index];
+		kept[i]->index = i;
+	}
+	array.resize(kept.size());
+}
+
+//--------------------------------------------------------------
+// Compares every object with the state its entry was compiled in and
+//  recompiles the changed ones in place, drops the objects that left the
+//  scene and appends the objects added after the others, so the arrays
+//  list objects in the scene's order as a full compile would (which
+//  decides between hits at the same distance). Objects inserted before
+//  others, reordered or listed twice make it compile the arrays again.
+//  The lights are compiled every time.
+void CompiledScene::update(const RenderScene &scene)
+{
+	const vector<SceneObject *> &objects = *scene.objects;
+	objectsCompiled = 0;
+	for (auto &entry : entries) entry.second.bSeen = false;
+	vector<int> added;						// places of the objects without entries
+	int seen = 0, lastOrder = -1;
+	bool bRebuild = false;
+	for (int i = 0; i < objects.size(); i++) {
+		SceneObject *object = objects[i];
+		auto found = entries.find(object->serial);
+		if (found == entries.end()) {
+			added.push_back(i);
+			continue;
+		}
+		Entry &entry = found->second;
+		if (entry.bSeen || entry.order < lastOrder || !added.empty()) {
+			bRebuild = true;
+			break;
+		}
+		lastOrder = entry.order;
+		entry.order = i;
+		entry.bSeen = true;
+		seen++;
+
+		glm::vec3 boundsMin, boundsMax;
+		bool bBounded = object->getWorldBounds(boundsMin, boundsMax);
+		if (entry.bBounded == bBounded && entry.revision == object->revision && entry.diffuse == object->diffuseColor &&
+			(!bBounded || (entry.boundsMin == boundsMin && entry.boundsMax == boundsMax))) {
+			continue;
+		}
+		entry.bBounded = bBounded;
+		entry.boundsMin = boundsMin;
+		entry.boundsMax = boundsMax;
+		entry.revision = object->revision;
+		entry.diffuse = object->diffuseColor;
+		compile(object, entry);
+		objectsCompiled++;
+	}
+
+	if (bRebuild) {
+		spheres.clear();
+		planes.clear();
+		meshes.clear();
+		others.clear();
+		entries.clear();
+		added.resize(objects.size());
+		for (int i = 0; i < objects.size(); i++) added[i] = i;
+		objectsCompiled = 0;
+	}
+	else if (seen < entries.size()) {
+		removeUnseen(spheres, COMPILED_SPHERE);
+		removeUnseen(planes, COMPILED_PLANE);
+		removeUnseen(meshes, COMPILED_MESH);
+		removeUnseen(others, COMPILED_OTHER);
+		for (auto entry = entries.begin(); entry != entries.end();) {
+			if (entry->second.bSeen) ++entry;
+			else entry = entries.erase(entry);
+		}
+	}
+	for (int i : added) {
+		SceneObject *object = objects[i];
+		Entry &entry = entries[object->serial];
+		entry.kind = kindOf(object);
+		entry.index = -1;
+		entry.order = i;
+		entry.bBounded = object->getWorldBounds(entry.boundsMin, entry.boundsMax);
+		entry.revision = object->revision;
+		entry.diffuse = object->diffuseColor;
+		entry.bSeen = true;
+		compile(object, entry);
+		objectsCompiled++;
+	}
+
+	// lights
+	lights.resize(scene.lights->size());
+	for (int i = 0; i < lights.size(); i++) {
+		const Light *light = (*scene.lights)[i];
+		CompiledLight &compiled = lights[i];
+		compiled.position = light->position;
+		compiled.intensity = light->intensity;
+		compiled.boundingRadius = light->getBoundingRadius();
+		compiled.radius = 0;
+		compiled.edgeU = compiled.edgeV = glm::vec3(0);
+		if (const SphereLight *sphereLight = dynamic_cast<const SphereLight *>(light)) {
+			compiled.shape = COMPILED_SPHERE_LIGHT;
+			compiled.radius = sphereLight->radius;
+		}
+		else if (const RectLight *rectLight = dynamic_cast<const RectLight *>(light)) {
+			compiled.shape = COMPILED_RECT_LIGHT;
+			compiled.edgeU = rectLight->edgeU;
+			compiled.edgeV = rectLight->edgeV;
+		}
+		else {
+			compiled.shape = COMPILED_POINT_LIGHT;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Writes the object into the array of its entry's kind
+void CompiledScene::compile(SceneObject *object, Entry &entry)
+{
+	if (entry.kind == COMPILED_MESH) {
+		Mesh *mesh = dynamic_cast<Mesh *>(object);
+		MeshInstance *instance = mesh ? NULL : dynamic_cast<MeshInstance *>(object);
+		CompiledMesh compiled;
+		compiled.mesh = mesh ? mesh : instance->mesh;
+		compiled.transform = mesh ? mesh->meshTransMatrix : instance->transform;
+		compiled.inverseTransform = mesh ? mesh->inverseMeshTransMatrix : instance->inverseTransform;
+		compiled.diffuse = object->diffuseColor;
+		compiled.source = object;
+		if (entry.index < 0) {
+			entry.index = (int)meshes.size();
+			meshes.push_back(compiled);
+		}
+		else meshes[entry.index] = compiled;
+	}
+	else if (entry.kind == COMPILED_PLANE) {
+		Plane *plane = static_cast<Plane *>(object);
+		CompiledPlane compiled;
+		compiled.position = plane->position;
+		compiled.normal = plane->normal;
+		compiled.width = plane->width;
+		compiled.height = plane->height;
+		compiled.diffuse = object->diffuseColor;
+		compiled.textured = plane->textureApplied ? plane : NULL;
+		compiled.source = object;
+		if (entry.index < 0) {
+			entry.index = (int)planes.size();
+			planes.push_back(compiled);
+		}
+		else planes[entry.index] = compiled;
+	}
+	else if (entry.kind == COMPILED_SPHERE) {
+		Sphere *sphere = static_cast<Sphere *>(object);
+		CompiledSphere compiled;
+		compiled.center = sphere->getPosition();
+		compiled.radius = sphere->radius;
+		compiled.diffuse = object->diffuseColor;
+		compiled.source = object;
+		if (entry.index < 0) {
+			entry.index = (int)spheres.size();
+			spheres.push_back(compiled);
+		}
+		else spheres[entry.index] = compiled;
+	}
+	else if (entry.index < 0) {
+		entry.index = (int)others.size();
+		others.push_back(object);
+	}
+}
+
+//--------------------------------------------------------------
+// Forgets every entry
+void CompiledScene::clear()
+{
+	spheres.clear();
+	planes.clear();
+	meshes.clear();
+	others.clear();
+	lights.clear();
+	entries.clear();
+}
+
+//--------------------------------------------------------------
+// Tests each array in turn; every test culls hits farther than the
+//  closest one so far
+bool CompiledScene::intersect(const Ray &ray, CompiledHit &hit) const
+{
+	HitRecord &record = hit.record;
+	float t;
+	for (int i = 0; i < spheres.size(); i++) {
+		if (Sphere::intersectSphere(ray, spheres[i].center, spheres[i].radius, record.tMin, record.tMax, t)) {
+			record.set(t, spheres[i].source);
+			hit.kind = COMPILED_SPHERE;
+			hit.index = i;
+		}
+	}
+	for (int i = 0; i < planes.size(); i++) {
+		const CompiledPlane &plane = planes[i];
+		if (Plane::intersectPlane(ray, plane.position, plane.normal, plane.width, plane.height, record.tMin, record.tMax, t)) {
+			record.set(t, plane.source);
+			hit.kind = COMPILED_PLANE;
+			hit.index = i;
+		}
+	}
+	for (int i = 0; i < meshes.size(); i++) {
+		if (meshes[i].mesh->intersect(ray, meshes[i].inverseTransform, record)) {
+			record.object = meshes[i].source;
+			hit.kind = COMPILED_MESH;
+			hit.index = i;
+		}
+	}
+	for (int i = 0; i < others.size(); i++) {
+		if (others[i]->intersect(ray, record)) {
+			hit.kind = COMPILED_OTHER;
+			hit.index = i;
+		}
+	}
+	return hit.index >= 0;
+}
+
+//--------------------------------------------------------------
+// Records the entry that blocked the ray
+static bool blockedBy(CompiledHit *blocker, CompiledKind kind, int index)
+{
+	if (blocker) {
+		blocker->kind = kind;
+		blocker->index = index;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Stops at the first hit closer than tMax
+bool CompiledScene::occluded(const Ray &ray, float tMax, CompiledHit *blocker) const
+{
+	HitRecord record;
+	record.tMax = tMax;
+	float t;
+	for (int i = 0; i < spheres.size(); i++) {
+		if (Sphere::intersectSphere(ray, spheres[i].center, spheres[i].radius, record.tMin, record.tMax, t)) {
+			return blockedBy(blocker, COMPILED_SPHERE, i);
+		}
+	}
+	for (int i = 0; i < planes.size(); i++) {
+		const CompiledPlane &plane = planes[i];
+		if (Plane::intersectPlane(ray, plane.position, plane.normal, plane.width, plane.height, record.tMin, record.tMax, t)) {
+			return blockedBy(blocker, COMPILED_PLANE, i);
+		}
+	}
+	for (int i = 0; i < meshes.size(); i++) {
+		if (meshes[i].mesh->intersect(ray, meshes[i].inverseTransform, record)) return blockedBy(blocker, COMPILED_MESH, i);
+	}
+	for (int i = 0; i < others.size(); i++) {
+		if (others[i]->intersect(ray, record)) return blockedBy(blocker, COMPILED_OTHER, i);
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+// Tests the one entry as occluded does
+bool CompiledScene::occludedBy(const Ray &ray, float tMax, const CompiledHit &blocker) const
+{
+	HitRecord record;
+	record.tMax = tMax;
+	float t;
+	switch (blocker.kind) {
+	case COMPILED_SPHERE: {
+		const CompiledSphere &sphere = spheres[blocker.index];
+		return Sphere::intersectSphere(ray, sphere.center, sphere.radius, record.tMin, record.tMax, t);
+	}
+	case COMPILED_PLANE: {
+		const CompiledPlane &plane = planes[blocker.index];
+		return Plane::intersectPlane(ray, plane.position, plane.normal, plane.width, plane.height, record.tMin, record.tMax, t);
+	}
+	case COMPILED_MESH:
+		return meshes[blocker.index].mesh->intersect(ray, meshes[blocker.index].inverseTransform, record);
+	default:
+		return others[blocker.index]->intersect(ray, record);
+	}
+}
+
+//--------------------------------------------------------------
+// Computes the normal of the entry hit (only done for the closest hit)
+glm::vec3 CompiledScene::getNormal(const Ray &ray, const CompiledHit &hit) const
+{
+	switch (hit.kind) {
+	case COMPILED_SPHERE:
+		return glm::normalize(ray.p + hit.record.t * ray.d - spheres[hit.index].center);
+	case COMPILED_PLANE:
+		return planes[hit.index].normal;
+	case COMPILED_MESH:
+		return meshes[hit.index].mesh->getNormal(meshes[hit.index].transform, hit.record.primIndex, hit.record.bary);
+	default:
+		return others[hit.index]->getHitNormal(ray, hit.record);
+	}
+}
+
+//--------------------------------------------------------------
+// Returns the entry's color (a textured plane's comes from its texture)
+ofColor CompiledScene::getColor(const CompiledHit &hit, const glm::vec3 &point) const
+{
+	switch (hit.kind) {
+	case COMPILED_SPHERE:
+		return spheres[hit.index].diffuse;
+	case COMPILED_PLANE:
+		return planes[hit.index].textured ? planes[hit.index].textured->Plane::getColor(point) : planes[hit.index].diffuse;
+	case COMPILED_MESH:
+		return meshes[hit.index].diffuse;
+	default:
+		return others[hit.index]->getColor(point);
+	}
+}
+
+//--------------------------------------------------------------
+// Samples the light by its shape
+glm::vec3 CompiledScene::sampleLight(const CompiledLight &light, const glm::vec2 &u, const glm::vec3 &from) const
+{
+	switch (light.shape) {
+	case COMPILED_SPHERE_LIGHT:
+		return SphereLight::sampleSphere(light.position, light.radius, u, from);
+	case COMPILED_RECT_LIGHT:
+		return RectLight::sampleRect(light.position, light.edgeU, light.edgeV, u);
+	default:
+		return light.position;
+	}
+}
@@ -0,0 +1,141 @@
+// This file provides the definition of the CompiledScene class, which
+//  flattens the objects and lights of a RenderScene into one contiguous
+//  array per kind (spheres, planes, mesh placements and lights) that the
+//  renderer walks without virtual calls.
+// Each entry holds what the ray tests and shading read (a sphere's world
+//  center and radius, a plane's placement and size, a placement's mesh and
+//  transformations, the object's color), so tracing a ray reads arrays in
+//  order instead of chasing pointers to objects scattered on the heap.
+// Compiling is incremental: the compiled scene remembers every object's
+//  entry and the state it was compiled in, and update only recompiles the
+//  objects that were added or changed (by the same test the renderer uses
+//  to find changed tiles) and drops removed objects' entries. The arrays
+//  keep the scene's order, so hits at the same distance are resolved the
+//  same way as by a full compile. The lights, which are few and change
+//  every frame, are compiled every time.
+// Objects of other types keep being traced through the SceneObject
+//  interface, so a scene never loses objects by being compiled.
+
+#pragma once
+
+#include "ofMain.h"
+#include "SceneObjects.h"
+
+class Mesh;
+struct RenderScene;
+
+// kinds of compiled objects
+enum CompiledKind { COMPILED_SPHERE, COMPILED_PLANE, COMPILED_MESH, COMPILED_OTHER };
+
+// kinds of compiled lights
+enum CompiledLightShape { COMPILED_POINT_LIGHT, COMPILED_SPHERE_LIGHT, COMPILED_RECT_LIGHT };
+
+// CompiledSphere: a sphere (or joint) at its world position
+//
+struct CompiledSphere {
+	glm::vec3 center;
+	float radius;
+	ofColor diffuse;
+	SceneObject *source;					// object the entry was compiled from
+};
+
+// CompiledPlane: the width x height part of a plane
+//
+struct CompiledPlane {
+	glm::vec3 position, normal;
+	float width, height;
+	ofColor diffuse;
+	Plane *textured;						// the plane if it is textured (its color is looked up in the texture), else NULL
+	SceneObject *source;
+};
+
+// CompiledMesh: a mesh placed in the world (a mesh's own placement or a MeshInstance)
+//
+struct CompiledMesh {
+	Mesh *mesh;								// mesh whose vertices and hierarchy are tested
+	glm::mat4 transform, inverseTransform;	// places the mesh in the world
+	ofColor diffuse;
+	SceneObject *source;
+};
+
+// CompiledLight: a point, sphere or rectangle light
+//
+struct CompiledLight {
+	CompiledLightShape shape;
+	glm::vec3 position;
+	float intensity;
+	float radius;							// radius of a sphere light
+	glm::vec3 edgeU, edgeV;					// edges of a rectangle light
+	float boundingRadius;					// distance from the position to the farthest point of the light
+};
+
+// CompiledHit: the closest hit of a ray and the entry it hit
+//
+struct CompiledHit {
+	HitRecord record;						// distance, triangle and barycentric coordinates of the hit
+	CompiledKind kind = COMPILED_OTHER;		// array of the entry hit
+	int index = -1;							// entry hit (-1 if nothing was hit)
+};
+
+// CompiledScene class
+//
+class CompiledScene {
+public:
+	// Brings the arrays up to date with the scene, recompiling only the
+	//  objects that were added or changed since the last update
+	void update(const RenderScene &scene);
+
+	// Forgets every entry
+	void clear();
+
+	// Finds the closest hit of the ray (returns false if nothing was hit)
+	bool intersect(const Ray &ray, CompiledHit &hit) const;
+
+	// Returns true if anything is hit by the ray closer than tMax (and the
+	//  entry hit in blocker's kind and index, if given)
+	bool occluded(const Ray &ray, float tMax, CompiledHit *blocker = NULL) const;
+
+	// Returns true if the given entry is hit by the ray closer than tMax
+	bool occludedBy(const Ray &ray, float tMax, const CompiledHit &blocker) const;
+
+	// Returns the surface normal and the color at a hit found by intersect
+	glm::vec3 getNormal(const Ray &ray, const CompiledHit &hit) const;
+	ofColor getColor(const CompiledHit &hit, const glm::vec3 &point) const;
+
+	// Returns the point a shadow ray from the given point aims at for the
+	//  sample u in [0,1)^2 of a light
+	glm::vec3 sampleLight(const CompiledLight &light, const glm::vec2 &u, const glm::vec3 &from) const;
+
+	// Fields of CompiledScene class
+	//
+	vector<CompiledSphere> spheres;
+	vector<CompiledPlane> planes;
+	vector<CompiledMesh> meshes;
+	vector<SceneObject *> others;			// objects traced through the SceneObject interface
+	vector<CompiledLight> lights;
+	int objectsCompiled = 0;				// objects compiled by the last update (the rest were kept)
+
+private:
+	// an object's entry and the state it was compiled in
+	struct Entry {
+		CompiledKind kind;
+		int index;							// place in the array of its kind
+		int order;							// place in the scene's list of objects
+		bool bBounded;
+		glm::vec3 boundsMin, boundsMax;
+		uint32_t revision;
+		ofColor diffuse;
+		bool bSeen;							// marks objects still in the scene while updating
+	};
+
+	// Writes the object into the array of its entry's kind (appending it if
+	//  entry.index is -1)
+	void compile(SceneObject *object, Entry &entry);
+
+	// Drops the elements of objects that left the scene from the array of
+	//  a kind (without reading the objects, which may be gone)
+	template <class T>
+	void removeUnseen(vector<T> &array, CompiledKind kind);
+
+	unordered_map<uint64_t, Entry> entries;	// entries by the object's serial
+};
@@ -0,0 +1,71 @@
+// This file provides implementation of the Crowd class methods.
+
+#include "Crowd.h"
+#include "Parallel.h"
+
+//--------------------------------------------------------------
+// Places the instances on a square grid and hands out the clips
+void Crowd::spawn(const Skeleton &skeleton, int count, float spacing, glm::vec3 origin,
+	const vector<const AnimationClip *> &clips)
+{
+	this->skeleton = &skeleton;
+	skeletonVersion = skeleton.version;
+	instances.resize(count);
+
+	// grid dimensions (as square as possible)
+	int columns = std::max(1, (int)ceil(sqrt((float)count)));
+	int rows = (count + columns - 1) / columns;
+	glm::vec3 corner = origin - glm::vec3((columns - 1) * spacing / 2, 0, (rows - 1) * spacing / 2);
+
+	for (int n = 0; n < count; n++) {
+		CrowdInstance &instance = instances[n];
+		glm::vec3 position = corner + glm::vec3((n % columns) * spacing, 0, (n / columns) * spacing);
+		instance.rootMatrix = glm::translate(glm::mat4(1.0), position);
+		instance.clip = clips.size() > 0 ? clips[n % clips.size()] : NULL;
+		instance.timeOffset = (instance.clip && instance.clip->duration > 0) ? ofRandom(0, instance.clip->duration) : 0;
+		instance.cursors = ClipCursors();
+		skeleton.copyPose(instance.pose);
+	}
+}
+
+//--------------------------------------------------------------
+// Removes every instance
+void Crowd::clear()
+{
+	instances.clear();
+}
+
+//--------------------------------------------------------------
+// Evaluates every instance. Instances only read the shared
+//  skeleton and clips and only write their own cursors and pose,
+//  so ranges of instances run on separate threads without locks.
+void Crowd::evaluate(float time, int minPerThread, const function<bool(CrowdInstance &)> &adjustPose)
+{
+	if (skeleton == NULL) return;
+
+	// start from the skeleton's pose again if its joint table changed
+	bool bReset = skeletonVersion != skeleton->version;
+	skeletonVersion = skeleton->version;
+
+	parallelFor((int)instances.size(), [&](int begin, int end) {
+		for (int n = begin; n < end; n++) {
+			CrowdInstance &instance = instances[n];
+			if (bReset) skeleton->copyPose(instance.pose);
+			if (instance.clip) instance.clip->sample(time + instance.timeOffset, *skeleton, instance.pose, instance.cursors);
+			skeleton->evaluate(instance.pose, instance.rootMatrix);
+			if (adjustPose && adjustPose(instance)) skeleton->evaluate(instance.pose, instance.rootMatrix);
+		}
+	}, minPerThread);
+}
+
+//--------------------------------------------------------------
+// Returns the size of one instance: its fields, its pose arrays
+//  and its clip cursors
+size_t Crowd::getInstanceSizeInBytes() const
+{
+	if (instances.empty()) return 0;
+	const CrowdInstance &instance = instances[0];
+	return sizeof(CrowdInstance) + instance.pose.getSizeInBytes() +
+		(instance.cursors.trackToJoint.capacity() + instance.cursors.positionCursors.capacity() +
+			instance.cursors.rotationCursors.capacity()) * sizeof(int);
+}
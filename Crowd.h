@@ -0,0 +1,59 @@
+// This file provides the definition of the Crowd class, which animates
+//  many instances of one Skeleton.
+// The skeleton's joint table, the animation clips and the meshes are
+//  shared by every instance; an instance only owns its placement, clip
+//  playback cursors and pose (local channels and world matrices), so
+//  memory grows by the pose data alone. Instances are evaluated in
+//  parallel since they don't depend on each other.
+
+#pragma once
+
+#include "ofMain.h"
+#include "Skeleton.h"
+#include "Animation.h"
+
+// CrowdInstance: one placed, animated copy of the crowd's skeleton
+//
+struct CrowdInstance {
+	glm::mat4 rootMatrix;				// placement of the instance's root joints in the world
+	const AnimationClip *clip = NULL;	// clip played by the instance (NULL holds the skeleton's pose)
+	float timeOffset = 0;				// added to the crowd's time when sampling the clip
+	ClipCursors cursors;				// the instance's playback state of its clip
+	SkeletonPose pose;					// the instance's current pose
+};
+
+// Crowd class
+//
+class Crowd {
+public:
+	// Places count instances of the skeleton on a grid of the given spacing
+	//  centered on origin (in the xz plane). Each instance plays one of the
+	//  clips (chosen in turn) from a random time offset.
+	void spawn(const Skeleton &skeleton, int count, float spacing, glm::vec3 origin,
+		const vector<const AnimationClip *> &clips);
+
+	// Removes every instance
+	void clear();
+
+	// Samples every instance's clip at time (plus its offset) and evaluates
+	//  its world matrices, spreading the instances across all hardware
+	//  threads (at least minPerThread instances per thread). adjustPose is
+	//  called for every posed instance on the same thread (e.g. to solve IK);
+	//  if it returns true the instance's world matrices are evaluated again.
+	void evaluate(float time, int minPerThread = 4,
+		const function<bool(CrowdInstance &)> &adjustPose = nullptr);
+
+	// Returns the number of instances
+	int size() const { return (int)instances.size(); }
+
+	// Returns the number of bytes used by one instance (including its pose)
+	size_t getInstanceSizeInBytes() const;
+
+	// Fields of Crowd class
+	//
+	const Skeleton *skeleton = NULL;		// skeleton shared by every instance
+	vector<CrowdInstance> instances;		// the instances of the crowd
+
+private:
+	int skeletonVersion = -1;				// version of the skeleton when the poses were initialised
+};
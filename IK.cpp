@@ -0,0 +1,209 @@
+// This file provides implementation of the IKSolver class methods.
+
+#include "IK.h"
+#include "Animation.h"
+#include "glm/gtx/quaternion.hpp"
+
+//--------------------------------------------------------------
+// Returns the rotation of a world matrix (its columns are
+//  normalised so a uniform scale doesn't distort it)
+static inline glm::quat worldRotation(const glm::mat4 &m)
+{
+	return glm::quat_cast(glm::mat3(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])),
+		glm::normalize(glm::vec3(m[2]))));
+}
+
+//--------------------------------------------------------------
+// Returns the shortest rotation turning direction a into b
+//  (identity if either is too short to have a direction)
+static inline glm::quat rotationBetween(const glm::vec3 &a, const glm::vec3 &b)
+{
+	float lengthA = glm::length(a);
+	float lengthB = glm::length(b);
+	if (lengthA < 1e-6f || lengthB < 1e-6f) return glm::quat(1, 0, 0, 0);
+	return glm::rotation(a / lengthA, b / lengthB);
+}
+
+//--------------------------------------------------------------
+// Returns direction scaled to the given length (keeps fallback
+//  if direction is too short to have a direction)
+static inline glm::vec3 scaledDirection(const glm::vec3 &direction, float length, const glm::vec3 &fallback)
+{
+	float d = glm::length(direction);
+	return d > 1e-6f ? direction * (length / d) : fallback * length;
+}
+
+//--------------------------------------------------------------
+// FABRIK: alternately drags the chain from the target back to
+//  its root and from the root forward to the target, keeping the
+//  bone lengths, then turns every joint so its bone points at the
+//  solved position of the next joint.
+// p and q hold the world positions and rotations of the n joints,
+//  offsets the position of each joint's child in its own frame,
+//  solved is scratch space for n positions.
+static void solveFABRIK(glm::vec3 *p, glm::quat *q, const glm::vec3 *offsets, glm::vec3 *solved, int n,
+	glm::vec3 target, int maxIterations, float tolerance)
+{
+	// bone lengths and reach of the chain
+	float reach = 0;
+	for (int k = 0; k < n - 1; k++) {
+		reach += glm::length(offsets[k]);
+		solved[k] = p[k];
+	}
+	solved[n - 1] = p[n - 1];
+	glm::vec3 root = p[0];
+
+	if (glm::distance(root, target) >= reach) {
+		// out of reach: stretch the chain straight toward the target
+		glm::vec3 direction = scaledDirection(target - root, 1, glm::vec3(0, 1, 0));
+		for (int k = 0; k < n - 1; k++) {
+			solved[k + 1] = solved[k] + direction * glm::length(offsets[k]);
+		}
+	}
+	else {
+		for (int iteration = 0; iteration < maxIterations; iteration++) {
+			if (glm::distance(solved[n - 1], target) <= tolerance) break;
+			// backward: effector onto the target, each joint pulled toward its child
+			solved[n - 1] = target;
+			for (int k = n - 2; k >= 0; k--) {
+				solved[k] = solved[k + 1] + scaledDirection(solved[k] - solved[k + 1], glm::length(offsets[k]), glm::vec3(0, -1, 0));
+			}
+			// forward: root back in place, each joint pulled toward its parent
+			solved[0] = root;
+			for (int k = 0; k < n - 1; k++) {
+				solved[k + 1] = solved[k] + scaledDirection(solved[k + 1] - solved[k], glm::length(offsets[k]), glm::vec3(0, 1, 0));
+			}
+		}
+	}
+
+	// turn the joints root first; every turn also carries the joints below it
+	glm::quat carried = glm::quat(1, 0, 0, 0);
+	for (int k = 0; k < n - 1; k++) {
+		q[k] = carried * q[k];
+		glm::quat turn = rotationBetween(q[k] * offsets[k], solved[k + 1] - p[k]);
+		q[k] = turn * q[k];
+		carried = turn * carried;
+		p[k + 1] = p[k] + q[k] * offsets[k];
+	}
+	q[n - 1] = carried * q[n - 1];
+}
+
+//--------------------------------------------------------------
+// CCD: turns each joint from the effector's parent back to the
+//  root so that the effector lies on the line from the joint to
+//  the target, repeating until the effector reaches the target
+static void solveCCD(glm::vec3 *p, glm::quat *q, int n, glm::vec3 target, int maxIterations, float tolerance)
+{
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		if (glm::distance(p[n - 1], target) <= tolerance) break;
+		for (int k = n - 2; k >= 0; k--) {
+			glm::quat turn = rotationBetween(p[n - 1] - p[k], target - p[k]);
+			// turn the joint and everything below it around the joint
+			for (int m = k + 1; m < n; m++) {
+				p[m] = p[k] + turn * (p[m] - p[k]);
+			}
+			for (int m = k; m < n; m++) {
+				q[m] = turn * q[m];
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Adds the chain ending at the effector
+int IKSolver::addChain(const Skeleton &skeleton, int effector, int numBones)
+{
+	if (effector < 0 || effector >= skeleton.size() || skeleton.parents[effector] < 0 || numBones < 1) return -1;
+
+	// walk up from the effector
+	vector<int> joints;
+	joints.push_back(effector);
+	while (numBones > 0 && skeleton.parents[joints.back()] >= 0) {
+		joints.push_back(skeleton.parents[joints.back()]);
+		numBones--;
+	}
+
+	// store the joints root first
+	chainStarts.push_back((int)chainJoints.size());
+	chainJoints.insert(chainJoints.end(), joints.rbegin(), joints.rend());
+	return (int)chainStarts.size() - 1;
+}
+
+//--------------------------------------------------------------
+// Removes every chain
+void IKSolver::clear()
+{
+	chainStarts.clear();
+	chainJoints.clear();
+}
+
+//--------------------------------------------------------------
+// Gathers the world positions and rotations of every chain into
+//  packed arrays, solves the chains, and writes the local rotation
+//  of every joint but the effectors back into the pose
+template<class Pose>
+void IKSolver::solvePose(const Skeleton &skeleton, Pose &pose, const glm::vec3 *targets) const
+{
+	// scratch arrays (one set per thread)
+	thread_local vector<glm::vec3> positions, offsets, solved;
+	thread_local vector<glm::quat> rotations;
+	int total = (int)chainJoints.size();
+	positions.resize(total);
+	offsets.resize(total);
+	solved.resize(total);
+	rotations.resize(total);
+
+	// gather
+	for (int k = 0; k < total; k++) {
+		const glm::mat4 &world = pose.worldMatrices[chainJoints[k]];
+		positions[k] = glm::vec3(world[3]);
+		rotations[k] = worldRotation(world);
+	}
+
+	for (int c = 0; c < chainStarts.size(); c++) {
+		int first = chainStarts[c];
+		int n = getChainEnd(c) - first;
+		glm::vec3 *p = &positions[first];
+		glm::quat *q = &rotations[first];
+
+		// rotation of the chain root's parent frame (includes the root matrix for root joints)
+		int root = chainJoints[first];
+		glm::quat parentRotation = q[0] * glm::inverse(AnimationClip::eulerToQuat(
+			glm::vec3(pose.rotX[root], pose.rotY[root], pose.rotZ[root])));
+
+		// position of each joint's child in the joint's frame
+		for (int k = 0; k < n - 1; k++) {
+			offsets[first + k] = glm::inverse(q[k]) * (p[k + 1] - p[k]);
+		}
+
+		// solve
+		if (method == CCD) {
+			solveCCD(p, q, n, targets[c], maxIterations, tolerance);
+		}
+		else {
+			solveFABRIK(p, q, &offsets[first], &solved[first], n, targets[c], maxIterations, tolerance);
+		}
+
+		// scatter the local rotations (the effector keeps its own)
+		for (int k = 0; k < n - 1; k++) {
+			glm::quat parent = k == 0 ? parentRotation : q[k - 1];
+			glm::vec3 r = AnimationClip::quatToEuler(glm::inverse(parent) * q[k]);
+			int j = chainJoints[first + k];
+			pose.rotX[j] = r.x; pose.rotY[j] = r.y; pose.rotZ[j] = r.z;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Solves the chains on the skeleton's own pose
+void IKSolver::solve(Skeleton &skeleton, const glm::vec3 *targets) const
+{
+	solvePose(skeleton, skeleton, targets);
+}
+
+//--------------------------------------------------------------
+// Solves the chains on an instance pose of the skeleton
+void IKSolver::solve(const Skeleton &skeleton, SkeletonPose &pose, const glm::vec3 *targets) const
+{
+	solvePose(skeleton, pose, targets);
+}
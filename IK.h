@@ -0,0 +1,64 @@
+// This file provides the definition of the IKSolver class, which poses
+//  joint chains of a Skeleton so that each chain's end-effector reaches
+//  a target, with either FABRIK (forward and backward reaching) or CCD
+//  (cyclic coordinate descent).
+// A solver holds any number of chains of one skeleton. Solving a pose
+//  gathers the world positions and rotations of all of its chains into
+//  packed arrays, solves every chain on those arrays and writes the new
+//  local rotations back, so many chains (and many crowd instances, one
+//  per thread) are solved without chasing the joint hierarchy.
+// Chains should not share joints, and joints are assumed to have unit
+//  scale and no pivot (as created by the app).
+
+#pragma once
+
+#include "ofMain.h"
+#include "Skeleton.h"
+
+// IKSolver class
+//
+class IKSolver {
+public:
+	// IK algorithms
+	enum Method { FABRIK, CCD };
+
+	// Adds the chain of numBones bones ending at the effector joint (shortened
+	//  if the effector has fewer ancestors). Returns the index of the chain
+	//  or -1 if the effector has no parent.
+	int addChain(const Skeleton &skeleton, int effector, int numBones);
+
+	// Removes every chain
+	void clear();
+
+	// Returns the number of chains
+	int getNumChains() const { return (int)chainStarts.size(); }
+
+	// Returns the skeleton index of the given chain's end-effector
+	int getEffector(int chain) const { return chainJoints[getChainEnd(chain) - 1]; }
+
+	// Solves every chain toward its target (targets holds one world position
+	//  per chain). The world matrices must be up to date; only the local
+	//  rotation channels are written, so the world matrices must be
+	//  evaluated again afterwards. The solver is only read, so one solver
+	//  can solve different poses on different threads.
+	void solve(Skeleton &skeleton, const glm::vec3 *targets) const;
+	void solve(const Skeleton &skeleton, SkeletonPose &pose, const glm::vec3 *targets) const;
+
+	// Fields of IKSolver class
+	//
+	Method method = FABRIK;		// algorithm used by solve
+	int maxIterations = 20;		// largest number of iterations per chain
+	float tolerance = 0.001;	// distance from the target at which a chain counts as solved
+	vector<int> chainStarts;	// index of each chain's first joint in chainJoints
+	vector<int> chainJoints;	// skeleton index of every chain's joints, from the chain's root to its effector
+
+private:
+	// Returns the index in chainJoints after the given chain's last joint
+	int getChainEnd(int chain) const {
+		return chain + 1 < chainStarts.size() ? chainStarts[chain + 1] : (int)chainJoints.size();
+	}
+
+	// Solves the chains of a Skeleton or a SkeletonPose
+	template<class Pose>
+	void solvePose(const Skeleton &skeleton, Pose &pose, const glm::vec3 *targets) const;
+};
@@ -0,0 +1,342 @@
+// This file provides implementation of the streaming image writers.
+
+#include "ImageWriter.h"
+
+// TIFF field types
+static const uint16_t TIFF_SHORT = 3, TIFF_LONG = 4, TIFF_LONG8 = 16;
+
+//--------------------------------------------------------------
+// Appends the low bytes of a value, least significant first
+static void putLittleEndian(vector<unsigned char> &data, uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) data.push_back((unsigned char)(value >> (8 * i)));
+}
+
+//--------------------------------------------------------------
+// Appends a 32 bit value, most significant byte first (PNG's order)
+static void putBigEndian(vector<unsigned char> &data, uint32_t value)
+{
+	for (int i = 3; i >= 0; i--) data.push_back((unsigned char)(value >> (8 * i)));
+}
+
+//--------------------------------------------------------------
+TiledTiffWriter::TiledTiffWriter(int tileSize)
+{
+	bandHeight = std::max(16, (tileSize + 15) / 16 * 16);
+}
+
+//--------------------------------------------------------------
+// Writes the header with a placeholder for the directory's offset;
+//  the tiles follow it
+bool TiledTiffWriter::open(const string &fileName, int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	rowsWritten = 0;
+	tilesAcross = (width + bandHeight - 1) / bandHeight;
+	int tilesDown = (height + bandHeight - 1) / bandHeight;
+	tileOffsets.assign((size_t)tilesAcross * tilesDown, 0);
+	tile.resize((size_t)bandHeight * bandHeight * 3);
+
+	// classic TIFF offsets are 32 bits; leave room for the directory
+	uint64_t pixelBytes = (uint64_t)tileOffsets.size() * tile.size();
+	bBigTiff = pixelBytes + 16 * tileOffsets.size() + 4096 > 0xFFFFFFFFull;
+
+	file.open(fileName, ios::binary | ios::trunc);
+	if (!file) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	vector<unsigned char> header = { 'I', 'I' };
+	if (bBigTiff) {
+		putLittleEndian(header, 43, 2);
+		putLittleEndian(header, 8, 2);		// bytes per offset
+		putLittleEndian(header, 0, 2);
+		putLittleEndian(header, 0, 8);		// directory offset, written by close
+	}
+	else {
+		putLittleEndian(header, 42, 2);
+		putLittleEndian(header, 0, 4);
+	}
+	file.write((const char *)header.data(), header.size());
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+// Cuts the band into tiles (padding the right and bottom edges with
+//  black) and appends them
+bool TiledTiffWriter::writeBand(const unsigned char *pixels, int rows)
+{
+	if (!file || rowsWritten >= height) return false;
+	int tileRow = rowsWritten / bandHeight;
+	for (int column = 0; column < tilesAcross; column++) {
+		int x0 = column * bandHeight;
+		int columns = std::min(bandHeight, width - x0);
+		std::fill(tile.begin(), tile.end(), 0);
+		for (int y = 0; y < rows; y++) {
+			memcpy(&tile[(size_t)y * bandHeight * 3], pixels + ((size_t)y * width + x0) * 3, (size_t)columns * 3);
+		}
+		tileOffsets[(size_t)tileRow * tilesAcross + column] = (uint64_t)file.tellp();
+		file.write((const char *)tile.data(), tile.size());
+	}
+	rowsWritten += rows;
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+// Writes the directory after the tiles and points the header at it
+bool TiledTiffWriter::close()
+{
+	if (!file.is_open()) return false;
+	bool bWritten = rowsWritten == height && (bBigTiff ? writeDirectory<uint64_t>() : writeDirectory<uint32_t>());
+	file.close();
+	return bWritten && !file.fail();
+}
+
+//--------------------------------------------------------------
+// Writes the image file directory for offsets of the given size:
+//  the entries, sorted by tag, then the values too long to fit in
+//  an entry
+template<class Offset>
+bool TiledTiffWriter::writeDirectory()
+{
+	const int offsetSize = sizeof(Offset);
+	const uint16_t offsetType = offsetSize == 8 ? TIFF_LONG8 : TIFF_LONG;
+	struct Entry {
+		uint16_t tag, type;
+		uint64_t count;
+		vector<unsigned char> value;
+	};
+	auto entry = [](uint16_t tag, uint16_t type, const vector<uint64_t> &values) {
+		Entry result = { tag, type, values.size(), {} };
+		int size = type == TIFF_SHORT ? 2 : type == TIFF_LONG ? 4 : 8;
+		for (int i = 0; i < values.size(); i++) putLittleEndian(result.value, values[i], size);
+		return result;
+	};
+	uint64_t tileBytes = tile.size();
+	vector<Entry> entries;
+	entries.push_back(entry(256, TIFF_LONG, { (uint64_t)width }));			// image width
+	entries.push_back(entry(257, TIFF_LONG, { (uint64_t)height }));			// image length
+	entries.push_back(entry(258, TIFF_SHORT, { 8, 8, 8 }));					// bits per sample
+	entries.push_back(entry(259, TIFF_SHORT, { 1 }));						// no compression
+	entries.push_back(entry(262, TIFF_SHORT, { 2 }));						// RGB
+	entries.push_back(entry(277, TIFF_SHORT, { 3 }));						// samples per pixel
+	entries.push_back(entry(284, TIFF_SHORT, { 1 }));						// samples interleaved
+	entries.push_back(entry(322, TIFF_LONG, { (uint64_t)bandHeight }));		// tile width
+	entries.push_back(entry(323, TIFF_LONG, { (uint64_t)bandHeight }));		// tile length
+	entries.push_back(entry(324, offsetType, tileOffsets));					// tile offsets
+	entries.push_back(entry(325, offsetType, vector<uint64_t>(tileOffsets.size(), tileBytes)));	// tile byte counts
+
+	// the directory, followed by the values that don't fit in their entries
+	uint64_t directoryOffset = (uint64_t)file.tellp();
+	uint64_t directorySize = offsetSize == 8 ? 8 + 20 * entries.size() + 8 : 2 + 12 * entries.size() + 4;
+	vector<unsigned char> directory, values;
+	putLittleEndian(directory, entries.size(), offsetSize == 8 ? 8 : 2);
+	for (int i = 0; i < entries.size(); i++) {
+		const Entry &field = entries[i];
+		putLittleEndian(directory, field.tag, 2);
+		putLittleEndian(directory, field.type, 2);
+		putLittleEndian(directory, field.count, offsetSize);
+		if (field.value.size() <= offsetSize) {
+			vector<unsigned char> inlineValue = field.value;
+			inlineValue.resize(offsetSize, 0);
+			directory.insert(directory.end(), inlineValue.begin(), inlineValue.end());
+		}
+		else {
+			putLittleEndian(directory, directoryOffset + directorySize + values.size(), offsetSize);
+			values.insert(values.end(), field.value.begin(), field.value.end());
+			if (values.size() & 1) values.push_back(0);		// values start on word boundaries
+		}
+	}
+	putLittleEndian(directory, 0, offsetSize);				// no next directory
+	file.write((const char *)directory.data(), directory.size());
+	file.write((const char *)values.data(), values.size());
+
+	// point the header at the directory
+	vector<unsigned char> pointer;
+	putLittleEndian(pointer, directoryOffset, offsetSize);
+	file.seekp(offsetSize == 8 ? 8 : 4);
+	file.write((const char *)pointer.data(), pointer.size());
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+// Returns the CRC-32 table used by PNG chunks
+static const uint32_t *crcTable()
+{
+	static uint32_t table[256];
+	static bool bBuilt = false;
+	if (!bBuilt) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		bBuilt = true;
+	}
+	return table;
+}
+
+//--------------------------------------------------------------
+// Continues a CRC-32 over more bytes (start with 0)
+static uint32_t updateCrc(uint32_t crc, const unsigned char *data, size_t size)
+{
+	const uint32_t *table = crcTable();
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+//--------------------------------------------------------------
+// Continues an Adler-32 over more bytes (start with 1). The sums are
+//  reduced every 5552 bytes, the most that can't overflow 32 bits.
+static uint32_t updateAdler(uint32_t adler, const unsigned char *data, size_t size)
+{
+	uint32_t a = adler & 0xffff, b = adler >> 16;
+	while (size > 0) {
+		size_t block = std::min(size, (size_t)5552);
+		for (size_t i = 0; i < block; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += block;
+		size -= block;
+	}
+	return (b << 16) | a;
+}
+
+//--------------------------------------------------------------
+// Writes a chunk: its length, type, data and the CRC of type and data
+void BandedPngWriter::writeChunk(const char *type, const vector<unsigned char> &data)
+{
+	vector<unsigned char> header;
+	putBigEndian(header, (uint32_t)data.size());
+	header.insert(header.end(), type, type + 4);
+	uint32_t crc = updateCrc(updateCrc(0, (const unsigned char *)type, 4), data.data(), data.size());
+	vector<unsigned char> trailer;
+	putBigEndian(trailer, crc);
+	file.write((const char *)header.data(), header.size());
+	file.write((const char *)data.data(), data.size());
+	file.write((const char *)trailer.data(), trailer.size());
+}
+
+//--------------------------------------------------------------
+// Writes the signature and the image header
+bool BandedPngWriter::open(const string &fileName, int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	rowsWritten = 0;
+	adler = 1;
+	bHeaderWritten = false;
+	file.open(fileName, ios::binary | ios::trunc);
+	if (!file) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write((const char *)signature, 8);
+	vector<unsigned char> header;
+	putBigEndian(header, (uint32_t)width);
+	putBigEndian(header, (uint32_t)height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });		// 8 bit RGB, deflate, no filter, not interlaced
+	writeChunk("IHDR", header);
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+// Appends the band's rows (each preceded by filter type 0) as stored
+//  deflate blocks of up to 65535 bytes in one IDAT chunk
+bool BandedPngWriter::writeBand(const unsigned char *pixels, int rows)
+{
+	if (!file || rowsWritten >= height) return false;
+	size_t rowBytes = (size_t)width * 3;
+	vector<unsigned char> scanlines;
+	scanlines.reserve(rows * (rowBytes + 1));
+	for (int y = 0; y < rows; y++) {
+		scanlines.push_back(0);
+		scanlines.insert(scanlines.end(), pixels + y * rowBytes, pixels + (y + 1) * rowBytes);
+	}
+	adler = updateAdler(adler, scanlines.data(), scanlines.size());
+
+	chunk.clear();
+	if (!bHeaderWritten) {
+		chunk.insert(chunk.end(), { 0x78, 0x01 });		// zlib header: deflate with a 32K window
+		bHeaderWritten = true;
+	}
+	for (size_t offset = 0; offset < scanlines.size();) {
+		uint16_t length = (uint16_t)std::min(scanlines.size() - offset, (size_t)65535);
+		chunk.push_back(0);								// not the final block, stored
+		putLittleEndian(chunk, length, 2);
+		putLittleEndian(chunk, (uint16_t)~length, 2);
+		chunk.insert(chunk.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+		offset += length;
+	}
+	writeChunk("IDAT", chunk);
+	rowsWritten += rows;
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+// Ends the deflate stream with an empty final block and the Adler-32
+//  of the image data, then writes the end chunk
+bool BandedPngWriter::close()
+{
+	if (!file.is_open()) return false;
+	bool bComplete = rowsWritten == height;
+	chunk.clear();
+	if (!bHeaderWritten) chunk.insert(chunk.end(), { 0x78, 0x01 });
+	chunk.insert(chunk.end(), { 0x01, 0x00, 0x00, 0xff, 0xff });
+	putBigEndian(chunk, adler);
+	writeChunk("IDAT", chunk);
+	writeChunk("IEND", vector<unsigned char>());
+	file.close();
+	return bComplete && !file.fail();
+}
+
+//--------------------------------------------------------------
+// Picks the writer from the file's extension
+ImageStreamWriter *createImageStreamWriter(const string &fileName)
+{
+	size_t dot = fileName.rfind('.');
+	if (dot == string::npos) return NULL;
+	string extension = fileName.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == "tif" || extension == "tiff") return new TiledTiffWriter();
+	if (extension == "png") return new BandedPngWriter();
+	return NULL;
+}
+
+//--------------------------------------------------------------
+// Copies the tile row by row into the bands it covers, then writes
+//  the complete bands at the front
+bool BandAssembler::addTile(int x0, int y0, int x1, int y1, const unsigned char *pixels)
+{
+	int width = writer.getWidth(), bandHeight = writer.getBandHeight();
+	for (int y = y0; y < y1; y++) {
+		int index = y / bandHeight;
+		auto found = bands.find(index);
+		if (found == bands.end()) {
+			int rows = std::min(bandHeight, writer.getHeight() - index * bandHeight);
+			Band band;
+			band.pixels.resize((size_t)width * rows * 3);
+			band.pixelsLeft = (size_t)width * rows;
+			found = bands.insert(make_pair(index, std::move(band))).first;
+		}
+		Band &band = found->second;
+		memcpy(&band.pixels[((size_t)(y - index * bandHeight) * width + x0) * 3], pixels + (size_t)(y - y0) * (x1 - x0) * 3,
+			(size_t)(x1 - x0) * 3);
+		band.pixelsLeft -= x1 - x0;
+	}
+
+	// write the bands that are complete, in order
+	while (!bands.empty() && bands.begin()->first == nextBand && bands.begin()->second.pixelsLeft == 0) {
+		Band &band = bands.begin()->second;
+		if (!writer.writeBand(band.pixels.data(), (int)(band.pixels.size() / ((size_t)width * 3)))) return false;
+		bands.erase(bands.begin());
+		nextBand++;
+	}
+	return true;
+}
@@ -0,0 +1,112 @@
+// This file provides writers that stream an image to disk a band of
+//  rows at a time, so a frame never has to fit in memory.
+// A renderer hands the writer full width bands of rows from top to
+//  bottom. The TIFF writer cuts each band into tiles and appends them to
+//  the file as they come, keeping only the offset of every tile until
+//  the directory is written at the end (BigTIFF is used once the pixels
+//  pass 4 GB). The PNG writer appends each band to the image data as
+//  stored (uncompressed) deflate blocks, keeping only the running CRC
+//  and Adler checksums, so it needs no compression library; tools like
+//  optipng can recompress the result. The BandAssembler collects tiles
+//  that finish in any order (like those returned by render workers) and
+//  passes each band on once all of its tiles arrived.
+
+#pragma once
+
+#include "ofMain.h"
+#include <fstream>
+
+// ImageStreamWriter class: an image file written band by band
+//
+class ImageStreamWriter {
+public:
+	virtual ~ImageStreamWriter() {}
+
+	// Creates the file for a width x height RGB image (returns false if it can't be written)
+	virtual bool open(const string &fileName, int width, int height) = 0;
+
+	// Appends the next rows of the image (bandHeight of them, fewer for the
+	//  last band) as RGB bytes, row by row
+	virtual bool writeBand(const unsigned char *pixels, int rows) = 0;
+
+	// Finishes the file after the last band
+	virtual bool close() = 0;
+
+	// Returns the size of the image and the number of rows in a band
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getBandHeight() const { return bandHeight; }
+
+protected:
+	ofstream file;
+	int width = 0, height = 0;
+	int bandHeight = 32;
+	int rowsWritten = 0;
+};
+
+// TiledTiffWriter class: an uncompressed RGB TIFF of tileSize x tileSize tiles
+//
+class TiledTiffWriter : public ImageStreamWriter {
+public:
+	// tileSize is rounded up to a multiple of 16, as TIFF requires
+	TiledTiffWriter(int tileSize = 32);
+
+	bool open(const string &fileName, int width, int height);
+	bool writeBand(const unsigned char *pixels, int rows);
+	bool close();
+
+private:
+	template<class Offset> bool writeDirectory();
+
+	int tilesAcross = 0;
+	bool bBigTiff = false;						// 64 bit offsets for files over 4 GB
+	vector<uint64_t> tileOffsets;				// offset of each tile in the file, row by row
+	vector<unsigned char> tile;					// the tile being cut from a band
+};
+
+// BandedPngWriter class: an 8 bit RGB PNG of stored deflate blocks
+//
+class BandedPngWriter : public ImageStreamWriter {
+public:
+	bool open(const string &fileName, int width, int height);
+	bool writeBand(const unsigned char *pixels, int rows);
+	bool close();
+
+private:
+	void writeChunk(const char *type, const vector<unsigned char> &data);
+
+	uint32_t adler = 1;							// Adler-32 of the uncompressed image data
+	bool bHeaderWritten = false;				// tracks whether the zlib header was written
+	vector<unsigned char> chunk;				// data of the chunk being written
+};
+
+// Returns a writer for the file's extension (.tif, .tiff or .png), or
+//  NULL for other formats
+ImageStreamWriter *createImageStreamWriter(const string &fileName);
+
+// BandAssembler class: collects tiles finished in any order and writes
+//  each band once all of its rows are complete
+//
+class BandAssembler {
+public:
+	BandAssembler(ImageStreamWriter &writer) : writer(writer) {}
+
+	// Copies the tile's pixels (RGB bytes, row by row) into their bands and
+	//  writes the bands that are now complete, in order. Returns false if
+	//  writing failed.
+	bool addTile(int x0, int y0, int x1, int y1, const unsigned char *pixels);
+
+	// Returns the number of bands held in memory
+	int bandsHeld() const { return (int)bands.size(); }
+
+private:
+	// a band waiting for tiles
+	struct Band {
+		vector<unsigned char> pixels;
+		size_t pixelsLeft;
+	};
+
+	ImageStreamWriter &writer;
+	map<int, Band> bands;						// incomplete or not yet written bands
+	int nextBand = 0;							// next band to write
+};
@@ -0,0 +1,104 @@
+// This file provides implementation of the MappedFile class methods.
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// mapped in place of an empty file (a zero length mapping is an error)
+static const char emptyFile[1] = { 0 };
+
+#ifdef _WIN32
+
+//--------------------------------------------------------------
+// Maps the file through a read only file mapping object
+bool MappedFile::open(const string &fileName)
+{
+	close();
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	length = (size_t)fileSize.QuadPart;
+	if (length == 0) {
+		bytes = emptyFile;
+		return true;
+	}
+	mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle) bytes = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Unmaps the view and closes the handles
+void MappedFile::close()
+{
+	if (bytes && bytes != emptyFile) UnmapViewOfFile(bytes);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle) CloseHandle(fileHandle);
+	bytes = NULL;
+	length = 0;
+	mappingHandle = NULL;
+	fileHandle = NULL;
+}
+
+#else
+
+//--------------------------------------------------------------
+// Maps the file with mmap (the descriptor can be closed once the
+//  mapping exists)
+bool MappedFile::open(const string &fileName)
+{
+	close();
+	int file = ::open(fileName.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	struct stat info;
+	if (fstat(file, &info) != 0) {
+		::close(file);
+		return false;
+	}
+	length = (size_t)info.st_size;
+	if (length == 0) {
+		::close(file);
+		bytes = emptyFile;
+		return true;
+	}
+	void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapping == MAP_FAILED) {
+		length = 0;
+		return false;
+	}
+	// the file is parsed front to back
+	madvise(mapping, length, MADV_SEQUENTIAL);
+	bytes = (const char *)mapping;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Unmaps the file
+void MappedFile::close()
+{
+	if (bytes && bytes != emptyFile) munmap((void *)bytes, length);
+	bytes = NULL;
+	length = 0;
+}
+
+#endif
@@ -0,0 +1,38 @@
+// This file provides the definition of the MappedFile class, which maps
+//  a whole file into memory read only (mmap on POSIX systems, a file
+//  mapping object on Windows). Loaders parse the mapped bytes directly
+//  instead of copying the file through a stream.
+
+#pragma once
+
+#include "ofMain.h"
+
+// MappedFile class
+//
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	// a mapping has a single owner
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Maps the file (returns false if it can't be opened or mapped)
+	bool open(const string &fileName);
+
+	// Unmaps the file
+	void close();
+
+	// Returns the first byte of the file and the file's size in bytes
+	const char *data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const char *bytes = NULL;		// start of the mapping (NULL if nothing is mapped)
+	size_t length = 0;				// size of the file
+#ifdef _WIN32
+	void *fileHandle = NULL;		// the open file
+	void *mappingHandle = NULL;		// the file mapping object
+#endif
+};
@@ -0,0 +1,272 @@
+// This file provides implementation of the MemoryReport class methods,
+//  the heap counters and the global operator new and delete that
+//  update them.
+
+#include "MemoryAccounting.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if MEMORY_TRACKING
+
+// heap counters (constant initialized, so allocations made before main see them)
+static std::atomic<uint64_t> heapAllocations{ 0 };
+static std::atomic<uint64_t> heapFrees{ 0 };
+static std::atomic<int64_t> heapBytesInUse{ 0 };
+static std::atomic<int64_t> heapPeakBytesInUse{ 0 };
+
+// size of the header in front of every block (keeps the block aligned
+//  like malloc's)
+static const size_t heapHeaderSize = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+// AlignedHeader: what sits right in front of a block allocated with
+//  more than malloc's alignment
+//
+struct AlignedHeader {
+	void *block;		// what malloc returned (the header and padding come first)
+	size_t size;		// bytes asked for
+};
+
+//--------------------------------------------------------------
+// Counts an allocation of size bytes
+static void countAllocation(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	int64_t inUse = heapBytesInUse.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+	int64_t peak = heapPeakBytesInUse.load(std::memory_order_relaxed);
+	while (inUse > peak && !heapPeakBytesInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+}
+
+//--------------------------------------------------------------
+// Counts freeing size bytes
+static void countFree(size_t size)
+{
+	heapFrees.fetch_add(1, std::memory_order_relaxed);
+	heapBytesInUse.fetch_sub((int64_t)size, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+// Allocates the block behind a header holding its size and counts it
+//  (returns NULL if malloc fails)
+static void *trackedAllocate(size_t size)
+{
+	char *block = (char *)malloc(size + heapHeaderSize);
+	if (!block) return NULL;
+	*(size_t *)block = size;
+	countAllocation(size);
+	return block + heapHeaderSize;
+}
+
+//--------------------------------------------------------------
+// Frees a block allocated by trackedAllocate and counts it
+static void trackedFree(void *pointer)
+{
+	if (!pointer) return;
+	char *block = (char *)pointer - heapHeaderSize;
+	countFree(*(size_t *)block);
+	free(block);
+}
+
+//--------------------------------------------------------------
+// Allocates size bytes at a multiple of alignment (a power of two)
+//  with an AlignedHeader in front, and counts them (returns NULL if
+//  malloc fails)
+static void *trackedAllocateAligned(size_t size, size_t alignment)
+{
+	if (alignment < alignof(AlignedHeader)) alignment = alignof(AlignedHeader);
+	char *block = (char *)malloc(size + alignment + sizeof(AlignedHeader));
+	if (!block) return NULL;
+	uintptr_t first = (uintptr_t)block + sizeof(AlignedHeader);
+	char *pointer = (char *)((first + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	AlignedHeader *header = (AlignedHeader *)pointer - 1;
+	header->block = block;
+	header->size = size;
+	countAllocation(size);
+	return pointer;
+}
+
+//--------------------------------------------------------------
+// Frees a block allocated by trackedAllocateAligned and counts it
+static void trackedFreeAligned(void *pointer)
+{
+	if (!pointer) return;
+	AlignedHeader *header = (AlignedHeader *)pointer - 1;
+	countFree(header->size);
+	free(header->block);
+}
+
+//--------------------------------------------------------------
+// Allocates like the standard operator new (calling the new handler
+//  until it gives up); an alignment of 0 means malloc's
+static void *trackedNew(size_t size, size_t alignment = 0)
+{
+	if (size == 0) size = 1;
+	while (true) {
+		void *pointer = alignment ? trackedAllocateAligned(size, alignment) : trackedAllocate(size);
+		if (pointer) return pointer;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+// the replaced global operators
+void *operator new(size_t size) { return trackedNew(size); }
+void *operator new[](size_t size) { return trackedNew(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	try {
+		return trackedNew(size);
+	}
+	catch (...) {
+		return NULL;
+	}
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *pointer) noexcept { trackedFree(pointer); }
+void operator delete[](void *pointer) noexcept { trackedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { trackedFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { trackedFree(pointer); }
+
+// the aligned ones, which C++17 calls for types declared alignas wider
+//  than malloc's alignment, such as the hierarchies' triangle blocks
+//  (before C++17 those go through the ones above)
+#ifdef __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t alignment) { return trackedNew(size, (size_t)alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return trackedNew(size, (size_t)alignment); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	try {
+		return trackedNew(size, (size_t)alignment);
+	}
+	catch (...) {
+		return NULL;
+	}
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size, alignment, tag);
+}
+void operator delete(void *pointer, std::align_val_t) noexcept { trackedFreeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { trackedFreeAligned(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { trackedFreeAligned(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { trackedFreeAligned(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { trackedFreeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { trackedFreeAligned(pointer); }
+#endif
+
+#endif
+
+//--------------------------------------------------------------
+// Reads the counters
+HeapStats getHeapStats()
+{
+	HeapStats stats;
+#if MEMORY_TRACKING
+	stats.bTracked = true;
+	stats.allocations = heapAllocations.load(std::memory_order_relaxed);
+	stats.frees = heapFrees.load(std::memory_order_relaxed);
+	stats.bytesInUse = heapBytesInUse.load(std::memory_order_relaxed);
+	stats.peakBytesInUse = heapPeakBytesInUse.load(std::memory_order_relaxed);
+#endif
+	return stats;
+}
+
+//--------------------------------------------------------------
+// Returns the bytes of the image's pixels
+size_t getImageBytes(const ofImage &image)
+{
+	return image.getPixels().getTotalBytes();
+}
+
+//--------------------------------------------------------------
+// Estimates the texture's size (drivers store 8 bit color textures with
+//  four bytes per texel)
+size_t getTextureBytes(const ofImage &image)
+{
+	if (!image.isUsingTexture() || !image.getTexture().isAllocated()) return 0;
+	return (size_t)image.getTexture().getWidth() * (size_t)image.getTexture().getHeight() * 4;
+}
+
+//--------------------------------------------------------------
+// Returns the count with the largest unit that keeps it above 1
+string formatBytes(size_t bytes)
+{
+	if (bytes >= 1024 * 1024) return ofToString(bytes / (1024.0 * 1024.0), 2) + " MB";
+	if (bytes >= 1024) return ofToString(bytes / 1024.0, 1) + " KB";
+	return std::to_string(bytes) + " B";
+}
+
+//--------------------------------------------------------------
+// Appends the asset
+void MemoryReport::add(const string &category, const string &name, size_t bytes, const string &details)
+{
+	entries.push_back({ category, name, details, bytes, false });
+}
+
+//--------------------------------------------------------------
+// Adds the pixels and the texture as separate assets
+void MemoryReport::addImage(const string &name, const ofImage &image)
+{
+	if (!image.isAllocated()) return;
+	string size = std::to_string((int)image.getWidth()) + "x" + std::to_string((int)image.getHeight());
+	add("Images", name, getImageBytes(image), size);
+	size_t textureBytes = getTextureBytes(image);
+	if (textureBytes > 0) {
+		add("Textures", name, textureBytes, size + ", on the graphics card");
+		entries.back().bGraphicsCard = true;
+	}
+}
+
+//--------------------------------------------------------------
+// Sums every asset
+size_t MemoryReport::getTotalBytes() const
+{
+	size_t total = 0;
+	for (const Entry &entry : entries) total += entry.bytes;
+	return total;
+}
+
+//--------------------------------------------------------------
+// Prints the categories in the order they first appear
+void MemoryReport::print() const
+{
+	vector<string> categories;
+	for (const Entry &entry : entries) {
+		if (std::find(categories.begin(), categories.end(), entry.category) == categories.end()) {
+			categories.push_back(entry.category);
+		}
+	}
+	cout << "Memory:" << endl;
+	for (const string &category : categories) {
+		size_t subtotal = 0;
+		for (const Entry &entry : entries) {
+			if (entry.category == category) subtotal += entry.bytes;
+		}
+		cout << "  " << category << ": " << formatBytes(subtotal) << endl;
+		for (const Entry &entry : entries) {
+			if (entry.category != category) continue;
+			cout << "    " << entry.name << ": " << formatBytes(entry.bytes);
+			if (!entry.details.empty()) cout << " (" << entry.details << ")";
+			cout << endl;
+		}
+	}
+	size_t gpuBytes = 0;
+	for (const Entry &entry : entries) {
+		if (entry.bGraphicsCard) gpuBytes += entry.bytes;
+	}
+	cout << "  Total: " << formatBytes(getTotalBytes() - gpuBytes) << " in memory";
+	if (gpuBytes > 0) cout << ", " << formatBytes(gpuBytes) << " of textures";
+	cout << endl;
+
+	HeapStats heap = getHeapStats();
+	if (heap.bTracked) {
+		cout << "  Heap: " << formatBytes(heap.bytesInUse) << " in use (peak " << formatBytes(heap.peakBytesInUse) << "), "
+			<< heap.allocations << " allocations, " << heap.frees << " frees" << endl;
+	}
+	cout << endl;
+}
@@ -0,0 +1,71 @@
+// This file provides the MemoryReport class and the heap counters, which
+//  show how much memory the assets of a scene hold and how the program
+//  uses the heap.
+// Assets report their own size (getSizeInBytes and Mesh::getMemoryUsage)
+//  by the capacity of their arrays, so memory reserved but unused is
+//  counted too, and a report lists them by category with subtotals.
+// The heap counters come from replacing the global operator new and
+//  delete (the aligned ones included): every allocation carries its size
+//  in a small header, so the bytes in use are known at any time. Building
+//  with MEMORY_TRACKING defined to 0 leaves the standard allocator in
+//  place.
+
+#pragma once
+
+#include "ofMain.h"
+
+#ifndef MEMORY_TRACKING
+#define MEMORY_TRACKING 1
+#endif
+
+// HeapStats: what went through the global operator new and delete
+//
+struct HeapStats {
+	bool bTracked = false;		// false if the counters were compiled out
+	uint64_t allocations = 0;	// calls to operator new
+	uint64_t frees = 0;			// calls to operator delete
+	int64_t bytesInUse = 0;		// bytes allocated and not freed yet
+	int64_t peakBytesInUse = 0;	// most bytes in use at any time
+};
+
+// Returns the heap counters
+HeapStats getHeapStats();
+
+// Returns the bytes held by a vector (its capacity, not just its size)
+template <class T>
+size_t getVectorBytes(const vector<T> &v) { return v.capacity() * sizeof(T); }
+
+// Returns the bytes of an image's pixels in memory, and an estimate of
+//  its texture's on the graphics card (four bytes per texel)
+size_t getImageBytes(const ofImage &image);
+size_t getTextureBytes(const ofImage &image);
+
+// MemoryReport class: sizes of assets by category
+//
+class MemoryReport {
+public:
+	// Adds an asset to a category (details are printed next to it)
+	void add(const string &category, const string &name, size_t bytes, const string &details = "");
+
+	// Adds an image and, if it has one, its texture
+	void addImage(const string &name, const ofImage &image);
+
+	// Returns the bytes of every asset added
+	size_t getTotalBytes() const;
+
+	// Prints the assets by category with subtotals, the total and the
+	//  heap counters
+	void print() const;
+
+	// Fields of MemoryReport class
+	//
+	struct Entry {
+		string category, name, details;
+		size_t bytes;
+		bool bGraphicsCard;		// held by the graphics card instead of main memory
+	};
+	vector<Entry> entries;		// assets in the order they were added
+};
+
+// Returns a byte count in B, KB or MB for printing
+string formatBytes(size_t bytes);
@@ -0,0 +1,240 @@
+// This file provides implementation of the mesh ordering functions.
+
+#include "MeshOrder.h"
+#include <list>
+
+// size of the vertex cache the triangles are ordered for, and the
+//  weights of Forsyth's vertex scores
+static const int forsythCacheSize = 32;
+static const float cacheDecayPower = 1.5f;
+static const float lastTriangleScore = 0.75f;
+static const float valenceBoostScale = 2.0f;
+static const float valenceBoostPower = 0.5f;
+
+// ForsythScores: the score of a vertex by its place in the cache and by
+//  the number of triangles it still has to be drawn with, tabulated
+//
+struct ForsythScores {
+	ForsythScores() {
+		for (int i = 0; i < forsythCacheSize; i++) {
+			// the last triangle's vertices score the same, so its order doesn't matter
+			cache[i] = i < 3 ? lastTriangleScore : pow(1.0f - (float)(i - 3) / (forsythCacheSize - 3), cacheDecayPower);
+		}
+		valence[0] = 0;
+		for (int i = 1; i < valenceCount; i++) valence[i] = valenceBoostScale * pow((float)i, -valenceBoostPower);
+	}
+
+	// Returns the score of a vertex (-1 once it has no triangles left)
+	float get(int cachePosition, int trianglesLeft) const {
+		if (trianglesLeft == 0) return -1;
+		float score = cachePosition >= 0 ? cache[cachePosition] : 0;
+		return score + valence[std::min(trianglesLeft, valenceCount - 1)];
+	}
+
+	static const int valenceCount = 64;
+	float cache[forsythCacheSize];
+	float valence[valenceCount];
+};
+static const ForsythScores forsythScores;
+
+//--------------------------------------------------------------
+// Orders the triangles of a cluster (indices into its own vertices,
+//  which are numbered from 0) for the vertex cache and appends their
+//  numbers to order. After drawing a triangle, only the triangles of the
+//  vertices in the cache are scored again; when none is left, drawing
+//  continues with the next triangle in the cluster's order.
+static void forsythOrder(const vector<int> &indices, int vertexCount, vector<int> &order)
+{
+	int triangleCount = (int)indices.size() / 3;
+
+	// triangles of every vertex; the first trianglesLeft of them aren't drawn yet
+	vector<int> trianglesLeft(vertexCount, 0);
+	for (int index : indices) trianglesLeft[index]++;
+	vector<int> first(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++) first[v + 1] = first[v] + trianglesLeft[v];
+	vector<int> vertexTriangles(indices.size());
+	vector<int> filled(first.begin(), first.end() - 1);
+	for (int i = 0; i < indices.size(); i++) vertexTriangles[filled[indices[i]]++] = i / 3;
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<bool> bDrawn(triangleCount, false);
+	int cache[forsythCacheSize + 3], cacheCount = 0;
+	int next = 0;		// first triangle that might not be drawn yet
+	int best = 0;		// triangle to draw next
+
+	for (int n = 0; n < triangleCount; n++) {
+		// draw the triangle and take it off its vertices' lists
+		order.push_back(best);
+		bDrawn[best] = true;
+		const int *corners = &indices[best * 3];
+		for (int k = 0; k < 3; k++) {
+			int v = corners[k];
+			int *triangles = &vertexTriangles[first[v]];
+			for (int i = 0; i < trianglesLeft[v]; i++) {
+				if (triangles[i] == best) {
+					std::swap(triangles[i], triangles[trianglesLeft[v] - 1]);
+					trianglesLeft[v]--;
+					break;
+				}
+			}
+		}
+
+		// its vertices move to the front of the cache, pushing the others back
+		int newCache[forsythCacheSize + 3], newCount = 0;
+		for (int k = 0; k < 3; k++) {
+			if (std::find(newCache, newCache + newCount, corners[k]) == newCache + newCount) newCache[newCount++] = corners[k];
+		}
+		for (int i = 0; i < cacheCount; i++) {
+			if (corners[0] != cache[i] && corners[1] != cache[i] && corners[2] != cache[i]) newCache[newCount++] = cache[i];
+		}
+		for (int i = forsythCacheSize; i < newCount; i++) cachePosition[newCache[i]] = -1;
+		cacheCount = std::min(newCount, forsythCacheSize);
+		for (int i = 0; i < cacheCount; i++) {
+			cache[i] = newCache[i];
+			cachePosition[cache[i]] = i;
+		}
+
+		// the best triangle among those of the cached vertices
+		best = -1;
+		float bestScore = -1;
+		for (int i = 0; i < cacheCount; i++) {
+			int v = cache[i];
+			for (int j = 0; j < trianglesLeft[v]; j++) {
+				int t = vertexTriangles[first[v] + j];
+				float score = 0;
+				for (int k = 0; k < 3; k++) {
+					int corner = indices[t * 3 + k];
+					score += forsythScores.get(cachePosition[corner], trianglesLeft[corner]);
+				}
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+		if (best < 0) {
+			while (next < triangleCount && bDrawn[next]) next++;
+			best = next;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Spreads the lowest 10 bits of x out to every third bit
+static uint32_t spreadBits(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x30000ff;
+	x = (x | (x << 8)) & 0x300f00f;
+	x = (x | (x << 4)) & 0x30c30c3;
+	x = (x | (x << 2)) & 0x9249249;
+	return x;
+}
+
+//--------------------------------------------------------------
+// Sorts the triangles by the Morton code of their centers in the box
+//  around the centers, then orders each run of clusterSize triangles
+//  with its vertices numbered from 0
+vector<int> orderTrianglesForCache(const vector<glm::vec3> &verts, const vector<int> &indices, int clusterSize)
+{
+	int triangleCount = (int)indices.size() / 3;
+	vector<glm::vec3> centers(triangleCount);
+	glm::vec3 low(std::numeric_limits<float>::infinity()), high(-std::numeric_limits<float>::infinity());
+	for (int t = 0; t < triangleCount; t++) {
+		centers[t] = (verts[indices[t * 3]] + verts[indices[t * 3 + 1]] + verts[indices[t * 3 + 2]]) / 3.0f;
+		low = glm::min(low, centers[t]);
+		high = glm::max(high, centers[t]);
+	}
+	glm::vec3 scale = 1023.0f / glm::max(high - low, glm::vec3(1e-20f));
+	vector<pair<uint32_t, int>> sorted(triangleCount);
+	for (int t = 0; t < triangleCount; t++) {
+		glm::vec3 cell = (centers[t] - low) * scale;
+		sorted[t].first = spreadBits((uint32_t)cell.x) | (spreadBits((uint32_t)cell.y) << 1) | (spreadBits((uint32_t)cell.z) << 2);
+		sorted[t].second = t;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	vector<int> order;
+	order.reserve(triangleCount);
+	vector<int> localIndex(verts.size(), -1);	// number of each vertex in the current cluster
+	vector<int> clusterVerts, clusterIndices, clusterOrder;
+	clusterSize = std::max(1, clusterSize);
+	for (int start = 0; start < triangleCount; start += clusterSize) {
+		int end = std::min(triangleCount, start + clusterSize);
+		clusterVerts.clear();
+		clusterIndices.clear();
+		for (int c = start; c < end; c++) {
+			for (int k = 0; k < 3; k++) {
+				int v = indices[sorted[c].second * 3 + k];
+				if (localIndex[v] < 0) {
+					localIndex[v] = (int)clusterVerts.size();
+					clusterVerts.push_back(v);
+				}
+				clusterIndices.push_back(localIndex[v]);
+			}
+		}
+		clusterOrder.clear();
+		forsythOrder(clusterIndices, (int)clusterVerts.size(), clusterOrder);
+		for (int t : clusterOrder) order.push_back(sorted[start + t].second);
+		for (int v : clusterVerts) localIndex[v] = -1;
+	}
+	return order;
+}
+
+//--------------------------------------------------------------
+// Numbers the vertices as the indices reach them
+vector<int> orderVerticesByFirstUse(const vector<int> &indices, int vertexCount)
+{
+	vector<int> remap(vertexCount, -1);
+	int next = 0;
+	for (int index : indices) {
+		if (remap[index] < 0) remap[index] = next++;
+	}
+	for (int v = 0; v < vertexCount; v++) {
+		if (remap[v] < 0) remap[v] = next++;
+	}
+	return remap;
+}
+
+//--------------------------------------------------------------
+// Simulates the cache: a vertex is in it if fewer than cacheSize
+//  vertices were fetched since it was
+float getAverageCacheMissRatio(const vector<int> &indices, int cacheSize)
+{
+	if (indices.size() < 3) return 0;
+	int vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+	vector<int> fetchedAt(vertexCount, -cacheSize - 1);
+	int fetches = 0;
+	for (int index : indices) {
+		if (fetches - fetchedAt[index] >= cacheSize) fetchedAt[index] = ++fetches;
+	}
+	return (float)fetches / (indices.size() / 3);
+}
+
+//--------------------------------------------------------------
+// Simulates the cache as a list of lines, most recently used first
+int countCacheLineMisses(const vector<int> &indices, int vertexBytes, int lineBytes, int cacheLines)
+{
+	list<size_t> lines;
+	unordered_map<size_t, list<size_t>::iterator> cached;
+	int misses = 0;
+	for (int index : indices) {
+		// a vertex can straddle two lines
+		size_t firstByte = (size_t)index * vertexBytes;
+		for (size_t line = firstByte / lineBytes; line <= (firstByte + vertexBytes - 1) / lineBytes; line++) {
+			auto found = cached.find(line);
+			if (found != cached.end()) {
+				lines.splice(lines.begin(), lines, found->second);
+				continue;
+			}
+			misses++;
+			lines.push_front(line);
+			cached[line] = lines.begin();
+			if (lines.size() > cacheLines) {
+				cached.erase(lines.back());
+				lines.pop_back();
+			}
+		}
+	}
+	return misses;
+}
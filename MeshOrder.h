@@ -0,0 +1,37 @@
+// This file provides the functions that reorder a mesh's triangles and
+//  vertices so that drawing and tracing it reads memory in order, and the
+//  measures of how well an order uses caches.
+// Triangles are first grouped into spatially compact clusters: sorted
+//  along a Morton (Z order) curve through their centers and cut into runs
+//  of a fixed size. Inside each cluster the triangles are ordered for the
+//  vertex cache with Tom Forsyth's linear speed algorithm, which keeps
+//  picking the triangle whose vertices were used most recently (or have
+//  the fewest triangles left), so consecutive triangles share vertices.
+//  Numbering the vertices in the order the triangles first use them then
+//  makes the vertex reads nearly sequential.
+// The average cache miss ratio (ACMR) counts the vertices a cache of the
+//  given size must fetch per triangle; it lies between about 0.5 for a
+//  well ordered closed mesh and 3 for one whose triangles share nothing.
+
+#pragma once
+
+#include "ofMain.h"
+
+// Returns the order to draw the triangles (three vertex indices each) in:
+//  clusters of clusterSize triangles along a Morton curve, each ordered for
+//  a vertex cache (a clusterSize of at least the triangle count orders the
+//  whole mesh as one cluster)
+vector<int> orderTrianglesForCache(const vector<glm::vec3> &verts, const vector<int> &indices, int clusterSize = 256);
+
+// Returns the new index of every vertex when the vertices are numbered in
+//  the order the indices first use them (unused vertices follow, in order)
+vector<int> orderVerticesByFirstUse(const vector<int> &indices, int vertexCount);
+
+// Returns the average number of vertices a first in first out cache of
+//  cacheSize vertices misses per triangle
+float getAverageCacheMissRatio(const vector<int> &indices, int cacheSize = 32);
+
+// Returns the number of cache lines of lineBytes bytes that a least
+//  recently used cache of cacheLines lines misses while reading the
+//  vertices (of vertexBytes bytes each) in the order of the indices
+int countCacheLineMisses(const vector<int> &indices, int vertexBytes, int lineBytes = 64, int cacheLines = 512);
@@ -0,0 +1,142 @@
+// This file provides the ObjectPool class template, which owns scene
+//  objects of one type, and PoolHandle, a generation checked reference
+//  to an object in a pool.
+// Objects live in fixed size chunks of slots, so their addresses never
+//  change and the hierarchy can keep pointing at them. Destroyed slots
+//  go on a free list and are reused, and the chunks are kept when the
+//  pool is cleared, so reloading scenes over and over doesn't grow
+//  memory. Every slot records the generation it was created in; a handle
+//  to a destroyed object no longer matches its slot and resolves to NULL
+//  instead of dangling, so references that outlive a frame should be
+//  handles rather than pointers. Clearing a pool rewinds its allocation cursor and
+//  free list in constant time (after running the destructors of objects
+//  that own memory of their own).
+
+#pragma once
+
+#include "ofMain.h"
+
+// PoolHandle: reference to an object of an ObjectPool<T>
+//
+template<class T>
+struct PoolHandle {
+	uint32_t index = UINT32_MAX;	// slot of the object
+	uint32_t generation = 0;		// generation of the slot when the object was created
+
+	bool operator==(const PoolHandle &other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const PoolHandle &other) const { return !(*this == other); }
+};
+
+// ObjectPool class template
+//
+template<class T>
+class ObjectPool {
+public:
+	ObjectPool() {}
+	~ObjectPool() { clear(); }
+
+	// a pool owns its objects
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	// Constructs an object in a free slot (arguments are passed to T's constructor)
+	template<class... Args>
+	T *create(Args &&... args) {
+		uint32_t index;
+		if (freeList != UINT32_MAX) {
+			// reuse the most recently freed slot
+			index = freeList;
+			freeList = slot(index).nextFree;
+		}
+		else {
+			// take the next unused slot, adding a chunk if every slot is taken
+			if (used == chunks.size() * CHUNK_SIZE) chunks.emplace_back(new Slot[CHUNK_SIZE]);
+			index = used++;
+		}
+		Slot &s = slot(index);
+		T *object = new (&s.storage) T(std::forward<Args>(args)...);
+		s.index = index;
+		s.generation = ++generationCounter;
+		s.alive = true;
+		live++;
+		return object;
+	}
+
+	// Returns the handle of an object of the pool
+	PoolHandle<T> handleOf(const T *object) const {
+		PoolHandle<T> handle;
+		if (object == NULL) return handle;
+		const Slot *s = reinterpret_cast<const Slot *>(object);
+		handle.index = s->index;
+		handle.generation = s->generation;
+		return handle;
+	}
+
+	// Returns the object a handle refers to (NULL if it was destroyed)
+	T *get(const PoolHandle<T> &handle) const {
+		if (handle.index >= used) return NULL;
+		const Slot &s = slot(handle.index);
+		if (!s.alive || s.generation != handle.generation) return NULL;
+		return reinterpret_cast<T *>(const_cast<typename Slot::Storage *>(&s.storage));
+	}
+
+	// Destroys an object of the pool and frees its slot
+	void destroy(T *object) {
+		if (object == NULL) return;
+		Slot *s = reinterpret_cast<Slot *>(object);
+		if (!s->alive) return;
+		object->~T();
+		s->alive = false;
+		s->nextFree = freeList;
+		freeList = s->index;
+		live--;
+	}
+	void destroy(const PoolHandle<T> &handle) { destroy(get(handle)); }
+
+	// Destroys every object. The chunks are kept for the next objects, and
+	//  handles to the destroyed objects stop resolving because the slots get
+	//  new generations when they are reused.
+	void clear() {
+		if (!std::is_trivially_destructible<T>::value) {
+			for (uint32_t i = 0; i < used; i++) {
+				Slot &s = slot(i);
+				if (s.alive) reinterpret_cast<T *>(&s.storage)->~T();
+				s.alive = false;
+			}
+		}
+		used = 0;
+		freeList = UINT32_MAX;
+		live = 0;
+	}
+
+	// Returns the number of live objects
+	int size() const { return (int)live; }
+
+	// Returns the number of bytes held by the pool's chunks
+	size_t getSizeInBytes() const { return chunks.size() * CHUNK_SIZE * sizeof(Slot); }
+
+private:
+	// number of slots allocated at a time
+	static const uint32_t CHUNK_SIZE = 64;
+
+	// storage of one object and its bookkeeping (the storage comes first,
+	//  so a pointer to the object is also a pointer to its slot)
+	struct Slot {
+		typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+		Storage storage;						// the object (constructed while alive)
+		uint32_t index = 0;						// position of the slot in the pool
+		uint32_t generation = 0;				// generation the current (or last) object was created in
+		uint32_t nextFree = UINT32_MAX;			// next slot of the free list
+		bool alive = false;						// tracks whether storage holds an object
+	};
+
+	// Returns the slot at the given index
+	Slot &slot(uint32_t index) { return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]; }
+	const Slot &slot(uint32_t index) const { return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]; }
+
+	vector<unique_ptr<Slot[]>> chunks;			// fixed size arrays of slots
+	uint32_t used = 0;							// slots handed out since the pool was last cleared
+	uint32_t freeList = UINT32_MAX;				// first destroyed slot available for reuse
+	uint32_t live = 0;							// number of live objects
+	uint32_t generationCounter = 0;				// last generation handed out (never reset, so old handles stay stale)
+};
@@ -0,0 +1,41 @@
+// This file provides a small parallel for helper that splits a range of
+//  work items across all hardware threads.
+
+#pragma once
+
+#include "ofMain.h"
+
+// Splits the items [0, count) into one contiguous range per hardware thread
+//  and calls body(begin, end) for each range. Ranges are never smaller than
+//  minPerThread items, so small workloads stay on the calling thread.
+//  Blocks until every range is done.
+inline void parallelFor(int count, const function<void(int, int)> &body, int minPerThread = 1)
+{
+	// decide how many threads the work is worth
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if (numThreads < 1) numThreads = 1;
+	if (minPerThread < 1) minPerThread = 1;
+	numThreads = std::min(numThreads, std::max(1, count / minPerThread));
+
+	// run small workloads directly on the calling thread
+	if (numThreads == 1) {
+		if (count > 0) body(0, count);
+		return;
+	}
+
+	// launch one thread per range (the calling thread takes the last range)
+	vector<std::thread> threads;
+	int perThread = (count + numThreads - 1) / numThreads;
+	for (int t = 0; t < numThreads - 1; t++) {
+		int begin = t * perThread;
+		int end = std::min(count, begin + perThread);
+		if (begin < end) threads.push_back(std::thread(body, begin, end));
+	}
+	int lastBegin = (numThreads - 1) * perThread;
+	if (lastBegin < count) body(lastBegin, count);
+
+	// wait for the other ranges to finish
+	for (int t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+}
@@ -0,0 +1,237 @@
+// This file provides implementation of the Profiler class methods.
+
+#include "Profiler.h"
+#include <mutex>
+#include <fstream>
+
+std::atomic<bool> Profiler::bEnabled{ false };
+
+// number of zones a buffer keeps (a power of two)
+static const uint64_t bufferCapacity = 1 << 14;
+
+// ProfileBuffer: the latest zones recorded by one thread. Only the thread
+//  holding the buffer writes it; readers copy it like a sequence lock,
+//  comparing what they read against the number of zones the writer had
+//  started to overwrite by the time they finished.
+//
+struct ProfileBuffer {
+	struct Slot {
+		std::atomic<const char *> name{ NULL };
+		std::atomic<int64_t> start{ 0 }, end{ 0 };
+	};
+
+	ProfileBuffer(int lane) : slots(new Slot[bufferCapacity]), lane(lane) {}
+
+	// Appends a zone (only called by the holding thread)
+	void push(const char *name, int64_t start, int64_t end) {
+		uint64_t index = count.load(std::memory_order_relaxed);
+		started.store(index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		Slot &slot = slots[index & (bufferCapacity - 1)];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.start.store(start, std::memory_order_relaxed);
+		slot.end.store(end, std::memory_order_relaxed);
+		count.store(index + 1, std::memory_order_release);
+	}
+
+	// Calls visit(name, start, end) for the zones held, newest first, until
+	//  it returns false
+	template <class Visit>
+	void read(Visit visit) const {
+		uint64_t last = count.load(std::memory_order_acquire);
+		uint64_t first = last > bufferCapacity ? last - bufferCapacity : 0;
+		for (uint64_t index = last; index > first; index--) {
+			const Slot &slot = slots[(index - 1) & (bufferCapacity - 1)];
+			const char *name = slot.name.load(std::memory_order_relaxed);
+			int64_t start = slot.start.load(std::memory_order_relaxed);
+			int64_t end = slot.end.load(std::memory_order_relaxed);
+			// stop at zones the writer overwrote (or was overwriting) meanwhile
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (started.load(std::memory_order_relaxed) > index - 1 + bufferCapacity) return;
+			if (!visit(name, start, end)) return;
+		}
+	}
+
+	// Fields of ProfileBuffer struct
+	//
+	unique_ptr<Slot[]> slots;
+	std::atomic<uint64_t> count{ 0 };		// zones written
+	std::atomic<uint64_t> started{ 0 };		// zones whose writing started
+	int lane;								// thread id in the trace export
+	string threadName;						// name of the thread holding the buffer (guarded by the profiler's mutex)
+};
+
+// buffers of every thread that recorded a zone, and the buffers free for new threads
+static std::mutex buffersMutex;
+static vector<unique_ptr<ProfileBuffer>> buffers;
+static vector<ProfileBuffer *> freeBuffers;
+
+// start of the current and the last frame (only used by the main thread)
+static int64_t frameStart = 0;
+static int64_t lastFrameStart = 0;
+
+// ThreadBuffer: the calling thread's buffer, taken when it first records
+//  a zone and given back when the thread ends
+//
+struct ThreadBuffer {
+	~ThreadBuffer() {
+		if (!buffer) return;
+		lock_guard<std::mutex> lock(buffersMutex);
+		buffer->threadName.clear();
+		freeBuffers.push_back(buffer);
+	}
+
+	ProfileBuffer *get() {
+		if (buffer) return buffer;
+		lock_guard<std::mutex> lock(buffersMutex);
+		if (freeBuffers.size()) {
+			buffer = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+		else {
+			buffers.push_back(unique_ptr<ProfileBuffer>(new ProfileBuffer((int)buffers.size())));
+			buffer = buffers.back().get();
+		}
+		buffer->threadName = name;
+		return buffer;
+	}
+
+	ProfileBuffer *buffer = NULL;
+	string name;
+};
+static thread_local ThreadBuffer threadBuffer;
+
+//--------------------------------------------------------------
+// Turns recording on or off
+void Profiler::setEnabled(bool bEnable)
+{
+	bEnabled.store(bEnable, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+// Reads the steady clock relative to the first call
+int64_t Profiler::now()
+{
+	static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+//--------------------------------------------------------------
+// Appends the zone to the calling thread's buffer
+void Profiler::record(const char *name, int64_t start, int64_t end)
+{
+	threadBuffer.get()->push(name, start, end);
+}
+
+//--------------------------------------------------------------
+// Names the calling thread (kept with its buffer while it holds one)
+void Profiler::setThreadName(const string &name)
+{
+	threadBuffer.name = name;
+	lock_guard<std::mutex> lock(buffersMutex);
+	if (threadBuffer.buffer) threadBuffer.buffer->threadName = name;
+}
+
+//--------------------------------------------------------------
+// Moves the frame boundary
+void Profiler::beginFrame()
+{
+	lastFrameStart = frameStart;
+	frameStart = now();
+}
+
+//--------------------------------------------------------------
+// Sums the zones of every buffer that ended between the last two frame
+//  starts (a buffer's zones are recorded in the order they end, so
+//  reading stops at the first zone that ended before the frame)
+vector<ProfileZoneStats> Profiler::getFrameStats(double &frameMilliseconds)
+{
+	frameMilliseconds = (frameStart - lastFrameStart) * 1e-6;
+	map<string, ProfileZoneStats> zones;
+	if (lastFrameStart < frameStart) {
+		lock_guard<std::mutex> lock(buffersMutex);
+		for (const auto &buffer : buffers) {
+			buffer->read([&](const char *name, int64_t start, int64_t end) {
+				if (end < lastFrameStart) return false;
+				if (end < frameStart) {
+					ProfileZoneStats &zone = zones[name];
+					zone.milliseconds += (end - start) * 1e-6;
+					zone.calls++;
+				}
+				return true;
+			});
+		}
+	}
+	vector<ProfileZoneStats> stats;
+	for (auto &zone : zones) {
+		zone.second.name = zone.first;
+		stats.push_back(zone.second);
+	}
+	std::sort(stats.begin(), stats.end(), [](const ProfileZoneStats &a, const ProfileZoneStats &b) {
+		return a.milliseconds > b.milliseconds;
+	});
+	return stats;
+}
+
+//--------------------------------------------------------------
+// Lists the zones of the last complete frame, one line each
+void Profiler::drawOverlay(float x, float y)
+{
+	double frameMilliseconds;
+	vector<ProfileZoneStats> stats = getFrameStats(frameMilliseconds);
+	ofSetColor(ofColor::white);
+	ofDrawBitmapString("Frame " + ofToString(frameMilliseconds, 2) + " ms", x, y);
+	for (int i = 0; i < stats.size() && i < 25; i++) {
+		y += 14;
+		ofDrawBitmapString(ofToString(stats[i].milliseconds, 2, 7, ' ') + " ms " + ofToString(stats[i].calls, 5, ' ') + "x  "
+			+ stats[i].name, x, y);
+	}
+}
+
+//--------------------------------------------------------------
+// Returns the text with the characters JSON strings can't hold escaped
+static string jsonEscape(const string &text)
+{
+	string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		if ((unsigned char)c < 0x20) escaped += ' ';
+		else escaped += c;
+	}
+	return escaped;
+}
+
+//--------------------------------------------------------------
+// Writes every held zone as a complete ("X") event on its buffer's lane,
+//  with the lanes named after their threads
+bool Profiler::writeChromeTrace(const string &fileName)
+{
+	ofstream file(fileName);
+	if (!file) {
+		cout << "Can't write profile " << fileName << endl;
+		return false;
+	}
+	int events = 0;
+	file << "{\"traceEvents\":[\n";
+	bool bFirst = true;
+	lock_guard<std::mutex> lock(buffersMutex);
+	for (const auto &buffer : buffers) {
+		string threadName = buffer->threadName.empty() ? "thread " + ofToString(buffer->lane) : buffer->threadName;
+		file << (bFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->lane
+			<< ",\"args\":{\"name\":\"" << jsonEscape(threadName) << "\"}}";
+		bFirst = false;
+		buffer->read([&](const char *name, int64_t start, int64_t end) {
+			file << ",\n{\"name\":\"" << jsonEscape(name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->lane
+				<< ",\"ts\":" << ofToString(start * 1e-3, 3) << ",\"dur\":" << ofToString((end - start) * 1e-3, 3) << "}";
+			events++;
+			return true;
+		});
+	}
+	file << "\n]}\n";
+	if (!file) {
+		cout << "Can't write profile " << fileName << endl;
+		return false;
+	}
+	cout << "Wrote " << events << " zones to " << fileName << endl;
+	return true;
+}
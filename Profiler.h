@@ -0,0 +1,100 @@
+// This file provides the definitions of the Profiler and ProfileZone
+//  classes, which time scoped zones of code on every thread so the viewer
+//  can show where a frame's time goes.
+// A zone is timed by declaring PROFILE_ZONE("name") at the top of a scope:
+//  the zone starts there and ends when the scope is left. Finished zones
+//  are appended to a buffer owned by the thread that timed them, so
+//  threads never wait on each other to record a zone. A buffer is a ring
+//  that keeps the thread's latest zones; the overlay and the trace export
+//  read the buffers while their threads keep writing, skipping zones that
+//  were overwritten while being read. Threads started for one job (like
+//  the render's) hand their buffer to the next thread when they finish,
+//  so the buffers are reused as lanes instead of piling up.
+// Zones cost one flag test while the profiler is turned off. Building with
+//  PROFILER_ENABLED defined to 0 removes them altogether.
+
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// ProfileZoneStats: time spent in one zone during a frame
+//
+struct ProfileZoneStats {
+	string name;
+	double milliseconds = 0;	// total time of the zone's calls (on every thread)
+	int calls = 0;
+};
+
+// Profiler class: records the zones timed by every thread
+//
+class Profiler {
+public:
+	// Turns recording on or off (zones timed while it is off are not recorded)
+	static void setEnabled(bool bEnabled);
+	static bool isEnabled() { return bEnabled.load(std::memory_order_relaxed); }
+
+	// Returns the time in nanoseconds since the profiler started
+	static int64_t now();
+
+	// Records a finished zone on the calling thread's buffer
+	static void record(const char *name, int64_t start, int64_t end);
+
+	// Names the calling thread in the trace export
+	static void setThreadName(const string &name);
+
+	// Marks the start of a frame (called once per frame, on the main thread)
+	static void beginFrame();
+
+	// Returns the time spent in every zone that ended during the last
+	//  complete frame, sorted by time, and the length of that frame
+	static vector<ProfileZoneStats> getFrameStats(double &frameMilliseconds);
+
+	// Draws the last complete frame's zones at the given point of the window
+	static void drawOverlay(float x, float y);
+
+	// Writes the zones held in the buffers as a Chrome trace (JSON that
+	//  chrome://tracing and Perfetto open); returns false if the file
+	//  couldn't be written
+	static bool writeChromeTrace(const string &fileName);
+
+private:
+	static std::atomic<bool> bEnabled;
+};
+
+// ProfileZone class: times the scope it is declared in (see PROFILE_ZONE)
+//
+class ProfileZone {
+public:
+	ProfileZone(const char *name) {
+		if (Profiler::isEnabled()) {
+			this->name = name;
+			start = Profiler::now();
+		}
+	}
+
+	~ProfileZone() {
+		if (name) Profiler::record(name, start, Profiler::now());
+	}
+
+	ProfileZone(const ProfileZone &) = delete;
+	ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+	const char *name = NULL;	// name of the zone (NULL if the profiler was off when it started)
+	int64_t start = 0;
+};
+
+// Times the rest of the enclosing scope as a zone with the given name
+//  (a string literal)
+#if PROFILER_ENABLED
+#define PROFILE_ZONE_JOIN2(a, b) a##b
+#define PROFILE_ZONE_JOIN(a, b) PROFILE_ZONE_JOIN2(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_JOIN(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,710 @@
+// This file provides implementation of the distributed render
+//  coordinator and worker.
+
+#include "RenderFarm.h"
+#include "SceneSnapshot.h"
+#include "Renderer.h"
+#include "Parallel.h"
+#include "ImageWriter.h"
+#include <deque>
+#include <functional>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET SocketHandle;
+static const SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+typedef int SocketHandle;
+static const SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+static const uint32_t FARM_PROTOCOL_VERSION = 1;
+static const uint32_t FARM_MAX_PAYLOAD = 1u << 30;	// larger messages are treated as corrupt
+
+// message types
+enum FarmMessage { FARM_HELLO = 1, FARM_SCENE, FARM_REQUEST, FARM_JOBS, FARM_TILE, FARM_DONE };
+
+//--------------------------------------------------------------
+// Starts the socket library once (a failed send to a closed socket
+//  is reported as an error instead of a signal)
+static bool startSockets()
+{
+#ifdef _WIN32
+	static bool bStarted = false;
+	if (!bStarted) {
+		WSADATA data;
+		bStarted = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}
+	return bStarted;
+#else
+	signal(SIGPIPE, SIG_IGN);
+	return true;
+#endif
+}
+
+//--------------------------------------------------------------
+// Closes a socket
+static void closeSocket(SocketHandle socket)
+{
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+
+//--------------------------------------------------------------
+// Makes sends and receives on the socket return at once instead of
+//  waiting
+static void setNonBlocking(SocketHandle socket)
+{
+#ifdef _WIN32
+	u_long bNonBlocking = 1;
+	ioctlsocket(socket, FIONBIO, &bNonBlocking);
+#else
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+//--------------------------------------------------------------
+// Returns true if the last send or receive on a non-blocking socket
+//  failed only because it would have had to wait (or was interrupted)
+static bool wouldBlock()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+//--------------------------------------------------------------
+// Sends every byte, retrying partial sends
+static bool sendAll(SocketHandle socket, const char *data, size_t size)
+{
+	while (size > 0) {
+		int sent = send(socket, data, (int)std::min(size, (size_t)1 << 20), 0);
+		if (sent <= 0) {
+#ifndef _WIN32
+			if (sent < 0 && errno == EINTR) continue;
+#endif
+			return false;
+		}
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Receives exactly size bytes (false if the connection closed first)
+static bool recvAll(SocketHandle socket, char *data, size_t size)
+{
+	while (size > 0) {
+		int received = recv(socket, data, (int)std::min(size, (size_t)1 << 20), 0);
+		if (received <= 0) {
+#ifndef _WIN32
+			if (received < 0 && errno == EINTR) continue;
+#endif
+			return false;
+		}
+		data += received;
+		size -= received;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Sends a message header and its payload
+static bool sendMessage(SocketHandle socket, uint32_t type, const vector<char> &payload)
+{
+	uint32_t header[2] = { type, (uint32_t)payload.size() };
+	return sendAll(socket, (const char *)header, sizeof(header)) && sendAll(socket, payload.data(), payload.size());
+}
+
+//--------------------------------------------------------------
+// Returns a message header and its payload as one block of bytes
+static shared_ptr<vector<char>> makeMessage(uint32_t type, const vector<char> &payload)
+{
+	uint32_t header[2] = { type, (uint32_t)payload.size() };
+	shared_ptr<vector<char>> message = make_shared<vector<char>>(sizeof(header) + payload.size());
+	memcpy(message->data(), header, sizeof(header));
+	if (!payload.empty()) memcpy(message->data() + sizeof(header), payload.data(), payload.size());
+	return message;
+}
+
+//--------------------------------------------------------------
+// Waits for a whole message
+static bool recvMessage(SocketHandle socket, uint32_t &type, vector<char> &payload)
+{
+	uint32_t header[2];
+	if (!recvAll(socket, (char *)header, sizeof(header)) || header[1] > FARM_MAX_PAYLOAD) return false;
+	type = header[0];
+	payload.resize(header[1]);
+	return recvAll(socket, payload.data(), payload.size());
+}
+
+//--------------------------------------------------------------
+// Appends the bytes of a value to a payload
+template<class T>
+static void put(vector<char> &payload, const T &value)
+{
+	const char *bytes = (const char *)&value;
+	payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+//--------------------------------------------------------------
+// Reads a value from a payload at the offset and moves past it
+template<class T>
+static T take(const char *payload, size_t &offset)
+{
+	T value;
+	memcpy(&value, payload + offset, sizeof(T));
+	offset += sizeof(T);
+	return value;
+}
+
+// FarmTile: a tile job and where it is
+//
+struct FarmTile {
+	int x0, y0, x1, y1;				// pixels [x0, x1) x [y0, y1) of the image
+	bool bDone = false;				// tracks whether the tile's pixels arrived
+	bool bQueued = true;			// tracks whether the tile waits in the queue
+	double assignedAt = 0;			// time the tile was last given to a worker
+};
+
+// FarmWorker: a connected worker
+//
+struct FarmWorker {
+	SocketHandle socket;			// non-blocking
+	vector<char> inbox;				// received bytes not yet parsed into messages
+	deque<shared_ptr<const vector<char>>> outbox;	// messages waiting to be sent (the scene's is shared)
+	size_t outboxSent = 0;			// bytes of the first message already sent
+	double lastSent = 0;			// time the outbox was last empty or last took bytes
+	int wanted = 0;					// tiles the worker asked for and wasn't given yet
+	vector<int> assigned;			// tiles given to the worker and not returned by it
+	int tilesDone = 0;				// tiles the worker returned
+};
+
+//--------------------------------------------------------------
+// Returns the seconds since the first call
+static double farmClock()
+{
+	static auto start = chrono::steady_clock::now();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//--------------------------------------------------------------
+// Queues a message for the worker
+static void queueMessage(FarmWorker &worker, shared_ptr<const vector<char>> message)
+{
+	if (worker.outbox.empty()) worker.lastSent = farmClock();
+	worker.outbox.push_back(message);
+}
+
+//--------------------------------------------------------------
+// Sends as much of the worker's outbox as its socket takes without
+//  waiting (returns false if the connection failed)
+static bool flushOutbox(FarmWorker &worker)
+{
+	while (!worker.outbox.empty()) {
+		const vector<char> &message = *worker.outbox.front();
+		size_t left = message.size() - worker.outboxSent;
+		int sent = send(worker.socket, message.data() + worker.outboxSent, (int)std::min(left, (size_t)1 << 20), 0);
+		if (sent < 0 && wouldBlock()) return true;
+		if (sent <= 0) return false;
+		worker.lastSent = farmClock();
+		worker.outboxSent += sent;
+		if (worker.outboxSent == message.size()) {
+			worker.outbox.pop_front();
+			worker.outboxSent = 0;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Opens a socket listening on the port of every interface
+static SocketHandle listenOn(int port)
+{
+	SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET_HANDLE) return INVALID_SOCKET_HANDLE;
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((uint16_t)port);
+	if (::bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+		closeSocket(listener);
+		return INVALID_SOCKET_HANDLE;
+	}
+	return listener;
+}
+
+//--------------------------------------------------------------
+// Starts worker processes running this program's worker tool
+//  against the coordinator's port
+static vector<int> startLocalWorkers(int count, int port)
+{
+	vector<int> processes;
+#ifdef __linux__
+	string address = "127.0.0.1:" + to_string(port);
+	for (int i = 0; i < count; i++) {
+		pid_t process = fork();
+		if (process == 0) {
+			execl("/proc/self/exe", "MeshAnimator", "--worker", address.c_str(), (char *)NULL);
+			_exit(127);
+		}
+		if (process > 0) processes.push_back((int)process);
+	}
+#else
+	if (count > 0) cout << "Starting local workers is only supported on Linux; start them with --worker" << endl;
+#endif
+	return processes;
+}
+
+//--------------------------------------------------------------
+// Waits for (or, if bKill, stops) the local worker processes
+static void stopLocalWorkers(const vector<int> &processes, bool bKill)
+{
+#ifndef _WIN32
+	for (int i = 0; i < processes.size(); i++) {
+		if (bKill) kill((pid_t)processes[i], SIGTERM);
+		waitpid((pid_t)processes[i], NULL, 0);
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+// Splits the image into tiles, accepts workers, hands out tiles as
+//  they ask for them (top to bottom) and passes the tiles they return
+//  to store(x0, y0, x1, y1, pixels), which returns false to abort.
+//  One thread polls every socket; only sockets with data are read and
+//  messages wait in each worker's outbox until its socket takes them,
+//  so a worker that is slow or gone never blocks the others (one that
+//  takes nothing for a tile timeout is dropped).
+static bool coordinateTiles(const vector<char> &snapshot, const RenderFarmSettings &settings, int width, int height,
+	const function<bool(int, int, int, int, const unsigned char *)> &store)
+{
+	if (!startSockets()) return false;
+	SocketHandle listener = listenOn(settings.port);
+	if (listener == INVALID_SOCKET_HANDLE) {
+		cout << "Couldn't listen on port " << settings.port << endl;
+		return false;
+	}
+
+	// the tile jobs, all queued
+	vector<FarmTile> tiles;
+	deque<int> queue;
+	int tileSize = std::max(1, settings.tileSize);
+	for (int y = 0; y < height; y += tileSize) {
+		for (int x = 0; x < width; x += tileSize) {
+			FarmTile tile;
+			tile.x0 = x;
+			tile.y0 = y;
+			tile.x1 = std::min(width, x + tileSize);
+			tile.y1 = std::min(height, y + tileSize);
+			queue.push_back((int)tiles.size());
+			tiles.push_back(tile);
+		}
+	}
+
+	cout << "Rendering " << width << "x" << height << " in " << tiles.size() << " tiles; waiting for workers on port "
+		<< settings.port << " (MeshAnimator --worker <host>:" << settings.port << ")" << endl;
+	vector<int> localProcesses = startLocalWorkers(settings.localWorkers, settings.port);
+
+	// puts a tile given to a worker back in the queue
+	int redispatched = 0;
+	auto requeue = [&](int index) {
+		FarmTile &tile = tiles[index];
+		if (tile.bDone || tile.bQueued) return;
+		tile.bQueued = true;
+		queue.push_front(index);
+		redispatched++;
+	};
+
+	shared_ptr<const vector<char>> sceneMessage = makeMessage(FARM_SCENE, snapshot);
+	vector<FarmWorker> workers;
+	int tilesDone = 0, workersSeen = 0, nextProgress = 10;
+	bool bStoreFailed = false;
+	double start = farmClock(), lastConnected = start;
+	while (tilesDone < tiles.size() && !bStoreFailed && !(settings.cancel && *settings.cancel)) {
+		// wait for a connection or data (waking up now and then to check for timeouts)
+		vector<pollfd> polls(workers.size() + 1);
+		polls[0].fd = listener;
+		polls[0].events = POLLIN;
+		for (int w = 0; w < workers.size(); w++) {
+			polls[w + 1].fd = workers[w].socket;
+			polls[w + 1].events = workers[w].outbox.empty() ? POLLIN : POLLIN | POLLOUT;
+		}
+#ifdef _WIN32
+		WSAPoll(polls.data(), (ULONG)polls.size(), 100);
+#else
+		poll(polls.data(), polls.size(), 100);
+#endif
+		double now = farmClock();
+
+		// a new worker
+		if (polls[0].revents & POLLIN) {
+			SocketHandle connection = accept(listener, NULL, NULL);
+			if (connection != INVALID_SOCKET_HANDLE) {
+				int noDelay = 1;
+				setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+				setNonBlocking(connection);
+				FarmWorker worker;
+				worker.socket = connection;
+				workers.push_back(worker);
+				workersSeen++;
+			}
+		}
+
+		// messages from the workers (a worker that sends something wrong, hangs up
+		//  or stops taking what is sent to it is dropped)
+		vector<bool> bDrop(workers.size(), false);
+		for (int w = 0; w < workers.size(); w++) {
+			FarmWorker &worker = workers[w];
+			if ((polls[w + 1].revents & POLLOUT) && !flushOutbox(worker)) bDrop[w] = true;
+			if (!worker.outbox.empty() && now - worker.lastSent > settings.tileTimeout) bDrop[w] = true;
+			if (bDrop[w] || !(polls[w + 1].revents & (POLLIN | POLLERR | POLLHUP))) continue;
+			char chunk[65536];
+			int received = recv(worker.socket, chunk, sizeof(chunk), 0);
+			if (received < 0 && wouldBlock()) continue;
+			if (received <= 0) {
+				bDrop[w] = true;
+				continue;
+			}
+			worker.inbox.insert(worker.inbox.end(), chunk, chunk + received);
+
+			size_t offset = 0;
+			while (!bDrop[w] && worker.inbox.size() - offset >= 8) {
+				uint32_t header[2];
+				memcpy(header, worker.inbox.data() + offset, sizeof(header));
+				if (header[1] > FARM_MAX_PAYLOAD) {
+					bDrop[w] = true;
+					break;
+				}
+				if (worker.inbox.size() - offset - 8 < header[1]) break;
+				const char *payload = worker.inbox.data() + offset + 8;
+				size_t size = header[1];
+				offset += 8 + size;
+
+				if (header[0] == FARM_HELLO && size == 8) {
+					size_t read = 0;
+					uint32_t version = take<uint32_t>(payload, read);
+					if (version != FARM_PROTOCOL_VERSION) bDrop[w] = true;
+					else queueMessage(worker, sceneMessage);
+				}
+				else if (header[0] == FARM_REQUEST && size == 4) {
+					size_t read = 0;
+					worker.wanted = (int)std::min<uint32_t>(take<uint32_t>(payload, read), 1024);
+				}
+				else if (header[0] == FARM_TILE && size >= 4) {
+					size_t read = 0;
+					uint32_t index = take<uint32_t>(payload, read);
+					if (index >= tiles.size()) {
+						bDrop[w] = true;
+						break;
+					}
+					FarmTile &tile = tiles[index];
+					if (size != 4 + (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * 3) {
+						bDrop[w] = true;
+						break;
+					}
+					worker.assigned.erase(std::remove(worker.assigned.begin(), worker.assigned.end(), (int)index), worker.assigned.end());
+					if (tile.bDone) continue;
+					// the first copy of a tile to arrive is kept
+					if (!store(tile.x0, tile.y0, tile.x1, tile.y1, (const unsigned char *)payload + read)) {
+						bStoreFailed = true;
+						break;
+					}
+					tile.bDone = true;
+					worker.tilesDone++;
+					tilesDone++;
+				}
+				else {
+					bDrop[w] = true;
+				}
+			}
+			worker.inbox.erase(worker.inbox.begin(), worker.inbox.begin() + std::min(offset, worker.inbox.size()));
+		}
+
+		// tiles of dropped workers go back in the queue
+		for (int w = (int)workers.size() - 1; w >= 0; w--) {
+			if (!bDrop[w]) continue;
+			cout << "Lost a worker with " << workers[w].assigned.size() << " tiles" << endl;
+			for (int i = 0; i < workers[w].assigned.size(); i++) requeue(workers[w].assigned[i]);
+			closeSocket(workers[w].socket);
+			workers.erase(workers.begin() + w);
+		}
+
+		// tiles that took too long go back in the queue (the worker may still return them)
+		for (int w = 0; w < workers.size(); w++) {
+			for (int i = 0; i < workers[w].assigned.size(); i++) {
+				const FarmTile &tile = tiles[workers[w].assigned[i]];
+				if (!tile.bDone && !tile.bQueued && now - tile.assignedAt > settings.tileTimeout) {
+					requeue(workers[w].assigned[i]);
+				}
+			}
+		}
+
+		// hand queued tiles to the workers that asked for them
+		for (int w = 0; w < workers.size() && !queue.empty(); w++) {
+			FarmWorker &worker = workers[w];
+			vector<char> payload;
+			put(payload, (uint32_t)0);
+			uint32_t count = 0;
+			while (worker.wanted > 0 && !queue.empty()) {
+				int index = queue.front();
+				queue.pop_front();
+				FarmTile &tile = tiles[index];
+				tile.bQueued = false;
+				if (tile.bDone) continue;
+				tile.assignedAt = now;
+				worker.assigned.push_back(index);
+				worker.wanted--;
+				put(payload, (uint32_t)index);
+				put(payload, (int32_t)tile.x0);
+				put(payload, (int32_t)tile.y0);
+				put(payload, (int32_t)tile.x1);
+				put(payload, (int32_t)tile.y1);
+				count++;
+			}
+			if (count == 0) continue;
+			memcpy(payload.data(), &count, sizeof(count));
+			queueMessage(worker, makeMessage(FARM_JOBS, payload));
+		}
+
+		// start sending what was queued (the rest goes when the sockets take it)
+		for (int w = (int)workers.size() - 1; w >= 0; w--) {
+			if (flushOutbox(workers[w])) continue;
+			// the worker is gone; its tiles go back in the queue
+			for (int i = 0; i < workers[w].assigned.size(); i++) requeue(workers[w].assigned[i]);
+			closeSocket(workers[w].socket);
+			workers.erase(workers.begin() + w);
+		}
+
+		// progress, and giving up when no worker has been connected for a while
+		int percent = (int)(100.0 * tilesDone / tiles.size());
+		if (percent >= nextProgress) {
+			cout << "  " << percent << "% (" << workers.size() << " workers)" << endl;
+			nextProgress = percent / 10 * 10 + 10;
+		}
+		if (!workers.empty()) lastConnected = now;
+		else if (now - lastConnected > settings.workerWait) {
+			cout << "No workers connected for " << settings.workerWait << " seconds; giving up" << endl;
+			break;
+		}
+	}
+
+	// tell the workers the image is done, then read what they still send until
+	//  they hang up (closing a socket with unread data resets the connection,
+	//  which could throw away the DONE message before the worker reads it)
+	bool bFinished = tilesDone == tiles.size();
+	shared_ptr<const vector<char>> doneMessage = makeMessage(FARM_DONE, vector<char>());
+	for (int w = 0; w < workers.size(); w++) {
+		queueMessage(workers[w], doneMessage);
+	}
+	double drainStart = farmClock();
+	while (!workers.empty() && farmClock() - drainStart < 2.0) {
+		vector<pollfd> polls(workers.size());
+		for (int w = 0; w < workers.size(); w++) {
+			polls[w].fd = workers[w].socket;
+			polls[w].events = workers[w].outbox.empty() ? POLLIN : POLLIN | POLLOUT;
+		}
+#ifdef _WIN32
+		WSAPoll(polls.data(), (ULONG)polls.size(), 100);
+#else
+		poll(polls.data(), polls.size(), 100);
+#endif
+		for (int w = (int)workers.size() - 1; w >= 0; w--) {
+			bool bGone = (polls[w].revents & POLLOUT) && !flushOutbox(workers[w]);
+			if (!bGone && (polls[w].revents & (POLLIN | POLLERR | POLLHUP))) {
+				char chunk[65536];
+				int received = recv(workers[w].socket, chunk, sizeof(chunk), 0);
+				bGone = received == 0 || (received < 0 && !wouldBlock());
+			}
+			if (!bGone) continue;
+			closeSocket(workers[w].socket);
+			workers.erase(workers.begin() + w);
+		}
+	}
+	for (int w = 0; w < workers.size(); w++) closeSocket(workers[w].socket);
+	closeSocket(listener);
+	stopLocalWorkers(localProcesses, !bFinished);
+	if (bFinished) {
+		cout << "Rendered " << tiles.size() << " tiles in " << farmClock() - start << " s with " << workersSeen << " workers ("
+			<< redispatched << " tiles re-dispatched)" << endl;
+	}
+	return bFinished;
+}
+
+//--------------------------------------------------------------
+// Renders into an image of the snapshot's size
+bool renderDistributed(const vector<char> &snapshot, const RenderFarmSettings &settings, ofImage &image)
+{
+	int width, height;
+	if (!SceneSnapshot::readImageSize(snapshot, width, height)) {
+		cout << "Scene snapshot is corrupt" << endl;
+		return false;
+	}
+	image.allocate(width, height, OF_IMAGE_COLOR);
+	return coordinateTiles(snapshot, settings, width, height, [&image](int x0, int y0, int x1, int y1, const unsigned char *pixels) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++, pixels += 3) {
+				image.setColor(x, y, ofColor(pixels[0], pixels[1], pixels[2]));
+			}
+		}
+		return true;
+	});
+}
+
+//--------------------------------------------------------------
+// Renders into the writer, holding only the bands with tiles still out
+bool renderDistributed(const vector<char> &snapshot, const RenderFarmSettings &settings, ImageStreamWriter &writer)
+{
+	int width, height;
+	if (!SceneSnapshot::readImageSize(snapshot, width, height) || width != writer.getWidth() || height != writer.getHeight()) {
+		cout << "Scene snapshot is corrupt or doesn't match the image file's size" << endl;
+		return false;
+	}
+	BandAssembler assembler(writer);
+	bool bFinished = coordinateTiles(snapshot, settings, width, height, [&assembler](int x0, int y0, int x1, int y1, const unsigned char *pixels) {
+		return assembler.addTile(x0, y0, x1, y1, pixels);
+	});
+	return writer.close() && bFinished;
+}
+
+//--------------------------------------------------------------
+// Connects to the coordinator, retrying for a while so workers can be
+//  started before it
+static SocketHandle connectTo(const string &host, const string &port)
+{
+	for (int attempt = 0; attempt < 100; attempt++) {
+		addrinfo hints, *addresses = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) == 0) {
+			for (addrinfo *address = addresses; address != NULL; address = address->ai_next) {
+				SocketHandle connection = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+				if (connection == INVALID_SOCKET_HANDLE) continue;
+				if (connect(connection, address->ai_addr, (int)address->ai_addrlen) == 0) {
+					freeaddrinfo(addresses);
+					int noDelay = 1;
+					setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+					return connection;
+				}
+				closeSocket(connection);
+			}
+			freeaddrinfo(addresses);
+		}
+		this_thread::sleep_for(chrono::milliseconds(100));
+	}
+	return INVALID_SOCKET_HANDLE;
+}
+
+//--------------------------------------------------------------
+// Receives the scene, then asks for a tile per core, traces the
+//  tiles in parallel and sends them back until the coordinator is done
+int runRenderWorker(const string &address)
+{
+	size_t colon = address.rfind(':');
+	if (colon == string::npos || colon == 0 || colon + 1 == address.size()) {
+		cout << "Expected the coordinator's address as host:port" << endl;
+		return 1;
+	}
+	if (!startSockets()) return 1;
+	SocketHandle connection = connectTo(address.substr(0, colon), address.substr(colon + 1));
+	if (connection == INVALID_SOCKET_HANDLE) {
+		cout << "Couldn't connect to " << address << endl;
+		return 1;
+	}
+
+	// introduce the worker and receive the scene
+	uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+	vector<char> payload;
+	put(payload, FARM_PROTOCOL_VERSION);
+	put(payload, threads);
+	uint32_t type;
+	vector<char> message;
+	SceneSnapshot snapshot;
+	if (!sendMessage(connection, FARM_HELLO, payload) || !recvMessage(connection, type, message) ||
+		type != FARM_SCENE || !snapshot.read(message)) {
+		cout << "Couldn't receive the scene from " << address << endl;
+		closeSocket(connection);
+		return 1;
+	}
+	RenderScene scene = snapshot.getScene();
+	Renderer renderer;
+	renderer.compile(scene);
+
+	int tilesTraced = 0;
+	while (true) {
+		// ask for work and wait for it
+		payload.clear();
+		put(payload, threads);
+		if (!sendMessage(connection, FARM_REQUEST, payload) || !recvMessage(connection, type, message)) break;
+		if (type == FARM_DONE) {
+			cout << "Worker traced " << tilesTraced << " tiles" << endl;
+			closeSocket(connection);
+			return 0;
+		}
+		if (type != FARM_JOBS || message.size() < 4) break;
+		size_t offset = 0;
+		uint32_t count = take<uint32_t>(message.data(), offset);
+		if (message.size() != 4 + (size_t)count * 20) break;
+		vector<uint32_t> indices(count);
+		vector<RenderTile> tiles(count);
+		bool bValid = true;
+		for (uint32_t i = 0; i < count; i++) {
+			indices[i] = take<uint32_t>(message.data(), offset);
+			tiles[i].x0 = take<int32_t>(message.data(), offset);
+			tiles[i].y0 = take<int32_t>(message.data(), offset);
+			tiles[i].x1 = take<int32_t>(message.data(), offset);
+			tiles[i].y1 = take<int32_t>(message.data(), offset);
+			bValid = bValid && tiles[i].x0 >= 0 && tiles[i].y0 >= 0 && tiles[i].x1 <= snapshot.width &&
+				tiles[i].y1 <= snapshot.height && tiles[i].x0 < tiles[i].x1 && tiles[i].y0 < tiles[i].y1;
+		}
+		if (!bValid) break;
+
+		// trace the tiles on all cores, each into its own message
+		vector<vector<char>> results(count);
+		parallelFor((int)count, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				RenderTile &tile = tiles[i];
+				vector<char> &result = results[i];
+				result.resize(4 + (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * 3);
+				memcpy(result.data(), &indices[i], 4);
+				renderer.traceTile(scene, snapshot.width, snapshot.height, tile, [&](int x, int y, const ofColor &color) {
+					char *pixel = result.data() + 4 + ((size_t)(y - tile.y0) * (tile.x1 - tile.x0) + (x - tile.x0)) * 3;
+					pixel[0] = (char)(unsigned char)color.r;
+					pixel[1] = (char)(unsigned char)color.g;
+					pixel[2] = (char)(unsigned char)color.b;
+				});
+			}
+		});
+		bool bSent = true;
+		for (uint32_t i = 0; i < count && bSent; i++) bSent = sendMessage(connection, FARM_TILE, results[i]);
+		if (!bSent) break;
+		tilesTraced += count;
+	}
+
+	cout << "Lost the connection to " << address << endl;
+	closeSocket(connection);
+	return 1;
+}
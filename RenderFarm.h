@@ -0,0 +1,54 @@
+// This file provides distributed rendering: a coordinator hands the
+//  tiles of an image out to worker processes on this or other machines
+//  and collects the finished tiles.
+// The coordinator listens on a TCP port and sends every worker that
+//  connects the scene snapshot (see SceneSnapshot.h) once. Workers pull
+//  tile jobs, as many at a time as they have cores, trace them and
+//  stream each finished tile back as raw pixels. Tiles given to a
+//  worker go back in the queue if its connection drops or it doesn't
+//  return them within a timeout; whichever copy of a tile arrives first
+//  is kept, so a slow worker can't hold up the frame.
+//
+// Messages are a header of two uint32 (type and payload size, host byte
+//  order) followed by the payload:
+//  HELLO     worker -> coordinator   protocol version, hardware threads
+//  SCENE     coordinator -> worker   the scene snapshot
+//  REQUEST   worker -> coordinator   number of tiles wanted
+//  JOBS      coordinator -> worker   tile count, then index, x0, y0, x1, y1 of each tile
+//  TILE      worker -> coordinator   tile index, then the tile's pixels row by row as RGB bytes
+//  DONE      coordinator -> worker   every tile is finished
+
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+
+// RenderFarmSettings: how a distributed render is run
+//
+struct RenderFarmSettings {
+	int port = 9000;				// port the coordinator listens on
+	int tileSize = 32;				// width and height of a tile job in pixels
+	double tileTimeout = 60;		// seconds before a tile that wasn't returned is given to another worker
+	double workerWait = 60;			// seconds to wait while no worker is connected before giving up
+	int localWorkers = 0;			// worker processes to start on this machine (Linux only)
+	const atomic<bool> *cancel = NULL;	// the render stops (returning false) once this is set
+};
+
+class ImageStreamWriter;
+
+// Renders the scene snapshot with the workers that connect and stores
+//  the tiles in the image (allocated with the snapshot's image size).
+//  Returns false if the snapshot is corrupt, the port can't be opened,
+//  no worker connected for settings.workerWait seconds or the render
+//  was cancelled.
+bool renderDistributed(const vector<char> &snapshot, const RenderFarmSettings &settings, ofImage &image);
+
+// Renders the scene snapshot the same way, streaming finished bands of
+//  rows to the writer (opened with the snapshot's image size), which is
+//  closed at the end. Tiles are handed out top to bottom, so only the
+//  bands with tiles still being traced are held in memory.
+bool renderDistributed(const vector<char> &snapshot, const RenderFarmSettings &settings, ImageStreamWriter &writer);
+
+// Connects to the coordinator at "host:port" and traces the tiles it
+//  hands out until the image is done. Returns the exit code.
+int runRenderWorker(const string &address);
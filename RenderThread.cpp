@@ -0,0 +1,268 @@
+// This file provides implementation of the SceneFreezer and RenderThread
+//  class methods.
+
+#include "RenderThread.h"
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+// Copies the mesh's vertices, normals, triangles and hierarchy unless the
+//  copy from an earlier freeze is still current (the copy is never posed
+//  itself; placements of it render it)
+shared_ptr<Mesh> SceneFreezer::freezeMesh(Mesh *mesh)
+{
+	auto found = meshes.find(mesh->serial);
+	if (found != meshes.end() && found->second.geometryRevision == mesh->geometryRevision &&
+		found->second.bSmooth == mesh->smoothShading) {
+		found->second.bSeen = true;
+		return found->second.copy;
+	}
+	shared_ptr<Mesh> copy = make_shared<Mesh>();
+	copy->verts = mesh->verts;
+	copy->nVerts = mesh->nVerts;
+	copy->triangles = mesh->triangles;
+	copy->bvh = mesh->bvh;
+	copy->smoothShading = mesh->smoothShading;
+	copy->name = mesh->name;
+
+	FrozenMesh &entry = meshes[mesh->serial];
+	entry.copy = copy;
+	entry.geometryRevision = mesh->geometryRevision;
+	entry.bSmooth = mesh->smoothShading;
+	entry.bSeen = true;
+	return copy;
+}
+
+//--------------------------------------------------------------
+// Shares the copy of every object whose bounds, revision, color, shading
+//  mode and geometry match the last copy, copies the rest, and copies the
+//  lights and camera (which are small) every time
+shared_ptr<const FrozenScene> SceneFreezer::freeze(const RenderScene &scene, int width, int height)
+{
+	PROFILE_ZONE("SceneFreezer::freeze");
+	shared_ptr<FrozenScene> frozen = make_shared<FrozenScene>();
+	frozen->width = width;
+	frozen->height = height;
+	objectsCopied = 0;
+	for (auto &entry : meshes) entry.second.bSeen = false;
+	for (auto &entry : objects) entry.second.bSeen = false;
+
+	// objects
+	for (SceneObject *object : *scene.objects) {
+		MeshInstance *instance = dynamic_cast<MeshInstance *>(object);
+		Mesh *mesh = dynamic_cast<Mesh *>(object);
+		Plane *plane = dynamic_cast<Plane *>(object);
+		Sphere *sphere = dynamic_cast<Sphere *>(object);
+
+		FrozenObject current;
+		current.bBounded = object->getWorldBounds(current.boundsMin, current.boundsMax);
+		current.revision = object->revision;
+		current.diffuse = object->diffuseColor;
+		current.bSmooth = object->smoothShading;
+		shared_ptr<Mesh> geometry;
+		if (mesh) geometry = freezeMesh(mesh);
+		else if (instance) geometry = freezeMesh(instance->mesh);
+		current.geometry = geometry.get();
+		current.bSeen = true;
+
+		// share the last copy if the object didn't change
+		auto found = objects.find(object->serial);
+		if (found != objects.end()) {
+			const FrozenObject &old = found->second;
+			if (old.bBounded == current.bBounded && old.revision == current.revision &&
+				old.diffuse == current.diffuse && old.bSmooth == current.bSmooth && old.geometry == current.geometry &&
+				(!current.bBounded || (old.boundsMin == current.boundsMin && old.boundsMax == current.boundsMax))) {
+				found->second.bSeen = true;
+				frozen->objectCopies.push_back(old.copy);
+				frozen->objects.push_back(old.copy.get());
+				continue;
+			}
+		}
+
+		// copy it (a mesh becomes a placement of its geometry's copy, and a
+		//  sphere, joints included, a sphere at its world position)
+		SceneObject *copy = NULL;
+		if (instance || mesh) {
+			MeshInstance *placement = new MeshInstance(geometry.get(), object->getName());
+			placement->setTransform(mesh ? mesh->meshTransMatrix : instance->transform);
+			copy = placement;
+		}
+		else if (plane) {
+			Plane *planeCopy = new Plane(plane->position, plane->normal, plane->diffuseColor, plane->width, plane->height);
+			planeCopy->setTiles(plane->tilesX, plane->tilesY);
+			if (plane->textureApplied) planeCopy->applyTexture(plane->textureImg);
+			copy = planeCopy;
+		}
+		else if (sphere) {
+			copy = new Sphere(sphere->getPosition(), sphere->radius, sphere->diffuseColor);
+		}
+		else {
+			cout << "Skipping object " << object->getName() << " that can't be rendered in the background" << endl;
+			continue;
+		}
+		copy->diffuseColor = object->diffuseColor;
+		copy->specularColor = object->specularColor;
+		copy->smoothShading = object->smoothShading;
+		copy->revision = object->revision;
+
+		// the placement holds on to its geometry's copy with the object's copy
+		current.copy = shared_ptr<SceneObject>(copy, [geometry](SceneObject *object) { delete object; });
+		objects[object->serial] = current;
+		frozen->objectCopies.push_back(current.copy);
+		frozen->objects.push_back(copy);
+		objectsCopied++;
+	}
+
+	// forget the copies of objects and meshes that left the scene
+	for (auto entry = objects.begin(); entry != objects.end();) {
+		if (entry->second.bSeen) ++entry;
+		else entry = objects.erase(entry);
+	}
+	for (auto entry = meshes.begin(); entry != meshes.end();) {
+		if (entry->second.bSeen) ++entry;
+		else entry = meshes.erase(entry);
+	}
+
+	// lights
+	for (const Light *light : *scene.lights) {
+		Light *copy;
+		if (const SphereLight *sphereLight = dynamic_cast<const SphereLight *>(light)) {
+			copy = new SphereLight(light->position, light->intensity, sphereLight->radius, light->diffuseColor);
+		}
+		else if (const RectLight *rectLight = dynamic_cast<const RectLight *>(light)) {
+			copy = new RectLight(light->position, light->intensity, rectLight->edgeU, rectLight->edgeV, light->diffuseColor);
+		}
+		else {
+			copy = new PointLight(light->position, light->intensity, 0.1, light->diffuseColor);
+		}
+		copy->revision = light->revision;
+		frozen->lightCopies.push_back(shared_ptr<Light>(copy));
+		frozen->lights.push_back(copy);
+	}
+
+	// camera and settings
+	frozen->camera.position = scene.camera->position;
+	frozen->camera.aim = scene.camera->aim;
+	frozen->camera.view.min = scene.camera->view.min;
+	frozen->camera.view.max = scene.camera->view.max;
+	frozen->camera.view.position = scene.camera->view.position;
+	frozen->scene = scene;
+	frozen->scene.objects = &frozen->objects;
+	frozen->scene.lights = &frozen->lights;
+	frozen->scene.camera = &frozen->camera;
+	return frozen;
+}
+
+//--------------------------------------------------------------
+// Drops the object's entries (a mesh's object and geometry entries share
+//  its serial)
+void SceneFreezer::remove(const SceneObject *object)
+{
+	objects.erase(object->serial);
+	meshes.erase(object->serial);
+}
+
+//--------------------------------------------------------------
+// Forgets the copies kept for sharing (frozen scenes keep theirs)
+void SceneFreezer::clear()
+{
+	objects.clear();
+	meshes.clear();
+}
+
+//--------------------------------------------------------------
+// Stops the thread after the tile it is tracing
+RenderThread::~RenderThread()
+{
+	{
+		lock_guard<std::mutex> lock(stateMutex);
+		bQuit = true;
+		renderer.bCancel = true;
+	}
+	wake.notify_one();
+	if (thread.joinable()) thread.join();
+}
+
+//--------------------------------------------------------------
+// Hands the scene to the thread (starting it the first time)
+void RenderThread::start(shared_ptr<const FrozenScene> scene, bool bFull)
+{
+	{
+		lock_guard<std::mutex> lock(stateMutex);
+		pending = scene;
+		bPendingFull = bPendingFull || bFull;
+		if (bRendering) renderer.bCancel = true;
+		if (!thread.joinable()) thread = std::thread(&RenderThread::run, this);
+	}
+	wake.notify_one();
+}
+
+//--------------------------------------------------------------
+// Drops the waiting scene and cancels the render in progress
+void RenderThread::cancel()
+{
+	lock_guard<std::mutex> lock(stateMutex);
+	pending.reset();
+	if (bRendering) renderer.bCancel = true;
+}
+
+//--------------------------------------------------------------
+// Returns true while the thread has work
+bool RenderThread::isBusy()
+{
+	lock_guard<std::mutex> lock(stateMutex);
+	return bRendering || pending;
+}
+
+//--------------------------------------------------------------
+// Copies the finished image and frees the retired scenes
+bool RenderThread::takeImage(ofImage &image)
+{
+	lock_guard<std::mutex> lock(stateMutex);
+	retired.clear();
+	if (!bFinished) return false;
+	image = finished;
+	tilesTraced = finishedTiles;
+	tileCount = finishedTileCount;
+	renderTime = finishedTime;
+	bFinished = false;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Takes the waiting scene, renders it without holding the lock and
+//  publishes the image if the render wasn't cancelled
+void RenderThread::run()
+{
+	Profiler::setThreadName("render");
+	unique_lock<std::mutex> lock(stateMutex);
+	while (true) {
+		wake.wait(lock, [this] { return bQuit || pending; });
+		if (bQuit) break;
+		shared_ptr<const FrozenScene> scene = std::move(pending);
+		bool bFull = bPendingFull;
+		bPendingFull = false;
+		renderer.bCancel = false;
+		bRendering = true;
+		lock.unlock();
+
+		// the image only lives in memory, so it needs no texture
+		if (image.getWidth() != scene->width || image.getHeight() != scene->height) {
+			image.setUseTexture(false);
+			image.allocate(scene->width, scene->height, OF_IMAGE_COLOR);
+		}
+		if (bFull) renderer.invalidate();
+		renderer.render(scene->scene, image);
+
+		lock.lock();
+		bRendering = false;
+		if (rendered) retired.push_back(std::move(rendered));
+		rendered = std::move(scene);
+		if (renderer.bComplete) {
+			finished = image;
+			finishedTiles = renderer.tilesTraced;
+			finishedTileCount = (int)renderer.tiles.size();
+			finishedTime = renderer.renderTime;
+			bFinished = true;
+		}
+	}
+}
@@ -0,0 +1,147 @@
+// This file provides the definitions of the FrozenScene struct and the
+//  SceneFreezer and RenderThread classes, which render the scene on a
+//  background thread while the viewer keeps changing it.
+// A render works from a frozen copy of the scene taken when it starts,
+//  so posing joints, playing clips or deforming skinned meshes never
+//  changes what a render in progress reads. Freezing is copy on write:
+//  the freezer remembers the copy it made of every object and shares
+//  it with the next frozen scene unless the object changed (by the same
+//  test the renderer uses to find changed tiles), and mesh vertices and
+//  hierarchies are only copied again after the vertices moved. Because
+//  unchanged objects keep their copies, the renderer still re-traces only
+//  the tiles that changed. Copies are remembered by the object's serial,
+//  not its address, so an object made in a destroyed object's pool slot
+//  is never mistaken for it.
+// The render thread renders one frozen scene at a time. Starting a new
+//  render cancels the one in progress instead of queueing behind it, and
+//  the tiles the cancelled render didn't reach are traced by the next.
+
+#pragma once
+
+#include "ofMain.h"
+#include "Renderer.h"
+#include <mutex>
+#include <condition_variable>
+
+class Mesh;
+
+// FrozenScene: a copy of everything a render reads (held through a
+//  shared_ptr and never changed once frozen)
+//
+struct FrozenScene {
+	FrozenScene() {}
+	FrozenScene(const FrozenScene &) = delete;
+	FrozenScene &operator=(const FrozenScene &) = delete;
+
+	vector<shared_ptr<SceneObject>> objectCopies;	// own the copies (shared with other frozen scenes)
+	vector<shared_ptr<Light>> lightCopies;
+	vector<SceneObject *> objects;					// the copies as the renderer reads them
+	vector<Light *> lights;
+	RenderCam camera;								// copy of the camera
+	RenderScene scene;								// the frozen scene (points into this struct)
+	int width = 0, height = 0;						// size of the image to render
+};
+
+// SceneFreezer class: takes frozen copies of a scene, sharing the copies
+//  of objects that didn't change since the last one
+//
+class SceneFreezer {
+public:
+	// Copies the scene and the size of the image to render (objects of types
+	//  the freezer can't copy are skipped with a warning)
+	shared_ptr<const FrozenScene> freeze(const RenderScene &scene, int width, int height);
+
+	// Forgets the copies kept for sharing the object's copy (and, for a
+	//  mesh, its geometry's) with the next frozen scene (called when the
+	//  object is destroyed; frozen scenes keep the copies they hold)
+	void remove(const SceneObject *object);
+
+	// Forgets the copies kept for sharing
+	void clear();
+
+	// Fields of SceneFreezer class
+	//
+	int objectsCopied = 0;						// objects the last freeze copied (the rest were shared)
+
+private:
+	// a copy of a mesh's vertices, triangles and hierarchy
+	struct FrozenMesh {
+		shared_ptr<Mesh> copy;
+		uint32_t geometryRevision;				// the mesh's geometry revision when copied
+		bool bSmooth;							// the mesh's shading mode when copied
+		bool bSeen;								// marks meshes still in the scene while freezing
+	};
+
+	// a copy of an object and the state it was copied in
+	struct FrozenObject {
+		shared_ptr<SceneObject> copy;
+		bool bBounded;
+		glm::vec3 boundsMin, boundsMax;
+		uint32_t revision;
+		ofColor diffuse;
+		bool bSmooth;
+		const Mesh *geometry;					// copy of the vertices a mesh or mesh placement renders
+		bool bSeen;								// marks objects still in the scene while freezing
+	};
+
+	// Returns the copy of the mesh's geometry, copying it if it changed
+	shared_ptr<Mesh> freezeMesh(Mesh *mesh);
+
+	unordered_map<uint64_t, FrozenMesh> meshes;			// geometry copies by the mesh's serial
+	unordered_map<uint64_t, FrozenObject> objects;		// copies by the object's serial
+};
+
+// RenderThread class: renders frozen scenes on a background thread
+//
+class RenderThread {
+public:
+	~RenderThread();
+
+	// Renders the frozen scene in the background (every tile if bFull is
+	//  set), cancelling the render in progress and replacing a scene that
+	//  is waiting
+	void start(shared_ptr<const FrozenScene> scene, bool bFull = false);
+
+	// Stops the render in progress after the tiles being traced and drops
+	//  a scene that is waiting
+	void cancel();
+
+	// Returns true while a scene is being rendered or waiting
+	bool isBusy();
+
+	// Returns the fraction of the render in progress that is done
+	float getProgress() const { return renderer.getProgress(); }
+
+	// Copies the image of the last render that finished (if one finished
+	//  since the last call) and returns true. Also releases the frozen
+	//  scenes the thread is done with, so they are freed on the caller's
+	//  thread.
+	bool takeImage(ofImage &image);
+
+	// Fields of RenderThread class
+	//
+	int tilesTraced = 0;				// tiles traced by the render of the taken image
+	int tileCount = 0;					// tiles of the taken image
+	double renderTime = 0;				// seconds taken by the render of the taken image
+
+private:
+	// Waits for scenes and renders them until the thread is stopped
+	void run();
+
+	std::thread thread;
+	std::mutex stateMutex;								// guards the fields the thread and its owner share
+	std::condition_variable wake;
+	Renderer renderer;									// only used by the thread (apart from progress and cancelling)
+	ofImage image;										// image the renderer updates (only used by the thread)
+	shared_ptr<const FrozenScene> pending;				// scene waiting to be rendered
+	bool bPendingFull = false;
+	shared_ptr<const FrozenScene> rendered;				// scene the renderer's compiled scene points into (kept
+														//  until the next render compiles another)
+	vector<shared_ptr<const FrozenScene>> retired;		// scenes the thread is done with
+	bool bRendering = false;							// set while the thread renders
+	bool bQuit = false;									// stops the thread
+	ofImage finished;									// image of the last render that finished
+	bool bFinished = false;								// set until the finished image is taken
+	int finishedTiles = 0, finishedTileCount = 0;
+	double finishedTime = 0;
+};
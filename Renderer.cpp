@@ -0,0 +1,673 @@
+// This file provides implementation of the Renderer class methods.
+
+#include "Renderer.h"
+#include "Parallel.h"
+#include "ImageWriter.h"
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+// Compares the objects with the records of the last render to find
+//  the boxes that changed, marks the tiles those boxes (or shadows
+//  through them) can reach, and traces the marked tiles on all cores
+int Renderer::render(const RenderScene &scene, ofImage &image)
+{
+	PROFILE_ZONE("Renderer::render");
+	auto start = chrono::high_resolution_clock::now();
+	int width = (int)image.getWidth();
+	int height = (int)image.getHeight();
+	bool bFull = !bValid || settingsChanged(scene, image);
+
+	// split the image into tiles
+	int columns = (width + tileSize - 1) / tileSize;
+	int rows = (height + tileSize - 1) / tileSize;
+	if (tiles.size() != columns * rows || bFull) {
+		tiles.resize(columns * rows);
+		for (int n = 0; n < tiles.size(); n++) {
+			RenderTile &tile = tiles[n];
+			tile.x0 = (n % columns) * tileSize;
+			tile.y0 = (n / columns) * tileSize;
+			tile.x1 = std::min(width, tile.x0 + tileSize);
+			tile.y1 = std::min(height, tile.y0 + tileSize);
+		}
+		bFull = true;
+	}
+
+	// boxes of objects that were added, removed or changed (old and new boxes)
+	vector<glm::vec3> changedMin, changedMax;
+	for (auto &entry : records) entry.second.bSeen = false;
+	const vector<SceneObject *> &objects = *scene.objects;
+	for (int k = 0; k < objects.size(); k++) {
+		ObjectRecord current;
+		current.bBounded = objects[k]->getWorldBounds(current.boundsMin, current.boundsMax);
+		current.revision = objects[k]->revision;
+		current.diffuse = objects[k]->diffuseColor;
+		current.bSmooth = objects[k]->smoothShading;
+		current.bSeen = true;
+
+		auto found = records.find(objects[k]->serial);
+		if (found != records.end()) {
+			ObjectRecord &old = found->second;
+			bool bSame = old.bBounded == current.bBounded && old.revision == current.revision &&
+				old.diffuse == current.diffuse && old.bSmooth == current.bSmooth &&
+				(!current.bBounded || (old.boundsMin == current.boundsMin && old.boundsMax == current.boundsMax));
+			if (!bSame) {
+				if (!old.bBounded || !current.bBounded) bFull = true;
+				changedMin.push_back(old.boundsMin);
+				changedMax.push_back(old.boundsMax);
+				changedMin.push_back(current.boundsMin);
+				changedMax.push_back(current.boundsMax);
+			}
+			old = current;
+		}
+		else {
+			// a new object
+			if (!current.bBounded) bFull = true;
+			changedMin.push_back(current.boundsMin);
+			changedMax.push_back(current.boundsMax);
+			records[objects[k]->serial] = current;
+		}
+	}
+	for (auto entry = records.begin(); entry != records.end();) {
+		if (entry->second.bSeen) {
+			++entry;
+			continue;
+		}
+		// a removed object
+		if (!entry->second.bBounded) bFull = true;
+		changedMin.push_back(entry->second.boundsMin);
+		changedMax.push_back(entry->second.boundsMax);
+		entry = records.erase(entry);
+	}
+
+	// mark the tiles to trace (with the tiles a cancelled render didn't reach)
+	vector<int> dirty;
+	if (bFull) {
+		for (int n = 0; n < tiles.size(); n++) dirty.push_back(n);
+	}
+	else {
+		vector<bool> bDirty(tiles.size(), false);
+		for (int n = 0; n < tiles.size(); n++) bDirty[n] = tiles[n].bStale;
+		for (int c = 0; c < changedMin.size(); c++) {
+			// tiles covered by the box on screen
+			int x0, y0, x1, y1;
+			if (!projectBounds(*scene.camera, changedMin[c], changedMax[c], width, height, x0, y0, x1, y1)) {
+				x0 = 0; y0 = 0; x1 = width; y1 = height;
+			}
+			for (int row = y0 / tileSize; row < rows && row * tileSize < y1; row++) {
+				for (int column = x0 / tileSize; column < columns && column * tileSize < x1; column++) {
+					bDirty[row * columns + column] = true;
+				}
+			}
+			// tiles whose shadow rays can pass through the box
+			for (int n = 0; n < tiles.size(); n++) {
+				if (bDirty[n] || !tiles[n].bAnyHit) continue;
+				for (int i = 0; i < scene.lights->size(); i++) {
+					const Light *light = (*scene.lights)[i];
+					if (shadowCouldCross(tiles[n], light->position, light->getBoundingRadius(), changedMin[c], changedMax[c])) {
+						bDirty[n] = true;
+						break;
+					}
+				}
+			}
+		}
+		for (int n = 0; n < tiles.size(); n++) {
+			if (bDirty[n]) dirty.push_back(n);
+		}
+	}
+
+	// trace the marked tiles (the objects' matrices were brought up to
+	//  date while getting their bounds, so tracing only reads the scene
+	//  and its compiled copy).
+	//  Once bCancel is set the remaining tiles stay stale for the next render.
+	compile(scene);
+	for (int d = 0; d < dirty.size(); d++) tiles[dirty[d]].bStale = true;
+	tilesMarked = (int)dirty.size();
+	tilesDone = 0;
+	parallelFor((int)dirty.size(), [&](int begin, int end) {
+		for (int d = begin; d < end && !bCancel; d++) {
+			traceTile(scene, width, height, tiles[dirty[d]], [&image](int x, int y, const ofColor &color) {
+				image.setColor(x, y, color);
+			});
+			tiles[dirty[d]].bStale = false;
+			tilesDone++;
+		}
+	});
+
+	// remember the settings the image was rendered with
+	imageWidth = width;
+	imageHeight = height;
+	cameraPosition = scene.camera->position;
+	viewMin = scene.camera->view.min;
+	viewMax = scene.camera->view.max;
+	viewDepth = scene.camera->view.position.z;
+	phongPower = scene.phongPower;
+	background = scene.background;
+	lightSamples = scene.lightSamples;
+	sampler = scene.sampler;
+	shadingModel = scene.shadingModel;
+	bShadows = scene.bShadows;
+	lightRecords.resize(scene.lights->size());
+	for (int i = 0; i < lightRecords.size(); i++) {
+		const Light *light = (*scene.lights)[i];
+		lightRecords[i].position = light->position;
+		lightRecords[i].intensity = light->intensity;
+		lightRecords[i].boundingRadius = light->getBoundingRadius();
+		lightRecords[i].revision = light->revision;
+	}
+	bValid = true;
+	tilesTraced = tilesDone;
+	bComplete = tilesTraced == dirty.size();
+	renderTime = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	return tilesTraced;
+}
+
+//--------------------------------------------------------------
+// Traces one band of rows at a time into a buffer that the writer
+//  then streams to disk, so memory holds a band instead of the image
+bool Renderer::renderToWriter(const RenderScene &scene, ImageStreamWriter &writer)
+{
+	PROFILE_ZONE("Renderer::renderToWriter");
+	auto start = chrono::high_resolution_clock::now();
+	int width = writer.getWidth();
+	int height = writer.getHeight();
+	int bandHeight = writer.getBandHeight();
+	int columns = (width + tileSize - 1) / tileSize;
+
+	// compiling brings the objects' matrices up to date, so tracing only reads the scene
+	compile(scene);
+
+	vector<unsigned char> band((size_t)width * bandHeight * 3);
+	tilesTraced = 0;
+	for (int y0 = 0; y0 < height; y0 += bandHeight) {
+		int y1 = std::min(height, y0 + bandHeight);
+		parallelFor(columns, [&](int begin, int end) {
+			for (int c = begin; c < end; c++) {
+				RenderTile tile;
+				tile.x0 = c * tileSize;
+				tile.x1 = std::min(width, tile.x0 + tileSize);
+				tile.y0 = y0;
+				tile.y1 = y1;
+				traceTile(scene, width, height, tile, [&](int x, int y, const ofColor &color) {
+					unsigned char *pixel = &band[((size_t)(y - y0) * width + x) * 3];
+					pixel[0] = color.r;
+					pixel[1] = color.g;
+					pixel[2] = color.b;
+				});
+			}
+		});
+		tilesTraced += columns;
+		if (!writer.writeBand(band.data(), y1 - y0)) return false;
+	}
+	bool bClosed = writer.close();
+	renderTime = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	return bClosed;
+}
+
+//--------------------------------------------------------------
+// Compares the camera, lights, image size and shading settings
+//  with those of the last render
+bool Renderer::settingsChanged(const RenderScene &scene, const ofImage &image) const
+{
+	if (image.getWidth() != imageWidth || image.getHeight() != imageHeight) return true;
+	const RenderCam &camera = *scene.camera;
+	if (camera.position != cameraPosition || camera.view.min != viewMin || camera.view.max != viewMax ||
+		camera.view.position.z != viewDepth) {
+		return true;
+	}
+	if (scene.phongPower != phongPower || scene.background != background) return true;
+	if (scene.lightSamples != lightSamples || scene.sampler != sampler) return true;
+	if (scene.shadingModel != shadingModel || scene.bShadows != bShadows) return true;
+	if (scene.lights->size() != lightRecords.size()) return true;
+	for (int i = 0; i < lightRecords.size(); i++) {
+		const Light *light = (*scene.lights)[i];
+		if (light->position != lightRecords[i].position || light->intensity != lightRecords[i].intensity ||
+			light->getBoundingRadius() != lightRecords[i].boundingRadius || light->revision != lightRecords[i].revision) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+// Projects the box's corners through the camera onto the view plane
+//  (a camera ray through a point of the box passes through the
+//  point's projection, which lies inside the corners' rectangle)
+bool Renderer::projectBounds(const RenderCam &camera, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	int width, int height, int &x0, int &y0, int &x1, int &y1)
+{
+	float depth = camera.view.position.z - camera.position.z;	// distance from the camera to the view plane along z
+	glm::vec2 viewSize = camera.view.max - camera.view.min;
+	float minX = std::numeric_limits<float>::infinity(), maxX = -minX;
+	float minY = minX, maxY = -minX;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec3 offset = point - camera.position;
+		// corners beside or behind the camera have no projection
+		if (offset.z * depth <= 1e-6 * fabs(depth)) return false;
+		float scale = depth / offset.z;
+		float u = (camera.position.x + offset.x * scale - camera.view.min.x) / viewSize.x;
+		float v = (camera.position.y + offset.y * scale - camera.view.min.y) / viewSize.y;
+		minX = std::min(minX, u * width);
+		maxX = std::max(maxX, u * width);
+		minY = std::min(minY, (1 - v) * height);
+		maxY = std::max(maxY, (1 - v) * height);
+	}
+	// pixels whose centers fall inside the rectangle, plus a pixel of padding
+	x0 = std::max(0, (int)floor(minX) - 1);
+	y0 = std::max(0, (int)floor(minY) - 1);
+	x1 = std::min(width, (int)ceil(maxX) + 1);
+	y1 = std::min(height, (int)ceil(maxY) + 1);
+	return true;
+}
+
+//--------------------------------------------------------------
+// Bounds the box and the tile's surface points with spheres and
+//  compares the cones they subtend at the light: a shadow ray can
+//  only pass through the box if the cones overlap and the box starts
+//  closer to the light than the farthest surface point. A shadow ray
+//  that ends anywhere on an area light is a ray to its center moved
+//  by at most the light's radius, so the box's sphere grows by it.
+bool Renderer::shadowCouldCross(const RenderTile &tile, const glm::vec3 &light, float lightRadius,
+	const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	// shadow rays start slightly off the surface
+	const float padding = 0.001;
+	glm::vec3 boxCenter = (boundsMin + boundsMax) * 0.5f;
+	float boxRadius = glm::length(boundsMax - boundsMin) * 0.5f + padding + lightRadius;
+	glm::vec3 hitCenter = (tile.hitMin + tile.hitMax) * 0.5f;
+	float hitRadius = glm::length(tile.hitMax - tile.hitMin) * 0.5f + padding;
+	float boxDistance = glm::distance(light, boxCenter);
+	float hitDistance = glm::distance(light, hitCenter);
+
+	// a light inside either sphere can send rays in any direction
+	if (boxDistance <= boxRadius || hitDistance <= hitRadius) return true;
+	// the box lies beyond every surface point
+	if (boxDistance - boxRadius > hitDistance + hitRadius) return false;
+	// the cones from the light around the spheres overlap
+	float cosAngle = glm::dot(boxCenter - light, hitCenter - light) / (boxDistance * hitDistance);
+	float angle = acos(std::max(-1.0f, std::min(1.0f, cosAngle)));
+	return angle <= asin(boxRadius / boxDistance) + asin(hitRadius / hitDistance);
+}
+
+//--------------------------------------------------------------
+// Updates the compiled scene, then collects the features its objects
+//  and the settings need and picks the kernel compiled for them
+void Renderer::compile(const RenderScene &scene)
+{
+	compiled.update(scene);
+	shadingFeatures = 0;
+	for (const CompiledMesh &placed : compiled.meshes) {
+		shadingFeatures |= placed.mesh->smoothShading ? SHADE_SMOOTH : SHADE_FLAT;
+	}
+	for (const CompiledPlane &plane : compiled.planes) {
+		if (plane.textured) shadingFeatures |= SHADE_TEXTURED;
+	}
+	if (scene.shadingModel == SHADING_PHONG) {
+		shadingFeatures |= SHADE_PHONG;
+		// whole powers up to 256 take at most 16 multiplications
+		if (scene.phongPower >= 0 && scene.phongPower <= 256 && scene.phongPower == floor(scene.phongPower)) {
+			shadingFeatures |= SHADE_INTEGER_POWER;
+			integerPower = (int)scene.phongPower;
+		}
+	}
+	if (scene.bShadows) shadingFeatures |= SHADE_SHADOWS;
+	// the kernel that tests each hit's mesh and plane and calls pow, for comparison
+	if (!bSpecialize) shadingFeatures = (shadingFeatures | SHADE_SMOOTH | SHADE_FLAT | SHADE_TEXTURED) & ~SHADE_INTEGER_POWER;
+	if (bWavefront && (shadingFeatures & SHADE_SHADOWS)) shadingFeatures |= SHADE_WAVEFRONT;
+	tileKernel = getTileKernels(std::make_index_sequence<SHADE_FEATURE_SETS>())[shadingFeatures];
+}
+
+//--------------------------------------------------------------
+// Instantiates the kernel for every set of features once
+template<size_t... Features>
+const Renderer::TileKernel *Renderer::getTileKernels(std::index_sequence<Features...>)
+{
+	static const TileKernel kernels[] = { &Renderer::traceTileWith<Features>... };
+	return kernels;
+}
+
+//--------------------------------------------------------------
+// Traces a tile in passes, or pixel by pixel
+template<unsigned Features>
+void Renderer::traceTileWith(const RenderScene &scene, int width, int height, RenderTile &tile, ofColor *colors) const
+{
+	if (Features & SHADE_WAVEFRONT) {
+		traceWavefront<Features>(scene, width, height, tile, colors);
+		return;
+	}
+	for (int y = tile.y0; y < tile.y1; y++) {
+		// get current pixel in u and v coordinates (v grows up, rows grow down)
+		float v = (height - y - 0.5) / height;
+		for (int x = tile.x0; x < tile.x1; x++) {
+			float u = (x + 0.5) / width;
+			*colors++ = trace<Features>(scene, scene.camera->getRay(u, v), tile, y * width + x);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Finds the closest hit of the ray; the point, normal and color are
+//  only computed for that hit
+template<unsigned Features>
+bool Renderer::traceHit(const Ray &ray, RenderTile &tile, glm::vec3 &point, glm::vec3 &normal, ofColor &color) const
+{
+	// trace the ray through every object once; an object only records a hit
+	//  closer than the closest one so far
+	CompiledHit hit;
+	if (!compiled.intersect(ray, hit)) return false;
+
+	// compute the point and normal of the closest hit only
+	point = ray.p + hit.record.t * ray.d;
+	normal = getNormal<Features>(ray, hit);
+	tile.bAnyHit = true;
+	tile.hitMin = glm::min(tile.hitMin, point);
+	tile.hitMax = glm::max(tile.hitMax, point);
+
+	// assign color of closest object (without textures every plane has its own color)
+	color = !(Features & SHADE_TEXTURED) && hit.kind == COMPILED_PLANE ?
+		compiled.planes[hit.index].diffuse : compiled.getColor(hit, point);
+	return true;
+}
+
+//--------------------------------------------------------------
+// Finds the closest hit of the ray and shades it
+template<unsigned Features>
+ofColor Renderer::trace(const RenderScene &scene, const Ray &ray, RenderTile &tile, uint32_t pixelSeed) const
+{
+	glm::vec3 intersectPt, intersectNormal;
+	ofColor objColor;
+	// if hit did not occur color current pixel with background color
+	if (!traceHit<Features>(ray, tile, intersectPt, intersectNormal, objColor)) return scene.background;
+
+	// Shades the current pixel with ambient, lambert and (if enabled) phong shading
+	return shade<Features>(scene, ray, intersectPt, intersectNormal, objColor, pixelSeed);
+}
+
+//--------------------------------------------------------------
+// Returns the normal at the hit, shading meshes smooth or flat by the
+//  features (and by the mesh's mode if there are both)
+template<unsigned Features>
+glm::vec3 Renderer::getNormal(const Ray &ray, const CompiledHit &hit) const
+{
+	const unsigned bothModes = SHADE_SMOOTH | SHADE_FLAT;
+	if (!(Features & bothModes) || hit.kind != COMPILED_MESH) return compiled.getNormal(ray, hit);
+	const CompiledMesh &placed = compiled.meshes[hit.index];
+	bool bSmooth = (Features & bothModes) == bothModes ? placed.mesh->smoothShading : (Features & SHADE_SMOOTH) != 0;
+	if (bSmooth) return placed.mesh->getSmoothNormal(placed.transform, hit.record.primIndex, hit.record.bary);
+	return placed.mesh->getFlatNormal(placed.transform, hit.record.primIndex);
+}
+
+//--------------------------------------------------------------
+// Adds lambert shading, and phong shading if enabled, to given pixel in the scene
+template<unsigned Features>
+ofColor Renderer::shade(const RenderScene &scene, const Ray &ray, const glm::vec3 &point, const glm::vec3 &normal,
+	const ofColor diffuse, uint32_t pixelSeed) const
+{
+	const bool bPhong = (Features & SHADE_PHONG) != 0;
+	// Sets ambient shading (phong leaves room for its highlights)
+	ofColor result = (bPhong ? 0.15 : 0.25) * diffuse;	// ambient shading value to not make image completely dark
+	glm::vec3 norm = glm::normalize(normal);			// normal at point
+	// vector from point to camera (only phong needs it)
+	glm::vec3 directionToCam = bPhong ? glm::normalize(scene.camera->position - point) : glm::vec3(0);
+	float diffuseTerm, specularTerm;					// light reaching the point, averaged over the light's samples
+
+	// iterates through all lights
+	for (int i = 0; i < compiled.lights.size(); i++) {
+		gatherLight<Features>(scene, i, point, norm, directionToCam, pixelSeed, diffuseTerm, specularTerm);
+		// Calculate and add diffuse shading to result
+		if (diffuseTerm > 0) result += diffuse * diffuseTerm;
+		// Adds phong shaded color to result
+		if (bPhong && specularTerm > 0) result += ofColor::white * specularTerm;
+	}
+	return result;
+}
+
+//--------------------------------------------------------------
+// Returns x to the power n by squaring (n >= 0)
+static inline float integerPow(float x, int n)
+{
+	float result = 1;
+	for (; n > 0; n >>= 1) {
+		if (n & 1) result *= x;
+		x *= x;
+	}
+	return result;
+}
+
+//--------------------------------------------------------------
+// Fires a shadow ray at one point of a point light, or at lightSamples
+//  points of an area light drawn from the scene's sampler, and averages
+//  the shading of the unblocked ones. The terms are summed as floats so
+//  many small contributions aren't rounded away one color at a time.
+template<unsigned Features>
+void Renderer::gatherLight(const RenderScene &scene, int light, const glm::vec3 &point, const glm::vec3 &norm,
+	const glm::vec3 &directionToCam, uint32_t pixelSeed, float &diffuseTerm, float &specularTerm) const
+{
+	const CompiledLight &source = compiled.lights[light];
+	bool bArea = source.boundingRadius > 0;
+	int samples = bArea ? std::max(1, scene.lightSamples) : 1;
+	// every light of every pixel scrambles the sequence differently
+	uint32_t seed = hashSeed(hashSeed(0, pixelSeed), light);
+	// point where shadow rays begin (a small step towards the normal)
+	glm::vec3 shadowRayPt = point + 0.0001f * norm;
+	diffuseTerm = 0;
+	specularTerm = 0;
+
+	for (int s = 0; s < samples; s++) {
+		glm::vec3 lightPoint = !bArea ? source.position :
+			compiled.sampleLight(source, getSample2D(scene.sampler, s, seed), point);
+		// Sets direction of ray pointing to light from intersection point on SceneObject
+		glm::vec3 directionToLight = glm::normalize(lightPoint - point);
+		// Checks for shadows, only unblocked samples light the point
+		if ((Features & SHADE_SHADOWS) && shadowCheck(scene, Ray(shadowRayPt, directionToLight), lightPoint)) continue;
+
+		float diffuse, specular;
+		sampleTerms<Features>(scene, source, lightPoint, point, norm, directionToCam, directionToLight, diffuse, specular);
+		diffuseTerm += diffuse;
+		specularTerm += specular;
+	}
+	diffuseTerm /= samples;
+	specularTerm /= samples;
+}
+
+//--------------------------------------------------------------
+// Computes the diffuse and phong terms of one light sample
+template<unsigned Features>
+void Renderer::sampleTerms(const RenderScene &scene, const CompiledLight &source, const glm::vec3 &lightPoint,
+	const glm::vec3 &point, const glm::vec3 &norm, const glm::vec3 &directionToCam, const glm::vec3 &directionToLight,
+	float &diffuse, float &specular) const
+{
+	// Gets the illumination from the sample (the distance squared in
+	//  double precision, as pow(distance, 2) computed it)
+	double distance = glm::distance(lightPoint, point);
+	float illumination = source.intensity / (distance * distance);
+	// diffuse term from the dot product of normal and directionToLight vectors
+	diffuse = illumination * glm::max(0.0f, glm::dot(norm, directionToLight));
+	specular = 0;
+	if (!(Features & SHADE_PHONG)) return;
+	// phong term from the bisecting vector between vector to cam and vector to light
+	glm::vec3 bisectingVec = glm::normalize(directionToCam + directionToLight);
+	float cosine = glm::max(0.0f, glm::dot(norm, bisectingVec));
+	specular = illumination * ((Features & SHADE_INTEGER_POWER) ? integerPow(cosine, integerPower) :
+		pow(cosine, scene.phongPower));
+}
+
+// most shadow rays a tile's stream holds (a light's samples are split
+//  into several streams beyond it)
+static const int maxStreamRays = 1 << 14;
+
+// ShadowRay: a shadow ray of a stream (it starts at its hit's shadow
+//  ray point)
+//
+struct ShadowRay {
+	glm::vec3 lightPoint;		// sample of the light the ray is aimed at
+	glm::vec3 direction;		// normalized direction to lightPoint
+};
+
+//--------------------------------------------------------------
+// Spreads the lowest 9 bits of x out to every third bit
+static uint32_t spreadBits9(uint32_t x)
+{
+	x &= 0x1ff;
+	x = (x | (x << 16)) & 0x30000ff;
+	x = (x | (x << 8)) & 0x300f00f;
+	x = (x | (x << 4)) & 0x30c30c3;
+	x = (x | (x << 2)) & 0x9249249;
+	return x;
+}
+
+//--------------------------------------------------------------
+// Traces the primary rays of every pixel, then for each light emits the
+//  shadow rays of every hit, orders them by direction octant and by hit
+//  and traces them in that order (testing first what blocked the previous
+//  ray, which coherent rays often share), and sums each hit's unblocked
+//  samples in sample order, so the sums match the pixel by pixel path.
+//  The pixels are shaded last.
+template<unsigned Features>
+void Renderer::traceWavefront(const RenderScene &scene, int width, int height, RenderTile &tile, ofColor *colors) const
+{
+	const bool bPhong = (Features & SHADE_PHONG) != 0;
+	int tileWidth = tile.x1 - tile.x0;
+
+	// primary hits
+	struct PrimaryHit {
+		glm::vec3 point, norm, directionToCam;
+		ofColor color;
+		int pixel;				// place in the tile
+		uint32_t pixelSeed;
+	};
+	vector<PrimaryHit> hits;
+	hits.reserve((size_t)tileWidth * (tile.y1 - tile.y0));
+	for (int y = tile.y0; y < tile.y1; y++) {
+		float v = (height - y - 0.5) / height;
+		for (int x = tile.x0; x < tile.x1; x++) {
+			float u = (x + 0.5) / width;
+			Ray ray = scene.camera->getRay(u, v);
+			int pixel = (y - tile.y0) * tileWidth + x - tile.x0;
+			PrimaryHit hit;
+			glm::vec3 normal;
+			if (!traceHit<Features>(ray, tile, hit.point, normal, hit.color)) {
+				colors[pixel] = scene.background;
+				continue;
+			}
+			hit.norm = glm::normalize(normal);
+			hit.directionToCam = bPhong ? glm::normalize(scene.camera->position - hit.point) : glm::vec3(0);
+			hit.pixel = pixel;
+			hit.pixelSeed = y * width + x;
+			hits.push_back(hit);
+		}
+	}
+	if (hits.empty()) return;
+
+	// shadow rays, one light at a time
+	int lightCount = (int)compiled.lights.size();
+	vector<float> diffuseTerms(hits.size() * lightCount, 0.0f), specularTerms(hits.size() * lightCount, 0.0f);
+	// the hits in Morton order of their points, so rays from nearby points
+	//  are traced together
+	glm::vec3 boxSize = glm::max(tile.hitMax - tile.hitMin, glm::vec3(1e-20f));
+	vector<pair<uint32_t, int>> hitOrder(hits.size());
+	for (int h = 0; h < hits.size(); h++) {
+		glm::vec3 cell = (hits[h].point - tile.hitMin) * (511.0f / boxSize);
+		hitOrder[h].first = spreadBits9((uint32_t)cell.x) | (spreadBits9((uint32_t)cell.y) << 1) | (spreadBits9((uint32_t)cell.z) << 2);
+		hitOrder[h].second = h;
+	}
+	std::sort(hitOrder.begin(), hitOrder.end());
+	vector<ShadowRay> stream;
+	vector<uint8_t> octants;			// octant of each ray's direction
+	vector<int> order;					// rays by octant, each octant's in the hits' order
+	vector<bool> bBlocked;
+	for (int light = 0; light < lightCount; light++) {
+		const CompiledLight &source = compiled.lights[light];
+		bool bArea = source.boundingRadius > 0;
+		int samples = bArea ? std::max(1, scene.lightSamples) : 1;
+		int streamSamples = std::max(1, std::min(samples, maxStreamRays / (int)hits.size()));
+		for (int first = 0; first < samples; first += streamSamples) {
+			// emit the rays of every hit's next samples
+			int count = std::min(streamSamples, samples - first);
+			size_t rays = hits.size() * count;
+			stream.resize(rays);
+			octants.resize(rays);
+			int octantStart[9] = {};
+			for (int h = 0; h < hits.size(); h++) {
+				const PrimaryHit &hit = hits[h];
+				uint32_t seed = hashSeed(hashSeed(0, hit.pixelSeed), light);
+				for (int s = 0; s < count; s++) {
+					size_t r = (size_t)h * count + s;
+					ShadowRay &ray = stream[r];
+					ray.lightPoint = !bArea ? source.position :
+						compiled.sampleLight(source, getSample2D(scene.sampler, first + s, seed), hit.point);
+					ray.direction = glm::normalize(ray.lightPoint - hit.point);
+					octants[r] = (ray.direction.x < 0) | (ray.direction.y < 0) << 1 | (ray.direction.z < 0) << 2;
+					octantStart[octants[r] + 1]++;
+				}
+			}
+
+			// order them by octant (counting how many each has), then by hit
+			for (int o = 0; o < 8; o++) octantStart[o + 1] += octantStart[o];
+			order.resize(rays);
+			for (const pair<uint32_t, int> &next : hitOrder) {
+				for (int s = 0; s < count; s++) {
+					size_t r = (size_t)next.second * count + s;
+					order[octantStart[octants[r]]++] = (int)r;
+				}
+			}
+
+			// trace them in that order
+			bBlocked.assign(rays, false);
+			CompiledHit blocker;		// entry that blocked the previous ray (none if it was unblocked)
+			for (int r : order) {
+				const ShadowRay &ray = stream[r];
+				const PrimaryHit &hit = hits[r / count];
+				glm::vec3 shadowRayPt = hit.point + 0.0001f * hit.norm;
+				Ray shadowRay(shadowRayPt, ray.direction);
+				float tMax = glm::distance(shadowRayPt, ray.lightPoint) / glm::length(ray.direction);
+				bool bHit = (blocker.index >= 0 && compiled.occludedBy(shadowRay, tMax, blocker)) ||
+					compiled.occluded(shadowRay, tMax, &blocker);
+				if (!bHit) blocker.index = -1;
+				bBlocked[r] = bHit;
+			}
+
+			// sum the unblocked samples of every hit in sample order
+			for (int h = 0; h < hits.size(); h++) {
+				const PrimaryHit &hit = hits[h];
+				float &diffuseTerm = diffuseTerms[(size_t)h * lightCount + light];
+				float &specularTerm = specularTerms[(size_t)h * lightCount + light];
+				for (int s = 0; s < count; s++) {
+					size_t r = (size_t)h * count + s;
+					if (bBlocked[r]) continue;
+					float diffuse, specular;
+					sampleTerms<Features>(scene, source, stream[r].lightPoint, hit.point, hit.norm, hit.directionToCam,
+						stream[r].direction, diffuse, specular);
+					diffuseTerm += diffuse;
+					specularTerm += specular;
+				}
+			}
+		}
+		for (int h = 0; h < hits.size(); h++) {
+			diffuseTerms[(size_t)h * lightCount + light] /= samples;
+			specularTerms[(size_t)h * lightCount + light] /= samples;
+		}
+	}
+
+	// shade the hits as shade does
+	for (int h = 0; h < hits.size(); h++) {
+		const PrimaryHit &hit = hits[h];
+		ofColor result = (bPhong ? 0.15 : 0.25) * hit.color;
+		for (int light = 0; light < lightCount; light++) {
+			float diffuseTerm = diffuseTerms[(size_t)h * lightCount + light];
+			float specularTerm = specularTerms[(size_t)h * lightCount + light];
+			if (diffuseTerm > 0) result += hit.color * diffuseTerm;
+			if (bPhong && specularTerm > 0) result += ofColor::white * specularTerm;
+		}
+		colors[hit.pixel] = result;
+	}
+}
+
+//--------------------------------------------------------------
+// Checks for intersection between lights and other objects in scene
+bool Renderer::shadowCheck(const RenderScene &scene, const Ray &ray, glm::vec3 lightPosition) const
+{
+	// only hits between the ray's start and the light block it, and any one of them will do
+	return compiled.occluded(ray, glm::distance(ray.p, lightPosition) / glm::length(ray.d));
+}
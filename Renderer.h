@@ -0,0 +1,243 @@
+// This file provides the definitions of the RenderScene struct and the
+//  Renderer class, which ray traces a scene into an image tile by tile.
+// The renderer remembers the state of every object and light it traced,
+//  and for every tile the box around the surface points its pixels
+//  shaded. When it renders again, only tiles that a changed object could
+//  affect are traced again: tiles that the object's old or new box
+//  covers on screen, and tiles with surface points whose shadow rays
+//  could pass through either box. Nudging one joint of a rig then only
+//  re-traces the pixels around its meshes and their shadows. Changes to
+//  the camera, the lights, the image size or the shading settings (and
+//  to objects without bounds) re-trace every tile.
+// Tracing reads the objects and lights from a CompiledScene, which keeps
+//  them in flat arrays by kind and is recompiled incrementally before
+//  every render.
+// A render can be cancelled from another thread; the tiles it didn't
+//  reach stay stale and are traced by the next render.
+// Area lights are shaded with several shadow rays per light, aimed at
+//  points drawn from a low discrepancy sequence that every pixel
+//  scrambles with its own seed (see Sampler.h).
+// Pixels are shaded by kernels compiled for a set of features (see
+//  ShadingFeature). Compiling the scene picks the kernel with only the
+//  features the scene uses, so the loop over a tile's pixels doesn't test
+//  the shading settings and each kernel is optimized for its own case.
+// In wavefront mode a tile is traced in passes instead of pixel by pixel:
+//  the primary hits of all its pixels first, then the shadow rays of one
+//  light at a time, grouped by the octant of their direction and ordered
+//  along a Morton curve through their origins so consecutive rays visit
+//  the same objects and hierarchy nodes, and the shading last. Both modes
+//  shade every pixel exactly the same; benchmarkShadowStreams times them.
+
+#pragma once
+
+#include "ofMain.h"
+#include "SceneObjects.h"
+#include "Sampler.h"
+#include "CompiledScene.h"
+#include "Profiler.h"
+#include <atomic>
+#include <utility>
+
+class ImageStreamWriter;
+
+// shading models of the renderer
+enum ShadingModel { SHADING_LAMBERT, SHADING_PHONG };
+
+// ShadingFeature: code paths a shading kernel contains. A kernel with
+//  both SHADE_SMOOTH and SHADE_FLAT looks up each mesh's mode; with only
+//  one of them every mesh is shaded that way.
+enum ShadingFeature {
+	SHADE_SMOOTH = 1 << 0,			// meshes interpolate their vertex normals
+	SHADE_FLAT = 1 << 1,			// meshes use the normals of their faces
+	SHADE_TEXTURED = 1 << 2,		// planes look up their color in a texture
+	SHADE_PHONG = 1 << 3,			// phong highlights are added to lambert shading
+	SHADE_SHADOWS = 1 << 4,			// shadow rays test whether the light is blocked
+	SHADE_INTEGER_POWER = 1 << 5,	// the phong power is a whole number (multiplied out instead of calling pow)
+	SHADE_WAVEFRONT = 1 << 6,		// a tile's shadow rays are traced as sorted streams after its primary rays
+	SHADE_FEATURE_SETS = 1 << 7		// number of kernels
+};
+
+// RenderScene: everything the renderer reads
+//
+struct RenderScene {
+	const vector<SceneObject *> *objects = NULL;	// objects to render
+	const vector<Light *> *lights = NULL;			// lights shading them
+	RenderCam *camera = NULL;						// camera the image is seen from
+	float phongPower = 20;							// specular exponent of phong shading
+	ofColor background = ofColor::black;			// color of pixels that hit nothing
+	int lightSamples = 16;							// shadow rays per area light and shaded point
+	SamplerType sampler = SAMPLER_SOBOL;			// sequence the shadow rays are drawn from
+	ShadingModel shadingModel = SHADING_PHONG;		// lambert (diffuse only) or phong (diffuse and highlights)
+	bool bShadows = true;							// tracks whether objects cast shadows
+};
+
+// RenderTile: a rectangle of pixels traced together
+//
+struct RenderTile {
+	int x0, y0, x1, y1;					// pixels [x0, x1) x [y0, y1) of the image (row 0 is the top)
+	bool bAnyHit = false;				// tracks whether any pixel of the tile hit an object
+	bool bStale = true;					// set until the tile's pixels show the last rendered scene
+	glm::vec3 hitMin, hitMax;			// box around the surface points shaded in the tile
+};
+
+// Renderer class
+//
+class Renderer {
+public:
+	// Renders the scene into the image (allocated with the image's size),
+	//  re-tracing only the tiles that changed since the last render.
+	//  Returns the number of tiles traced (fewer than marked if bCancel
+	//  was set from another thread; the next render traces the rest).
+	int render(const RenderScene &scene, ofImage &image);
+
+	// Returns the fraction of the tiles marked by the render in progress
+	//  (or the last render) that were traced
+	float getProgress() const { return tilesMarked > 0 ? (float)tilesDone / tilesMarked : 1.0f; }
+
+	// Renders the scene into the writer (opened with the image size) band by
+	//  band and closes it, holding one band of pixels in memory. Doesn't
+	//  change what the next render() re-traces. Returns false if writing failed.
+	bool renderToWriter(const RenderScene &scene, ImageStreamWriter &writer);
+
+	// Brings the flat copy of the scene's objects and lights that tracing
+	//  reads up to date and picks the shading kernel for the scene
+	//  (render() and renderToWriter() call it; call it before calling
+	//  traceTile directly)
+	void compile(const RenderScene &scene);
+
+	// Returns the features of the kernel picked by the last compile
+	unsigned getShadingFeatures() const { return shadingFeatures; }
+
+	// Makes the next render trace every tile
+	void invalidate() { bValid = false; }
+
+	// Traces the pixels of a tile of a width x height image (resetting and
+	//  growing the tile's box of shaded points) and passes each pixel's
+	//  color to store(x, y, color)
+	template<class Store>
+	void traceTile(const RenderScene &scene, int width, int height, RenderTile &tile, Store store) const;
+
+	// checks ray fired from object to light for intersction with other SceneObjects before the light
+	bool shadowCheck(const RenderScene &scene, const Ray &ray, glm::vec3 lightPosition) const;
+
+	// Fields of Renderer class
+	//
+	int tileSize = 32;					// width and height of a tile in pixels
+	bool bSpecialize = true;			// picks the kernel with only the scene's features (else one that tests them per pixel)
+	bool bWavefront = false;			// traces a tile's shadow rays as sorted streams (else pixel by pixel)
+	CompiledScene compiled;				// the objects and lights as traced (see compile)
+	vector<RenderTile> tiles;			// tiles of the image, row by row
+	int tilesTraced = 0;				// number of tiles traced by the last render
+	double renderTime = 0;				// seconds taken by the last render
+	bool bComplete = false;				// tracks whether the last render traced every marked tile
+	std::atomic<bool> bCancel{false};	// stops the render in progress after the tiles being traced (left set until cleared)
+	std::atomic<int> tilesMarked{0};	// tiles marked and traced so far by the render in progress
+	std::atomic<int> tilesDone{0};
+
+private:
+	// state of an object when it was last traced
+	struct ObjectRecord {
+		bool bBounded;					// tracks whether the object had bounds
+		glm::vec3 boundsMin, boundsMax;	// world space box around the object
+		uint32_t revision;				// the object's revision
+		ofColor diffuse;				// the object's color
+		bool bSmooth;					// the object's shading mode
+		bool bSeen;						// marks objects still in the scene while comparing
+	};
+
+	// state of a light when it was last traced
+	struct LightRecord {
+		glm::vec3 position;
+		float intensity;
+		float boundingRadius;
+		uint32_t revision;					// area lights mark changes to their shape
+	};
+
+	// Returns true if the settings the whole image depends on changed
+	bool settingsChanged(const RenderScene &scene, const ofImage &image) const;
+
+	// Gets the pixels [x0, x1) x [y0, y1) whose rays could pass through the
+	//  box (returns false if the box reaches behind the camera)
+	static bool projectBounds(const RenderCam &camera, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+		int width, int height, int &x0, int &y0, int &x1, int &y1);
+
+	// Returns true if a shadow ray from the tile's surface points to the
+	//  light (a sphere of the given radius around its position) could pass
+	//  through the box
+	static bool shadowCouldCross(const RenderTile &tile, const glm::vec3 &light, float lightRadius,
+		const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+	bool bValid = false;								// false until a full render (and after invalidate)
+	unordered_map<uint64_t, ObjectRecord> records;		// objects traced by the last render, by serial
+	vector<LightRecord> lightRecords;					// lights of the last render
+	glm::vec3 cameraPosition;							// camera of the last render
+	glm::vec2 viewMin, viewMax;
+	float viewDepth;
+	int imageWidth = 0, imageHeight = 0;				// image size of the last render
+	float phongPower = 0;								// shading settings of the last render
+	ofColor background;
+	int lightSamples = 0;
+	SamplerType sampler = SAMPLER_SOBOL;
+	ShadingModel shadingModel = SHADING_PHONG;
+	bool bShadows = true;
+
+	// a kernel: traces the pixels of a tile into colors (row by row)
+	typedef void (Renderer::*TileKernel)(const RenderScene &scene, int width, int height, RenderTile &tile,
+		ofColor *colors) const;
+
+	// Returns the kernels of every set of features, indexed by the set
+	template<size_t... Features>
+	static const TileKernel *getTileKernels(std::index_sequence<Features...>);
+
+	// The kernel and the functions it inlines, compiled for a set of
+	//  features. traceHit finds the closest hit of a primary ray and its
+	//  point, normal and color, growing the tile's box of shaded points.
+	//  trace returns the color seen along a primary ray (the pixel seed
+	//  scrambles the pixel's light samples), shade adds lambert (and phong)
+	//  shading of every light to the ambient color, and gatherLight
+	//  averages the diffuse (normal . light) and phong (normal . bisector)^power
+	//  terms times the illumination over the unblocked samples of a light,
+	//  each sample's terms given by sampleTerms. traceWavefront traces a
+	//  tile in passes (see the top of the file).
+	template<unsigned Features>
+	void traceTileWith(const RenderScene &scene, int width, int height, RenderTile &tile, ofColor *colors) const;
+	template<unsigned Features>
+	bool traceHit(const Ray &ray, RenderTile &tile, glm::vec3 &point, glm::vec3 &normal, ofColor &color) const;
+	template<unsigned Features>
+	ofColor trace(const RenderScene &scene, const Ray &ray, RenderTile &tile, uint32_t pixelSeed) const;
+	template<unsigned Features>
+	glm::vec3 getNormal(const Ray &ray, const CompiledHit &hit) const;
+	template<unsigned Features>
+	ofColor shade(const RenderScene &scene, const Ray &ray, const glm::vec3 &point, const glm::vec3 &normal,
+		const ofColor diffuse, uint32_t pixelSeed) const;
+	template<unsigned Features>
+	void gatherLight(const RenderScene &scene, int light, const glm::vec3 &point, const glm::vec3 &norm,
+		const glm::vec3 &directionToCam, uint32_t pixelSeed, float &diffuseTerm, float &specularTerm) const;
+	template<unsigned Features>
+	void sampleTerms(const RenderScene &scene, const CompiledLight &source, const glm::vec3 &lightPoint, const glm::vec3 &point,
+		const glm::vec3 &norm, const glm::vec3 &directionToCam, const glm::vec3 &directionToLight, float &diffuse,
+		float &specular) const;
+	template<unsigned Features>
+	void traceWavefront(const RenderScene &scene, int width, int height, RenderTile &tile, ofColor *colors) const;
+
+	unsigned shadingFeatures = 0;						// features of the kernel picked by compile
+	TileKernel tileKernel = NULL;						// the kernel picked by compile
+	int integerPower = 0;								// the phong power if it is a whole number
+};
+
+//--------------------------------------------------------------
+// Traces the tile's pixels with the picked kernel, then stores them row by row
+template<class Store>
+void Renderer::traceTile(const RenderScene &scene, int width, int height, RenderTile &tile, Store store) const
+{
+	PROFILE_ZONE("Renderer::traceTile");
+	tile.bAnyHit = false;
+	tile.hitMin = glm::vec3(std::numeric_limits<float>::infinity());
+	tile.hitMax = -tile.hitMin;
+	int tileWidth = tile.x1 - tile.x0;
+	vector<ofColor> colors((size_t)tileWidth * (tile.y1 - tile.y0));
+	(this->*tileKernel)(scene, width, height, tile, colors.data());
+	for (int y = tile.y0; y < tile.y1; y++) {
+		for (int x = tile.x0; x < tile.x1; x++) store(x, y, colors[(size_t)(y - tile.y0) * tileWidth + x - tile.x0]);
+	}
+}
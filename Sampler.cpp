@@ -0,0 +1,109 @@
+// This file provides implementation of the sample sequences.
+
+#include "Sampler.h"
+
+//--------------------------------------------------------------
+// Reverses the order of the bits of x
+static inline uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+//--------------------------------------------------------------
+// Mixes the bits of x (a 32 bit integer hash)
+static inline uint32_t mixBits(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+//--------------------------------------------------------------
+// Returns a seed mixing a value into another seed
+uint32_t hashSeed(uint32_t seed, uint32_t value)
+{
+	return mixBits(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+//--------------------------------------------------------------
+// Permutes the bits of x so that every bit only depends on the bits
+//  below it (Laine and Karras). Applied to reversed bits, this is an
+//  Owen scramble: each digit is flipped depending on the digits above it.
+static inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+//--------------------------------------------------------------
+// Owen scrambles the digits of a 0.32 fixed point number
+static inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+	return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+//--------------------------------------------------------------
+// Returns the first dimension of the index-th Sobol point as a 0.32
+//  fixed point number (the van der Corput sequence)
+static inline uint32_t sobol0(uint32_t index)
+{
+	return reverseBits(index);
+}
+
+//--------------------------------------------------------------
+// Returns the second dimension of the index-th Sobol point (primitive
+//  polynomial x + 1, so each direction number is the previous one
+//  xor'ed with itself shifted right by one)
+static inline uint32_t sobol1(uint32_t index)
+{
+	uint32_t result = 0;
+	uint32_t direction = 0x80000000u;
+	for (; index != 0; index >>= 1) {
+		if (index & 1) result ^= direction;
+		direction ^= direction >> 1;
+	}
+	return result;
+}
+
+//--------------------------------------------------------------
+// Converts a 0.32 fixed point number to a float in [0, 1)
+static inline float toUnitFloat(uint32_t x)
+{
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+//--------------------------------------------------------------
+// Returns the index-th point of the sequence scrambled with the seed
+glm::vec2 getSample2D(SamplerType type, uint32_t index, uint32_t seed)
+{
+	if (type == SAMPLER_SOBOL) {
+		// shuffling the indices keeps every power of two prefix a (0, m, 2) net
+		uint32_t shuffled = nestedUniformScramble(index, seed);
+		return glm::vec2(toUnitFloat(nestedUniformScramble(sobol0(shuffled), hashSeed(seed, 1))),
+			toUnitFloat(nestedUniformScramble(sobol1(shuffled), hashSeed(seed, 2))));
+	}
+	// independent random points
+	uint32_t hash = hashSeed(seed, index);
+	return glm::vec2(toUnitFloat(mixBits(hash ^ 0x68bc21ebu)), toUnitFloat(mixBits(hash ^ 0x02e5be93u)));
+}
+
+//--------------------------------------------------------------
+// Returns the name of a sequence
+const char *getSamplerName(SamplerType type)
+{
+	switch (type) {
+	case SAMPLER_SOBOL: return "sobol";
+	default: return "white noise";
+	}
+}
@@ -0,0 +1,30 @@
+// This file provides the sample sequences used to estimate how much of
+//  an area light a surface point sees (soft shadows).
+// A sampler returns the i-th point of a 2D sequence in [0,1)^2 for a
+//  given seed. White noise hashes the index into independent random
+//  points; Sobol uses the first two dimensions of the Sobol sequence,
+//  whose first 2^k points stratify the square in every elementary
+//  interval, so a shadow estimate converges about as 1/N instead of
+//  1/sqrt(N). Each pixel (and each light) scrambles the Sobol points
+//  with its own seed (hash based Owen scrambling of the digits, and a
+//  shuffle of the indices), which keeps the stratification but
+//  decorrelates neighbouring pixels, so the remaining error looks like
+//  fine noise instead of banding. Samples only depend on the index and
+//  the seed, so renders are repeatable and tiles can be traced in any
+//  order.
+
+#pragma once
+
+#include "ofMain.h"
+
+// sequences a sampler can draw from
+enum SamplerType { SAMPLER_WHITE_NOISE, SAMPLER_SOBOL };
+
+// Returns the index-th point of the sequence scrambled with the seed
+glm::vec2 getSample2D(SamplerType type, uint32_t index, uint32_t seed);
+
+// Returns a seed mixing a value into another seed
+uint32_t hashSeed(uint32_t seed, uint32_t value);
+
+// Returns the name of a sequence
+const char *getSamplerName(SamplerType type);
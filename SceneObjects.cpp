@@ -1,5 +1,6 @@
 // The file provides implementations for methods utilized by
-//  the SceneObject, Plane, ViewPlane, and RenderCam classes.
+//  the SceneObject, Plane, Sphere, SphereLight, ViewPlane, and RenderCam
+//  classes.
 // - author: Jared Bechthold 
 // - starter files provided by Professor Kevin Smith
 
@@ -40,6 +41,107 @@ bool Plane::intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normalAtInt
 	return (insidePlane);
 }
 
+// Intersect Ray with Plane, recording the hit if it lies inside the
+// hit record's [tMin, tMax) interval
+bool Plane::intersect(const Ray &ray, HitRecord &hit) {
+	float dist;
+	if (!intersectPlane(ray, position, normal, width, height, hit.tMin, hit.tMax, dist)) return false;
+	hit.set(dist, this);
+	return true;
+}
+
+// Intersect Ray with the width x height part of the plane through
+// position, returning the distance if it lies inside [tMin, tMax)
+bool Plane::intersectPlane(const Ray &ray, const glm::vec3 &position, const glm::vec3 &normal, float width, float height,
+	float tMin, float tMax, float &t) {
+	// measures distance along the array
+	float dist;
+	if (!glm::intersectRayPlane(ray.p, ray.d, position, normal, dist)) return false;
+	// cull the hit before computing the point if it is outside the interval
+	if (dist < tMin || dist >= tMax) return false;
+	// determines if intersection point was within range of the Plane's dimensions
+	glm::vec3 point = ray.p + dist * ray.d;
+	if (point.x >= position.x + width / 2 || point.x <= position.x - width / 2 ||
+		point.z >= position.z + height / 2 || point.z <= position.z - height / 2) {
+		return false;
+	}
+	t = dist;
+	return true;
+}
+
+// Gets the box around the part of the Plane that intersect hits: the
+// x and z ranges given by width and height, and the heights of the
+// Plane at their corners (a Plane parallel to the y axis is unbounded)
+bool Plane::getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+	if (fabs(normal.y) < 1e-6) return false;
+	boundsMin = glm::vec3(std::numeric_limits<float>::infinity());
+	boundsMax = -boundsMin;
+	for (int corner = 0; corner < 4; corner++) {
+		float x = position.x + ((corner & 1) ? width / 2 : -width / 2);
+		float z = position.z + ((corner & 2) ? height / 2 : -height / 2);
+		// y such that (point - position) . normal = 0
+		float y = position.y - (normal.x * (x - position.x) + normal.z * (z - position.z)) / normal.y;
+		boundsMin = glm::min(boundsMin, glm::vec3(x, y, z));
+		boundsMax = glm::max(boundsMax, glm::vec3(x, y, z));
+	}
+	return true;
+}
+
+// Intersect Ray with Sphere, recording the nearest distance at which the
+// ray crosses the sphere inside the hit record's [tMin, tMax) interval
+// (the far crossing is used when the near one is culled, so rays starting
+// inside the sphere still hit it). The crossings are measured from the
+// ray's closest approach to the center, which stays accurate for grazing
+// rays and distant spheres.
+bool Sphere::intersect(const Ray &ray, HitRecord &hit) {
+	float t;
+	if (!intersectSphere(ray, getPosition(), radius, hit.tMin, hit.tMax, t)) return false;
+	hit.set(t, this);
+	return true;
+}
+
+// Intersect Ray with the sphere of the given center and radius, returning
+// the distance of the nearest crossing inside [tMin, tMax)
+bool Sphere::intersectSphere(const Ray &ray, const glm::vec3 &center, float radius, float tMin, float tMax, float &t) {
+	glm::vec3 offset = ray.p - center;
+	float a = glm::dot(ray.d, ray.d);
+	// distance along the ray to its closest approach, and the squared distance from there to the center
+	float tClosest = -glm::dot(offset, ray.d) / a;
+	glm::vec3 closest = offset + tClosest * ray.d;
+	float distanceSquared = glm::dot(closest, closest);
+	if (distanceSquared > radius * radius) return false;
+	float halfChord = sqrt((radius * radius - distanceSquared) / a);
+	t = tClosest - halfChord;
+	if (t < tMin) t = tClosest + halfChord;
+	return t >= tMin && t < tMax;
+}
+
+// Map the sample to the disk through the center of the SphereLight
+// facing the given point (concentric mapping, which keeps neighbouring
+// samples neighbours). Seen from a point, a sphere covers the same
+// directions as this disk, so shadows from it have the right penumbra.
+glm::vec3 SphereLight::sampleSphere(const glm::vec3 &position, float radius, const glm::vec2 &u, const glm::vec3 &from) {
+	if (radius <= 0) return position;
+	glm::vec2 offset = 2.0f * u - glm::vec2(1);
+	const float quarterPi = glm::pi<float>() / 4;
+	float r, phi;
+	if (offset.x == 0 && offset.y == 0) return position;
+	if (fabs(offset.x) > fabs(offset.y)) {
+		r = offset.x;
+		phi = quarterPi * (offset.y / offset.x);
+	}
+	else {
+		r = offset.y;
+		phi = 2 * quarterPi - quarterPi * (offset.x / offset.y);
+	}
+	// two axes perpendicular to the direction to the point
+	glm::vec3 axis = from - position;
+	float length = glm::length(axis);
+	axis = length > 0 ? axis / length : glm::vec3(0, 1, 0);
+	glm::vec3 tangent = glm::normalize(glm::cross(axis, fabs(axis.x) > 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0)));
+	glm::vec3 bitangent = glm::cross(axis, tangent);
+	return position + radius * r * (cos(phi) * tangent + sin(phi) * bitangent);
+}
 
 // Convert (u, v) to (x, y, z) 
 // We assume u,v is in [0, 1]
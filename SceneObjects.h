@@ -1,5 +1,6 @@
-// This file provides definitions for the Ray, SceneObject, Sphere,
-// Plane, ViewPlane, and RenderCam classes.
+// This file provides definitions for the Ray, HitRecord, SceneObject,
+// Sphere, Plane, Light, PointLight, SphereLight, RectLight, ViewPlane,
+// and RenderCam classes.
 // - author: Jared Bechthold 
 // - starter files provided by Professor Kevin Smith
 
@@ -8,6 +9,7 @@
 #include "ofMain.h"
 #include "glm/gtx/euler_angles.hpp"
 #include <glm/gtx/intersect.hpp>
+#include <atomic>
 
 //  General Purpose Ray class 
 //
@@ -33,16 +35,87 @@ public:
 	glm::vec3 p, d;
 };
 
+class SceneObject;
+
+//  Record of the closest hit found so far along a ray
+//	Objects only report hits with t in [tMin, tMax) and shrink tMax to
+//	every hit they report, so each object tested culls everything farther
+//	than the closest hit so far. Only what identifies the hit is stored;
+//	the point, normal, and color are computed from it once the closest
+//	hit is known (see SceneObject::getHitNormal).
+struct HitRecord {
+	float t = std::numeric_limits<float>::infinity();		// distance along the ray to the hit (in units of ray.d)
+	float tMin = 0;											// nearest distance accepted
+	float tMax = std::numeric_limits<float>::infinity();	// farthest distance accepted (the closest hit so far)
+	SceneObject *object = NULL;								// object hit (NULL if nothing was hit)
+	int primIndex = -1;										// primitive of the object hit (triangle of a mesh)
+	glm::vec2 bary = glm::vec2(0, 0);						// barycentric coordinates of the hit on the primitive
+
+	// records a hit at distance t and shrinks the interval to it
+	void set(float t, SceneObject *object, int primIndex = -1, glm::vec2 bary = glm::vec2(0, 0)) {
+		this->t = t;
+		tMax = t;
+		this->object = object;
+		this->primIndex = primIndex;
+		this->bary = bary;
+	}
+};
+
+//  Number naming one scene object for the life of the program
+//	Caches that outlive the objects they describe (the renderer's records,
+//	the compiled scene and the frozen copies) are keyed by it rather than
+//	by address: the object pools reuse the slots of destroyed objects, so
+//	a new object can take an old one's address, but never its serial. A
+//	copy of an object is a new object and gets a new serial; assigning
+//	one object to another keeps the target's.
+struct ObjectSerial {
+	ObjectSerial() : value(next()) {}
+	ObjectSerial(const ObjectSerial &) : value(next()) {}
+	ObjectSerial &operator=(const ObjectSerial &) { return *this; }
+	operator uint64_t() const { return value; }
+
+	const uint64_t value;
+
+private:
+	// hands out the serials in order (objects may be made on any thread)
+	static uint64_t next() {
+		static std::atomic<uint64_t> counter{ 0 };
+		return ++counter;
+	}
+};
+
 //  Base class for any renderable object in the scene
 //	(AKA SurfaceObject)
 class SceneObject {
 public:
+	// scene objects are deleted through base class pointers
+	virtual ~SceneObject() {}
+
 	// every SceneObject has draw() and intersect() methods to be overloaded
 	// pure virtual funcs - must be overloaded
 	// draws the scene object
 	virtual void draw() = 0;
 	// determines is ray intersects with scene object (to be overriden)
 	virtual bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) { cout << "SceneObject::intersect" << endl; return false; }
+	// records the hit in the record if the ray hits the object inside the record's [tMin, tMax)
+	//  (objects that don't override it fall back on the point and normal version)
+	virtual bool intersect(const Ray &ray, HitRecord &hit) {
+		glm::vec3 point, normal;
+		if (!intersect(ray, point, normal)) return false;
+		float t = glm::dot(point - ray.p, ray.d) / glm::dot(ray.d, ray.d);
+		if (t < hit.tMin || t >= hit.tMax) return false;
+		hit.set(t, this);
+		return true;
+	}
+	// returns the surface normal at a hit recorded by intersect(ray, hit)
+	virtual glm::vec3 getHitNormal(const Ray &ray, const HitRecord &hit) {
+		glm::vec3 point, normal;
+		intersect(ray, point, normal);
+		return normal;
+	}
+	// gets the world space box around everything the object renders
+	//  (returns false if the object is unbounded or its bounds are unknown)
+	virtual bool getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) { return false; }
 	// returns the color of the scene object
 	virtual ofColor getColor(glm::vec3 intersectPt) { return diffuseColor; }
 	// method to be overridden in the Joint/Mesh class to return the joint's/mesh's name
@@ -64,33 +137,44 @@ public:
 	}
 
 	// returns the matrix transformations exclusive to current scene object 
+	// (cached until position, rotation, scale, or pivot change)
 	glm::mat4 getLocalMatrix() {
-		// get the local transformations + pivot
-		//
-		glm::mat4 scale = getScaleMatrix();
-		glm::mat4 rotate = getRotateMatrix();
-		glm::mat4 trans = getTranslateMatrix();
-
-		// handle pivot point  (rotate around a point that is not the object's center)
-		//
-		glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-pivot.x, -pivot.y, -pivot.z));
-		glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(pivot.x, pivot.y, pivot.z));
-
-		return (trans * post * rotate * pre * scale);
+		// only rebuild the local matrix if a transformation changed since the last call
+		if (localDirty) {
+			// get the local transformations + pivot
+			//
+			glm::mat4 scale = getScaleMatrix();
+			glm::mat4 rotate = getRotateMatrix();
+			glm::mat4 trans = getTranslateMatrix();
+
+			// handle pivot point  (rotate around a point that is not the object's center)
+			//
+			glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-pivot.x, -pivot.y, -pivot.z));
+			glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(pivot.x, pivot.y, pivot.z));
+
+			localMatrix = (trans * post * rotate * pre * scale);
+			localDirty = false;
+		}
+		return localMatrix;
 	}
 
 	// returns complete set of current scene object's matrix transformations
 	// concatenated with parent's transformations
+	// (cached until this object or one of its ancestors is marked dirty)
 	glm::mat4 getMatrix() {
-
-		// if we have a parent (we are not the root),
-		// concatenate parent's transform (this is recursive)
-		// 
-		if (parent) {
-			glm::mat4 M = parent->getMatrix();
-			return (M * getLocalMatrix());
+		// only rebuild the world matrix if this object or an ancestor changed
+		if (worldDirty) {
+			// if we have a parent (we are not the root),
+			// concatenate parent's transform (this is recursive, but stops
+			// at the first ancestor whose cached matrix is still valid)
+			// 
+			if (parent) {
+				worldMatrix = parent->getMatrix() * getLocalMatrix();
+			}
+			else worldMatrix = getLocalMatrix();  // priority order is SRT
+			worldDirty = false;
 		}
-		else return getLocalMatrix();  // priority order is SRT
+		return worldMatrix;
 	}
 
 	// get current Position in World Space
@@ -102,26 +186,75 @@ public:
 	// set position (pos is in world space)
 	//
 	void setPosition(glm::vec3 pos) {
-		position = glm::inverse(getMatrix()) * glm::vec4(pos, 1.0);
+		setLocalPosition(glm::inverse(getMatrix()) * glm::vec4(pos, 1.0));
+	}
+
+	// setters for the local transformation fields
+	// these must be used instead of writing the fields directly so that
+	// the cached matrices of this object and its subtree are invalidated
+	//
+	void setLocalPosition(glm::vec3 p) {
+		if (p != position) { position = p; markLocalDirty(); }
+	}
+	void setRotation(glm::vec3 r) {
+		if (r != rotation) { rotation = r; markLocalDirty(); }
+	}
+	void setScale(glm::vec3 s) {
+		if (s != scale) { scale = s; markLocalDirty(); }
+	}
+	void setPivot(glm::vec3 p) {
+		if (p != pivot) { pivot = p; markLocalDirty(); }
+	}
+
+	// sets the parent pointer of this object (the parent's childList is
+	// maintained separately by addChild)
+	//
+	void setParent(SceneObject *newParent) {
+		parent = newParent;
+		markDirty();
+	}
+
+	// flags the local and world matrices of this object for recomputation
+	//
+	void markLocalDirty() {
+		localDirty = true;
+		markDirty();
+	}
+
+	// counts a change to how the object renders that its bounds and
+	// color may not show (so the renderer re-traces what it covers)
+	//
+	void markChanged() { revision++; }
+
+	// flags the world matrix of this object and its whole subtree for recomputation
+	// if this object is already dirty so is its subtree, so the walk stops early
+	//
+	void markDirty() {
+		revision++;
+		if (worldDirty) return;
+		worldDirty = true;
+		for (int i = 0; i < childList.size(); i++) {
+			childList[i]->markDirty();
+		}
 	}
 
 	// resets SceneObjects position/orientation matrices back to default
 	//
 	void resetMatrices() {
-		position = glm::vec3(0, 0, 0);
-		rotation = glm::vec3(0, 0, 0);
-		scale = glm::vec3(1, 1, 1);
+		setLocalPosition(glm::vec3(0, 0, 0));
+		setRotation(glm::vec3(0, 0, 0));
+		setScale(glm::vec3(1, 1, 1));
 	}
 
 	// return a rotation  matrix that rotates one vector to another
 	//
-	glm::mat4 rotateToVector(glm::vec3 v1, glm::vec3 v2);
+	static glm::mat4 rotateToVector(glm::vec3 v1, glm::vec3 v2);
 
 	//  Hierarchy 
 	//
 	void addChild(SceneObject *child) {
 		childList.push_back(child);
-		child->parent = this;
+		child->setParent(this);
 	}
 
 	// hierachy implementation: each scene object (that is not a root)
@@ -130,6 +263,7 @@ public:
 	vector<SceneObject *> childList;
 
 	// position/orientation of scene object
+	// (read freely, but write through the setters above to keep the caches valid)
 	glm::vec3 position = glm::vec3(0, 0, 0);   // translate
 	glm::vec3 rotation = glm::vec3(0, 0, 0);   // rotate
 	glm::vec3 scale = glm::vec3(1, 1, 1);      // scale
@@ -138,6 +272,16 @@ public:
 	//
 	glm::vec3 pivot = glm::vec3(0, 0, 0);
 
+	// cached transformation matrices and the flags that mark them stale
+	//
+	glm::mat4 localMatrix = glm::mat4(1.0);
+	glm::mat4 worldMatrix = glm::mat4(1.0);
+	bool localDirty = true;
+	bool worldDirty = true;
+
+	// incremented whenever the object's placement or shape changes (see markChanged)
+	uint32_t revision = 0;
+
 	// material properties (we will ultimately replace this with a Material class - TBD)
 	//
 	ofColor diffuseColor = ofColor::grey;    // default colors - can be changed.
@@ -152,6 +296,12 @@ public:
 
 	// default name of a scene object
 	string name = "SceneObject";
+
+	// ID given by the SceneRegistry the object is registered with (-1 if none)
+	int id = -1;
+
+	// never reused, unlike the object's address (see ObjectSerial)
+	ObjectSerial serial;
 };
 
 //  General purpose sphere  (assume parametric)
@@ -167,6 +317,20 @@ public:
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 		return (glm::intersectRaySphere(ray.p, ray.d, this->getPosition(), radius, point, normal));
 	}
+	// records the nearer root of the ray/sphere quadratic that lies inside the hit record's interval
+	bool intersect(const Ray &ray, HitRecord &hit);
+	// gets the distance to the nearer crossing of a sphere inside [tMin, tMax) (shared with compiled scenes)
+	static bool intersectSphere(const Ray &ray, const glm::vec3 &center, float radius, float tMin, float tMax, float &t);
+	// returns the normal of the Sphere at the hit point
+	glm::vec3 getHitNormal(const Ray &ray, const HitRecord &hit) {
+		return glm::normalize(ray.p + hit.t * ray.d - getPosition());
+	}
+	// gets the box around the Sphere
+	bool getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		boundsMin = getPosition() - glm::vec3(radius);
+		boundsMax = getPosition() + glm::vec3(radius);
+		return true;
+	}
 
 	// draws the Sphere
 	void draw() {
@@ -220,12 +384,14 @@ public:
 	void applyTexture(ofImage textureToApply) {
 		textureImg = textureToApply;
 		textureApplied = true;
+		markChanged();
 	}
 
 	// sets amount of tiles in x and y direction for texture mapping
 	void setTiles(int x, int y) {
 		tilesX = x;
 		tilesY = y;
+		markChanged();
 	}
 
 	// overrdes getColor to handle textureMapping
@@ -264,6 +430,16 @@ public:
 
 	// tests for intersection of Plane with a Ray
 	bool intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normal);
+	// records the intersection of Plane with a Ray if it lies inside the hit record's interval
+	bool intersect(const Ray &ray, HitRecord &hit);
+	// gets the distance to the intersection of a plane's width x height part inside [tMin, tMax)
+	//  (shared with compiled scenes)
+	static bool intersectPlane(const Ray &ray, const glm::vec3 &position, const glm::vec3 &normal, float width, float height,
+		float tMin, float tMax, float &t);
+	// returns the Plane's normal at the hit point
+	glm::vec3 getHitNormal(const Ray &ray, const HitRecord &hit) { return this->normal; }
+	// gets the box around the part of the Plane that intersect hits
+	bool getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax);
 	// returns the Plane's normal
 	glm::vec3 getNormal(const glm::vec3 &p) { return this->normal; }
 	// draws the Plane
@@ -297,6 +473,122 @@ public:
 	int tilesY = 10;
 };
 
+// Base Light class
+//
+class Light : public SceneObject {
+public:
+	// Sets intensity of light
+	void setIntensity(float newIntensity) {
+		intensity = newIntensity;
+	}
+
+	// Returns the point of the light that a shadow ray from the given point
+	//  aims at for the sample u in [0,1)^2 (a point light is a single point)
+	virtual glm::vec3 samplePoint(const glm::vec2 &u, const glm::vec3 &from) const { return position; }
+
+	// Returns the radius of the sphere around position that holds every
+	//  point of the light (0 for lights that are a single point)
+	virtual float getBoundingRadius() const { return 0; }
+
+	// Tracks light intensity
+	float intensity;
+};
+
+// Point Light class
+//
+class PointLight : public Light {
+public:
+	// PointLight constructor
+	PointLight(glm::vec3 position, float intensity, float radius, ofColor diffuse = ofColor::white) {
+		this->position = position;
+		this->intensity = intensity;
+		this->radius = radius;
+		this->diffuseColor = diffuse;
+	}
+
+	// Draws the Sphere representing the light
+	void draw() {
+		ofNoFill();
+		ofSetColor(diffuseColor);
+		ofDrawSphere(position, radius);
+	}
+
+	// Tracks size of drawble light
+	float radius;
+};
+
+// Sphere Light class: a light that emits from a ball, seen from a
+//  surface point as a disk facing it
+//
+class SphereLight : public Light {
+public:
+	// SphereLight constructor (a radius of 0 makes it a point light)
+	SphereLight(glm::vec3 position, float intensity, float radius, ofColor diffuse = ofColor::white) {
+		this->position = position;
+		this->intensity = intensity;
+		this->radius = radius;
+		this->diffuseColor = diffuse;
+	}
+
+	// Returns a point on the disk of the sphere facing the given point
+	glm::vec3 samplePoint(const glm::vec2 &u, const glm::vec3 &from) const { return sampleSphere(position, radius, u, from); }
+	float getBoundingRadius() const { return radius; }
+	// Returns the point for the sample u of a sphere light of the given center and radius
+	static glm::vec3 sampleSphere(const glm::vec3 &position, float radius, const glm::vec2 &u, const glm::vec3 &from);
+
+	// Draws the Sphere representing the light
+	void draw() {
+		ofNoFill();
+		ofSetColor(diffuseColor);
+		ofDrawSphere(position, std::max(radius, 0.1f));
+	}
+
+	// Tracks radius of the emitting sphere
+	float radius;
+};
+
+// Rectangle Light class: a light that emits from a parallelogram
+//  centered on position, spanned by two edges
+//
+class RectLight : public Light {
+public:
+	// RectLight constructor
+	RectLight(glm::vec3 position, float intensity, glm::vec3 edgeU, glm::vec3 edgeV, ofColor diffuse = ofColor::white) {
+		this->position = position;
+		this->intensity = intensity;
+		this->edgeU = edgeU;
+		this->edgeV = edgeV;
+		this->diffuseColor = diffuse;
+	}
+
+	// Returns the point of the rectangle at u
+	glm::vec3 samplePoint(const glm::vec2 &u, const glm::vec3 &from) const { return sampleRect(position, edgeU, edgeV, u); }
+	// Returns the point at u of the rectangle with the given center and edges
+	static glm::vec3 sampleRect(const glm::vec3 &position, const glm::vec3 &edgeU, const glm::vec3 &edgeV, const glm::vec2 &u) {
+		return position + (u.x - 0.5f) * edgeU + (u.y - 0.5f) * edgeV;
+	}
+	// the corners are half a diagonal away from the center
+	float getBoundingRadius() const { return 0.5f * std::max(glm::length(edgeU + edgeV), glm::length(edgeU - edgeV)); }
+
+	// Draws the outline of the rectangle (a small sphere while it has no size)
+	void draw() {
+		ofSetColor(diffuseColor);
+		if (getBoundingRadius() <= 0) {
+			ofNoFill();
+			ofDrawSphere(position, 0.1);
+			return;
+		}
+		glm::vec3 corner = position - 0.5f * edgeU - 0.5f * edgeV;
+		ofDrawLine(corner, corner + edgeU);
+		ofDrawLine(corner + edgeU, corner + edgeU + edgeV);
+		ofDrawLine(corner + edgeU + edgeV, corner + edgeV);
+		ofDrawLine(corner + edgeV, corner);
+	}
+
+	// Tracks the edges of the rectangle
+	glm::vec3 edgeU, edgeV;
+};
+
 // view plane for render camera
 // 
 class  ViewPlane : public Plane {
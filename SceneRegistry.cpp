@@ -0,0 +1,65 @@
+// This file provides implementation of the SceneRegistry class methods.
+
+#include "SceneRegistry.h"
+#include "SceneObjects.h"
+
+//--------------------------------------------------------------
+// Registers the object under the next ID
+int SceneRegistry::add(SceneObject *object)
+{
+	object->id = (int)objects.size();
+	objects.push_back(object);
+	ids[object->getName()].push_back(object->id);
+	count++;
+	return object->id;
+}
+
+//--------------------------------------------------------------
+// Clears the object's slot and index entry
+void SceneRegistry::remove(SceneObject *object)
+{
+	if (get(object->id) != object) return;
+	unindex(object->getName(), object->id);
+	objects[object->id] = NULL;
+	object->id = -1;
+	count--;
+}
+
+//--------------------------------------------------------------
+// Forgets every object
+void SceneRegistry::clear()
+{
+	for (int i = 0; i < objects.size(); i++) {
+		if (objects[i]) objects[i]->id = -1;
+	}
+	objects.clear();
+	ids.clear();
+	count = 0;
+}
+
+//--------------------------------------------------------------
+// Looks the name up in the hash index
+SceneObject *SceneRegistry::find(const string &name) const
+{
+	auto found = ids.find(name);
+	return found != ids.end() ? objects[found->second.back()] : NULL;
+}
+
+//--------------------------------------------------------------
+// Returns the object in the ID's slot
+SceneObject *SceneRegistry::get(int id) const
+{
+	return (id >= 0 && id < objects.size()) ? objects[id] : NULL;
+}
+
+//--------------------------------------------------------------
+// Removes the ID from the name's entry, dropping the name once no
+//  object holds it (the name then refers to the latest object left)
+void SceneRegistry::unindex(const string &name, int id)
+{
+	auto found = ids.find(name);
+	if (found == ids.end()) return;
+	vector<int> &holders = found->second;
+	holders.erase(std::remove(holders.begin(), holders.end(), id), holders.end());
+	if (holders.empty()) ids.erase(found);
+}
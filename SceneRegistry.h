@@ -0,0 +1,55 @@
+// This file provides the definition of the SceneRegistry class, which
+//  gives scene objects stable integer IDs and finds them by name.
+// IDs are handed out in order and never reused, so an ID stays valid
+//  (and keeps naming the same object) until the object is removed.
+//  Names are kept in a hash index that is updated on add and remove, so
+//  looking an object up by name takes constant time instead of a scan
+//  over every object. Objects are named before they are registered and
+//  keep their names while registered.
+// A name held by several objects refers to the one registered last;
+//  once that one is removed, to the latest of the others. Skeleton
+//  follows the same rule for repeated joint names.
+
+#pragma once
+
+#include "ofMain.h"
+#include <unordered_map>
+
+class SceneObject;
+
+// SceneRegistry class
+//
+class SceneRegistry {
+public:
+	// Registers the object under its current name and stores its new ID in
+	//  object->id. Returns the ID. If another object already has the name,
+	//  lookups by that name return this one from now on.
+	int add(SceneObject *object);
+
+	// Unregisters the object (its ID is not handed out again)
+	void remove(SceneObject *object);
+
+	// Unregisters every object and starts handing out IDs from 0 again
+	void clear();
+
+	// Returns the object with the given name or ID (NULL if there is none)
+	SceneObject *find(const string &name) const;
+	SceneObject *get(int id) const;
+
+	// Returns true if an object with the given name is registered
+	bool contains(const string &name) const { return ids.count(name) > 0; }
+
+	// Returns the number of registered objects
+	int size() const { return count; }
+
+	// Fields of SceneRegistry class
+	//
+	vector<SceneObject *> objects;			// object of every ID (NULL once removed)
+	unordered_map<string, vector<int>> ids;	// IDs of the objects holding each name, in the order registered
+
+private:
+	// Removes the ID from the name's entry in the index
+	void unindex(const string &name, int id);
+
+	int count = 0;							// number of registered objects
+};
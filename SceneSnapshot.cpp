@@ -0,0 +1,472 @@
+// This file provides implementation of the SceneSnapshot class methods.
+
+#include "SceneSnapshot.h"
+#include "ofApp.h"
+
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+// kinds of objects and lights in a snapshot
+enum SnapshotObjectType { SNAPSHOT_SPHERE, SNAPSHOT_PLANE, SNAPSHOT_MESH };
+enum SnapshotLightType { SNAPSHOT_POINT_LIGHT, SNAPSHOT_SPHERE_LIGHT, SNAPSHOT_RECT_LIGHT };
+
+//--------------------------------------------------------------
+// Appends the bytes of a value to the buffer
+template<class T>
+static void put(vector<char> &buffer, const T &value)
+{
+	const char *bytes = (const char *)&value;
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+//--------------------------------------------------------------
+// Appends a color as four floats (so the layout doesn't depend on
+//  the type of ofColor's channels)
+static void putColor(vector<char> &buffer, const ofColor &color)
+{
+	put(buffer, (float)color.r);
+	put(buffer, (float)color.g);
+	put(buffer, (float)color.b);
+	put(buffer, (float)color.a);
+}
+
+//--------------------------------------------------------------
+// Appends a vector of values, preceded by its size
+template<class T>
+static void putArray(vector<char> &buffer, const vector<T> &values)
+{
+	put(buffer, (uint32_t)values.size());
+	const char *bytes = (const char *)values.data();
+	buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+// SnapshotReader: reads values back in order, failing (and staying
+//  failed) instead of reading past the end
+//
+struct SnapshotReader {
+	const vector<char> &buffer;
+	size_t offset = 0;
+	bool bFailed = false;
+
+	SnapshotReader(const vector<char> &b) : buffer(b) {}
+
+	bool getBytes(void *data, size_t size) {
+		if (bFailed || size > buffer.size() - offset) {
+			bFailed = true;
+			return false;
+		}
+		memcpy(data, buffer.data() + offset, size);
+		offset += size;
+		return true;
+	}
+
+	template<class T>
+	T get() {
+		T value = T();
+		getBytes(&value, sizeof(T));
+		return value;
+	}
+
+	ofColor getColor() {
+		float channels[4] = { 0, 0, 0, 255 };
+		getBytes(channels, sizeof(channels));
+		return ofColor(channels[0], channels[1], channels[2], channels[3]);
+	}
+
+	template<class T>
+	bool getArray(vector<T> &values) {
+		uint32_t count = get<uint32_t>();
+		if (bFailed || count > (buffer.size() - offset) / sizeof(T)) {
+			bFailed = true;
+			return false;
+		}
+		values.resize(count);
+		return getBytes(values.data(), count * sizeof(T));
+	}
+};
+
+//--------------------------------------------------------------
+SceneSnapshot::SceneSnapshot()
+{
+}
+
+//--------------------------------------------------------------
+SceneSnapshot::~SceneSnapshot()
+{
+	clear();
+}
+
+//--------------------------------------------------------------
+// Frees the rebuilt objects, lights and meshes
+void SceneSnapshot::clear()
+{
+	for (int i = 0; i < objects.size(); i++) delete objects[i];
+	for (int i = 0; i < lights.size(); i++) delete lights[i];
+	for (int i = 0; i < meshes.size(); i++) delete meshes[i];
+	objects.clear();
+	lights.clear();
+	meshes.clear();
+}
+
+//--------------------------------------------------------------
+// Writes the header, settings and camera, then the table of meshes
+//  used by the scene, the objects and the lights
+void SceneSnapshot::write(const RenderScene &scene, int width, int height, vector<char> &buffer)
+{
+	buffer.clear();
+	buffer.insert(buffer.end(), { 'M', 'A', 'S', 'N' });
+	put(buffer, SNAPSHOT_VERSION);
+	put(buffer, (uint32_t)width);
+	put(buffer, (uint32_t)height);
+
+	// settings and camera
+	put(buffer, scene.phongPower);
+	putColor(buffer, scene.background);
+	put(buffer, (int32_t)scene.lightSamples);
+	put(buffer, (int32_t)scene.sampler);
+	put(buffer, (int32_t)scene.shadingModel);
+	put(buffer, (uint8_t)scene.bShadows);
+	const RenderCam &camera = *scene.camera;
+	put(buffer, camera.position);
+	put(buffer, camera.view.min);
+	put(buffer, camera.view.max);
+	put(buffer, camera.view.position);
+
+	// every mesh once, whether it is placed by itself or by instances
+	const vector<SceneObject *> &sceneObjects = *scene.objects;
+	vector<Mesh *> tableMeshes;
+	unordered_map<Mesh *, uint32_t> tableIndex;
+	for (int k = 0; k < sceneObjects.size(); k++) {
+		Mesh *mesh = dynamic_cast<Mesh *>(sceneObjects[k]);
+		if (MeshInstance *instance = dynamic_cast<MeshInstance *>(sceneObjects[k])) mesh = instance->mesh;
+		if (mesh != NULL && tableIndex.find(mesh) == tableIndex.end()) {
+			tableIndex[mesh] = (uint32_t)tableMeshes.size();
+			tableMeshes.push_back(mesh);
+		}
+	}
+	put(buffer, (uint32_t)tableMeshes.size());
+	for (int m = 0; m < tableMeshes.size(); m++) {
+		const Mesh &mesh = *tableMeshes[m];
+		putArray(buffer, mesh.verts);
+		putArray(buffer, mesh.nVerts);
+		put(buffer, (uint32_t)mesh.triangles.size());
+		for (int i = 0; i < mesh.triangles.size(); i++) {
+			const Triangle &triangle = mesh.triangles[i];
+			for (int v = 0; v < 3; v++) put(buffer, (int32_t)triangle.vertInd[v]);
+			for (int v = 0; v < 3; v++) put(buffer, (int32_t)triangle.nVertInd[v]);
+		}
+		put(buffer, (uint8_t)mesh.smoothShading);
+	}
+
+	// objects (the count is patched once the skipped objects are known)
+	size_t countOffset = buffer.size();
+	uint32_t objectCount = 0;
+	put(buffer, objectCount);
+	for (int k = 0; k < sceneObjects.size(); k++) {
+		SceneObject *object = sceneObjects[k];
+		MeshInstance *instance = dynamic_cast<MeshInstance *>(object);
+		Mesh *mesh = dynamic_cast<Mesh *>(object);
+		Plane *plane = dynamic_cast<Plane *>(object);
+		Sphere *sphere = dynamic_cast<Sphere *>(object);
+		if (instance == NULL && mesh == NULL && plane == NULL && sphere == NULL) {
+			cout << "Snapshot skips " << object->getName() << ", an object it can't store" << endl;
+			continue;
+		}
+		uint32_t type = (instance || mesh) ? SNAPSHOT_MESH : plane ? SNAPSHOT_PLANE : SNAPSHOT_SPHERE;
+		put(buffer, type);
+		putColor(buffer, object->diffuseColor);
+		put(buffer, (uint8_t)object->smoothShading);
+		if (instance) {
+			put(buffer, tableIndex[instance->mesh]);
+			put(buffer, instance->transform);
+		}
+		else if (mesh) {
+			put(buffer, tableIndex[mesh]);
+			put(buffer, mesh->meshTransMatrix);
+		}
+		else if (plane) {
+			put(buffer, plane->position);
+			put(buffer, plane->normal);
+			put(buffer, plane->width);
+			put(buffer, plane->height);
+			put(buffer, (int32_t)plane->tilesX);
+			put(buffer, (int32_t)plane->tilesY);
+			put(buffer, (uint8_t)plane->textureApplied);
+			if (plane->textureApplied) {
+				uint32_t textureWidth = (uint32_t)plane->textureImg.getWidth();
+				uint32_t textureHeight = (uint32_t)plane->textureImg.getHeight();
+				put(buffer, textureWidth);
+				put(buffer, textureHeight);
+				for (uint32_t y = 0; y < textureHeight; y++) {
+					for (uint32_t x = 0; x < textureWidth; x++) {
+						ofColor color = plane->textureImg.getColor(x, y);
+						buffer.push_back((char)(unsigned char)color.r);
+						buffer.push_back((char)(unsigned char)color.g);
+						buffer.push_back((char)(unsigned char)color.b);
+					}
+				}
+			}
+		}
+		else {
+			put(buffer, sphere->getPosition());
+			put(buffer, sphere->radius);
+		}
+		objectCount++;
+	}
+	memcpy(buffer.data() + countOffset, &objectCount, sizeof(objectCount));
+
+	// lights
+	const vector<Light *> &sceneLights = *scene.lights;
+	put(buffer, (uint32_t)sceneLights.size());
+	for (int i = 0; i < sceneLights.size(); i++) {
+		const Light *light = sceneLights[i];
+		const SphereLight *sphereLight = dynamic_cast<const SphereLight *>(light);
+		const RectLight *rectLight = dynamic_cast<const RectLight *>(light);
+		uint32_t type = sphereLight ? SNAPSHOT_SPHERE_LIGHT : rectLight ? SNAPSHOT_RECT_LIGHT : SNAPSHOT_POINT_LIGHT;
+		put(buffer, type);
+		put(buffer, light->position);
+		put(buffer, light->intensity);
+		putColor(buffer, light->diffuseColor);
+		if (sphereLight) {
+			put(buffer, sphereLight->radius);
+		}
+		else if (rectLight) {
+			put(buffer, rectLight->edgeU);
+			put(buffer, rectLight->edgeV);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Checks the magic and version and reads the size that follows them
+bool SceneSnapshot::readImageSize(const vector<char> &buffer, int &width, int &height)
+{
+	SnapshotReader reader(buffer);
+	char magic[4];
+	if (!reader.getBytes(magic, 4) || memcmp(magic, "MASN", 4) != 0 || reader.get<uint32_t>() != SNAPSHOT_VERSION) {
+		return false;
+	}
+	width = (int)reader.get<uint32_t>();
+	height = (int)reader.get<uint32_t>();
+	return !reader.bFailed && width > 0 && height > 0;
+}
+
+//--------------------------------------------------------------
+// Reads the snapshot back in the order write wrote it, rebuilding
+//  each mesh's hierarchy once
+bool SceneSnapshot::read(const vector<char> &buffer)
+{
+	clear();
+	SnapshotReader reader(buffer);
+	char magic[4];
+	if (!reader.getBytes(magic, 4) || memcmp(magic, "MASN", 4) != 0 || reader.get<uint32_t>() != SNAPSHOT_VERSION) {
+		cout << "Scene snapshot is corrupt" << endl;
+		return false;
+	}
+	width = (int)reader.get<uint32_t>();
+	height = (int)reader.get<uint32_t>();
+
+	// settings and camera
+	phongPower = reader.get<float>();
+	background = reader.getColor();
+	lightSamples = reader.get<int32_t>();
+	sampler = (SamplerType)reader.get<int32_t>();
+	shadingModel = (ShadingModel)reader.get<int32_t>();
+	bShadows = reader.get<uint8_t>() != 0;
+	camera.position = reader.get<glm::vec3>();
+	camera.view.min = reader.get<glm::vec2>();
+	camera.view.max = reader.get<glm::vec2>();
+	camera.view.position = reader.get<glm::vec3>();
+
+	// meshes
+	uint32_t meshCount = reader.get<uint32_t>();
+	for (uint32_t m = 0; m < meshCount && !reader.bFailed; m++) {
+		Mesh *mesh = new Mesh();
+		meshes.push_back(mesh);
+		reader.getArray(mesh->verts);
+		reader.getArray(mesh->nVerts);
+		uint32_t triangleCount = reader.get<uint32_t>();
+		if (reader.bFailed || triangleCount > (buffer.size() - reader.offset) / (6 * sizeof(int32_t))) {
+			reader.bFailed = true;
+			break;
+		}
+		mesh->triangles.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			Triangle &triangle = mesh->triangles[i];
+			for (int v = 0; v < 3; v++) triangle.vertInd[v] = reader.get<int32_t>();
+			for (int v = 0; v < 3; v++) triangle.nVertInd[v] = reader.get<int32_t>();
+			for (int v = 0; v < 3; v++) {
+				if (triangle.vertInd[v] < 0 || triangle.vertInd[v] >= mesh->verts.size() ||
+					triangle.nVertInd[v] < 0 || triangle.nVertInd[v] >= mesh->nVerts.size()) {
+					reader.bFailed = true;
+				}
+			}
+		}
+		mesh->smoothShading = reader.get<uint8_t>() != 0;
+		if (!reader.bFailed) mesh->buildBVH();
+	}
+
+	// objects
+	uint32_t objectCount = reader.get<uint32_t>();
+	for (uint32_t k = 0; k < objectCount && !reader.bFailed; k++) {
+		uint32_t type = reader.get<uint32_t>();
+		ofColor color = reader.getColor();
+		bool bSmooth = reader.get<uint8_t>() != 0;
+		SceneObject *object = NULL;
+		if (type == SNAPSHOT_MESH) {
+			uint32_t mesh = reader.get<uint32_t>();
+			glm::mat4 transform = reader.get<glm::mat4>();
+			if (mesh >= meshes.size()) break;
+			MeshInstance *instance = new MeshInstance(meshes[mesh], "placement");
+			instance->setTransform(transform);
+			object = instance;
+		}
+		else if (type == SNAPSHOT_PLANE) {
+			glm::vec3 position = reader.get<glm::vec3>();
+			glm::vec3 normal = reader.get<glm::vec3>();
+			float planeWidth = reader.get<float>();
+			float planeHeight = reader.get<float>();
+			Plane *plane = new Plane(position, normal, color, planeWidth, planeHeight);
+			object = plane;
+			int tilesX = reader.get<int32_t>();
+			int tilesY = reader.get<int32_t>();
+			plane->setTiles(tilesX, tilesY);
+			if (reader.get<uint8_t>() != 0) {
+				uint32_t textureWidth = reader.get<uint32_t>();
+				uint32_t textureHeight = reader.get<uint32_t>();
+				if (reader.bFailed || textureWidth == 0 || textureHeight == 0 ||
+					(size_t)textureWidth * textureHeight * 3 > buffer.size() - reader.offset) {
+					delete plane;
+					break;
+				}
+				// snapshots are read by processes without a GL context, so the
+				//  texture (and the plane's copy of it) mustn't create a GL texture
+				ofImage texture;
+				texture.setUseTexture(false);
+				texture.allocate(textureWidth, textureHeight, OF_IMAGE_COLOR);
+				const unsigned char *pixels = (const unsigned char *)buffer.data() + reader.offset;
+				for (uint32_t y = 0; y < textureHeight; y++) {
+					for (uint32_t x = 0; x < textureWidth; x++, pixels += 3) {
+						texture.setColor(x, y, ofColor(pixels[0], pixels[1], pixels[2]));
+					}
+				}
+				reader.offset += (size_t)textureWidth * textureHeight * 3;
+				plane->applyTexture(texture);
+			}
+		}
+		else if (type == SNAPSHOT_SPHERE) {
+			glm::vec3 center = reader.get<glm::vec3>();
+			float radius = reader.get<float>();
+			object = new Sphere(center, radius, color);
+		}
+		else {
+			break;
+		}
+		object->diffuseColor = color;
+		object->smoothShading = bSmooth;
+		objects.push_back(object);
+	}
+	if (objects.size() != objectCount) reader.bFailed = true;
+
+	// lights
+	uint32_t lightCount = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < lightCount && !reader.bFailed; i++) {
+		uint32_t type = reader.get<uint32_t>();
+		glm::vec3 position = reader.get<glm::vec3>();
+		float intensity = reader.get<float>();
+		ofColor color = reader.getColor();
+		if (type == SNAPSHOT_SPHERE_LIGHT) {
+			float radius = reader.get<float>();
+			lights.push_back(new SphereLight(position, intensity, radius, color));
+		}
+		else if (type == SNAPSHOT_RECT_LIGHT) {
+			glm::vec3 edgeU = reader.get<glm::vec3>();
+			glm::vec3 edgeV = reader.get<glm::vec3>();
+			lights.push_back(new RectLight(position, intensity, edgeU, edgeV, color));
+		}
+		else if (type == SNAPSHOT_POINT_LIGHT) {
+			lights.push_back(new PointLight(position, intensity, 0.1, color));
+		}
+		else {
+			reader.bFailed = true;
+		}
+	}
+
+	if (reader.bFailed || reader.offset != buffer.size() || width <= 0 || height <= 0) {
+		cout << "Scene snapshot is corrupt" << endl;
+		clear();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+// Returns the rebuilt scene (it points into the snapshot)
+RenderScene SceneSnapshot::getScene()
+{
+	RenderScene scene;
+	scene.objects = &objects;
+	scene.lights = &lights;
+	scene.camera = &camera;
+	scene.phongPower = phongPower;
+	scene.background = background;
+	scene.lightSamples = lightSamples;
+	scene.sampler = sampler;
+	scene.shadingModel = shadingModel;
+	scene.bShadows = bShadows;
+	return scene;
+}
+
+//--------------------------------------------------------------
+// Writes a buffer to a file
+bool saveSnapshotFile(const string &fileName, const vector<char> &buffer)
+{
+	ofstream outputStream(fileName, ios::binary);
+	if (!outputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	outputStream.write(buffer.data(), buffer.size());
+	return (bool)outputStream;
+}
+
+//--------------------------------------------------------------
+// Reads a whole file into a buffer
+bool loadSnapshotFile(const string &fileName, vector<char> &buffer)
+{
+	ifstream inputStream(fileName, ios::binary);
+	if (!inputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	buffer.assign(istreambuf_iterator<char>(inputStream), istreambuf_iterator<char>());
+	return true;
+}
+
+//--------------------------------------------------------------
+// Reports every mesh with its parts, the objects and lights, and the
+//  planes' textures
+void SceneSnapshot::addToReport(MemoryReport &report) const
+{
+	for (int m = 0; m < meshes.size(); m++) {
+		MeshMemory memory = meshes[m]->getMemoryUsage();
+		report.add("Meshes", "mesh " + std::to_string(m) + " (" + std::to_string(meshes[m]->triangles.size()) + " triangles)",
+			memory.getTotal(), memory.getDetails());
+	}
+	size_t objectBytes = getVectorBytes(objects) + getVectorBytes(lights) + getVectorBytes(meshes) + meshes.size() * sizeof(Mesh);
+	for (const SceneObject *object : objects) {
+		if (dynamic_cast<const MeshInstance *>(object)) objectBytes += sizeof(MeshInstance);
+		else if (dynamic_cast<const Plane *>(object)) objectBytes += sizeof(Plane);
+		else objectBytes += sizeof(Sphere);
+	}
+	for (const Light *light : lights) {
+		if (dynamic_cast<const RectLight *>(light)) objectBytes += sizeof(RectLight);
+		else if (dynamic_cast<const SphereLight *>(light)) objectBytes += sizeof(SphereLight);
+		else objectBytes += sizeof(PointLight);
+	}
+	report.add("Scene objects", "objects and lights", objectBytes,
+		std::to_string(objects.size()) + " objects, " + std::to_string(lights.size()) + " lights");
+	for (int k = 0; k < objects.size(); k++) {
+		const Plane *plane = dynamic_cast<const Plane *>(objects[k]);
+		if (plane && plane->textureApplied) report.addImage("texture of object " + std::to_string(k), plane->textureImg);
+	}
+}
@@ -0,0 +1,82 @@
+// This file provides the definition of the SceneSnapshot class, which
+//  writes everything a render reads (objects, lights, camera, shading
+//  settings and image size) to a byte buffer and rebuilds a scene from
+//  one in another process.
+// A snapshot holds what is traced, not how it got there: skinned and
+//  posed meshes are written with their current vertices and placement,
+//  so a worker doesn't need the skeleton, clips or skin bindings. Every
+//  mesh is written once, however many placements (crowd instances)
+//  share it, and rebuilt as one mesh with its hierarchy and one
+//  MeshInstance per placement.
+//
+// Layout (host byte order, like the binary skeleton file):
+//  magic "MASN", version, image width and height
+//  settings        phong power, background, light samples, sampler, shading
+//                  model and shadows
+//  camera          position, view plane min, max and position
+//  meshes          vertices, normals, triangles and shading mode of each mesh
+//  objects         type, color and shading mode, then a sphere's center and
+//                  radius, a plane's placement, size and texture, or a mesh
+//                  placement's mesh and transformation
+//  lights          type, position, intensity and color, then a sphere light's
+//                  radius or a rectangle light's edges
+
+#pragma once
+
+#include "ofMain.h"
+#include "SceneObjects.h"
+#include "Renderer.h"
+
+class Mesh;
+class MemoryReport;
+
+// SceneSnapshot class
+//
+class SceneSnapshot {
+public:
+	SceneSnapshot();
+	~SceneSnapshot();
+
+	// Writes the scene and the size of the image to render to the buffer
+	//  (objects of types a snapshot can't hold are skipped with a warning)
+	static void write(const RenderScene &scene, int width, int height, vector<char> &buffer);
+
+	// Gets the image size from the header of a buffer written by write
+	//  without rebuilding the scene (returns false if it isn't a snapshot)
+	static bool readImageSize(const vector<char> &buffer, int &width, int &height);
+
+	// Rebuilds the scene from a buffer written by write (returns false if it is corrupt)
+	bool read(const vector<char> &buffer);
+
+	// Returns the rebuilt scene
+	RenderScene getScene();
+
+	// Adds the rebuilt meshes, objects and plane textures to a memory report
+	void addToReport(MemoryReport &report) const;
+
+	// Fields of SceneSnapshot class
+	//
+	int width = 0, height = 0;							// size of the image to render
+	vector<SceneObject *> objects;						// objects of the scene
+	vector<Light *> lights;								// lights of the scene
+	RenderCam camera;									// camera of the scene
+	float phongPower = 20;								// shading settings
+	ofColor background = ofColor::black;
+	int lightSamples = 16;
+	SamplerType sampler = SAMPLER_SOBOL;
+	ShadingModel shadingModel = SHADING_PHONG;
+	bool bShadows = true;
+
+private:
+	SceneSnapshot(const SceneSnapshot &) = delete;
+	SceneSnapshot &operator=(const SceneSnapshot &) = delete;
+	void clear();
+
+	vector<Mesh *> meshes;								// meshes shared by the mesh placements
+};
+
+// Writes a buffer to a file (returns false if it couldn't be written)
+bool saveSnapshotFile(const string &fileName, const vector<char> &buffer);
+
+// Reads a whole file into a buffer (returns false if it couldn't be read)
+bool loadSnapshotFile(const string &fileName, vector<char> &buffer);
@@ -0,0 +1,568 @@
+// This file provides implementation of the Skeleton class methods.
+
+#include "Skeleton.h"
+#include "SceneObjects.h"
+#include "MappedFile.h"
+#include "MemoryAccounting.h"
+
+//--------------------------------------------------------------
+// Builds the skeleton from the given scene objects. Joints keep the
+//  objects' order, except that one listed before its parent is moved
+//  after it, so that every parent index is lower than the index of
+//  its children (and the last joint holding a name is the last object
+//  holding it, as in SceneRegistry).
+void Skeleton::compile(const vector<SceneObject *> &objects)
+{
+	// maps each scene object to its index in the skeleton (or to where it is in the ordering)
+	const int UNVISITED = -1, ON_CHAIN = -2, DROPPED = -3;
+	unordered_map<SceneObject *, int> indexOf;
+	for (int i = 0; i < objects.size(); i++) {
+		indexOf[objects[i]] = UNVISITED;
+	}
+
+	// order holds the scene objects in topological order: every object is
+	//  placed after the chain of its ancestors not placed yet (a chain that
+	//  closes on itself or hangs off a dropped object is dropped)
+	vector<SceneObject *> order, chain;
+	order.reserve(objects.size());
+	for (int i = 0; i < objects.size(); i++) {
+		chain.clear();
+		bool bDropped = false;
+		for (SceneObject *object = objects[i]; object != NULL; object = object->parent) {
+			auto found = indexOf.find(object);
+			if (found == indexOf.end()) break;	// the parent is outside the skeleton
+			if (found->second != UNVISITED) {
+				bDropped = found->second == ON_CHAIN || found->second == DROPPED;
+				break;
+			}
+			found->second = ON_CHAIN;
+			chain.push_back(object);
+		}
+		for (int k = (int)chain.size() - 1; k >= 0; k--) {
+			indexOf[chain[k]] = bDropped ? DROPPED : (int)order.size();
+			if (!bDropped) order.push_back(chain[k]);
+		}
+	}
+	for (auto entry = indexOf.begin(); entry != indexOf.end();) {
+		if (entry->second == DROPPED) entry = indexOf.erase(entry);
+		else ++entry;
+	}
+
+	// fill in the joint table
+	resize((int)order.size());
+	source = order;
+	for (int i = 0; i < order.size(); i++) {
+		names[i] = order[i]->getName();
+		parents[i] = (order[i]->parent && indexOf.count(order[i]->parent)) ? indexOf[order[i]->parent] : -1;
+	}
+
+	indexNames();
+
+	// copy over the current pose
+	pullPose();
+}
+
+//--------------------------------------------------------------
+// Returns the joints of a file in the file's order, except that a
+//  joint listed before its parent is moved after it (so a file that
+//  lists parents first keeps its order), given each joint's parent
+//  index in the file (-1 for roots). Every joint is visited once with
+//  the chain of its ancestors not yet placed; joints caught in a
+//  parent cycle (and their descendants) are left out.
+static vector<int> topologicalOrder(const vector<int> &fileParent)
+{
+	int count = (int)fileParent.size();
+	enum { UNVISITED, ON_CHAIN, PLACED, DROPPED };
+	vector<char> state(count, UNVISITED);
+	vector<int> order, chain;
+	order.reserve(count);
+	for (int i = 0; i < count; i++) {
+		// climb to a root or to a joint already handled
+		chain.clear();
+		int j = i;
+		while (j >= 0 && state[j] == UNVISITED) {
+			state[j] = ON_CHAIN;
+			chain.push_back(j);
+			j = fileParent[j];
+		}
+		// the chain closes on itself or hangs off a dropped joint if it isn't rooted
+		bool bDropped = j >= 0 && state[j] != PLACED;
+		for (int k = (int)chain.size() - 1; k >= 0; k--) {
+			state[chain[k]] = bDropped ? DROPPED : PLACED;
+			if (!bDropped) order.push_back(chain[k]);
+		}
+	}
+	return order;
+}
+
+//--------------------------------------------------------------
+// Returns true for the characters that separate script tokens
+//  (vector punctuation is treated as whitespace)
+static inline bool isScriptSeparator(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '<' || c == '>' || c == ',';
+}
+
+//--------------------------------------------------------------
+// Finds the next token between cursor and end, moving the cursor
+//  past it (returns false at the end of the file)
+static inline bool nextScriptToken(const char *&cursor, const char *end, const char *&token, size_t &tokenLength)
+{
+	while (cursor < end && isScriptSeparator(*cursor)) cursor++;
+	if (cursor == end) return false;
+	token = cursor;
+	while (cursor < end && !isScriptSeparator(*cursor)) cursor++;
+	tokenLength = cursor - token;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Reads the next token as a float (0 if there is none)
+static inline float nextScriptFloat(const char *&cursor, const char *end)
+{
+	const char *token;
+	size_t tokenLength;
+	if (!nextScriptToken(cursor, end, token, tokenLength)) return 0;
+	// copy the token so strtof stops inside it (the mapping isn't null terminated)
+	char number[64];
+	tokenLength = std::min(tokenLength, sizeof(number) - 1);
+	memcpy(number, token, tokenLength);
+	number[tokenLength] = 0;
+	return strtof(number, NULL);
+}
+
+//--------------------------------------------------------------
+// Reads a joint script file into the skeleton. The file is mapped
+//  and tokenised in one pass, then parent names are resolved
+//  through a hash of the joint names, so parents may be listed
+//  after their children and loading takes O(n). Joints are
+//  reordered so every parent precedes its children.
+bool Skeleton::loadScript(const string &fileName)
+{
+	MappedFile file;
+	if (!file.open(fileName)) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	// joints in file order
+	vector<string> fileNames, fileParents;
+	vector<glm::vec3> fileRotations, fileTranslations;
+	const char *cursor = file.data();
+	const char *end = cursor + file.size();
+	const char *token;
+	size_t tokenLength;
+	auto tokenIs = [&token, &tokenLength](const char *keyword) {
+		return tokenLength == strlen(keyword) && memcmp(token, keyword, tokenLength) == 0;
+	};
+	while (nextScriptToken(cursor, end, token, tokenLength)) {
+		if (tokenIs("create")) {
+			fileNames.push_back("");
+			fileParents.push_back("");
+			fileRotations.push_back(glm::vec3(0, 0, 0));
+			fileTranslations.push_back(glm::vec3(0, 0, 0));
+		}
+		else if (fileNames.empty()) continue;
+		else if (tokenIs("-joint") || tokenIs("-parent")) {
+			string &target = tokenIs("-joint") ? fileNames.back() : fileParents.back();
+			if (nextScriptToken(cursor, end, token, tokenLength)) target.assign(token, tokenLength);
+		}
+		else if (tokenIs("-rotate") || tokenIs("-translate")) {
+			glm::vec3 &target = tokenIs("-rotate") ? fileRotations.back() : fileTranslations.back();
+			target.x = nextScriptFloat(cursor, end);
+			target.y = nextScriptFloat(cursor, end);
+			target.z = nextScriptFloat(cursor, end);
+		}
+	}
+	file.close();
+
+	// resolve parent names (a repeated name refers to its last joint)
+	int count = (int)fileNames.size();
+	unordered_map<string, int> fileIndex;
+	fileIndex.reserve(count);
+	for (int i = 0; i < count; i++) {
+		fileIndex[fileNames[i]] = i;
+	}
+	vector<int> fileParent(count, -1);
+	for (int i = 0; i < count; i++) {
+		auto found = fileIndex.find(fileParents[i]);
+		if (found != fileIndex.end() && found->second != i) fileParent[i] = found->second;
+	}
+
+	// fill in the joint table in parent-before-child order (joints caught in a parent cycle are dropped)
+	vector<int> order = topologicalOrder(fileParent);
+	resize(0);
+	resize((int)order.size());
+	vector<int> newIndex(count, -1);
+	for (int i = 0; i < order.size(); i++) {
+		int f = order[i];
+		newIndex[f] = i;
+		names[i] = std::move(fileNames[f]);
+		parents[i] = fileParent[f] >= 0 ? newIndex[fileParent[f]] : -1;
+		posX[i] = fileTranslations[f].x; posY[i] = fileTranslations[f].y; posZ[i] = fileTranslations[f].z;
+		rotX[i] = fileRotations[f].x; rotY[i] = fileRotations[f].y; rotZ[i] = fileRotations[f].z;
+	}
+	indexNames();
+	return true;
+}
+
+//--------------------------------------------------------------
+// Writes one "create" line per joint, parents first
+bool Skeleton::saveScript(const string &fileName) const
+{
+	ofstream outputStream(fileName);
+	if (!outputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	for (int i = 0; i < size(); i++) {
+		outputStream << "create -joint " << names[i];
+		outputStream << " -rotate <" << rotX[i] << ", " << rotY[i] << ", " << rotZ[i] << ">";
+		outputStream << " -translate <" << posX[i] << ", " << posY[i] << ", " << posZ[i] << ">";
+		if (parents[i] >= 0) outputStream << " -parent " << names[parents[i]];
+		outputStream << "\n";
+	}
+	return (bool)outputStream;
+}
+
+// binary skeleton file layout (every field is 4 bytes, little endian):
+//  header          "MASK", format version, joint count n, string pool size
+//  joint table     n x (name offset, name length) into the string pool
+//  parents         n x int32, index of each joint's parent in the file (-1 for roots)
+//  TRS channels    9 x n floats: posX, posY, posZ, rotX, rotY, rotZ, scaleX, scaleY, scaleZ
+//  string pool     the joint names, back to back
+// A writer may list joints in any order; the loader copies the channels
+//  straight out of the mapping when parents already precede their children.
+static const uint32_t SKELETON_FILE_VERSION = 1;
+static const int SKELETON_FILE_CHANNELS = 9;
+
+//--------------------------------------------------------------
+// Writes the joint table, parents, channels and string pool
+bool Skeleton::saveBinary(const string &fileName) const
+{
+	ofstream outputStream(fileName, ios::binary);
+	if (!outputStream) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+	uint32_t count = (uint32_t)size();
+
+	// joint table
+	vector<uint32_t> table(2 * count);
+	uint32_t poolSize = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		table[2 * i] = poolSize;
+		table[2 * i + 1] = (uint32_t)names[i].size();
+		poolSize += (uint32_t)names[i].size();
+	}
+
+	// header
+	uint32_t header[3] = { SKELETON_FILE_VERSION, count, poolSize };
+	outputStream.write("MASK", 4);
+	outputStream.write((const char *)header, sizeof(header));
+	outputStream.write((const char *)table.data(), table.size() * sizeof(uint32_t));
+	outputStream.write((const char *)parents.data(), count * sizeof(int32_t));
+
+	// channels
+	const vector<float> *channels[SKELETON_FILE_CHANNELS] = { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &scaleX, &scaleY, &scaleZ };
+	for (int c = 0; c < SKELETON_FILE_CHANNELS; c++) {
+		outputStream.write((const char *)channels[c]->data(), count * sizeof(float));
+	}
+
+	// string pool
+	for (uint32_t i = 0; i < count; i++) {
+		outputStream.write(names[i].data(), names[i].size());
+	}
+	return (bool)outputStream;
+}
+
+//--------------------------------------------------------------
+// Maps a binary skeleton file and copies its sections out of the
+//  mapping
+bool Skeleton::loadBinary(const string &fileName)
+{
+	MappedFile file;
+	if (!file.open(fileName) || file.size() < 16 || memcmp(file.data(), "MASK", 4) != 0) {
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	// header and the sections that follow it
+	uint32_t header[3];
+	memcpy(header, file.data() + 4, sizeof(header));
+	uint32_t count = header[1], poolSize = header[2];
+	size_t tableOffset = 16;
+	size_t parentsOffset = tableOffset + (size_t)count * 2 * sizeof(uint32_t);
+	size_t channelsOffset = parentsOffset + (size_t)count * sizeof(int32_t);
+	size_t poolOffset = channelsOffset + (size_t)count * SKELETON_FILE_CHANNELS * sizeof(float);
+	if (header[0] != SKELETON_FILE_VERSION || count > file.size() || poolOffset + poolSize != file.size()) {
+		cout << "Skeleton file " << fileName << " is corrupt" << endl;
+		return false;
+	}
+	const uint32_t *table = (const uint32_t *)(file.data() + tableOffset);
+	const int32_t *fileParents = (const int32_t *)(file.data() + parentsOffset);
+	const float *fileChannels = (const float *)(file.data() + channelsOffset);
+	const char *pool = file.data() + poolOffset;
+
+	// validate the parents and names, and check whether the file is already in parent-before-child order
+	vector<int> fileParent(fileParents, fileParents + count);
+	bool bOrdered = true;
+	for (uint32_t i = 0; i < count; i++) {
+		if (fileParent[i] < -1 || fileParent[i] >= (int)count || fileParent[i] == (int)i ||
+			(size_t)table[2 * i] + table[2 * i + 1] > poolSize) {
+			cout << "Skeleton file " << fileName << " is corrupt" << endl;
+			return false;
+		}
+		if (fileParent[i] > (int)i) bOrdered = false;
+	}
+
+	// fill in the joint table
+	vector<int> order;
+	if (!bOrdered) order = topologicalOrder(fileParent);
+	int joints = bOrdered ? (int)count : (int)order.size();
+	resize(0);
+	resize(joints);
+	vector<float> *channels[SKELETON_FILE_CHANNELS] = { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &scaleX, &scaleY, &scaleZ };
+	if (bOrdered) {
+		// copy the arrays straight out of the mapping
+		for (int c = 0; c < SKELETON_FILE_CHANNELS; c++) {
+			memcpy(channels[c]->data(), fileChannels + (size_t)c * count, count * sizeof(float));
+		}
+		for (int i = 0; i < joints; i++) {
+			parents[i] = fileParent[i];
+			names[i].assign(pool + table[2 * i], table[2 * i + 1]);
+		}
+	}
+	else {
+		// gather every joint into its place in the order
+		vector<int> newIndex(count, -1);
+		for (int i = 0; i < joints; i++) {
+			int f = order[i];
+			newIndex[f] = i;
+			parents[i] = fileParent[f] >= 0 ? newIndex[fileParent[f]] : -1;
+			names[i].assign(pool + table[2 * f], table[2 * f + 1]);
+			for (int c = 0; c < SKELETON_FILE_CHANNELS; c++) {
+				(*channels[c])[i] = fileChannels[(size_t)c * count + f];
+			}
+		}
+	}
+	indexNames();
+	return true;
+}
+
+//--------------------------------------------------------------
+// Picks the loader from the file's extension
+bool Skeleton::load(const string &fileName)
+{
+	bool bBinary = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".skb") == 0;
+	return bBinary ? loadBinary(fileName) : loadScript(fileName);
+}
+
+//--------------------------------------------------------------
+// Resizes all of the per joint arrays to hold count joints
+//  (new joints get an identity transformation and no parent)
+void Skeleton::resize(int count)
+{
+	version++;
+	source.clear();
+	bNamesIndexed = false;
+	parents.resize(count, -1);
+	names.resize(count);
+	posX.resize(count, 0); posY.resize(count, 0); posZ.resize(count, 0);
+	rotX.resize(count, 0); rotY.resize(count, 0); rotZ.resize(count, 0);
+	scaleX.resize(count, 1); scaleY.resize(count, 1); scaleZ.resize(count, 1);
+	pivotX.resize(count, 0); pivotY.resize(count, 0); pivotZ.resize(count, 0);
+	sinX.resize(count); cosX.resize(count);
+	sinY.resize(count); cosY.resize(count);
+	sinZ.resize(count); cosZ.resize(count);
+	localMatrices.resize(count);
+	worldMatrices.resize(count);
+}
+
+//--------------------------------------------------------------
+// Copies the local transformation channels of the source
+//  scene objects into the SoA arrays
+void Skeleton::pullPose()
+{
+	for (int i = 0; i < source.size(); i++) {
+		SceneObject *obj = source[i];
+		posX[i] = obj->position.x; posY[i] = obj->position.y; posZ[i] = obj->position.z;
+		rotX[i] = obj->rotation.x; rotY[i] = obj->rotation.y; rotZ[i] = obj->rotation.z;
+		scaleX[i] = obj->scale.x; scaleY[i] = obj->scale.y; scaleZ[i] = obj->scale.z;
+		pivotX[i] = obj->pivot.x; pivotY[i] = obj->pivot.y; pivotZ[i] = obj->pivot.z;
+	}
+}
+
+//--------------------------------------------------------------
+// Writes the local transformation channels of the SoA arrays
+//  back to the source scene objects (through their setters so
+//  their cached matrices are invalidated)
+void Skeleton::pushPose()
+{
+	for (int i = 0; i < source.size(); i++) {
+		source[i]->setLocalPosition(glm::vec3(posX[i], posY[i], posZ[i]));
+		source[i]->setRotation(glm::vec3(rotX[i], rotY[i], rotZ[i]));
+		source[i]->setScale(glm::vec3(scaleX[i], scaleY[i], scaleZ[i]));
+	}
+}
+
+//--------------------------------------------------------------
+// Builds a local matrix from the sines and cosines of the rotation
+//  channels: translate * pivot * rotate(YXZ) * inverse pivot * scale
+//  (same order as SceneObject::getLocalMatrix, expanded by hand)
+static inline void composeLocalMatrix(glm::mat4 &m, float sinX, float cosX, float sinY, float cosY,
+	float sinZ, float cosZ, glm::vec3 position, glm::vec3 scale, glm::vec3 pivot)
+{
+	// rotation matrix columns (matches glm::eulerAngleYXZ)
+	float r00 = cosY * cosZ + sinY * sinX * sinZ;
+	float r01 = sinZ * cosX;
+	float r02 = -sinY * cosZ + cosY * sinX * sinZ;
+	float r10 = -cosY * sinZ + sinY * sinX * cosZ;
+	float r11 = cosZ * cosX;
+	float r12 = sinZ * sinY + cosY * sinX * cosZ;
+	float r20 = sinY * cosX;
+	float r21 = -sinX;
+	float r22 = cosY * cosX;
+
+	m[0] = glm::vec4(r00 * scale.x, r01 * scale.x, r02 * scale.x, 0);
+	m[1] = glm::vec4(r10 * scale.y, r11 * scale.y, r12 * scale.y, 0);
+	m[2] = glm::vec4(r20 * scale.z, r21 * scale.z, r22 * scale.z, 0);
+	// translation column: position + pivot - rotate * pivot
+	m[3] = glm::vec4(position.x + pivot.x - (r00 * pivot.x + r10 * pivot.y + r20 * pivot.z),
+		position.y + pivot.y - (r01 * pivot.x + r11 * pivot.y + r21 * pivot.z),
+		position.z + pivot.z - (r02 * pivot.x + r12 * pivot.y + r22 * pivot.z), 1);
+}
+
+//--------------------------------------------------------------
+// Evaluates the local and world matrices of every joint.
+// The local matrices are built channel by channel over the
+//  contiguous arrays (no dependencies between joints, so the
+//  loops vectorise), then the world matrices are concatenated
+//  in a single forward pass since parents precede children.
+void Skeleton::evaluate(const glm::mat4 &rootMatrix)
+{
+	int count = size();
+	const float toRadians = glm::pi<float>() / 180.0f;
+
+	// sines and cosines of every rotation channel
+	for (int i = 0; i < count; i++) {
+		sinX[i] = sin(rotX[i] * toRadians); cosX[i] = cos(rotX[i] * toRadians);
+		sinY[i] = sin(rotY[i] * toRadians); cosY[i] = cos(rotY[i] * toRadians);
+		sinZ[i] = sin(rotZ[i] * toRadians); cosZ[i] = cos(rotZ[i] * toRadians);
+	}
+
+	// local matrices (no dependencies between joints)
+	for (int i = 0; i < count; i++) {
+		composeLocalMatrix(localMatrices[i], sinX[i], cosX[i], sinY[i], cosY[i], sinZ[i], cosZ[i],
+			glm::vec3(posX[i], posY[i], posZ[i]), glm::vec3(scaleX[i], scaleY[i], scaleZ[i]),
+			glm::vec3(pivotX[i], pivotY[i], pivotZ[i]));
+	}
+
+	// world matrices: parents are always evaluated before their children
+	for (int i = 0; i < count; i++) {
+		if (parents[i] < 0) {
+			worldMatrices[i] = rootMatrix * localMatrices[i];
+		}
+		else {
+			worldMatrices[i] = worldMatrices[parents[i]] * localMatrices[i];
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Copies the local channels of the skeleton into the pose
+void Skeleton::copyPose(SkeletonPose &pose) const
+{
+	pose.posX = posX; pose.posY = posY; pose.posZ = posZ;
+	pose.rotX = rotX; pose.rotY = rotY; pose.rotZ = rotZ;
+	pose.scaleX = scaleX; pose.scaleY = scaleY; pose.scaleZ = scaleZ;
+	pose.worldMatrices.resize(size());
+}
+
+//--------------------------------------------------------------
+// Evaluates the world matrices of an instance pose. The local
+//  matrix of each joint is only needed until its world matrix is
+//  computed, so it is not stored.
+void Skeleton::evaluate(SkeletonPose &pose, const glm::mat4 &rootMatrix) const
+{
+	int count = std::min(size(), (int)pose.posX.size());
+	const float toRadians = glm::pi<float>() / 180.0f;
+	pose.worldMatrices.resize(count);
+
+	glm::mat4 local;
+	for (int i = 0; i < count; i++) {
+		float x = pose.rotX[i] * toRadians;
+		float y = pose.rotY[i] * toRadians;
+		float z = pose.rotZ[i] * toRadians;
+		composeLocalMatrix(local, sin(x), cos(x), sin(y), cos(y), sin(z), cos(z),
+			glm::vec3(pose.posX[i], pose.posY[i], pose.posZ[i]),
+			glm::vec3(pose.scaleX[i], pose.scaleY[i], pose.scaleZ[i]),
+			glm::vec3(pivotX[i], pivotY[i], pivotZ[i]));
+		pose.worldMatrices[i] = (parents[i] < 0 ? rootMatrix : pose.worldMatrices[parents[i]]) * local;
+	}
+}
+
+//--------------------------------------------------------------
+// Resizes all of the per joint arrays of the pose to hold count
+//  joints (new joints get an identity transformation)
+void SkeletonPose::resize(int count)
+{
+	posX.resize(count, 0); posY.resize(count, 0); posZ.resize(count, 0);
+	rotX.resize(count, 0); rotY.resize(count, 0); rotZ.resize(count, 0);
+	scaleX.resize(count, 1); scaleY.resize(count, 1); scaleZ.resize(count, 1);
+	worldMatrices.resize(count);
+}
+
+//--------------------------------------------------------------
+// Returns the number of bytes used by the pose's arrays
+size_t SkeletonPose::getSizeInBytes() const
+{
+	return posX.capacity() * 9 * sizeof(float) + worldMatrices.capacity() * sizeof(glm::mat4);
+}
+
+//--------------------------------------------------------------
+// Adds up the capacity of every array, the characters of names too long
+//  for a string's own buffer and the name index's buckets and nodes (a
+//  node holds the key, value and a pointer to the next node)
+size_t Skeleton::getSizeInBytes() const
+{
+	size_t bytes = getVectorBytes(parents) + getVectorBytes(names) + getVectorBytes(source);
+	size_t shortCapacity = string().capacity();
+	for (const string &name : names) {
+		if (name.capacity() > shortCapacity) bytes += name.capacity() + 1;
+	}
+	bytes += (posX.capacity() + posY.capacity() + posZ.capacity() + rotX.capacity() + rotY.capacity() + rotZ.capacity()
+		+ scaleX.capacity() + scaleY.capacity() + scaleZ.capacity() + pivotX.capacity() + pivotY.capacity() + pivotZ.capacity()
+		+ sinX.capacity() + cosX.capacity() + sinY.capacity() + cosY.capacity() + sinZ.capacity() + cosZ.capacity()) * sizeof(float);
+	bytes += getVectorBytes(localMatrices) + getVectorBytes(worldMatrices);
+	bytes += nameIndex.bucket_count() * sizeof(void *) + nameIndex.size() * (sizeof(pair<const string, int>) + sizeof(void *));
+	return bytes;
+}
+
+//--------------------------------------------------------------
+// Maps every joint name to its index (the first joint keeps a
+//  name shared by several joints, as with a scan)
+void Skeleton::indexNames()
+{
+	nameIndex.clear();
+	nameIndex.reserve(names.size());
+	for (int i = 0; i < names.size(); i++) {
+		nameIndex[names[i]] = i;
+	}
+	bNamesIndexed = true;
+}
+
+//--------------------------------------------------------------
+// Returns the index of the joint with the given name
+//  or -1 if no joint has that name
+int Skeleton::findJoint(const string &jointName) const
+{
+	if (bNamesIndexed) {
+		auto found = nameIndex.find(jointName);
+		return found != nameIndex.end() ? found->second : -1;
+	}
+	for (int i = (int)names.size() - 1; i >= 0; i--) {
+		if (names[i] == jointName) return i;
+	}
+	return -1;
+}
@@ -0,0 +1,137 @@
+// This file provides the definition of the Skeleton class, a compiled
+//  copy of a Joint hierarchy stored as flat structure-of-arrays data.
+// Joints are stored in topological order (every parent comes before its
+//  children) so world matrices can be evaluated in one linear pass
+//  without chasing parent/childList pointers.
+
+#pragma once
+
+#include "ofMain.h"
+#include <unordered_map>
+
+class SceneObject;
+
+// SkeletonPose: the pose of one instance of a shared Skeleton (only the
+//  animated channels and the resulting world matrices, the joint table
+//  and pivots stay in the Skeleton)
+//
+struct SkeletonPose {
+	// Resizes the pose to hold count joints
+	void resize(int count);
+
+	// Returns the world space position of the given joint (after Skeleton::evaluate)
+	glm::vec3 getWorldPosition(int i) const { return glm::vec3(worldMatrices[i][3]); }
+
+	// Returns the number of bytes used by the pose
+	size_t getSizeInBytes() const;
+
+	// local transformation channels of every joint (same layout as Skeleton)
+	vector<float> posX, posY, posZ;			// translation
+	vector<float> rotX, rotY, rotZ;			// euler rotation in degrees
+	vector<float> scaleX, scaleY, scaleZ;	// scale
+
+	// results of Skeleton::evaluate(pose)
+	vector<glm::mat4> worldMatrices;		// world matrix of every joint
+};
+
+// Skeleton class
+//
+class Skeleton {
+public:
+	// Builds the skeleton from a list of scene objects (usually ofApp::joints)
+	//  in parent-before-child order and copies their current pose
+	void compile(const vector<SceneObject *> &objects);
+
+	// Builds the skeleton from a joint script file (as written by
+	//  ofApp::createFile) without creating any scene objects
+	//  (returns false if the file could not be read). Parents may be
+	//  listed after their children; joints keep the file's order otherwise.
+	//  A repeated parent name refers to the joint defined last, as
+	//  findJoint and SceneRegistry resolve repeated names.
+	bool loadScript(const string &fileName);
+
+	// Writes the skeleton's joint names, parents, rotations and
+	//  translations as a joint script file
+	bool saveScript(const string &fileName) const;
+
+	// Builds the skeleton from a binary skeleton file (.skb), which is
+	//  mapped into memory and copied out of the mapping (a block per
+	//  channel if the joints are already in parent-before-child order)
+	bool loadBinary(const string &fileName);
+
+	// Writes the skeleton as a binary skeleton file (.skb): joint table,
+	//  parent indices, translation/rotation/scale channels and a string
+	//  pool holding the names
+	bool saveBinary(const string &fileName) const;
+
+	// Loads a binary skeleton file if fileName ends in ".skb", otherwise
+	//  a joint script file
+	bool load(const string &fileName);
+
+	// Resizes the skeleton to hold count joints (used when building a skeleton
+	//  that is not backed by scene objects, e.g. for benchmarks or loaders)
+	void resize(int count);
+
+	// Copies the current local position/rotation/scale/pivot of the source
+	//  scene objects into the SoA arrays
+	void pullPose();
+
+	// Writes the local position/rotation/scale of the SoA arrays back
+	//  to the source scene objects
+	void pushPose();
+
+	// Computes local and world matrices of every joint in one linear pass
+	//  (root joints are placed relative to rootMatrix)
+	void evaluate(const glm::mat4 &rootMatrix = glm::mat4(1.0));
+
+	// Copies the skeleton's current local channels into an instance pose
+	void copyPose(SkeletonPose &pose) const;
+
+	// Computes the world matrices of an instance pose of this skeleton. Only
+	//  reads the skeleton, so many poses can be evaluated in parallel.
+	void evaluate(SkeletonPose &pose, const glm::mat4 &rootMatrix = glm::mat4(1.0)) const;
+
+	// Rebuilds the hash index from joint names to joint indices (done by
+	//  compile and loadScript; call it after filling in names by hand)
+	void indexNames();
+
+	// Returns the index of the joint with the given name (-1 if not found),
+	//  the last one if several joints have it. Uses the name index if it
+	//  is up to date, otherwise scans the names.
+	int findJoint(const string &jointName) const;
+
+	// Returns the number of joints in the skeleton
+	int size() const { return (int)parents.size(); }
+
+	// Returns the world space position of the given joint (after evaluate)
+	glm::vec3 getWorldPosition(int i) const { return glm::vec3(worldMatrices[i][3]); }
+
+	// Returns the number of bytes used by the joint table, channels, matrices
+	//  and name index (the index's nodes are estimated)
+	size_t getSizeInBytes() const;
+
+	// Fields of Skeleton class
+	//
+	vector<int> parents;				// index of each joint's parent (-1 for roots), always lower than the joint's own index
+	vector<string> names;				// name of each joint
+	vector<SceneObject *> source;		// scene objects the skeleton was compiled from (empty if not backed by scene objects)
+	int version = 0;					// incremented whenever the joint table changes (so joint indices can be re-resolved)
+
+	// local transformation channels of every joint (structure of arrays)
+	vector<float> posX, posY, posZ;		// translation
+	vector<float> rotX, rotY, rotZ;		// euler rotation in degrees (applied in Y, X, Z order like SceneObject)
+	vector<float> scaleX, scaleY, scaleZ;	// scale
+	vector<float> pivotX, pivotY, pivotZ;	// rotate pivot
+
+	// results of evaluate()
+	vector<glm::mat4> localMatrices;	// matrix transformations exclusive to each joint
+	vector<glm::mat4> worldMatrices;	// local matrices concatenated with all of the joint's ancestors
+
+private:
+	// index of the last joint holding each name (valid while bNamesIndexed)
+	unordered_map<string, int> nameIndex;
+	bool bNamesIndexed = false;
+
+	// scratch arrays holding the sines and cosines of the rotation channels
+	vector<float> sinX, cosX, sinY, cosY, sinZ, cosZ;
+};
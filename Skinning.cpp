@@ -0,0 +1,337 @@
+// This file provides implementation of the Skin class methods and
+//  the linear blend skinning kernel.
+
+#include "Skinning.h"
+#include "Parallel.h"
+#include "MemoryAccounting.h"
+
+// use SSE for the skinning kernel when the target supports it
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+//--------------------------------------------------------------
+// Linear blend skinning kernel: transforms the points [begin, end)
+//  given as arrays of x, y, z by the weighted sum of their influencing
+//  palette matrices and writes them to out. If remap is given, point i
+//  uses the influences of vertex remap[i] (used for normal verticies).
+//  Normals ignore translation and are renormalized.
+static void skinRange(const float *x, const float *y, const float *z,
+	const int *joints, const float *weights, const int *remap,
+	const glm::mat4 *palette, glm::vec3 *out, bool bNormals, int begin, int end)
+{
+	for (int i = begin; i < end; i++) {
+		// vertex whose influences are used for this point
+		int v = remap ? remap[i] : i;
+		if (v < 0) {
+			// point is not used by any triangle so it keeps its bind value
+			out[i] = glm::vec3(x[i], y[i], z[i]);
+			continue;
+		}
+		const int *j = joints + v * MAX_INFLUENCES;
+		const float *w = weights + v * MAX_INFLUENCES;
+
+#ifdef SKINNING_SSE
+		// blend the columns of the influencing matrices four floats at a time
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		for (int k = 0; k < MAX_INFLUENCES; k++) {
+			__m128 wk = _mm_set1_ps(w[k]);
+			const float *m = &palette[j[k]][0][0];
+			c0 = _mm_add_ps(c0, _mm_mul_ps(wk, _mm_loadu_ps(m)));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(wk, _mm_loadu_ps(m + 4)));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(wk, _mm_loadu_ps(m + 8)));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(wk, _mm_loadu_ps(m + 12)));
+		}
+		// transform the point by the blended matrix
+		__m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(x[i])), _mm_mul_ps(c1, _mm_set1_ps(y[i]))),
+			_mm_mul_ps(c2, _mm_set1_ps(z[i])));
+		if (!bNormals) p = _mm_add_ps(p, c3);
+		float result[4];
+		_mm_storeu_ps(result, p);
+		glm::vec3 point = glm::vec3(result[0], result[1], result[2]);
+#else
+		// blend the influencing matrices
+		glm::mat4 m = w[0] * palette[j[0]];
+		for (int k = 1; k < MAX_INFLUENCES; k++) {
+			m += w[k] * palette[j[k]];
+		}
+		// transform the point by the blended matrix
+		glm::vec3 point = m * glm::vec4(x[i], y[i], z[i], bNormals ? 0.0f : 1.0f);
+#endif
+		if (bNormals) {
+			float len = glm::length(point);
+			if (len > 0) point /= len;
+		}
+		out[i] = point;
+	}
+}
+
+//--------------------------------------------------------------
+// Records the bind pose of the skin
+void Skin::bind(const Skeleton &skeleton, const vector<glm::vec3> &verts,
+	const vector<glm::vec3> &nVerts, const vector<int> &normalToVert)
+{
+	// store the inverse world matrix of every joint in the bind pose
+	jointNames = skeleton.names;
+	inverseBindMatrices.resize(skeleton.size());
+	for (int i = 0; i < skeleton.size(); i++) {
+		inverseBindMatrices[i] = glm::inverse(skeleton.worldMatrices[i]);
+	}
+
+	// store the bind vertices as structure of arrays
+	bindX.resize(verts.size()); bindY.resize(verts.size()); bindZ.resize(verts.size());
+	for (int i = 0; i < verts.size(); i++) {
+		bindX[i] = verts[i].x; bindY[i] = verts[i].y; bindZ[i] = verts[i].z;
+	}
+	bindNX.resize(nVerts.size()); bindNY.resize(nVerts.size()); bindNZ.resize(nVerts.size());
+	for (int i = 0; i < nVerts.size(); i++) {
+		bindNX[i] = nVerts[i].x; bindNY[i] = nVerts[i].y; bindNZ[i] = nVerts[i].z;
+	}
+	this->normalToVert = normalToVert;
+
+	// every vertex starts fully bound to the first joint
+	influenceJoints.assign(verts.size() * MAX_INFLUENCES, 0);
+	influenceWeights.assign(verts.size() * MAX_INFLUENCES, 0.0f);
+	for (int i = 0; i < verts.size(); i++) {
+		influenceWeights[i * MAX_INFLUENCES] = 1.0f;
+	}
+
+	// force the palette to be rebuilt on the next deform
+	lastSkeleton = NULL;
+	bDeformed = false;
+}
+
+//--------------------------------------------------------------
+// Generates weights by bone proximity. A bone runs from a joint to
+//  each of its children and is driven by that joint; joints without
+//  children act as a bone of zero length. Each vertex is bound to the
+//  MAX_INFLUENCES closest joints with weights falling off with the
+//  fourth power of the distance.
+void Skin::generateWeights(const Skeleton &skeleton)
+{
+	int numJoints = (int)jointNames.size();
+	if (numJoints == 0) return;
+
+	// bind pose position of every joint
+	vector<glm::vec3> jointPos(numJoints);
+	for (int i = 0; i < numJoints; i++) {
+		jointPos[i] = glm::inverse(inverseBindMatrices[i])[3];
+	}
+
+	// list the bones as (start, end, driving joint)
+	vector<glm::vec3> boneStart, boneEnd;
+	vector<int> boneJoint;
+	vector<bool> hasChildren(numJoints, false);
+	for (int i = 0; i < numJoints && i < skeleton.size(); i++) {
+		int p = skeleton.parents[i];
+		if (p >= 0) {
+			boneStart.push_back(jointPos[p]);
+			boneEnd.push_back(jointPos[i]);
+			boneJoint.push_back(p);
+			hasChildren[p] = true;
+		}
+	}
+	for (int i = 0; i < numJoints; i++) {
+		if (!hasChildren[i]) {
+			boneStart.push_back(jointPos[i]);
+			boneEnd.push_back(jointPos[i]);
+			boneJoint.push_back(i);
+		}
+	}
+
+	// find the closest joints of each vertex in parallel
+	parallelFor(getVertexCount(), [&](int begin, int end) {
+		vector<float> jointDist(numJoints);
+		for (int v = begin; v < end; v++) {
+			glm::vec3 p = glm::vec3(bindX[v], bindY[v], bindZ[v]);
+
+			// distance to the closest bone driven by each joint
+			std::fill(jointDist.begin(), jointDist.end(), std::numeric_limits<float>::infinity());
+			for (int b = 0; b < boneJoint.size(); b++) {
+				glm::vec3 seg = boneEnd[b] - boneStart[b];
+				float segLen2 = glm::dot(seg, seg);
+				float t = segLen2 > 0 ? glm::clamp(glm::dot(p - boneStart[b], seg) / segLen2, 0.0f, 1.0f) : 0.0f;
+				float d = glm::distance(p, boneStart[b] + t * seg);
+				jointDist[boneJoint[b]] = std::min(jointDist[boneJoint[b]], d);
+			}
+
+			// keep the closest MAX_INFLUENCES joints (insertion into a small sorted list)
+			int bestJoint[MAX_INFLUENCES];
+			float bestDist[MAX_INFLUENCES];
+			int numBest = 0;
+			for (int j = 0; j < numJoints; j++) {
+				int k = numBest < MAX_INFLUENCES ? numBest++ : MAX_INFLUENCES;
+				while (k > 0 && jointDist[j] < bestDist[k - 1]) {
+					if (k < MAX_INFLUENCES) {
+						bestDist[k] = bestDist[k - 1];
+						bestJoint[k] = bestJoint[k - 1];
+					}
+					k--;
+				}
+				if (k < MAX_INFLUENCES) {
+					bestDist[k] = jointDist[j];
+					bestJoint[k] = j;
+				}
+			}
+
+			// weights fall off with distance^4 and are normalized to sum to one
+			float total = 0;
+			float w[MAX_INFLUENCES];
+			for (int k = 0; k < numBest; k++) {
+				float d2 = bestDist[k] * bestDist[k];
+				w[k] = 1.0f / (d2 * d2 + 1e-8f);
+				total += w[k];
+			}
+			for (int k = 0; k < MAX_INFLUENCES; k++) {
+				influenceJoints[v * MAX_INFLUENCES + k] = k < numBest ? bestJoint[k] : 0;
+				influenceWeights[v * MAX_INFLUENCES + k] = k < numBest ? w[k] / total : 0.0f;
+			}
+		}
+	}, 1024);
+
+	// bind pose must be recomputed on the next deform
+	bDeformed = false;
+}
+
+//--------------------------------------------------------------
+// Loads weights from a text file. Vertices that are not listed in
+//  the file keep their current weights, influences beyond the
+//  MAX_INFLUENCES largest are dropped, and the remaining weights
+//  are normalized.
+bool Skin::loadWeights(const string &fileName, const vector<int> &vertexRemap)
+{
+	ifstream inputStream;		// input stream
+	string line;				// current line of the file
+
+	// attaches file to input stream
+	inputStream.open(fileName);
+	if (!inputStream) {	// checks if file opening failed
+		cout << "File open failed" << endl;
+		return false;
+	}
+
+	// maps joint names to their index in the skin
+	unordered_map<string, int> jointIndex;
+	for (int i = 0; i < jointNames.size(); i++) {
+		jointIndex[jointNames[i]] = i;
+	}
+
+	int numLoaded = 0;	// tracks number of vertices read
+	while (getline(inputStream, line)) {
+		istringstream lineStream(line);
+		int v;
+		if (!(lineStream >> v) || v < 0 || v >= getVertexCount()) continue;
+		// the file numbers the vertices as the mesh file did
+		if (v < vertexRemap.size()) v = vertexRemap[v];
+
+		// read every (joint, weight) pair of the line
+		vector<pair<float, int>> influences;
+		string jointName;
+		float weight;
+		while (lineStream >> jointName >> weight) {
+			auto found = jointIndex.find(jointName);
+			if (found != jointIndex.end() && weight > 0) {
+				influences.push_back(make_pair(weight, found->second));
+			}
+		}
+		if (influences.empty()) continue;
+
+		// keep the largest influences and normalize them
+		sort(influences.begin(), influences.end(), [](const pair<float, int> &a, const pair<float, int> &b) { return a.first > b.first; });
+		float total = 0;
+		for (int k = 0; k < influences.size() && k < MAX_INFLUENCES; k++) {
+			total += influences[k].first;
+		}
+		for (int k = 0; k < MAX_INFLUENCES; k++) {
+			bool used = k < influences.size();
+			influenceJoints[v * MAX_INFLUENCES + k] = used ? influences[k].second : 0;
+			influenceWeights[v * MAX_INFLUENCES + k] = used ? influences[k].first / total : 0.0f;
+		}
+		numLoaded++;
+	}
+	// detaches file from input stream
+	inputStream.close();
+
+	cout << "Loaded skin weights for " << numLoaded << " of " << getVertexCount() << " vertices\n" << endl;
+	bDeformed = false;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Resolves the bound joints in the skeleton and rebuilds the
+//  palette. Returns true if any palette matrix changed.
+bool Skin::updatePalette(const Skeleton &skeleton)
+{
+	// re-resolve joint indices by name whenever the skeleton was recompiled
+	if (lastSkeleton != &skeleton || lastSkeletonVersion != skeleton.version) {
+		skeletonIndex.resize(jointNames.size());
+		for (int i = 0; i < jointNames.size(); i++) {
+			skeletonIndex[i] = skeleton.findJoint(jointNames[i]);
+		}
+		lastSkeleton = &skeleton;
+		lastSkeletonVersion = skeleton.version;
+		bDeformed = false;
+	}
+
+	// palette = current world matrix * inverse bind matrix
+	//  (joints that were removed from the skeleton keep the bind pose)
+	bool changed = palette.size() != jointNames.size();
+	palette.resize(jointNames.size());
+	for (int i = 0; i < jointNames.size(); i++) {
+		glm::mat4 m = skeletonIndex[i] >= 0 ?
+			skeleton.worldMatrices[skeletonIndex[i]] * inverseBindMatrices[i] : glm::mat4(1.0);
+		if (m != palette[i]) {
+			palette[i] = m;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+//--------------------------------------------------------------
+// Deforms the skin with the current pose of the skeleton. Vertices
+//  and normals are split into ranges that are skinned in parallel.
+bool Skin::deform(const Skeleton &skeleton, vector<glm::vec3> &verts, vector<glm::vec3> &nVerts)
+{
+	// nothing to do if the pose did not change since the last deform
+	if (!updatePalette(skeleton) && bDeformed) return false;
+	if (palette.empty()) return false;
+
+	verts.resize(bindX.size());
+	nVerts.resize(bindNX.size());
+
+	// skin the position vertices
+	parallelFor((int)bindX.size(), [&](int begin, int end) {
+		skinRange(bindX.data(), bindY.data(), bindZ.data(), influenceJoints.data(), influenceWeights.data(),
+			NULL, palette.data(), verts.data(), false, begin, end);
+	}, 4096);
+
+	// skin the normal verticies with the weights of their position vertices
+	parallelFor((int)bindNX.size(), [&](int begin, int end) {
+		skinRange(bindNX.data(), bindNY.data(), bindNZ.data(), influenceJoints.data(), influenceWeights.data(),
+			normalToVert.data(), palette.data(), nVerts.data(), true, begin, end);
+	}, 4096);
+
+	bDeformed = true;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Adds up the capacity of every array (joint names included)
+size_t Skin::getSizeInBytes() const
+{
+	size_t bytes = getVectorBytes(jointNames) + getVectorBytes(inverseBindMatrices)
+		+ getVectorBytes(bindX) + getVectorBytes(bindY) + getVectorBytes(bindZ)
+		+ getVectorBytes(bindNX) + getVectorBytes(bindNY) + getVectorBytes(bindNZ)
+		+ getVectorBytes(normalToVert) + getVectorBytes(influenceJoints) + getVectorBytes(influenceWeights)
+		+ getVectorBytes(skeletonIndex) + getVectorBytes(palette);
+	size_t shortCapacity = string().capacity();
+	for (const string &name : jointNames) {
+		if (name.capacity() > shortCapacity) bytes += name.capacity() + 1;
+	}
+	return bytes;
+}
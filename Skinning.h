@@ -0,0 +1,68 @@
+// This file provides the definition of the Skin class which deforms a
+//  single continuous mesh with the joints of a Skeleton using linear
+//  blend skinning.
+// Every vertex is influenced by up to MAX_INFLUENCES joints. Weights are
+//  either generated automatically from the distance of each vertex to the
+//  bones or loaded from a weights file.
+
+#pragma once
+
+#include "ofMain.h"
+#include "Skeleton.h"
+
+// maximum number of joints that can influence a single vertex
+const int MAX_INFLUENCES = 4;
+
+// Skin class
+//
+class Skin {
+public:
+	// Records the bind pose: the mesh's current vertices/normals and the
+	//  skeleton's current world matrices. normalToVert gives, for every
+	//  normal vertex, a position vertex that shares its triangle corner
+	//  (normals reuse that vertex's weights).
+	void bind(const Skeleton &skeleton, const vector<glm::vec3> &verts,
+		const vector<glm::vec3> &nVerts, const vector<int> &normalToVert);
+
+	// Generates weights from the distance of every bind vertex to the bones
+	//  of the skeleton (a bone is driven by the joint it starts at)
+	void generateWeights(const Skeleton &skeleton);
+
+	// Loads weights from a file with one line per vertex in the form
+	//  "<vertex index> <joint name> <weight> [<joint name> <weight> ...]"
+	//  (returns false if the file could not be read). If the mesh's vertices
+	//  were reordered, vertexRemap gives the index of each vertex of the file.
+	bool loadWeights(const string &fileName, const vector<int> &vertexRemap = vector<int>());
+
+	// Deforms the bind vertices/normals with the current pose of the skeleton
+	//  and writes them into verts/nVerts (returns false if the pose did not
+	//  change since the last call and nothing was written)
+	bool deform(const Skeleton &skeleton, vector<glm::vec3> &verts, vector<glm::vec3> &nVerts);
+
+	// Returns the number of bind vertices
+	int getVertexCount() const { return (int)bindX.size(); }
+
+	// Returns the number of bytes used by the bind pose, weights and palette
+	size_t getSizeInBytes() const;
+
+	// Fields of Skin class
+	//
+	vector<string> jointNames;				// names of the joints the skin was bound to
+	vector<glm::mat4> inverseBindMatrices;	// inverse world matrix of each joint at bind time
+	vector<float> bindX, bindY, bindZ;		// bind pose position vertices (structure of arrays)
+	vector<float> bindNX, bindNY, bindNZ;	// bind pose normal verticies (structure of arrays)
+	vector<int> normalToVert;				// position vertex whose weights each normal vertex uses
+	vector<int> influenceJoints;			// MAX_INFLUENCES joint indices per position vertex
+	vector<float> influenceWeights;			// MAX_INFLUENCES normalized weights per position vertex
+
+private:
+	// Maps each bound joint to its index in the skeleton (by name) and
+	//  computes the skinning palette (world * inverse bind matrices)
+	bool updatePalette(const Skeleton &skeleton);
+
+	vector<int> skeletonIndex;				// index in the skeleton of each bound joint (-1 if it was removed)
+	vector<glm::mat4> palette;				// matrices used by the skinning kernel
+	const Skeleton *lastSkeleton = NULL;	// skeleton used for the last deform (to detect recompiles)
+	int lastSkeletonVersion = -1;			// version of that skeleton when it was used
+	bool bDeformed = false;					// tracks whether deform has written vertices yet
+};
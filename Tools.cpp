@@ -0,0 +1,300 @@
+// This file provides implementation of the headless command line tools.
+//
+// Usage:
+//  MeshAnimator --clip-report <skeleton.txt|skeleton.skb> <clip.anm> [<clip.anm> ...] [--tolerance <distance>]
+//      compresses each clip and prints its compression ratio and maximum
+//      end-effector error for the given skeleton
+//  MeshAnimator --render-coordinator <scene.snap> <image.png> [--port <port>] [--tile-size <pixels>]
+//          [--local-workers <count>] [--tile-timeout <seconds>]
+//      renders a scene snapshot (saved by the viewer's 'w' key) with the
+//      workers that connect, optionally starting local worker processes
+//      (.tif and .png images are streamed to disk as their bands finish)
+//  MeshAnimator --worker <host>:<port>
+//      traces tiles for the coordinator at the given address until its
+//      image is done
+//  MeshAnimator --render <scene.snap> <image.tif|image.png> [--size <width>x<height>]
+//      renders a scene snapshot on this machine at its own or the given
+//      size, streaming bands of rows to disk, so poster sized frames need
+//      only a band of pixels in memory
+//  MeshAnimator --memory-report <file> [<file> ...]
+//      loads skeletons (.txt, .skb), clips (.anm), compressed clips (.anc),
+//      scene snapshots (.snap) and images and prints the memory each holds
+//      and the heap's allocation counts
+
+#include "Tools.h"
+#include "Skeleton.h"
+#include "Animation.h"
+#include "AnimationCompression.h"
+#include "SceneSnapshot.h"
+#include "RenderFarm.h"
+#include "Renderer.h"
+#include "ImageWriter.h"
+#include "MemoryAccounting.h"
+#include <cerrno>
+#include <climits>
+
+//--------------------------------------------------------------
+// Prints the usage of every tool
+static void printUsage()
+{
+	cout << "Usage:" << endl;
+	cout << "  MeshAnimator --clip-report <skeleton.txt|skeleton.skb> <clip.anm> [<clip.anm> ...] [--tolerance <distance>]" << endl;
+	cout << "  MeshAnimator --render-coordinator <scene.snap> <image.png> [--port <port>] [--tile-size <pixels>]" << endl;
+	cout << "      [--local-workers <count>] [--tile-timeout <seconds>]" << endl;
+	cout << "  MeshAnimator --worker <host>:<port>" << endl;
+	cout << "  MeshAnimator --render <scene.snap> <image.tif|image.png> [--size <width>x<height>]" << endl;
+	cout << "  MeshAnimator --memory-report <file> [<file> ...]" << endl;
+}
+
+//--------------------------------------------------------------
+// Reads a whole argument as an integer (false if it isn't one)
+static bool parseInt(const string &text, int &value)
+{
+	char *end;
+	errno = 0;
+	long parsed = strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) return false;
+	value = (int)parsed;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Reads a whole argument as a number (false if it isn't one)
+static bool parseDouble(const string &text, double &value)
+{
+	char *end;
+	errno = 0;
+	double parsed = strtod(text.c_str(), &end);
+	if (text.empty() || *end != '\0' || errno == ERANGE) return false;
+	value = parsed;
+	return true;
+}
+
+//--------------------------------------------------------------
+// Loads a skeleton and clips and prints their compression report
+static int clipReport(const vector<string> &args)
+{
+	string skeletonFile;
+	vector<string> clipFiles;
+	float tolerance = 0.001f;
+
+	// parse the arguments
+	for (int i = 0; i < args.size(); i++) {
+		if (args[i] == "--tolerance" && i + 1 < args.size()) {
+			double value;
+			if (!parseDouble(args[++i], value)) {
+				printUsage();
+				return 1;
+			}
+			tolerance = (float)value;
+		}
+		else if (skeletonFile.empty()) {
+			skeletonFile = args[i];
+		}
+		else {
+			clipFiles.push_back(args[i]);
+		}
+	}
+	if (skeletonFile.empty() || clipFiles.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	// load the skeleton and the clips
+	Skeleton skeleton;
+	if (!skeleton.load(skeletonFile)) return 1;
+	skeleton.evaluate();
+	vector<AnimationClip> clips(clipFiles.size());
+	for (int i = 0; i < clipFiles.size(); i++) {
+		if (!clips[i].load(clipFiles[i])) return 1;
+		clips[i].name = clipFiles[i];
+	}
+
+	printCompressionReport(clips, skeleton, tolerance);
+	return 0;
+}
+
+//--------------------------------------------------------------
+// Loads a scene snapshot, renders it with workers and saves the image
+static int renderCoordinator(const vector<string> &args)
+{
+	string snapshotFile, imageFile;
+	RenderFarmSettings settings;
+
+	// parse the arguments (a value that isn't a number is an error)
+	for (int i = 0; i < args.size(); i++) {
+		bool bValid = true;
+		if (args[i] == "--port" && i + 1 < args.size()) {
+			bValid = parseInt(args[++i], settings.port);
+		}
+		else if (args[i] == "--tile-size" && i + 1 < args.size()) {
+			bValid = parseInt(args[++i], settings.tileSize);
+		}
+		else if (args[i] == "--local-workers" && i + 1 < args.size()) {
+			bValid = parseInt(args[++i], settings.localWorkers);
+		}
+		else if (args[i] == "--tile-timeout" && i + 1 < args.size()) {
+			bValid = parseDouble(args[++i], settings.tileTimeout);
+		}
+		else if (snapshotFile.empty()) {
+			snapshotFile = args[i];
+		}
+		else if (imageFile.empty()) {
+			imageFile = args[i];
+		}
+		if (!bValid) {
+			printUsage();
+			return 1;
+		}
+	}
+	if (snapshotFile.empty() || imageFile.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	vector<char> snapshot;
+	int width, height;
+	if (!loadSnapshotFile(snapshotFile, snapshot) || !SceneSnapshot::readImageSize(snapshot, width, height)) return 1;
+
+	// TIFF and PNG images are streamed to disk as their bands finish
+	unique_ptr<ImageStreamWriter> writer(createImageStreamWriter(imageFile));
+	if (writer) {
+		if (!writer->open(imageFile, width, height)) return 1;
+		return renderDistributed(snapshot, settings, *writer) ? 0 : 1;
+	}
+	// (this process has no GL context, so the image mustn't create a texture)
+	ofImage image;
+	image.setUseTexture(false);
+	if (!renderDistributed(snapshot, settings, image)) return 1;
+	if (!image.save(imageFile)) {
+		cout << "Couldn't write " << imageFile << endl;
+		return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------
+// Loads a scene snapshot and renders it on this machine, streaming
+//  the image to disk
+static int renderLocal(const vector<string> &args)
+{
+	string snapshotFile, imageFile;
+	int width = 0, height = 0;
+
+	// parse the arguments
+	for (int i = 0; i < args.size(); i++) {
+		if (args[i] == "--size" && i + 1 < args.size()) {
+			if (sscanf(args[++i].c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				printUsage();
+				return 1;
+			}
+		}
+		else if (snapshotFile.empty()) {
+			snapshotFile = args[i];
+		}
+		else if (imageFile.empty()) {
+			imageFile = args[i];
+		}
+	}
+	unique_ptr<ImageStreamWriter> writer(createImageStreamWriter(imageFile));
+	if (snapshotFile.empty() || !writer) {
+		printUsage();
+		return 1;
+	}
+
+	vector<char> buffer;
+	SceneSnapshot snapshot;
+	if (!loadSnapshotFile(snapshotFile, buffer) || !snapshot.read(buffer)) {
+		cout << "Couldn't read scene snapshot " << snapshotFile << endl;
+		return 1;
+	}
+	if (width > 0) {
+		snapshot.width = width;
+		snapshot.height = height;
+	}
+	if (!writer->open(imageFile, snapshot.width, snapshot.height)) return 1;
+	Renderer renderer;
+	if (!renderer.renderToWriter(snapshot.getScene(), *writer)) {
+		cout << "Couldn't write " << imageFile << endl;
+		return 1;
+	}
+	cout << "Rendered " << snapshot.width << "x" << snapshot.height << " image in " << renderer.renderTime << " s" << endl;
+	return 0;
+}
+
+//--------------------------------------------------------------
+// Loads every file by its extension and reports the memory it holds
+//  (the assets stay loaded until the report is printed, so the heap
+//  counters include them)
+static int memoryReport(const vector<string> &args)
+{
+	if (args.empty()) {
+		printUsage();
+		return 1;
+	}
+	MemoryReport report;
+	vector<unique_ptr<Skeleton>> skeletons;
+	vector<unique_ptr<AnimationClip>> clips;
+	vector<unique_ptr<CompressedClip>> compressedClips;
+	vector<unique_ptr<SceneSnapshot>> snapshots;
+	vector<unique_ptr<ofImage>> images;
+	for (const string &fileName : args) {
+		size_t dot = fileName.rfind('.');
+		string extension = dot == string::npos ? "" : fileName.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "txt" || extension == "skb") {
+			skeletons.emplace_back(new Skeleton());
+			if (!skeletons.back()->load(fileName)) return 1;
+			skeletons.back()->evaluate();
+			report.add("Skeletons", fileName, skeletons.back()->getSizeInBytes(),
+				std::to_string(skeletons.back()->size()) + " joints");
+		}
+		else if (extension == "anm") {
+			clips.emplace_back(new AnimationClip());
+			if (!clips.back()->load(fileName)) return 1;
+			report.add("Animation", fileName, CompressedClip::getRawSizeInBytes(*clips.back()),
+				std::to_string(clips.back()->tracks.size()) + " tracks");
+		}
+		else if (extension == "anc") {
+			compressedClips.emplace_back(new CompressedClip());
+			if (!compressedClips.back()->load(fileName)) return 1;
+			report.add("Animation", fileName, compressedClips.back()->getSizeInBytes(),
+				std::to_string(compressedClips.back()->tracks.size()) + " tracks");
+		}
+		else if (extension == "snap") {
+			vector<char> buffer;
+			snapshots.emplace_back(new SceneSnapshot());
+			if (!loadSnapshotFile(fileName, buffer) || !snapshots.back()->read(buffer)) {
+				cout << "Couldn't read scene snapshot " << fileName << endl;
+				return 1;
+			}
+			snapshots.back()->addToReport(report);
+		}
+		else {
+			images.emplace_back(new ofImage());
+			images.back()->setUseTexture(false);
+			if (!images.back()->load(fileName)) {
+				cout << "Couldn't load " << fileName << endl;
+				return 1;
+			}
+			report.addImage(fileName, *images.back());
+		}
+	}
+	report.print();
+	return 0;
+}
+
+//--------------------------------------------------------------
+// Runs the tool named by the first argument
+int runTool(int argc, char *argv[])
+{
+	string tool = argv[1];
+	vector<string> args(argv + 2, argv + argc);
+	if (tool == "--clip-report") return clipReport(args);
+	if (tool == "--render-coordinator") return renderCoordinator(args);
+	if (tool == "--render") return renderLocal(args);
+	if (tool == "--memory-report") return memoryReport(args);
+	if (tool == "--worker" && args.size() == 1) return runRenderWorker(args[0]);
+	printUsage();
+	return 1;
+}
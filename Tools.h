@@ -0,0 +1,10 @@
+// This file provides declarations of the headless command line tools.
+// Running the program with arguments runs a tool instead of opening
+//  the viewer.
+
+#pragma once
+
+#include "ofMain.h"
+
+// Runs the tool named by the first argument and returns the exit code
+int runTool(int argc, char *argv[]);
@@ -0,0 +1,322 @@
+// This file provides implementation of the TriangleBlocks class methods
+//  and of the scalar, SSE and AVX2 block kernels.
+
+#include "TriangleBlocks.h"
+
+// the SIMD kernels are only built for x86 processors
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRIANGLE_BLOCKS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX intrinsics without extra flags
+#define TARGET_AVX2
+#else
+// GCC and Clang compile just the AVX2 kernel for AVX2, so the rest of the
+//  program still runs on CPUs without it
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// SSE2 is part of every x86-64 CPU (and of 32 bit builds that ask for it)
+#if defined(TRIANGLE_BLOCKS_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TRIANGLE_BLOCKS_SSE
+#endif
+
+// determinants closer to zero than this belong to rays parallel to the
+//  triangle (the tolerance used by glm::intersectRayTriangle)
+static const float PARALLEL_EPSILON = std::numeric_limits<float>::epsilon();
+
+// signature shared by the kernels
+typedef int (*BlockKernel)(const TriangleBlock *blocks, int numBlocks, const glm::vec3 &origin,
+	const glm::vec3 &direction, float tMin, float &tMax, glm::vec2 &barycentric);
+
+//--------------------------------------------------------------
+// Packs up to eight triangles into a block, leaving unused lanes
+//  with zero edges (which no ray hits)
+static void packBlock(TriangleBlock &block, const vector<glm::vec3> &verts, const vector<int> &indices,
+	const int *triangles, int count)
+{
+	for (int lane = 0; lane < TRIANGLE_BLOCK_SIZE; lane++) {
+		glm::vec3 v0(0), e1(0), e2(0);
+		int triangle = -1;
+		if (lane < count) {
+			triangle = triangles[lane];
+			const int *tri = &indices[3 * triangle];
+			v0 = verts[tri[0]];
+			e1 = verts[tri[1]] - v0;
+			e2 = verts[tri[2]] - v0;
+		}
+		block.v0x[lane] = v0.x; block.v0y[lane] = v0.y; block.v0z[lane] = v0.z;
+		block.e1x[lane] = e1.x; block.e1y[lane] = e1.y; block.e1z[lane] = e1.z;
+		block.e2x[lane] = e2.x; block.e2y[lane] = e2.y; block.e2z[lane] = e2.z;
+		block.triangle[lane] = triangle;
+	}
+}
+
+//--------------------------------------------------------------
+// Tests the lanes one at a time
+static int intersectScalar(const TriangleBlock *blocks, int numBlocks, const glm::vec3 &origin,
+	const glm::vec3 &direction, float tMin, float &tMax, glm::vec2 &barycentric)
+{
+	int closest = -1;
+	for (int b = 0; b < numBlocks; b++) {
+		const TriangleBlock &block = blocks[b];
+		for (int lane = 0; lane < TRIANGLE_BLOCK_SIZE; lane++) {
+			glm::vec3 e1(block.e1x[lane], block.e1y[lane], block.e1z[lane]);
+			glm::vec3 e2(block.e2x[lane], block.e2y[lane], block.e2z[lane]);
+			glm::vec3 p = glm::cross(direction, e2);
+			float det = glm::dot(e1, p);
+			if (fabs(det) <= PARALLEL_EPSILON) continue;
+			float inverseDet = 1.0f / det;
+			glm::vec3 s = origin - glm::vec3(block.v0x[lane], block.v0y[lane], block.v0z[lane]);
+			float u = glm::dot(s, p) * inverseDet;
+			if (u < 0 || u > 1) continue;
+			glm::vec3 q = glm::cross(s, e1);
+			float v = glm::dot(direction, q) * inverseDet;
+			if (v < 0 || u + v > 1) continue;
+			float t = glm::dot(e2, q) * inverseDet;
+			if (t < tMin || t >= tMax) continue;
+			tMax = t;
+			closest = block.triangle[lane];
+			barycentric = glm::vec2(u, v);
+		}
+	}
+	return closest;
+}
+
+#ifdef TRIANGLE_BLOCKS_SSE
+//--------------------------------------------------------------
+// Tests four lanes per instruction (each block in two halves)
+static int intersectSSE(const TriangleBlock *blocks, int numBlocks, const glm::vec3 &origin,
+	const glm::vec3 &direction, float tMin, float &tMax, glm::vec2 &barycentric)
+{
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(PARALLEL_EPSILON), signBit = _mm_set1_ps(-0.0f);
+	const __m128 nearest = _mm_set1_ps(tMin);
+	int closest = -1;
+
+	for (int b = 0; b < numBlocks; b++) {
+		const TriangleBlock &block = blocks[b];
+		for (int half = 0; half < TRIANGLE_BLOCK_SIZE; half += 4) {
+			__m128 e1x = _mm_loadu_ps(block.e1x + half), e1y = _mm_loadu_ps(block.e1y + half), e1z = _mm_loadu_ps(block.e1z + half);
+			__m128 e2x = _mm_loadu_ps(block.e2x + half), e2y = _mm_loadu_ps(block.e2y + half), e2z = _mm_loadu_ps(block.e2z + half);
+
+			// p = direction x e2, det = e1 . p
+			__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 inverseDet = _mm_div_ps(one, det);
+
+			// s = origin - v0, u = (s . p) / det
+			__m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(block.v0x + half));
+			__m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(block.v0y + half));
+			__m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(block.v0z + half));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+			// q = s x e1, v = (direction . q) / det, t = (e2 . q) / det
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+			// lanes that hit inside the triangle and the interval
+			__m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(signBit, det), epsilon);
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, nearest), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+			int hits = _mm_movemask_ps(mask);
+			if (hits == 0) continue;
+
+			// keep the closest of the lanes hit
+			alignas(16) float ts[4], us[4], vs[4];
+			_mm_store_ps(ts, t);
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+			for (int lane = 0; lane < 4; lane++) {
+				if ((hits & (1 << lane)) && ts[lane] < tMax) {
+					tMax = ts[lane];
+					closest = block.triangle[half + lane];
+					barycentric = glm::vec2(us[lane], vs[lane]);
+				}
+			}
+		}
+	}
+	return closest;
+}
+#endif
+
+#ifdef TRIANGLE_BLOCKS_X86
+//--------------------------------------------------------------
+// Tests a whole block per instruction
+TARGET_AVX2 static int intersectAVX2(const TriangleBlock *blocks, int numBlocks, const glm::vec3 &origin,
+	const glm::vec3 &direction, float tMin, float &tMax, glm::vec2 &barycentric)
+{
+	const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+	const __m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	const __m256 epsilon = _mm256_set1_ps(PARALLEL_EPSILON), signBit = _mm256_set1_ps(-0.0f);
+	const __m256 nearest = _mm256_set1_ps(tMin);
+	int closest = -1;
+
+	for (int b = 0; b < numBlocks; b++) {
+		const TriangleBlock &block = blocks[b];
+		__m256 e1x = _mm256_loadu_ps(block.e1x), e1y = _mm256_loadu_ps(block.e1y), e1z = _mm256_loadu_ps(block.e1z);
+		__m256 e2x = _mm256_loadu_ps(block.e2x), e2y = _mm256_loadu_ps(block.e2y), e2z = _mm256_loadu_ps(block.e2z);
+
+		// p = direction x e2, det = e1 . p
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+		__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+		__m256 inverseDet = _mm256_div_ps(one, det);
+
+		// s = origin - v0, u = (s . p) / det
+		__m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(block.v0x));
+		__m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(block.v0y));
+		__m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(block.v0z));
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDet);
+
+		// q = s x e1, v = (direction . q) / det, t = (e2 . q) / det
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDet);
+		__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inverseDet);
+
+		// lanes that hit inside the triangle and the interval
+		__m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(signBit, det), epsilon, _CMP_GT_OQ);
+		mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+		mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+		mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(t, nearest, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+		int hits = _mm256_movemask_ps(mask);
+		if (hits == 0) continue;
+
+		// keep the closest of the lanes hit
+		alignas(32) float ts[8], us[8], vs[8];
+		_mm256_store_ps(ts, t);
+		_mm256_store_ps(us, u);
+		_mm256_store_ps(vs, v);
+		for (int lane = 0; lane < 8; lane++) {
+			if ((hits & (1 << lane)) && ts[lane] < tMax) {
+				tMax = ts[lane];
+				closest = block.triangle[lane];
+				barycentric = glm::vec2(us[lane], vs[lane]);
+			}
+		}
+	}
+	return closest;
+}
+#endif
+
+//--------------------------------------------------------------
+// Returns true if the CPU (and the operating system, which must save
+//  the 256 bit registers) supports AVX2
+static bool cpuSupportsAVX2()
+{
+#if defined(TRIANGLE_BLOCKS_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	bool bAVX = (info[2] & (1 << 28)) != 0;
+	if (!bOSXSave || !bAVX || (_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(TRIANGLE_BLOCKS_X86)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+//--------------------------------------------------------------
+// Returns the fastest kernel the CPU supports
+TriangleKernel getBestTriangleKernel()
+{
+	static const TriangleKernel best = cpuSupportsAVX2() ? TRIANGLE_KERNEL_AVX2 :
+#ifdef TRIANGLE_BLOCKS_SSE
+		TRIANGLE_KERNEL_SSE;
+#else
+		TRIANGLE_KERNEL_SCALAR;
+#endif
+	return best;
+}
+
+//--------------------------------------------------------------
+// Returns the function of a kernel
+static BlockKernel kernelFunction(TriangleKernel kernel)
+{
+	switch (kernel) {
+#ifdef TRIANGLE_BLOCKS_X86
+	case TRIANGLE_KERNEL_AVX2: return intersectAVX2;
+#endif
+#ifdef TRIANGLE_BLOCKS_SSE
+	case TRIANGLE_KERNEL_SSE: return intersectSSE;
+#endif
+	default: return intersectScalar;
+	}
+}
+
+// kernel used by TriangleBlocks::intersect (chosen when the program starts)
+static TriangleKernel currentKernel = getBestTriangleKernel();
+static BlockKernel currentFunction = kernelFunction(currentKernel);
+
+//--------------------------------------------------------------
+// Returns the kernel in use
+TriangleKernel getTriangleKernel()
+{
+	return currentKernel;
+}
+
+//--------------------------------------------------------------
+// Switches kernels, never to one the CPU can't run
+void setTriangleKernel(TriangleKernel kernel)
+{
+	currentKernel = std::min(kernel, getBestTriangleKernel());
+	currentFunction = kernelFunction(currentKernel);
+}
+
+//--------------------------------------------------------------
+// Returns the name of a kernel
+const char *getTriangleKernelName(TriangleKernel kernel)
+{
+	switch (kernel) {
+	case TRIANGLE_KERNEL_AVX2: return "AVX2";
+	case TRIANGLE_KERNEL_SSE: return "SSE";
+	default: return "scalar";
+	}
+}
+
+//--------------------------------------------------------------
+// Appends blocks for the triangles
+int TriangleBlocks::add(const vector<glm::vec3> &verts, const vector<int> &indices, const int *triangles, int count)
+{
+	int firstBlock = (int)blocks.size();
+	blocks.resize(firstBlock + blocksFor(count));
+	pack(firstBlock, verts, indices, triangles, count);
+	return firstBlock;
+}
+
+//--------------------------------------------------------------
+// Fills the blocks eight triangles at a time
+void TriangleBlocks::pack(int firstBlock, const vector<glm::vec3> &verts, const vector<int> &indices,
+	const int *triangles, int count)
+{
+	for (int i = 0; i < count; i += TRIANGLE_BLOCK_SIZE) {
+		packBlock(blocks[firstBlock + i / TRIANGLE_BLOCK_SIZE], verts, indices, triangles + i,
+			std::min(TRIANGLE_BLOCK_SIZE, count - i));
+	}
+}
+
+//--------------------------------------------------------------
+// Runs the current kernel over a range of blocks
+int TriangleBlocks::intersect(int firstBlock, int numBlocks, const glm::vec3 &origin, const glm::vec3 &direction,
+	float tMin, float &tMax, glm::vec2 &barycentric) const
+{
+	if (numBlocks <= 0) return -1;
+	return currentFunction(&blocks[firstBlock], numBlocks, origin, direction, tMin, tMax, barycentric);
+}
@@ -0,0 +1,79 @@
+// This file provides the definition of the TriangleBlocks class, which
+//  stores triangles in blocks of eight laid out one array per coordinate
+//  (structure of arrays), and of the kernels that test a ray against a
+//  whole block at once.
+// Each lane holds a triangle's first vertex and its two edges from that
+//  vertex, so a Moller-Trumbore test needs no index lookups and the eight
+//  lanes are tested together: with AVX2 in one 8-wide pass, with SSE in
+//  two 4-wide passes, and otherwise one lane at a time. The kernel is
+//  chosen once from what the CPU supports when the program starts. Blocks
+//  can hold a whole mesh (testing every triangle) or the triangles of the
+//  leaves of a MeshBVH.
+
+#pragma once
+
+#include "ofMain.h"
+
+// number of triangles in a block
+static const int TRIANGLE_BLOCK_SIZE = 8;
+
+// TriangleBlock: eight triangles as their first vertex and two edges
+//
+struct alignas(32) TriangleBlock {
+	float v0x[TRIANGLE_BLOCK_SIZE], v0y[TRIANGLE_BLOCK_SIZE], v0z[TRIANGLE_BLOCK_SIZE];	// first vertex
+	float e1x[TRIANGLE_BLOCK_SIZE], e1y[TRIANGLE_BLOCK_SIZE], e1z[TRIANGLE_BLOCK_SIZE];	// second vertex - first vertex
+	float e2x[TRIANGLE_BLOCK_SIZE], e2y[TRIANGLE_BLOCK_SIZE], e2z[TRIANGLE_BLOCK_SIZE];	// third vertex - first vertex
+	int triangle[TRIANGLE_BLOCK_SIZE];		// index of each lane's triangle (-1 for unused lanes, whose edges are zero)
+};
+
+// kernels that test a ray against blocks of triangles
+enum TriangleKernel { TRIANGLE_KERNEL_SCALAR, TRIANGLE_KERNEL_SSE, TRIANGLE_KERNEL_AVX2 };
+
+// Returns the fastest kernel the CPU supports
+TriangleKernel getBestTriangleKernel();
+
+// Returns the kernel used by TriangleBlocks::intersect
+TriangleKernel getTriangleKernel();
+
+// Changes the kernel used by TriangleBlocks::intersect (kernels the CPU
+//  doesn't support fall back on the best one it does). Not thread safe;
+//  meant for comparing kernels.
+void setTriangleKernel(TriangleKernel kernel);
+
+// Returns the name of a kernel
+const char *getTriangleKernelName(TriangleKernel kernel);
+
+// TriangleBlocks class
+//
+class TriangleBlocks {
+public:
+	// Packs the given triangles (indices into a table of three vertex indices
+	//  per triangle) into new blocks at the end and returns the first of them
+	int add(const vector<glm::vec3> &verts, const vector<int> &indices, const int *triangles, int count);
+
+	// Packs the given triangles into the blocks starting at firstBlock
+	//  again, after the vertices moved
+	void pack(int firstBlock, const vector<glm::vec3> &verts, const vector<int> &indices, const int *triangles, int count);
+
+	// Removes every block
+	void clear() { blocks.clear(); }
+
+	// Finds the closest triangle of the blocks [firstBlock, firstBlock + numBlocks)
+	//  hit by the ray origin + t * direction with t in [tMin, tMax). Returns the
+	//  triangle (-1 if none was hit) and shrinks tMax to its distance.
+	int intersect(int firstBlock, int numBlocks, const glm::vec3 &origin, const glm::vec3 &direction,
+		float tMin, float &tMax, glm::vec2 &barycentric) const;
+
+	// Returns the number of blocks needed for count triangles
+	static int blocksFor(int count) { return (count + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE; }
+
+	// Returns true if there are no blocks
+	bool empty() const { return blocks.empty(); }
+
+	// Returns the number of bytes used by the blocks
+	size_t getSizeInBytes() const { return blocks.capacity() * sizeof(TriangleBlock); }
+
+	// Fields of TriangleBlocks class
+	//
+	vector<TriangleBlock> blocks;		// the packed triangles
+};
@@ -1,8 +1,14 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "Tools.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+	// command line arguments run one of the headless tools instead of the viewer
+	if (argc > 1) {
+		return runTool(argc, argv);
+	}
+
 	ofSetupOpenGL(1200,800,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
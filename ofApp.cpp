@@ -10,47 +10,180 @@
 
 #include "ofApp.h"
 
+// kinds of objects in the picking tree
+static const int PICK_JOINT = 0;	// a joint's sphere
+static const int PICK_MESH = 1;		// the mesh attatched to a joint
+
 //--------------------------------------------------------------
 // Returns the size of the mesh in KB
 int Mesh::getMeshSize()
 {
-	return (sizeof(verts[0]) * verts.size() + sizeof(triangles[0]) * triangles.size()) / 1000;
+	return (int)(getMemoryUsage().getTotal() / 1000);
 }
 
 //--------------------------------------------------------------
-// Draws the mesh by iterating through its list of triangles
-//  and drawing them with the stored transformations of the mesh
-//  applied
+// Adds up the capacity of the vertex, normal and triangle arrays, the
+//  hierarchy and the skin
+MeshMemory Mesh::getMemoryUsage() const
+{
+	MeshMemory memory;
+	memory.vertices = getVectorBytes(verts);
+	memory.normals = getVectorBytes(nVerts);
+	memory.triangles = getVectorBytes(triangles);
+	memory.bvh = bvh.getSizeInBytes();
+	memory.skin = skin ? skin->getSizeInBytes() : 0;
+	memory.slack = (verts.capacity() - verts.size()) * sizeof(verts[0]) + (nVerts.capacity() - nVerts.size()) * sizeof(nVerts[0])
+		+ (triangles.capacity() - triangles.size()) * sizeof(triangles[0]);
+	return memory;
+}
+
+//--------------------------------------------------------------
+// Draws the mesh with the stored transformations of the mesh
+//  applied (and the triangles passing through another mesh in red,
+//  drawn over everything)
 void Mesh::draw()
+{
+	PROFILE_ZONE("Mesh::draw");
+	ofPushMatrix();
+	ofMultMatrix(this->meshTransMatrix);
+	drawTriangles();
+	if (!collidingTriangles.empty()) {
+		// over the rest of the scene, as they are mostly buried in the other mesh
+		ofDisableDepthTest();
+		ofSetColor(ofColor::red);
+		ofFill();
+		for (int t : collidingTriangles) {
+			const Triangle &tri = triangles[t];
+			ofDrawTriangle(verts[tri.vertInd[0]], verts[tri.vertInd[1]], verts[tri.vertInd[2]]);
+		}
+		ofEnableDepthTest();
+	}
+	ofPopMatrix();
+}
+
+//--------------------------------------------------------------
+// Draws the mesh by iterating through its list of triangles
+//  (in the mesh's object space)
+void Mesh::drawTriangles()
 {
 	// Makes drawing of mesh in viewer transparent and filled
 	ofEnableAlphaBlending();
 	ofSetColor(ofColor::gray, 160);
 	ofFill();
 
-	// Integer variables to hold vertices of Triangle
-	int v1, v2, v3;
-
 	// Iterate through and draw each Triangle in Mesh
-	for (Triangle t : triangles) {
-		// Record indices of vertices of triangle
-		v1 = t.vertInd[0];
-		v2 = t.vertInd[1];
-		v3 = t.vertInd[2];
-		// Draw triangle using recorded vertices with
-		//  mesh's stored transformations applied
-		ofPushMatrix();
-		ofMultMatrix(this->meshTransMatrix);
-		ofDrawTriangle(verts[v1], verts[v2], verts[v3]);
-		ofPopMatrix();
-		
+	for (const Triangle &t : triangles) {
+		ofDrawTriangle(verts[t.vertInd[0]], verts[t.vertInd[1]], verts[t.vertInd[2]]);
 	}
 	ofDisableAlphaBlending();
 }
 
+//--------------------------------------------------------------
+// Builds the bounding volume hierarchy over the triangles of the
+//  mesh in object space (with its leaves packed for the block kernel)
+void Mesh::buildBVH()
+{
+	bvh.build(verts, getVertexIndices(), true);
+}
+
+//--------------------------------------------------------------
+// Lists the three position vertex indices of each triangle
+vector<int> Mesh::getVertexIndices() const
+{
+	vector<int> indices;
+	indices.reserve(triangles.size() * 3);
+	for (int i = 0; i < triangles.size(); i++) {
+		indices.push_back(triangles[i].vertInd[0]);
+		indices.push_back(triangles[i].vertInd[1]);
+		indices.push_back(triangles[i].vertInd[2]);
+	}
+	return indices;
+}
+
+//--------------------------------------------------------------
+// Orders the triangles in spatially compact clusters, each ordered for
+//  the vertex cache, then numbers the position and normal vertices in
+//  the order the triangles first use them. The new number of every
+//  vertex the file had is kept in vertexRemap, so files that number the
+//  vertices like the mesh file (skin weights) can still be read.
+void Mesh::optimizeOrder(int clusterSize)
+{
+	vector<int> order = orderTrianglesForCache(verts, getVertexIndices(), clusterSize);
+	vector<Triangle> ordered;
+	ordered.reserve(triangles.size());
+	for (int i = 0; i < order.size(); i++) ordered.push_back(triangles[order[i]]);
+	triangles.swap(ordered);
+
+	// number the position vertices by first use
+	vector<int> remap = orderVerticesByFirstUse(getVertexIndices(), (int)verts.size());
+	vector<glm::vec3> remapped(verts.size());
+	for (int i = 0; i < verts.size(); i++) remapped[remap[i]] = verts[i];
+	verts.swap(remapped);
+
+	// and the normal vertices
+	vector<int> normalIndices;
+	normalIndices.reserve(triangles.size() * 3);
+	for (const Triangle &t : triangles) normalIndices.insert(normalIndices.end(), t.nVertInd, t.nVertInd + 3);
+	vector<int> normalRemap = orderVerticesByFirstUse(normalIndices, (int)nVerts.size());
+	remapped.resize(nVerts.size());
+	for (int i = 0; i < nVerts.size(); i++) remapped[normalRemap[i]] = nVerts[i];
+	nVerts.swap(remapped);
+
+	for (Triangle &t : triangles) {
+		for (int k = 0; k < 3; k++) {
+			t.vertInd[k] = remap[t.vertInd[k]];
+			t.nVertInd[k] = normalRemap[t.nVertInd[k]];
+		}
+	}
+	// compose with an earlier reordering
+	if (vertexRemap.empty()) vertexRemap = remap;
+	else for (int &v : vertexRemap) v = remap[v];
+	markGeometryChanged();
+}
+
+//--------------------------------------------------------------
+// Binds the mesh to the skeleton's current pose. The mesh's current
+//  transformation is baked into the bind vertices, every vertex gets
+//  weights from its proximity to the bones, and from then on the
+//  vertices are written in world space by the skin.
+void Mesh::bindSkin(const Skeleton &skeleton)
+{
+	// bake the current transformation into the vertices
+	glm::mat4 normalMatrix = glm::transpose(glm::inverse(meshTransMatrix));
+	for (int i = 0; i < verts.size(); i++) {
+		verts[i] = meshTransMatrix * glm::vec4(verts[i], 1);
+	}
+	for (int i = 0; i < nVerts.size(); i++) {
+		nVerts[i] = glm::normalize(glm::vec3(normalMatrix * glm::vec4(nVerts[i], 0)));
+	}
+	setMeshTransMatrix(glm::mat4(1.0));
+	buildBVH();
+
+	// map each normal vertex to a position vertex sharing its triangle corner
+	vector<int> normalToVert(nVerts.size(), -1);
+	for (int i = 0; i < triangles.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			normalToVert[triangles[i].nVertInd[k]] = triangles[i].vertInd[k];
+		}
+	}
+
+	// create the skin and generate its weights
+	if (!skin) skin.reset(new Skin());
+	skin->bind(skeleton, verts, nVerts, normalToVert);
+	skin->generateWeights(skeleton);
+}
+
+//--------------------------------------------------------------
+// Stops a distributed render still running
+ofApp::~ofApp() {
+	bFarmCancel = true;
+	if (farmThread.joinable()) farmThread.join();
+}
+
 //--------------------------------------------------------------
 // Provides initial setup for the cameras, scene, and image instances.
 void ofApp::setup() {
+	Profiler::setThreadName("main");
 	// camera setup
 	ofSetBackgroundColor(ofColor::black);
 	theCam = &mainCam;
@@ -78,10 +211,11 @@ void ofApp::setup() {
 	// adds the floor plane to the scene
 	meshScene.push_back(floor);
 
-	// adds Light instances to lights vector
-	addLight(new PointLight(glm::vec3(0, 4, 0), 100, 0.1));
-	addLight(new PointLight(glm::vec3(-5, 2, 2), 100, 0.1));
-	addLight(new PointLight(glm::vec3(3, 5, -2), 100, 0.1));
+	// adds Light instances to lights vector (area lights with a size of 0
+	//  are point lights until the Light Size slider grows them)
+	addLight(new RectLight(glm::vec3(0, 4, 0), 100, glm::vec3(0), glm::vec3(0)));
+	addLight(new SphereLight(glm::vec3(-5, 2, 2), 100, 0));
+	addLight(new SphereLight(glm::vec3(3, 5, -2), 100, 0));
 
 	// initializes the image ofImage instance to be drawn by rayTrace method
 	image.allocate(imageWidth, imageHeight, ofImageType::OF_IMAGE_COLOR);
@@ -92,23 +226,115 @@ void ofApp::setup() {
 	gui.add(power.setup("Phong Power", 20, 0, 100));
 	gui.add(intensity.setup("P-Lights Intensity", 15, 0, 100));
 	gui.add(smoothMesh.setup("Smooth Shading", true, 20, 20));
+	gui.add(clipTimeSlider.setup("Clip Time", 0, 0, 10));
+	gui.add(crowdSize.setup("Crowd Size", 100, 1, 1000));
+	gui.add(ikChainLength.setup("IK Chain Length", 2, 1, 10));
+	gui.add(ccdIK.setup("CCD IK", false, 20, 20));
+	gui.add(crowdIK.setup("Crowd IK", true, 20, 20));
+	gui.add(binarySkeleton.setup("Save Binary Skeleton", false, 20, 20));
+	gui.add(lightSize.setup("Light Size", 0, 0, 2));
+	gui.add(lightSamples.setup("Light Samples", 16, 1, 256));
+	gui.add(sobolSampling.setup("Sobol Sampling", true, 20, 20));
+	gui.add(phongHighlights.setup("Phong Highlights", true, 20, 20));
+	gui.add(castShadows.setup("Shadows", true, 20, 20));
+	gui.add(optimizeMeshOrder.setup("Optimize Mesh Order", true, 20, 20));
+	gui.add(collisionChecks.setup("Collision Checks", true, 20, 20));
+	gui.add(blockCollisions.setup("Block Collisions", false, 20, 20));
 }
 
 //--------------------------------------------------------------
 // Update each light's intensity and the power of phong shading
 //  to values shown in gui
 void ofApp::update() {
+	Profiler::beginFrame();
+	PROFILE_ZONE("ofApp::update");
 
 	// Sets each light's intensity value to current value in the gui
 	for (int i = 0; i < lights.size(); i++) {
 		lights[i]->setIntensity(intensity);
 	}
+	// Resizes the area lights to the current value in the gui (the overhead
+	//  light is a square panel facing down, the others are spheres)
+	if (lightSize != areaLightSize) {
+		areaLightSize = lightSize;
+		for (int i = 0; i < lights.size(); i++) {
+			if (SphereLight *sphereLight = dynamic_cast<SphereLight *>(lights[i])) {
+				sphereLight->radius = areaLightSize * 0.5f;
+			}
+			else if (RectLight *rectLight = dynamic_cast<RectLight *>(lights[i])) {
+				rectLight->edgeU = glm::vec3(areaLightSize, 0, 0);
+				rectLight->edgeV = glm::vec3(0, 0, areaLightSize);
+			}
+			lights[i]->markChanged();
+		}
+	}
 	// Sets phong shading power to current value on gui
 	phongPower = power;
 	// Sets smooth shading boolean value of all scene objects in meshScene
 	for (int i = 0; i < meshScene.size(); i++) {
 		meshScene[i]->smoothShading = smoothMesh;
 	}
+	// Recompiles the flat skeleton if joints were added or removed
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
+		// the crowd's attatched meshes are looked up by joint index, so re-create it
+		if (bShowCrowd) spawnCrowd();
+	}
+	// Advances clip playback, or follows the clip time slider if it was scrubbed
+	bool bSampleClip = false;
+	float clipDuration = bUseCompressedClip ? compressedClip.duration : clip.duration;
+	if (bPlaying && clipDuration > 0) {
+		clipTime = bUseCompressedClip ? compressedClip.wrapTime(clipTime + ofGetLastFrameTime())
+			: clip.wrapTime(clipTime + ofGetLastFrameTime());
+		clipTimeSlider = clipTime;
+		bSampleClip = true;
+	}
+	else if (clipTimeSlider != lastSliderTime) {
+		clipTime = clipTimeSlider;
+		bSampleClip = bUseCompressedClip ? compressedClip.tracks.size() > 0 : clip.tracks.size() > 0;
+	}
+	lastSliderTime = clipTimeSlider;
+	// Evaluates the current pose of the skeleton (posed by the clip if it is playing or scrubbed)
+	skeleton.pullPose();
+	if (bSampleClip) {
+		// a render of the old pose is of no use any more
+		renderThread.cancel();
+		if (bUseCompressedClip) compressedClip.sample(clipTime, skeleton);
+		else clip.sample(clipTime, skeleton);
+		skeleton.pushPose();
+	}
+	skeleton.evaluate();
+	// Deforms skinned meshes with the current pose (refitting their hierarchies to the moved vertices)
+	for (int i = 0; i < skinnedMeshes.size(); i++) {
+		Mesh *mesh = meshPool.get(skinnedMeshes[i]);
+		if (mesh == NULL) continue;
+		PROFILE_ZONE("Skin::deform");
+		if (mesh->skin->deform(skeleton, mesh->verts, mesh->nVerts)) {
+			mesh->bvh.refit(mesh->verts);
+			mesh->markGeometryChanged();
+		}
+	}
+	// Removes the highlights of the last collision check once checks are turned off
+	if (!collisionChecks && !collisions.empty()) clearCollisions();
+	// Moves the picking tree's boxes to the new pose
+	updatePickTree();
+	// Poses the crowd instances
+	updateCrowd();
+	// Saves the image of a background render that finished
+	if (renderThread.takeImage(image)) {
+		cout << "traced " << renderThread.tilesTraced << " of " << renderThread.tileCount << " tiles in "
+			<< renderThread.renderTime * 1000.0 << " ms" << endl;
+		image.save("newImage.png");
+	}
+	// Saves the image of a distributed render that finished
+	if (farmThread.joinable() && !bFarmBusy) {
+		farmThread.join();
+		if (bFarmFinished) {
+			image.setFromPixels(farmImage.getPixels());
+			image.save("newImage.png");
+		}
+	}
 }
 
 //--------------------------------------------------------------
@@ -116,11 +342,26 @@ void ofApp::update() {
 // User can also toggle to see drawing of the completed rendering
 //	with the 'P' key.
 void ofApp::draw() {
+	PROFILE_ZONE("ofApp::draw");
 	// draws the SceneObjects in the 3D view if bShowImage = false
 	if (!bShowImage) {
 		// show gui
 		ofDisableDepthTest();
-		gui.draw();
+		{
+			PROFILE_ZONE("ofxPanel::draw");
+			gui.draw();
+		}
+		// show how far the background render got
+		if (renderThread.isBusy()) {
+			ofSetColor(ofColor::white);
+			ofDrawBitmapString("Rendering " + ofToString((int)(renderThread.getProgress() * 100)) + "%", 10, ofGetHeight() - 10);
+		}
+		if (bFarmBusy) {
+			ofSetColor(ofColor::white);
+			ofDrawBitmapString("Rendering with workers", 10, ofGetHeight() - 25);
+		}
+		// show where the last frame's time went
+		if (bShowProfile) Profiler::drawOverlay(ofGetWidth() - 400, 20);
 		ofEnableDepthTest();
 		// 3D transformation for the camera
 		theCam->begin();
@@ -133,7 +374,7 @@ void ofApp::draw() {
 		// lighting in viewer enabled
 		ofEnableLighting();
 		for (int i = 0; i < joints.size(); i++) {
-			if (objSelected() && joints[i] == selected[0])
+			if (objSelected() && joints[i] == getSelected())
 				ofSetColor(ofColor::yellow);	// set color of selected joint to yellow
 			else ofSetColor(joints[i]->diffuseColor);
 			joints[i]->draw();
@@ -141,14 +382,25 @@ void ofApp::draw() {
 		meshScene[0]->draw();
 		ofDisableLighting();
 
+		// Draw the bones of every crowd instance
+		ofSetColor(ofColor::blue);
+		for (int n = 0; n < crowd.size(); n++) {
+			const SkeletonPose &pose = crowd.instances[n].pose;
+			for (int i = 0; i < skeleton.size() && i < pose.worldMatrices.size(); i++) {
+				if (skeleton.parents[i] >= 0) {
+					ofDrawLine(pose.getWorldPosition(skeleton.parents[i]), pose.getWorldPosition(i));
+				}
+			}
+		}
+
 		// Draw all of the meshes in the meshScene vector and the 
 		// referenceMesh if it is not NULL with 
 		// lighting in viewer disabled
 		for (int i = 1; i < meshScene.size(); i++) {
 			meshScene[i]->draw();
 		}
-		if (referenceMesh != NULL) {
-			referenceMesh->draw();
+		if (meshPool.get(referenceMesh) != NULL) {
+			meshPool.get(referenceMesh)->draw();
 		}
 
 		// Draw all Lights in light vector
@@ -210,123 +462,145 @@ void ofApp::printChannels(SceneObject *obj) {
 	cout << "scale = glm::vec3(" << obj->scale.x << "," << obj->scale.y << "," << obj->scale.z << ");" << endl;
 }
 
+//--------------------------------------------------------------
+// Prints the memory held by every mesh (attatched, reference and skinned
+//  meshes, crowd placements excluded since they share their mesh), the
+//  skeleton and crowd poses, the object pools, the clips and the images
+//
+void ofApp::printMemoryReport() {
+	MemoryReport report;
+	vector<Mesh *> meshes;
+	for (SceneObject *object : meshScene) {
+		if (Mesh *mesh = dynamic_cast<Mesh *>(object)) meshes.push_back(mesh);
+	}
+	if (meshPool.get(referenceMesh) != NULL) meshes.push_back(meshPool.get(referenceMesh));
+	for (Mesh *mesh : meshes) {
+		MeshMemory memory = mesh->getMemoryUsage();
+		report.add("Meshes", mesh->getName() + (mesh == meshPool.get(referenceMesh) ? " (reference)" : ""), memory.getTotal(),
+			std::to_string(mesh->triangles.size()) + " triangles: " + memory.getDetails());
+	}
+	report.add("Skeletons", "skeleton", skeleton.getSizeInBytes(), std::to_string(skeleton.size()) + " joints");
+	if (crowd.size() > 0) {
+		report.add("Skeletons", "crowd poses", crowd.size() * crowd.getInstanceSizeInBytes(),
+			std::to_string(crowd.size()) + " instances");
+	}
+	report.add("Scene objects", "joints", jointPool.getSizeInBytes(), std::to_string(jointPool.size()) + " joints");
+	report.add("Scene objects", "meshes", meshPool.getSizeInBytes(), std::to_string(meshPool.size()) + " meshes");
+	report.add("Scene objects", "mesh placements", instancePool.getSizeInBytes(), std::to_string(instancePool.size()) + " placements");
+	report.add("Animation", clip.name, CompressedClip::getRawSizeInBytes(clip), std::to_string(clip.tracks.size()) + " tracks");
+	if (compressedClip.tracks.size() > 0) {
+		report.add("Animation", "compressed " + clip.name, compressedClip.getSizeInBytes(),
+			std::to_string(compressedClip.tracks.size()) + " tracks");
+	}
+	report.addImage("rendered image", image);
+	report.addImage("preview image", prevImage);
+	report.addImage("plane texture", planeTexture);
+	if (floor->textureApplied) report.addImage("floor texture", floor->textureImg);
+	report.print();
+}
+
 //--------------------------------------------------------------
 // Creates script file to store current skeleton
 //
 void ofApp::createFile() {
-	// creates and instantiates name of new joint script file
-	string newFileName = "skeleton_" + std::to_string(joints.size()) + "_joints.txt";
-
-	// output stream for new file
-	ofstream outputStream;
-
-	// creates and opens new file to write to
-	outputStream.open(newFileName);
-
-	// iterate through all joints in the joints vector
-	for (int i = 0; i < joints.size(); i++) {
-		if (joints[i]->getName() != "no name") {
-			// add current joint's name to line
-			outputStream << "create -joint " << joints[i]->getName();
-			// add current joint's rotation to line
-			outputStream << " -rotate <" << joints[i]->rotation.x << ", " << joints[i]->rotation.y << ", " << joints[i]->rotation.z << ">";
-			// add current joint's translation to line
-			outputStream << " -translate <" << joints[i]->position.x << ", " << joints[i]->position.y << ", " << joints[i]->position.z << ">";
-			// add current joint's parent to line if it exists
-			if (joints[i]->parent) {
-				outputStream << " -parent " << joints[i]->parent->getName();
-			}
-			// skip outputStream to next line
-			outputStream << "\n";
-		}
+	// the file is written from the compiled skeleton (parents before their children)
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
 	}
+	skeleton.pullPose();
+
+	// creates and instantiates name of new joint script file (or binary skeleton file)
+	string newFileName = "skeleton_" + std::to_string(joints.size()) + "_joints" + (binarySkeleton ? ".skb" : ".txt");
 
-	// detaches file from output stream
-	outputStream.close();
+	// writes one line per joint (or the joint table, channels and names of the binary format)
+	bool bSaved = binarySkeleton ? skeleton.saveBinary(newFileName) : skeleton.saveScript(newFileName);
+	if (!bSaved) return;
 
 	// message showing file was saved
 	cout << "Saved current skeleton to file " + newFileName + "\n" << endl;
+
+	// saves the animation clip next to the skeleton if it has keys
+	if (clip.getNumKeys() > 0) {
+		string clipFileName = "animation_" + std::to_string(joints.size()) + "_joints.anm";
+		if (clip.save(clipFileName)) {
+			cout << "Saved animation clip to file " + clipFileName + "\n" << endl;
+		}
+	}
+	// saves the compressed clip as well if it is being played
+	if (bUseCompressedClip) {
+		string compressedFileName = "animation_" + std::to_string(joints.size()) + "_joints.anc";
+		if (compressedClip.save(compressedFileName)) {
+			cout << "Saved compressed animation clip to file " + compressedFileName + "\n" << endl;
+		}
+	}
 }
 
 //--------------------------------------------------------------
-// Parses through script file and adds joints to joints vector
-//  with specified name, rotation, translation, and parent
+// Reads a script file (or a binary .skb skeleton file) and adds
+//  joints to joints vector with specified name, rotation,
+//  translation, and parent
+// (the file is read into a Skeleton first, which resolves parent
+//  names in one pass and lists parents before their children, so
+//  every joint's parent already exists when the joint is added)
 //
 void ofApp::loadScriptFile(string fileName)
 {
+	PROFILE_ZONE("ofApp::loadScriptFile");
+	Skeleton loaded;			// joint table read from the file
+	if (!loaded.load(fileName)) {	// checks if file opening failed
+		exit();	// special system call to abort program
+		return;
+	}
+
+	// removes the crowd's mesh placements (the crowd is re-created for the new skeleton)
+	clearCrowd();
 	// removes all meshes from scene
 	meshScene.erase(meshScene.begin() + 1, meshScene.begin() + meshScene.size());
+	// removes all skinned meshes
+	skinnedMeshes.clear();
 	// removes all joints from the joints vector
 	joints.clear();
-	// clear selection vector
-	selected.clear();
-
-	ifstream inputStream;		// input stream
-	string read;				// reads from input stream
-	string tempString;			// temporarily stores string read from input stream
-	string readName;			// holds name of joint read from file
-	string parentName;			// holds name of parent read from file
-	glm::vec3 readRotate;		// holds the rotation read from file
-	glm::vec3 readTranslate;	// holds the translation read from file
-	Joint *jointToAdd;			// holds joint to be added to joints vector
-	float v1, v2, v3;			// temprorarily stores values of vertices read for rotation and translation
-
-	// attaches file to input stream
-	inputStream.open(fileName);
-
-	if (!inputStream) {	// checks if file opening failed
-		cout << "File open failed" << endl;
-		exit();	// special system call to abort program
+	jointRegistry.clear();
+	jointCount = 0;
+	// frees the previous joints and meshes (the reference mesh is kept
+	//  by moving it into the emptied pool)
+	Mesh *reference = meshPool.get(referenceMesh);
+	Mesh keptReference;
+	if (reference) keptReference = std::move(*reference);
+	meshRegistry.clear();
+	sceneFreezer.clear();
+	meshPool.clear();
+	jointPool.clear();
+	pickTree.clear();
+	jointProxies.clear();
+	meshProxies.clear();
+	if (reference) {
+		reference = meshPool.create(std::move(keptReference));
+		referenceMesh = meshPool.handleOf(reference);
+		meshRegistry.add(reference);
 	}
-	else {
-		// read from input stream
-		while (inputStream >> read) {
-			if (read == "create") {
-				// create new joint and adds it to joints vector
-				jointToAdd = new Joint();
-				joints.push_back(jointToAdd);
-			}
-			else if (read == "-joint") {
-				// sets the name of the new joint
-				inputStream >> readName;
-				jointToAdd->name = readName;
-			}
-			else if (read == "-rotate") {
-				// gets and sets rotation of new joint
-				inputStream >> tempString;
-				v1 = stof(tempString.substr(1, tempString.find(",")));
-				inputStream >> tempString;
-				v2 = stof(tempString.substr(0, tempString.find(",")));
-				inputStream >> tempString;
-				v3 = stof(tempString.substr(0, tempString.find(">")));
-
-				readRotate = glm::vec3(v1, v2, v3);
-				jointToAdd->rotation = readRotate;
-			}
-			else if (read == "-translate") {
-				// gets and sets translation of new joint
-				inputStream >> tempString;
-				v1 = stof(tempString.substr(1, tempString.find(",")));
-				inputStream >> tempString;
-				v2 = stof(tempString.substr(0, tempString.find(",")));
-				inputStream >> tempString;
-				v3 = stof(tempString.substr(0, tempString.find(">")));
-
-				readTranslate = glm::vec3(v1, v2, v3);
-				jointToAdd->position = readTranslate;
-			}
-			else if (read == "-parent") {
-				// gets and sets parent of new joint (if it exists)
-				inputStream >> parentName;
-				for (int i = 0; i < joints.size(); i++) {
-					if (joints[i]->getName() == parentName)
-						joints[i]->addChild(jointToAdd);
-				}
-			}
+	// clear selection vector
+	selected = PoolHandle<Joint>();
+	// skeleton must be recompiled from the new joints
+	bSkeletonChanged = true;
+
+	// create a joint for every entry of the joint table
+	joints.reserve(loaded.size());
+	for (int i = 0; i < loaded.size(); i++) {
+		Joint *jointToAdd = jointPool.create();
+		jointToAdd->name = loaded.names[i];
+		jointToAdd->setRotation(glm::vec3(loaded.rotX[i], loaded.rotY[i], loaded.rotZ[i]));
+		jointToAdd->setLocalPosition(glm::vec3(loaded.posX[i], loaded.posY[i], loaded.posZ[i]));
+		jointToAdd->setScale(glm::vec3(loaded.scaleX[i], loaded.scaleY[i], loaded.scaleZ[i]));
+		// sets parent of new joint (if it has one)
+		if (loaded.parents[i] >= 0) {
+			joints[loaded.parents[i]]->addChild(jointToAdd);
 		}
+		joints.push_back(jointToAdd);
+		jointRegistry.add(jointToAdd);
 	}
-	// detaches file from input stream
-	inputStream.close();
+	cout << "Loaded " << joints.size() << " joints from " << fileName << "\n" << endl;
 }
 
 //--------------------------------------------------------------
@@ -338,26 +612,18 @@ void ofApp::deleteJoint() {
 	SceneObject *currentChild;	// holds reference to current child in joint's child list
 	glm::vec3 resetPosition;	// holds currentChild's position in world space
 	glm::vec3 resetRotation;	// holds currentChild's rotation
-	string currentJointName;	// holds the joint's name
-	if (selected.size() > 0) {
+	if (objSelected()) {
 		// set jointToDelete to currrently selected joint
-		jointToDelete = selected[0];
-		// set currentJointName to currently selected joint's name
-		currentJointName = jointToDelete->getName();
+		jointToDelete = getSelected();
 
 		// check if the current joint has a parent and remove the joint from
 		//  its parent's child list if it does
 		if (jointToDelete->parent) {
 			// set parentJoint variable to the joint's parent
 			parentJoint = jointToDelete->parent;
-			// iterate through all of the parent's children
-			for (int i = 0; i < parentJoint->childList.size(); i++) {
-				// find the joint to be deleted in parent's child list
-				if (parentJoint->childList[i]->getName() == currentJointName) {
-					// remove the joint from the child list
-					parentJoint->childList.erase(parentJoint->childList.begin() + i);
-				}
-			}
+			// remove the joint from the parent's child list
+			parentJoint->childList.erase(std::remove(parentJoint->childList.begin(), parentJoint->childList.end(),
+				jointToDelete), parentJoint->childList.end());
 		}
 
 		// change the parent of each of the current joint's children to
@@ -365,19 +631,15 @@ void ofApp::deleteJoint() {
 		for (int i = 0; i < jointToDelete->childList.size(); i++) {
 			// set currentChild to the current child in list
 			currentChild = jointToDelete->childList[i];
-			// Checks if currentChild has an attatched Mesh
-			for (int i = 0; i < meshScene.size(); i++) {
-				if (meshScene[i]->getName() == currentChild->getMeshName()) {
-					// if currentChild has an attatched mesh remove it from scene
-					meshScene.erase(meshScene.begin() + i);
-				}
-			}
+			// if currentChild has an attatched mesh remove it from scene and free it
+			//  (the child may become a root, which can't hold a mesh)
+			freeAttatchedMesh(static_cast<Joint *>(currentChild));
 			// record currentChild's position in world space
 			resetPosition = currentChild->getPosition();
 			// record currentChild's rotation
 			resetRotation = currentChild->rotation;
 			// set parent of current child to NULL if joint to be deleted has no parent
-			currentChild->parent = NULL;
+			currentChild->setParent(NULL);
 			// resets matrices of current child to default
 			currentChild->resetMatrices();
 			// add child to childlist of current joint's parent if it has one
@@ -387,40 +649,72 @@ void ofApp::deleteJoint() {
 			// reset current child's position relative to new parent
 			currentChild->setPosition(resetPosition);
 			// reset current child's rotation back to previous value
-			currentChild->rotation = resetRotation;
+			currentChild->setRotation(resetRotation);
 		}
 
-		// Checks if selected Joint has an attatched mesh
-		for (int i = 0; i < meshScene.size(); i++) {
-			if (meshScene[i]->getName() == selected[0]->getMeshName()) {
-				// if selected Joint has an attatched mesh remove it from scene
-				meshScene.erase(meshScene.begin() + i);
-			}
-		}
+		// if selected Joint has an attatched mesh remove it from scene and free it
+		freeAttatchedMesh(getSelected());
 
-		// remove joint to be deleted from joints vector
-		for (int i = 0; i < joints.size(); i++) {
-			if (joints[i]->getName() == currentJointName) {
-				joints.erase(joints.begin() + i);
-			}
-		}
+		// remove joint to be deleted from joints vector, picking tree, registry and the
+		//  render copies and free it
+		joints.erase(std::remove(joints.begin(), joints.end(), jointToDelete), joints.end());
+		removePickProxy(jointProxies, jointToDelete);
+		jointRegistry.remove(jointToDelete);
+		sceneFreezer.remove(jointToDelete);
+		jointPool.destroy(getSelected());
 	}
 
 	// de-select currently selected variable
-	selected.clear();
+	selected = PoolHandle<Joint>();
+	// skeleton must be recompiled without the deleted joint
+	bSkeletonChanged = true;
+}
+
+//--------------------------------------------------------------
+// removes the mesh attatched to the given joint from meshScene
+//  (the mesh is found by name through the mesh registry)
+//
+void ofApp::removeAttatchedMesh(SceneObject *joint) {
+	SceneObject *attatchedMesh = meshRegistry.find(joint->getMeshName());
+	if (attatchedMesh == NULL) return;
+	meshScene.erase(std::remove(meshScene.begin(), meshScene.end(), attatchedMesh), meshScene.end());
 }
 
 //--------------------------------------------------------------
-// iterates through the joints vector to see if any of the joint
-//  names already present match the given name
+// removes the mesh attatched to the given joint from meshScene
+//  and frees it (removing the crowd if it places the mesh; it is
+//  placed again when the crowd is re-created)
+//
+void ofApp::freeAttatchedMesh(Joint *joint) {
+	if (!joint->hasMesh) return;
+	clearCollisions();
+	PoolHandle<Mesh> handle = meshPool.handleOf(joint->attatchedMesh);
+	for (int p = 0; p < crowdParts.size(); p++) {
+		if (crowdParts[p].mesh == handle) {
+			clearCrowd();
+			break;
+		}
+	}
+	removeAttatchedMesh(joint);
+	removePickProxy(meshProxies, joint->attatchedMesh);
+	meshRegistry.remove(joint->attatchedMesh);
+	sceneFreezer.remove(joint->attatchedMesh);
+	meshPool.destroy(joint->attatchedMesh);
+	joint->attatchedMesh = NULL;
+	joint->hasMesh = false;
+}
+
+//--------------------------------------------------------------
+// checks the joint registry to see if any of the joint names
+//  already present match the given name
 // if any matches are detected, the name is changed
+// (jointCount only grows until the next script is loaded, so
+//  adding n joints checks O(n) names in total)
 //
 string ofApp::getNewName(string newName) {
-	for (int i = 0; i < joints.size(); i++) {
-		if (joints[i]->getName() == newName) {
-			jointCount++;
-			return getNewName("joint" + std::to_string(jointCount));
-		}
+	while (jointRegistry.contains(newName)) {
+		jointCount++;
+		newName = "joint" + std::to_string(jointCount);
 	}
 	return newName;
 }
@@ -429,18 +723,20 @@ string ofApp::getNewName(string newName) {
 // adds a joint to the joints vector
 //
 void ofApp::addJoint() {
-	// creates pointer to new Joint to add to joints vector
-	Joint *jointToAdd = new Joint();
+	// creates pointer to new Joint (owned by the joint pool) to add to joints vector
+	Joint *jointToAdd = jointPool.create();
 	// instantiates the name of the new Joint
-	jointCount = 0;
 	jointToAdd->name = getNewName("joint" + std::to_string(jointCount));
-	// add the new Joint instance to the joints vector
+	// add the new Joint instance to the joints vector and registry
 	joints.push_back(jointToAdd);
+	jointRegistry.add(jointToAdd);
+	// skeleton must be recompiled with the new joint
+	bSkeletonChanged = true;
 
 	// check to see if a joint is selected
 	if (objSelected()) {
 		// if a joint is selected, add new joint to its children
-		selected[0]->addChild(jointToAdd);
+		getSelected()->addChild(jointToAdd);
 	}
 
 	// set new joint's position relative to mouse position
@@ -455,8 +751,9 @@ void ofApp::addJoint() {
 //  the selected joint
 void ofApp::loadObjFile(string fileName)
 {
-	// Create a new mesh instance
-	Mesh* mesh = new Mesh();
+	PROFILE_ZONE("ofApp::loadObjFile");
+	// Create a new mesh instance (owned by the mesh pool)
+	Mesh* mesh = meshPool.create();
 
 	ifstream inputStream;			// Input stream
 	string read;					// Reads from input stream
@@ -535,7 +832,19 @@ void ofApp::loadObjFile(string fileName)
 	// Print mesh diagnostic information
 	cout << "Number of Vertices: " << mesh->verts.size() << endl;
 	cout << "Total Number of Faces: " << mesh->triangles.size() << endl;
-	cout << "Size of Mesh (in kB): " << mesh->getMeshSize() << "\n" << endl;
+	cout << "Size of Mesh (in kB): " << mesh->getMeshSize() << endl;
+
+	// reorders the triangles and vertices so drawing and tracing the mesh
+	//  read the vertices in order (files often list faces at random)
+	float missRatio = getAverageCacheMissRatio(mesh->getVertexIndices());
+	if (optimizeMeshOrder) {
+		mesh->optimizeOrder();
+		cout << "Vertex cache misses per triangle: " << missRatio << " in file order, "
+			<< getAverageCacheMissRatio(mesh->getVertexIndices()) << " reordered\n" << endl;
+	}
+	else {
+		cout << "Vertex cache misses per triangle: " << missRatio << "\n" << endl;
+	}
 
 	// Iterate through all vertices of mesh to determine greatest and lowest y value
 	for (int i = 0; i < mesh->verts.size(); i++) {
@@ -550,31 +859,581 @@ void ofApp::loadObjFile(string fileName)
 	// assigns a name to the mesh
 	numMeshes++;
 	mesh->name = "mesh" + std::to_string(numMeshes);
+	meshRegistry.add(mesh);
+
+	// builds the mesh's hierarchy used by the ray tracer
+	mesh->buildBVH();
 
 	
 	if (objSelected()) { // Attatches Mesh to selected joint
 		// Checks if selected joint is a root
-		if (selected[0]->parent == NULL) {
+		if (getSelected()->parent == NULL) {
 			// do not add mesh to scene if selected joint is a root
 			cout << "The joint you selected is a root joint and a mesh cannot be attatched to it.\n" << endl;
+			meshRegistry.remove(mesh);
+			meshPool.destroy(mesh);
 		}
 		else {
-			// Checks if selected Joint already has a mesh
-			for (int i = 0; i < meshScene.size(); i++) {
-				if (meshScene[i]->getName() == selected[0]->getMeshName()) {
-					// if selected Joint already has a mesh, delete it from scene
-					meshScene.erase(meshScene.begin() + i);
-				}
-			}
+			// if selected Joint already has a mesh, delete it from scene and free it
+			freeAttatchedMesh(getSelected());
 			// set selected joint's attatchedMesh to new mesh
-			selected[0]->attatchMesh(mesh);
+			getSelected()->attatchMesh(mesh);
 			// add new mesh to scene
 			meshScene.push_back(mesh);
+			// place the new mesh on the crowd instances as well
+			if (bShowCrowd) spawnCrowd();
+		}
+	}
+	else { // Sets new mesh to be reference mesh if no joint is selected (freeing the previous one)
+		freeReferenceMesh();
+		referenceMesh = meshPool.handleOf(mesh);
+	}
+}
+
+//--------------------------------------------------------------
+// Turns the reference mesh into a skinned mesh bound to the current
+//  pose of the skeleton so that it deforms with the joints
+void ofApp::skinReferenceMesh()
+{
+	Mesh *mesh = meshPool.get(referenceMesh);
+	if (mesh == NULL) {
+		cout << "Load a mesh without a joint selected to use it as the skinned mesh.\n" << endl;
+		return;
+	}
+	if (joints.size() == 0) {
+		cout << "The skeleton has no joints to bind the mesh to.\n" << endl;
+		return;
+	}
+
+	// make sure the skeleton matches the current joints and pose
+	skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+	bSkeletonChanged = false;
+	skeleton.evaluate();
+
+	// bind the mesh and move it from reference mesh into the scene
+	mesh->bindSkin(skeleton);
+	skinnedMeshes.push_back(meshPool.handleOf(mesh));
+	meshScene.push_back(mesh);
+	cout << "Skinned " << mesh->getName() << " to " << skeleton.size() << " joints\n" << endl;
+	referenceMesh = PoolHandle<Mesh>();
+}
+
+//--------------------------------------------------------------
+// Adds every joint and attatched mesh to the picking tree and
+//  updates their boxes. Boxes that stay within their margin
+//  leave the tree untouched, so a moving rig only re-inserts
+//  the joints that moved far.
+void ofApp::updatePickTree()
+{
+	jointProxies.resize(jointRegistry.objects.size(), -1);
+	meshProxies.resize(meshRegistry.objects.size(), -1);
+	for (int i = 0; i < joints.size(); i++) {
+		Joint *joint = joints[i];
+
+		// box around the joint's sphere
+		glm::vec3 center = joint->getPosition();
+		glm::vec3 boundsMin = center - glm::vec3(joint->radius);
+		glm::vec3 boundsMax = center + glm::vec3(joint->radius);
+		int &proxy = jointProxies[joint->id];
+		if (proxy < 0) proxy = pickTree.createProxy(boundsMin, boundsMax, joint, PICK_JOINT);
+		else pickTree.moveProxy(proxy, boundsMin, boundsMax);
+
+		// box around the attatched mesh placed over the bone (as Joint::draw places it)
+		if (!joint->hasMesh || joint->parent == NULL || joint->attatchedMesh->bvh.empty()) continue;
+		Mesh *mesh = joint->attatchedMesh;
+		glm::mat4 placement = Joint::boneMeshMatrix(center, joint->parent->getPosition(), joint->parent->rotation) * mesh->getMatrix();
+		mesh->bvh.getPlacedBounds(placement, boundsMin, boundsMax);
+		int &meshProxy = meshProxies[mesh->id];
+		if (meshProxy < 0) meshProxy = pickTree.createProxy(boundsMin, boundsMax, joint, PICK_MESH);
+		else pickTree.moveProxy(meshProxy, boundsMin, boundsMax);
+	}
+}
+
+//--------------------------------------------------------------
+// Removes the object's leaf from the picking tree
+void ofApp::removePickProxy(vector<int> &proxies, SceneObject *object)
+{
+	if (object->id < 0 || object->id >= proxies.size() || proxies[object->id] < 0) return;
+	pickTree.destroyProxy(proxies[object->id]);
+	proxies[object->id] = -1;
+}
+
+//--------------------------------------------------------------
+// Returns the joint whose sphere or attatched mesh the ray hits
+//  first (NULL if it hits neither). The picking tree hands out
+//  only the objects whose boxes the ray enters, nearest first, and
+//  meshes are tested triangle by triangle through their hierarchies.
+Joint *ofApp::pickJoint(const Ray &ray)
+{
+	Joint *picked = NULL;
+	pickTree.raycast(ray.p, ray.d, std::numeric_limits<float>::infinity(), [&](int proxy, float tMax) {
+		Joint *joint = static_cast<Joint *>(pickTree.getObject(proxy));
+		if (!joint->isSelectable) return tMax;
+		// only hits closer than the closest one so far are recorded
+		HitRecord hit;
+		hit.tMax = tMax;
+		bool bHit = pickTree.getTag(proxy) == PICK_JOINT ? joint->intersect(ray, hit)
+			: joint->attatchedMesh->intersect(ray, hit);
+		if (!bHit) return tMax;
+		picked = joint;
+		return hit.t;
+	});
+	return picked;
+}
+
+//--------------------------------------------------------------
+// Places every attatched mesh over its bone (as Joint::draw does),
+//  then tests the pairs whose boxes overlap by descending both
+//  hierarchies together. A bone's mesh meets the meshes of its parent's
+//  bone and of its sibling bones at their shared joint by construction,
+//  so those pairs are not tested. With a cache, a pair whose meshes
+//  both have the placement and geometry of the last check reuses that
+//  check's result.
+void ofApp::findCollisions(const vector<Joint *> &joints, vector<pair<Mesh *, Mesh *>> &collisions, CollisionCache *cache)
+{
+	PROFILE_ZONE("ofApp::findCollisions");
+	collisions.clear();
+	if (cache) cache->checks++;
+
+	// the placed meshes with their boxes
+	struct PlacedMesh {
+		Joint *joint;
+		Mesh *mesh;
+		glm::vec3 boundsMin, boundsMax;
+		bool bMoved;			// tracks whether the mesh moved or changed since the last check
+	};
+	vector<PlacedMesh> placed;
+	for (Joint *joint : joints) {
+		if (!joint->hasMesh || joint->parent == NULL || joint->attatchedMesh->bvh.empty()) continue;
+		PlacedMesh part;
+		part.joint = joint;
+		part.mesh = joint->attatchedMesh;
+		glm::mat4 matrix = Joint::boneMeshMatrix(joint->getPosition(), joint->parent->getPosition(), joint->parent->rotation)
+			* part.mesh->getMatrix();
+		// (an unchanged placement isn't set again, which would also count as a change to the render)
+		if (matrix != part.mesh->meshTransMatrix) part.mesh->setMeshTransMatrix(matrix);
+		part.mesh->collidingTriangles.clear();
+		part.bMoved = true;
+		if (cache) {
+			// (the cache only holds meshes placed by the last check)
+			auto entry = cache->placements.emplace(part.mesh->serial, CollisionCache::Placement());
+			CollisionCache::Placement &placement = entry.first->second;
+			part.bMoved = entry.second || placement.matrix != matrix || placement.geometryRevision != part.mesh->geometryRevision;
+			if (part.bMoved) {
+				part.mesh->getWorldBounds(placement.boundsMin, placement.boundsMax);
+				placement.matrix = matrix;
+				placement.geometryRevision = part.mesh->geometryRevision;
+			}
+			placement.check = cache->checks;
+			part.boundsMin = placement.boundsMin;
+			part.boundsMax = placement.boundsMax;
+		}
+		else part.mesh->getWorldBounds(part.boundsMin, part.boundsMax);
+		placed.push_back(part);
+	}
+
+	// every pair of meshes on bones that don't share a joint
+	vector<pair<int, int>> triangles;
+	for (int i = 0; i < placed.size(); i++) {
+		for (int j = i + 1; j < placed.size(); j++) {
+			const PlacedMesh &a = placed[i], &b = placed[j];
+			if (a.mesh == b.mesh || a.joint->parent == b.joint || b.joint->parent == a.joint || a.joint->parent == b.joint->parent) {
+				continue;
+			}
+			bool bApart = false;
+			for (int k = 0; k < 3; k++) bApart = bApart || a.boundsMin[k] > b.boundsMax[k] || b.boundsMin[k] > a.boundsMax[k];
+			if (bApart) continue;
+			const vector<pair<int, int>> *found = &triangles;
+			if (cache) {
+				// the result of the last check still holds if neither mesh moved
+				auto entry = cache->pairs.emplace(make_pair(a.mesh->serial.value, b.mesh->serial.value), CollisionCache::PairResult());
+				CollisionCache::PairResult &result = entry.first->second;
+				if (entry.second || a.bMoved || b.bMoved) {
+					result.triangles.clear();
+					result.bColliding = a.mesh->bvh.collide(a.mesh->verts, b.mesh->bvh, b.mesh->verts,
+						a.mesh->inverseMeshTransMatrix * b.mesh->meshTransMatrix, &result.triangles);
+				}
+				result.check = cache->checks;
+				if (!result.bColliding) continue;
+				found = &result.triangles;
+			}
+			else {
+				triangles.clear();
+				if (!a.mesh->bvh.collide(a.mesh->verts, b.mesh->bvh, b.mesh->verts, a.mesh->inverseMeshTransMatrix * b.mesh->meshTransMatrix,
+					&triangles)) {
+					continue;
+				}
+			}
+			collisions.push_back(make_pair(a.mesh, b.mesh));
+			for (const pair<int, int> &pair : *found) {
+				a.mesh->collidingTriangles.push_back(pair.first);
+				b.mesh->collidingTriangles.push_back(pair.second);
+			}
+		}
+	}
+	// forgets the meshes and pairs this check didn't need (freed meshes among them)
+	if (cache) {
+		for (auto placement = cache->placements.begin(); placement != cache->placements.end();) {
+			if (placement->second.check != cache->checks) placement = cache->placements.erase(placement);
+			else ++placement;
+		}
+		for (auto result = cache->pairs.begin(); result != cache->pairs.end();) {
+			if (result->second.check != cache->checks) result = cache->pairs.erase(result);
+			else ++result;
+		}
+	}
+	for (const PlacedMesh &part : placed) {
+		vector<int> &colliding = part.mesh->collidingTriangles;
+		std::sort(colliding.begin(), colliding.end());
+		colliding.erase(std::unique(colliding.begin(), colliding.end()), colliding.end());
+	}
+}
+
+//--------------------------------------------------------------
+// Finds the collisions of the current pose and compares them with
+//  those of the pose checked before
+bool ofApp::checkCollisions()
+{
+	vector<pair<Mesh *, Mesh *>> found;
+	findCollisions(joints, found, &collisionCache);
+	vector<pair<PoolHandle<Mesh>, PoolHandle<Mesh>>> current;
+	bool bNew = false;
+	for (const pair<Mesh *, Mesh *> &collision : found) {
+		current.push_back(make_pair(meshPool.handleOf(collision.first), meshPool.handleOf(collision.second)));
+		if (std::find(collisions.begin(), collisions.end(), current.back()) == collisions.end()) bNew = true;
+	}
+	collisions.swap(current);
+	return bNew;
+}
+
+//--------------------------------------------------------------
+// Forgets the collisions and the highlighted triangles
+void ofApp::clearCollisions()
+{
+	collisions.clear();
+	collisionCache.clear();
+	for (Joint *joint : joints) {
+		if (joint->hasMesh) joint->attatchedMesh->collidingTriangles.clear();
+	}
+}
+
+//--------------------------------------------------------------
+// Frees the reference mesh (if there is one)
+void ofApp::freeReferenceMesh()
+{
+	Mesh *mesh = meshPool.get(referenceMesh);
+	if (mesh == NULL) return;
+	meshRegistry.remove(mesh);
+	sceneFreezer.remove(mesh);
+	meshPool.destroy(mesh);
+	referenceMesh = PoolHandle<Mesh>();
+}
+
+//--------------------------------------------------------------
+// Loads a skin weights file for the most recently skinned mesh
+void ofApp::loadSkinWeights(string fileName)
+{
+	PROFILE_ZONE("ofApp::loadSkinWeights");
+	Mesh *mesh = skinnedMeshes.size() > 0 ? meshPool.get(skinnedMeshes.back()) : NULL;
+	if (mesh == NULL) {
+		cout << "Skin a mesh with the 'K' key before loading weights.\n" << endl;
+		return;
+	}
+	mesh->skin->loadWeights(fileName, mesh->vertexRemap);
+}
+
+//--------------------------------------------------------------
+// Adds a key for the current pose of every joint at the current
+//  clip time
+void ofApp::addAnimationKey()
+{
+	// make sure the skeleton matches the current joints and pose
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
+	}
+	skeleton.pullPose();
+	clip.addPose(skeleton, clipTime);
+	cout << "Keyed " << skeleton.size() << " joints at " << clipTime << " s (clip length " << clip.duration << " s)\n" << endl;
+	// keep the compressed clip in sync with the edited clip
+	if (bUseCompressedClip) {
+		compressedClip.compress(clip, skeleton, compressionTolerance);
+	}
+}
+
+//--------------------------------------------------------------
+// Switches playback between the raw clip and a compressed copy
+//  of it, printing the compression ratio and error when turned on
+void ofApp::toggleClipCompression()
+{
+	bUseCompressedClip = !bUseCompressedClip;
+	if (!bUseCompressedClip) {
+		cout << "Playing the uncompressed clip\n" << endl;
+		return;
+	}
+
+	// compress against the current skeleton
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
+	}
+	skeleton.pullPose();
+	skeleton.evaluate();
+	compressedClip.compress(clip, skeleton, compressionTolerance);
+
+	// report how well the clip compressed
+	size_t raw = CompressedClip::getRawSizeInBytes(clip);
+	size_t packed = compressedClip.getSizeInBytes();
+	cout << "Playing the compressed clip: " << clip.getNumKeys() << " -> " << compressedClip.getNumKeys() << " keys, "
+		<< raw << " -> " << packed << " bytes, max error " << measureCompressionError(clip, compressedClip, skeleton)
+		<< " (tolerance " << compressionTolerance << ")\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Loads a compressed animation clip and plays it
+void ofApp::loadCompressedAnimationFile(string fileName)
+{
+	PROFILE_ZONE("ofApp::loadCompressedAnimationFile");
+	if (compressedClip.load(fileName)) {
+		bUseCompressedClip = true;
+		clipTime = 0;
+		clipTimeSlider.setMax(std::max(10.0f, compressedClip.duration));
+		clipTimeSlider = 0;
+		cout << "Loaded compressed clip " << compressedClip.name << " with " << compressedClip.tracks.size() << " tracks and "
+			<< compressedClip.getNumKeys() << " keys (" << compressedClip.duration << " s)\n" << endl;
+	}
+}
+
+//--------------------------------------------------------------
+// Loads an animation clip and rewinds playback
+void ofApp::loadAnimationFile(string fileName)
+{
+	PROFILE_ZONE("ofApp::loadAnimationFile");
+	if (clip.load(fileName)) {
+		clipTime = 0;
+		clipTimeSlider.setMax(std::max(10.0f, clip.duration));
+		clipTimeSlider = 0;
+		cout << "Loaded clip " << clip.name << " with " << clip.tracks.size() << " tracks and "
+			<< clip.getNumKeys() << " keys (" << clip.duration << " s)\n" << endl;
+	}
+}
+
+//--------------------------------------------------------------
+// Places crowdSize instances of the skeleton behind it, or removes
+//  them if they are shown
+void ofApp::toggleCrowd()
+{
+	bShowCrowd = !bShowCrowd;
+	if (bShowCrowd) spawnCrowd();
+	else clearCrowd();
+}
+
+//--------------------------------------------------------------
+// Creates the crowd instances. Every instance shares the skeleton,
+//  the clip and the attatched meshes (with their hierarchies); it
+//  only adds its pose and one placement per attatched mesh.
+void ofApp::spawnCrowd()
+{
+	clearCrowd();
+	if (joints.size() == 0) return;
+
+	// the instances start from the current pose of the skeleton
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
+	}
+	skeleton.pullPose();
+
+	// meshes attatched to the joints
+	for (int i = 0; i < skeleton.size(); i++) {
+		Joint *joint = static_cast<Joint *>(skeleton.source[i]);
+		if (joint->hasMesh && skeleton.parents[i] >= 0) {
+			crowdParts.push_back({ i, skeleton.parents[i], meshPool.handleOf(joint->attatchedMesh), joint->attatchedMesh->getMatrix() });
 		}
 	}
-	else { // Sets new mesh to be reference mesh if no joint is selected
-		referenceMesh = mesh;
+
+	// feet and hands solved on every instance
+	setupCrowdIK();
+
+	// place the instances on a grid behind the skeleton, playing the clip
+	vector<const AnimationClip *> clips;
+	if (clip.getNumKeys() > 0) clips.push_back(&clip);
+	float spacing = 2.5;
+	float depth = ceil(sqrt((float)crowdSize)) * spacing;
+	crowd.spawn(skeleton, crowdSize, spacing, glm::vec3(0, 0, -3 - depth / 2), clips);
+
+	// one placement of every attatched mesh per instance
+	for (int n = 0; n < crowd.size(); n++) {
+		for (int p = 0; p < crowdParts.size(); p++) {
+			Mesh *mesh = meshPool.get(crowdParts[p].mesh);
+			MeshInstance *instance = instancePool.create(mesh, "crowd" + std::to_string(n) + "_" + mesh->getName());
+			crowdMeshes.push_back(instance);
+			meshScene.push_back(instance);
+		}
 	}
+	updateCrowd();
+
+	// report what the instances cost on top of the shared data
+	size_t sharedSize = 0;
+	for (int p = 0; p < crowdParts.size(); p++) {
+		sharedSize += meshPool.get(crowdParts[p].mesh)->getMemoryUsage().getTotal();
+	}
+	size_t instanceSize = crowd.getInstanceSizeInBytes() + crowdParts.size() * sizeof(MeshInstance);
+	cout << "Placed " << crowd.size() << " instances of the " << skeleton.size() << " joint skeleton with "
+		<< crowdParts.size() << " meshes: " << instanceSize << " bytes per instance, "
+		<< sharedSize << " bytes of shared meshes and hierarchies\n" << endl;
+}
+
+//--------------------------------------------------------------
+// Removes the crowd and its mesh placements from the scene
+void ofApp::clearCrowd()
+{
+	if (crowdMeshes.size() > 0) {
+		vector<SceneObject *> placements(crowdMeshes.begin(), crowdMeshes.end());
+		sort(placements.begin(), placements.end());
+		meshScene.erase(remove_if(meshScene.begin(), meshScene.end(), [&placements](SceneObject *obj) {
+			return binary_search(placements.begin(), placements.end(), obj); }), meshScene.end());
+	}
+	// frees every placement at once
+	for (MeshInstance *instance : crowdMeshes) sceneFreezer.remove(instance);
+	instancePool.clear();
+	crowdMeshes.clear();
+	crowdParts.clear();
+	crowd.clear();
+	crowdFootSolver.clear();
+	crowdHandSolver.clear();
+}
+
+//--------------------------------------------------------------
+// Poses every crowd instance at the current clip time and moves
+//  its mesh placements onto its bones (both in parallel across
+//  instances)
+void ofApp::updateCrowd()
+{
+	PROFILE_ZONE("ofApp::updateCrowd");
+	if (crowd.size() == 0) return;
+
+	// IK keeps the feet above the floor and reaches the hands toward the selected joint
+	bool bSolveFeet = crowdIK && crowdFootSolver.getNumChains() > 0;
+	bool bReach = crowdIK && objSelected() && crowdHandSolver.getNumChains() > 0;
+	glm::vec3 reachTarget = bReach ? getSelected()->getPosition() : glm::vec3(0, 0, 0);
+	float floorHeight = floor->position.y;
+	crowdFootSolver.method = crowdHandSolver.method = ccdIK ? IKSolver::CCD : IKSolver::FABRIK;
+	auto solveLimbs = [&](CrowdInstance &instance) {
+		thread_local vector<glm::vec3> targets;
+		if (bSolveFeet) {
+			targets.resize(crowdFootSolver.getNumChains());
+			for (int c = 0; c < targets.size(); c++) {
+				targets[c] = instance.pose.getWorldPosition(crowdFootSolver.getEffector(c));
+				targets[c].y = std::max(targets[c].y, floorHeight);
+			}
+			crowdFootSolver.solve(skeleton, instance.pose, targets.data());
+		}
+		if (bReach) {
+			targets.assign(crowdHandSolver.getNumChains(), reachTarget);
+			crowdHandSolver.solve(skeleton, instance.pose, targets.data());
+		}
+		return true;
+	};
+
+	// pose the instances (and solve their limbs on the same threads)
+	if (bSolveFeet || bReach) crowd.evaluate(clipTime, 4, solveLimbs);
+	else crowd.evaluate(clipTime);
+
+	// the meshes' own transformations can be changed by the user, so read them once per frame
+	//  (freeing a mesh removes the crowd placing it, so the handles resolve while the crowd exists)
+	for (int p = 0; p < crowdParts.size(); p++) {
+		Mesh *mesh = meshPool.get(crowdParts[p].mesh);
+		if (mesh) crowdParts[p].meshMatrix = mesh->getMatrix();
+	}
+
+	int numParts = (int)crowdParts.size();
+	parallelFor(crowd.size(), [&](int begin, int end) {
+		for (int n = begin; n < end; n++) {
+			const SkeletonPose &pose = crowd.instances[n].pose;
+			for (int p = 0; p < numParts; p++) {
+				const CrowdPart &part = crowdParts[p];
+				glm::vec3 parentRotation = glm::vec3(pose.rotX[part.parent], pose.rotY[part.parent], pose.rotZ[part.parent]);
+				crowdMeshes[n * numParts + p]->setTransform(Joint::boneMeshMatrix(pose.getWorldPosition(part.joint),
+					pose.getWorldPosition(part.parent), parentRotation) * part.meshMatrix);
+			}
+		}
+	}, 8);
+}
+
+//--------------------------------------------------------------
+// Creates two bone chains ending at every leaf joint of the
+//  skeleton: leaves below the root are feet, the others hands.
+//  Chains that would share a joint with an earlier chain are
+//  skipped.
+void ofApp::setupCrowdIK()
+{
+	crowdFootSolver.clear();
+	crowdHandSolver.clear();
+	skeleton.evaluate();
+
+	vector<bool> isLeaf(skeleton.size(), true);
+	for (int i = 0; i < skeleton.size(); i++) {
+		if (skeleton.parents[i] >= 0) isLeaf[skeleton.parents[i]] = false;
+	}
+	vector<bool> used(skeleton.size(), false);
+	for (int i = 0; i < skeleton.size(); i++) {
+		if (!isLeaf[i] || skeleton.parents[i] < 0) continue;
+
+		// joints of the chain (the leaf and up to two ancestors) must be free
+		vector<int> chain;
+		for (int j = i; j >= 0 && chain.size() < 3; j = skeleton.parents[j]) {
+			chain.push_back(j);
+		}
+		bool bFree = true;
+		for (int k = 0; k < chain.size(); k++) {
+			if (used[chain[k]]) bFree = false;
+		}
+		if (!bFree) continue;
+		for (int k = 0; k < chain.size(); k++) {
+			used[chain[k]] = true;
+		}
+
+		// find the leaf's root to tell feet from hands
+		int root = i;
+		while (skeleton.parents[root] >= 0) root = skeleton.parents[root];
+		if (skeleton.getWorldPosition(i).y < skeleton.getWorldPosition(root).y) crowdFootSolver.addChain(skeleton, i, 2);
+		else crowdHandSolver.addChain(skeleton, i, 2);
+	}
+}
+
+//--------------------------------------------------------------
+// Makes the selected joint the end-effector of a chain of
+//  ikChainLength bones that follows the mouse while dragging
+void ofApp::startIKDrag()
+{
+	if (bSkeletonChanged) {
+		skeleton.compile(vector<SceneObject *>(joints.begin(), joints.end()));
+		bSkeletonChanged = false;
+	}
+	skeleton.pullPose();
+	skeleton.evaluate();
+
+	dragSolver.clear();
+	int effector = skeleton.findJoint(getSelected()->getName());
+	if (dragSolver.addChain(skeleton, effector, ikChainLength) < 0) {
+		cout << "A root joint can't be posed with IK.\n" << endl;
+		return;
+	}
+	ikTarget = skeleton.getWorldPosition(effector);
+	bIKDrag = true;
+}
+
+//--------------------------------------------------------------
+// Solves the dragged chain toward the IK target and writes the
+//  new rotations back to the joints
+void ofApp::solveDragIK()
+{
+	skeleton.pullPose();
+	skeleton.evaluate();
+	dragSolver.method = ccdIK ? IKSolver::CCD : IKSolver::FABRIK;
+	dragSolver.solve(skeleton, &ikTarget);
+	skeleton.pushPose();
 }
 
 //--------------------------------------------------------------
@@ -583,6 +1442,17 @@ void ofApp::loadObjFile(string fileName)
 // and call the rayTrace method.
 void ofApp::keyPressed(int key) {
 	switch (key) {
+	case 'A':
+	case 'a':			// keys the current pose at the current clip time
+		addAnimationKey();
+		break;
+	case ' ':			// toggles playback of the animation clip
+		bPlaying = !bPlaying;
+		break;
+	case 'B':
+	case 'b':			// runs the benchmarks and prints their results
+		runBenchmarks();
+		break;
 	case 'C':
 	case 'c':			// enables camera movement
 		if (mainCam.getMouseInputEnabled()) mainCam.disableMouseInput();
@@ -590,34 +1460,47 @@ void ofApp::keyPressed(int key) {
 		break;
 	case 'D':
 	case 'd':			// deletes the reference mesh
-		referenceMesh = NULL;
+		freeReferenceMesh();
+		break;
+	case 'E':
+	case 'e':			// enables posing the dragged joint's chain with IK
+		bIKKeyDown = true;
+		break;
+	case 'G':
+	case 'g':			// toggles the crowd of skeleton instances
+		toggleCrowd();
 		break;
 	case 'I':
-	case 'i':			// get info on currently selected joint
+	case 'i':			// get info on currently selected joint and the memory the scene holds
 		if (objSelected()) {
 			// print out name of selected joint
-			cout << selected[0]->getName() << ":" << endl;
+			cout << getSelected()->getName() << ":" << endl;
 			// print out all matrices of the selected joint
-			printChannels(selected[0]);
+			printChannels(getSelected());
 			// print out position in world space of selected joint
-			cout << "Selected joint's position in world space: " << selected[0]->getPosition() << endl;
+			cout << "Selected joint's position in world space: " << getSelected()->getPosition() << endl;
 			// print all children of selected joint's child list
-			if (selected[0]->childList.size() > 0) {
+			if (getSelected()->childList.size() > 0) {
 				int count = 1;									// tracks current child
 				string result = "Selected joint's children: ";	// string to contain all children
-				for (int i = 0; i < selected[0]->childList.size(); i++) {
+				for (int i = 0; i < getSelected()->childList.size(); i++) {
 					result += "child" + std::to_string(count) + " = " +
-						selected[0]->childList[i]->getName() + ", ";
+						getSelected()->childList[i]->getName() + ", ";
 					count++;
 				}
 				cout << result << endl;
 			}
 			// print parent of selected joint if it has one
-			if (selected[0]->parent)
-				cout << "Selected joint's parent: " + selected[0]->parent->getName() << endl;
+			if (getSelected()->parent)
+				cout << "Selected joint's parent: " + getSelected()->parent->getName() << endl;
 			// skip next line
 			cout << endl;
 		}
+		printMemoryReport();
+		break;
+	case 'K':
+	case 'k':			// binds the reference mesh to the skeleton as a skinned mesh
+		skinReferenceMesh();
 		break;
 	case 'J':
 	case 'j':			// adds new joint to scene
@@ -630,11 +1513,13 @@ void ofApp::keyPressed(int key) {
 	case 's':			// creates script file containing current skeleton's joints
 		createFile();
 		break;
-	case 'R':
-	case 'r':			// calls the rayTrace method
-		cout << "rendering..." << endl;
-		rayTrace();
-		cout << "done" << endl;
+	case 'R':			// renders every tile of the image again
+	case 'r':			// renders the tiles of the image that changed
+		rayTrace(key == 'R');
+		break;
+	case 'W':
+	case 'w':			// renders the image with worker processes
+		rayTraceDistributed();
 		break;
 	case 'X':
 	case 'x':			// enables rotation around x axis
@@ -663,14 +1548,28 @@ void ofApp::keyPressed(int key) {
 		break;
 	case OF_KEY_UP:
 		if (objSelected()) {	// increments position of mesh towards selected joint 0.1 in y direction
-			selected[0]->yOffset += 0.1;
+			getSelected()->yOffset += 0.1;
 		}
 		break;
 	case OF_KEY_DOWN:
 		if (objSelected()) {	// decrements position of mesh towards selected joint 0.1 in y direction
-			selected[0]->yOffset -= 0.1;
+			getSelected()->yOffset -= 0.1;
 		}
 		break;
+	case 'M':
+	case 'm':			// toggles playback of the compressed clip
+		toggleClipCompression();
+		break;
+	case 'O':
+	case 'o':			// toggles the profiler and its overlay
+		bShowProfile = !bShowProfile;
+		Profiler::setEnabled(bShowProfile);
+		break;
+	case 'T':
+	case 't':			// writes the zones the profiler holds as a Chrome trace
+		if (Profiler::isEnabled()) Profiler::writeChromeTrace("profile.json");
+		else cout << "Turn the profiler on with the 'O' key first.\n" << endl;
+		break;
 	case 'P':
 	case 'p':			// toggles drawing of prevImage
 		bShowImage = !bShowImage;
@@ -691,6 +1590,10 @@ void ofApp::keyReleased(int key) {
 		bAltKeyDown = false;
 		mainCam.disableMouseInput();
 		break;
+	case 'E':
+	case 'e':	// disables posing with IK
+		bIKKeyDown = false;
+		break;
 	case 'X':
 	case 'x':	// disables rotation around x axis
 		bRotateX = false;
@@ -720,21 +1623,45 @@ void ofApp::mouseMoved(int x, int y) {
 void ofApp::mouseDragged(int x, int y, int button) {
 	// translates or rotates currently selected object
 	if (objSelected() && bDrag) {
+		// a render of the old pose is of no use any more
+		renderThread.cancel();
+		// keeps the pose (and the IK target) to go back to if this step makes meshes collide
+		vector<glm::vec3> positions, rotations;
+		glm::vec3 lastTarget = ikTarget;
+		bool bBlock = collisionChecks && blockCollisions;
+		for (int i = 0; bBlock && i < joints.size(); i++) {
+			positions.push_back(joints[i]->position);
+			rotations.push_back(joints[i]->rotation);
+		}
 		glm::vec3 point;
 		mouseToDragPlane(x, y, point);
-		if (bRotateX) {
-			selected[0]->rotation += glm::vec3((point.x - lastPoint.x) * 20.0, 0, 0);
+		if (bIKDrag) {
+			ikTarget += point - lastPoint;
+			solveDragIK();
+		}
+		else if (bRotateX) {
+			getSelected()->setRotation(getSelected()->rotation + glm::vec3((point.x - lastPoint.x) * 20.0, 0, 0));
 		}
 		else if (bRotateY) {
-			selected[0]->rotation += glm::vec3(0, (point.x - lastPoint.x) * 20.0, 0);
+			getSelected()->setRotation(getSelected()->rotation + glm::vec3(0, (point.x - lastPoint.x) * 20.0, 0));
 		}
 		else if (bRotateZ) {
-			selected[0]->rotation += glm::vec3(0, 0, (point.x - lastPoint.x) * 20.0);
+			getSelected()->setRotation(getSelected()->rotation + glm::vec3(0, 0, (point.x - lastPoint.x) * 20.0));
 		}
 		else {
-			selected[0]->position += (point - lastPoint);
+			getSelected()->setLocalPosition(getSelected()->position + (point - lastPoint));
 		}
 		lastPoint = point;
+		// checks the new pose for attatched meshes passing through each other
+		//  (and undoes the step if it made a new pair collide and that is blocked)
+		if (collisionChecks && checkCollisions() && bBlock) {
+			for (int i = 0; i < joints.size(); i++) {
+				joints[i]->setLocalPosition(positions[i]);
+				joints[i]->setRotation(rotations[i]);
+			}
+			ikTarget = lastTarget;
+			checkCollisions();
+		}
 	}
 }
 
@@ -751,7 +1678,7 @@ bool ofApp::mouseToDragPlane(int x, int y, glm::vec3 &point) {
 	float dist;
 	glm::vec3 pos;
 	if (objSelected()) {
-		pos = selected[0]->position;
+		pos = getSelected()->position;
 	}
 	else pos = glm::vec3(0, 0, 0);
 	if (glm::intersectRayPlane(p, dn, pos, glm::normalize(theCam->getZAxis()), dist)) {
@@ -772,57 +1699,34 @@ void ofApp::mousePressed(int x, int y, int button) {
 
 	// clear selection list
 	//
-	selected.clear();
+	selected = PoolHandle<Joint>();
 
 	// test if something selected
 	//
-	vector<Joint *> hits;
-
 	glm::vec3 p = theCam->screenToWorld(glm::vec3(x, y, 0));
 	glm::vec3 d = p - theCam->getPosition();
 	glm::vec3 dn = glm::normalize(d);
 
-	// check for selection of joints
+	// pick the joint whose sphere (or attatched mesh) is hit first
 	//
-	for (int i = 0; i < joints.size(); i++) {
-
-		glm::vec3 point, norm;
-
-		//  We hit an object
-		//
-		if (joints[i]->isSelectable && joints[i]->intersect(Ray(p, dn), point, norm)) {
-			hits.push_back(joints[i]);
-		}
-	}
-
-
-	// if we selected more than one, pick nearest
-	//
-	Joint *selectedObj = NULL;
-	if (hits.size() > 0) {
-		selectedObj = hits[0];
-		float nearestDist = std::numeric_limits<float>::infinity();
-		for (int n = 0; n < hits.size(); n++) {
-			float dist = glm::length(hits[n]->position - theCam->getPosition());
-			if (dist < nearestDist) {
-				nearestDist = dist;
-				selectedObj = hits[n];
-			}
-		}
-	}
+	Joint *selectedObj = pickJoint(Ray(p, dn));
 	if (selectedObj) {
-		selected.push_back(selectedObj);
+		selected = jointPool.handleOf(selectedObj);
 		bDrag = true;
 		mouseToDragPlane(x, y, lastPoint);
+		if (bIKKeyDown) startIKDrag();
+		// collisions the drag starts with are not blocked
+		if (collisionChecks) checkCollisions();
 	}
 	else {
-		selected.clear();
+		selected = PoolHandle<Joint>();
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::mouseReleased(int x, int y, int button) {
 	bDrag = false;
+	bIKDrag = false;
 }
 
 //--------------------------------------------------------------
@@ -847,10 +1751,10 @@ void ofApp::gotMessage(ofMessage msg) {
 
 void ofApp::printCurrentObjRot()
 {
-	if (selected.size() > 0) {
-		cout << "Selected object's rotation: X = " + to_string(selected[0]->rotation.x)
-			+ ", Y = " + to_string(selected[0]->rotation.y)
-			+ ", Z = " + to_string(selected[0]->rotation.z) + "\n" << endl;
+	if (objSelected()) {
+		cout << "Selected object's rotation: X = " + to_string(getSelected()->rotation.x)
+			+ ", Y = " + to_string(getSelected()->rotation.y)
+			+ ", Z = " + to_string(getSelected()->rotation.z) + "\n" << endl;
 	}
 }
 
@@ -866,11 +1770,23 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
 		// loads an obj file to create a mesh
 		loadObjFile(dragInfo.files[0]);
 	}
-	else if (fileType == "txt"){
-		// load a script file containing list of joints and reintialize 
-		//  the joint vector with this new list of joints
+	else if (fileType == "txt" || fileType == "skb"){
+		// load a script file (or binary skeleton file) containing list of
+		//  joints and reintialize the joint vector with this new list of joints
 		loadScriptFile(dragInfo.files[0]);
 	}
+	else if (fileType == "anm") {
+		// loads an animation clip for the skeleton
+		loadAnimationFile(dragInfo.files[0]);
+	}
+	else if (fileType == "anc") {
+		// loads a compressed animation clip for the skeleton
+		loadCompressedAnimationFile(dragInfo.files[0]);
+	}
+	else if (fileType == "wgt") {
+		// loads skin weights for the most recently skinned mesh
+		loadSkinWeights(dragInfo.files[0]);
+	}
 	else {
 		// no of the specified files were added
 		cout << "Invalid File Type\n" << endl;
@@ -878,185 +1794,60 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
 }
 
 //--------------------------------------------------------------
-// Iterates through the dimensions of the image ofImage instance 
-// given by imageHeight and imageWidth and draws a color at each
-// pixel given by the closest SceneObject viewed by the RenderCam
-// at that position
-void ofApp::rayTrace()
+// Returns the objects, lights, camera and shading settings to render
+RenderScene ofApp::getRenderScene()
 {
-	Ray ray;						// holds the current ray set by the current pixel in the iteration
-	bool hit;						// determines if the ray hit a SceneObject
-	float shortestDistance;			// holds the distance from the ray start position to the closest SceneObject
-	float currentDistance;			// holds the distance between the ray start position at current pixel in iteration and the current SceneObject
-	SceneObject *closestObject;		// refers to the object that is closest to the RenderCam where a hit occurred
-	ofColor color;					// holds color of closest object after phong shading has been applied
-	ofColor objColor;				// holds color of closest object before any shading has been applied
-
-	// for each pixel in the image
-	for (int i = 0; i < imageWidth; i++) {
-		for (int j = 0; j < imageHeight; j++) {
-			// get current pixel in u and v coordinates
-			float u = (i + 0.5) / imageWidth;
-			float v = (j + 0.5) / imageHeight;
-			// get the current ray from renderCam to point(u, v)
-			ray = renderCam.getRay(u, v);
-			// hit is initially set to false
-			hit = false;
-			// distance is initially infinity since no object has been tested for intersection yet
-			shortestDistance = std::numeric_limits<float>::infinity();
-			// set closest object equal to NULL to begin since no object has been tested for intersection yet
-			closestObject = NULL;
-			// for each object in the scene
-			for (int k = 0; k < meshScene.size(); k++) {
-				// tests the current SceneObject for intersection with Ray from current pixel in iteration
-				if (meshScene[k]->intersect(ray, intersectPt, intersectNormal)) {
-					// gets the distance of the Ray at current pixel to Intersection Point with current SceneObject
-					currentDistance = glm::distance(ray.p, intersectPt);
-					// checks if the currentDistance is shortest
-					if (currentDistance < shortestDistance) {
-						// sets currentDistance to be shortest and sets closestObject to current SceneObject
-						shortestDistance = currentDistance;
-						closestObject = meshScene[k];
-					}
-					// sets hit to true since Ray intersected with a SceneObject
-					hit = true;
-				}
-				if (hit) {	// if a hit occurred color current pixel with currentObject's color and shade it according to light placement
-					// reset intersectPt and intersectNormal to closestObject
-					closestObject->intersect(ray, intersectPt, intersectNormal);
-
-					// assign color of closest object to objColor (use texture for plane if applied)
-					objColor = closestObject->getColor(intersectPt);
-
-					// Shades the current pixel with ambient and lambert shading
-					//color = lambert(ray, intersectPt, intersectNormal, closestObject->diffuseColor);
-					// Shades the current pixel with ambient, lambert and phong shading
-					color = phong(ray, intersectPt, intersectNormal, objColor, ofColor::white, phongPower);
-
-					// colors the current pixel in iteration
-					image.setColor(i, imageHeight - 1 - j, color);
-				}
-				else {		// if hit did not occur color current pixel with background color
-					image.setColor(i, imageHeight - 1 - j, ofGetBackgroundColor());
-				}
-			}
-		}
-	}
-	// save changes to the image
-	image.save("newImage.png");
+	RenderScene scene;
+	scene.objects = &meshScene;
+	scene.lights = &lights;
+	scene.camera = &renderCam;
+	scene.phongPower = phongPower;
+	scene.background = ofGetBackgroundColor();
+	scene.lightSamples = lightSamples;
+	scene.sampler = sobolSampling ? SAMPLER_SOBOL : SAMPLER_WHITE_NOISE;
+	scene.shadingModel = phongHighlights ? SHADING_PHONG : SHADING_LAMBERT;
+	scene.bShadows = castShadows;
+	return scene;
 }
 
 //--------------------------------------------------------------
-// Adds lambert shading to given pixel in the scene
-ofColor ofApp::lambert(Ray ray, const glm::vec3 & point, const glm::vec3 & normal, const ofColor diffuse)
+// Starts rendering a frozen copy of the scene as seen by the RenderCam
+// on the render thread, cancelling a render still in progress. update()
+// saves the image once it is done. The renderer only re-traces the tiles
+// of the image that changed since the last render (every tile after
+// bFull is given).
+void ofApp::rayTrace(bool bFull)
 {
-	// Sets ambient shading
-	ofColor result = 0.25 * diffuse;			// ambient shading value to not make image completely dark
-	// Variables used in checking for shadows
-	glm::vec3 blockIntersectPt;					// point where ray to light from given point intersects another surface
-	glm::vec3 blockIntersectNormal;				// normal where ray to light from point intersects another surface
-	glm::vec3 shadowRayPt;						// point where light intersects (+ small value towards normal)
-	Ray shadingRay;								// ray from	shadowRayPt to light origin
-	bool blocked;								// dictates whether point is blocked from current light
-	// Variables used in calculating the light
-	glm::vec3 directionToCam;					// vector from point to camera
-	glm::vec3 directionToLight;					// vector from point to light
-	glm::vec3 norm = glm::normalize(normal);	// normal at point
-	float illumination;							// light intensity/(distance to light)^2
-	float dotProdNormLight;						// dot product of norm vector and directionToLight vector
-
-
-	// iterates through all lights
-	for (int i = 0; i < lights.size(); i++) {
-		// Sets direction of ray pointing to camera from intersection point on SceneObject
-		directionToCam = -glm::normalize(ray.d);
-		// Sets direction of ray pointing to light from intersection point on SceneObject
-		directionToLight = glm::normalize(lights[i]->position - point);
-
-		// Determines point near surface where shadingRay begins
-		shadowRayPt = point + 0.0001*norm;
-		// Initializes ray fired from shadowRayPt
-		shadingRay = Ray(shadowRayPt, directionToLight);
-		// Checks for shadows and sets blocked to true if point is blocked from light
-		blocked = shadowCheck(shadingRay, blockIntersectPt, blockIntersectNormal, lights[i]->position);
-
-		// Only adds lambert shading to result if point is not blocked from current light
-		if (blocked == false) {
-			// Gets the illumination from source
-			illumination = lights[i]->intensity / pow(glm::distance(lights[i]->position, point), 2);
-			// Gets dot product of normal and directionToLight vectors
-			dotProdNormLight = glm::dot(norm, directionToLight);
-			// Adds lambert shaded color to result
-			result = result + diffuse * illumination * glm::max(0.0f, dotProdNormLight);
-		}
-	}
-	return result;
+	shared_ptr<const FrozenScene> scene = sceneFreezer.freeze(getRenderScene(), imageWidth, imageHeight);
+	cout << "rendering in the background (" << sceneFreezer.objectsCopied << " of " << scene->objects.size()
+		<< " objects copied)" << endl;
+	renderThread.start(scene, bFull);
 }
 
 //--------------------------------------------------------------
-// Adds phong shading to given pixel in the scene
-ofColor ofApp::phong(Ray ray, const glm::vec3 & point, const glm::vec3 & normal, const ofColor diffuse, const ofColor specular, float power)
+// Writes a snapshot of the scene to scene.snap and starts rendering it
+// on the farm thread with the worker processes that connect (on this
+// or other machines). update() saves the image once it is done; the
+// render gives up if no worker has been connected for a minute.
+void ofApp::rayTraceDistributed()
 {
-	// Sets ambient shading
-	ofColor result = 0.15 * (diffuse);			// ambient shading value to not make image completely dark
-	// Variables used in checking for shadows
-	glm::vec3 blockIntersectPt;					// point where ray to light from given point intersects another surface
-	glm::vec3 blockIntersectNormal;				// normal where ray to light from point intersects another surface
-	glm::vec3 shadowRayPt;						// point where light intersects (+ small value towards normal)
-	Ray shadingRay;								// ray from	shadowRayPt to light origin
-	bool blocked;								// dictates whether point is blocked from current light
-	// Variables used in calculating the diffuse and phong shading
-	glm::vec3 directionToCam;					// vector from point to camera
-	glm::vec3 directionToLight;					// vector from point to light
-	glm::vec3 norm = glm::normalize(normal);	// normal at point
-	float illumination;							// light intensity/(distance to light)^2
-	float dotProdNormLight;						// dot product of norm vector and directionToLight vector
-	glm::vec3 bisectingVec;						// bisecting vector between directionToLight and directionToCam vectors
-	float dotProdNormBis;						// dot product of norm vector and bisectingVec vector
-
-
-	// iterates through all lights
-	for (int i = 0; i < lights.size(); i++) {
-		// Sets direction of ray pointing to camera from intersection point on SceneObject
-		directionToCam = glm::normalize(renderCam.position - point);
-		// Sets direction of ray pointing to light from intersection point on SceneObject
-		directionToLight = glm::normalize(lights[i]->position - point);
-
-		// Determines point near surface where shadingRay begins
-		shadowRayPt = point + 0.0001*norm;
-		// Initializes ray fired from shadowPt
-		shadingRay = Ray(shadowRayPt, directionToLight);
-		// Checks for shadows and sets blocked to true if point is blocked from light
-		blocked = shadowCheck(shadingRay, blockIntersectPt, blockIntersectNormal, lights[i]->position);
-
-		// Only adds lambert and phong shading to result if point is not blocked from current light
-		if (blocked == false) {
-			// Gets the illumination from source
-			illumination = lights[i]->intensity / pow(glm::distance(lights[i]->position, point), 2);
-			// Gets dot product of normal and directionToLight vectors
-			dotProdNormLight = glm::dot(norm, directionToLight);
-			// Calculate and add diffuse shading to result
-			result += diffuse * illumination * glm::max(0.0f, dotProdNormLight);
-			// Obtains the bisecting vector between vector to cam and vector to light
-			bisectingVec = glm::normalize(directionToCam + directionToLight);
-			// Dot product of bisecting vector and normal
-			dotProdNormBis = glm::dot(norm, bisectingVec);
-			// Adds phong shaded color to result
-			result += specular * illumination * pow(glm::max(0.0f, dotProdNormBis), power);
-		}
-	}
-	return result;
-}
-
-//--------------------------------------------------------------
-// Checks for intersection between lights and other objects in scene
-bool ofApp::shadowCheck(Ray ray, glm::vec3 intersection, glm::vec3 normal, glm::vec3 lightPosition) {
-	for (int k = 0; k < meshScene.size(); k++) {
-		// only return true if an intersection occurs with a surface before ray reaches the light
-		if (meshScene[k]->intersect(ray, intersection, normal) && (glm::distance(ray.p, intersection) < glm::distance(ray.p, lightPosition))
-			&& (glm::distance(intersection, lightPosition) < glm::distance(ray.p, lightPosition))) {
-			return true;
-		}
+	if (farmThread.joinable()) {
+		cout << "a distributed render is still running" << endl;
+		return;
 	}
-	return false;
+	shared_ptr<vector<char>> snapshot = make_shared<vector<char>>();
+	SceneSnapshot::write(getRenderScene(), imageWidth, imageHeight, *snapshot);
+	saveSnapshotFile("scene.snap", *snapshot);
+	// the thread mustn't create a texture
+	farmImage.setUseTexture(false);
+	bFarmCancel = false;
+	bFarmFinished = false;
+	bFarmBusy = true;
+	farmThread = std::thread([this, snapshot] {
+		Profiler::setThreadName("farm");
+		RenderFarmSettings settings;
+		settings.cancel = &bFarmCancel;
+		bFarmFinished = renderDistributed(*snapshot, settings, farmImage);
+		bFarmBusy = false;
+	});
 }
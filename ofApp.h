@@ -1,49 +1,34 @@
-// This file provides definitions for Light, PointLight, Triangle,
-//  Joint, and Mesh classes in addition to declarations of variables
-//  and methods utilized in the ofApp class.
+// This file provides definitions for Triangle, Mesh, MeshInstance,
+//  and Joint classes in addition to declarations of variables and
+//  methods utilized in the ofApp class.
 // - author: Jared Bechthold 
 // - starter files provided by Professor Kevin Smith
 
 #include "ofMain.h"
 #include "ofxGui.h"
 #include "SceneObjects.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "Animation.h"
+#include "AnimationCompression.h"
+#include "Benchmarks.h"
+#include "BVH.h"
+#include "Crowd.h"
+#include "SceneRegistry.h"
+#include "ObjectPool.h"
+#include "AABBTree.h"
+#include "IK.h"
+#include "Parallel.h"
+#include "Renderer.h"
+#include "RenderThread.h"
+#include "SceneSnapshot.h"
+#include "RenderFarm.h"
+#include "Profiler.h"
+#include "MemoryAccounting.h"
+#include "MeshOrder.h"
 #include <glm/gtx/intersect.hpp>
-
-// Base Light class
-//
-class Light : public SceneObject {
-public:
-	// Sets intensity of light
-	void setIntensity(float newIntensity) {
-		intensity = newIntensity;
-	}
-
-	// Tracks light intensity
-	float intensity;
-};
-
-// Point Light class
-//
-class PointLight : public Light {
-public:
-	// PointLight constructor
-	PointLight(glm::vec3 position, float intensity, float radius, ofColor diffuse = ofColor::white) {
-		this->position = position;
-		this->intensity = intensity;
-		this->radius = radius;
-		this->diffuseColor = diffuse;
-	}
-
-	// Draws the Sphere representing the light
-	void draw() {
-		ofNoFill();
-		ofSetColor(diffuseColor);
-		ofDrawSphere(position, radius);
-	}
-
-	// Tracks size of drawble light
-	float radius;
-};
+#include <thread>
+#include <atomic>
 
 // Triangle class
 //
@@ -70,6 +55,26 @@ public:
 	int nVertInd[3];	// holds the three normal verticies of triangel
 };
 
+// MeshMemory: bytes held by a mesh's arrays, by part (each part counts
+//  the capacity its arrays reserved, which slack totals)
+//
+struct MeshMemory {
+	size_t vertices = 0;	// position vertices
+	size_t normals = 0;		// normal vertices
+	size_t triangles = 0;	// vertex and normal indices of the triangles
+	size_t bvh = 0;			// bounding volume hierarchy with its triangle blocks
+	size_t skin = 0;		// bind pose and weights of a skinned mesh
+	size_t slack = 0;		// capacity reserved beyond the arrays' sizes (part of the above)
+
+	size_t getTotal() const { return vertices + normals + triangles + bvh + skin; }
+
+	// Returns the parts for printing
+	string getDetails() const {
+		return "vertices " + formatBytes(vertices) + ", normals " + formatBytes(normals) + ", triangles " + formatBytes(triangles)
+			+ ", BVH " + formatBytes(bvh) + (skin ? ", skin " + formatBytes(skin) : "") + ", slack " + formatBytes(slack);
+	}
+};
+
 //  Mesh class
 //  
 class Mesh : public SceneObject {
@@ -81,64 +86,115 @@ public:
 	
 	// Detects intersection between mesh and ray
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
-		// distance between closest intersection point and camera
-		float shortestDistance = std::numeric_limits<float>::infinity();
-		float currentDistance = 0;	// distance between current intersection point and camera	
-		glm::vec3 v0, v1, v2;		// current position vertices of current triangle
-		glm::vec3 nV0, nV1, nV2;	// current normal verticies of current triangle 
-		bool hit = false;			// tracks whether ray hits the mesh
+		return intersect(ray, meshTransMatrix, inverseMeshTransMatrix, point, normal);
+	}
+
+	// Records the closest triangle hit by the ray inside the hit record's interval
+	bool intersect(const Ray &ray, HitRecord &hit) {
+		return intersect(ray, inverseMeshTransMatrix, hit);
+	}
+
+	// Returns the normal at a hit recorded by intersect(ray, hit)
+	glm::vec3 getHitNormal(const Ray &ray, const HitRecord &hit) {
+		return getNormal(meshTransMatrix, hit.primIndex, hit.bary);
+	}
+
+	// Gets the box around the placed mesh
+	bool getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		if (bvh.empty()) return false;
+		bvh.getPlacedBounds(meshTransMatrix, boundsMin, boundsMax);
+		return true;
+	}
+
+	// Detects intersection between ray and the mesh placed with the given
+	//  transformation (and its inverse), returning the point and normal
+	bool intersect(const Ray &ray, const glm::mat4 &transform, const glm::mat4 &inverseTransform,
+		glm::vec3 &point, glm::vec3 &normal) {
+		HitRecord hit;		// closest hit along the ray
+		Ray r = ray;		// ray passed into the method
+		if (!intersect(ray, inverseTransform, hit)) return false;
+		point = r.evalPoint(hit.t);
+		normal = getNormal(transform, hit.primIndex, hit.bary);
+		return true;
+	}
+
+	// Records the closest triangle hit by the ray inside the hit record's interval,
+	//  with the mesh placed by the transformation whose inverse is given. The ray
+	//  is moved into the mesh's object space and tested against the mesh's bounding
+	//  volume hierarchy, so any number of placements can share one hierarchy.
+	bool intersect(const Ray &ray, const glm::mat4 &inverseTransform, HitRecord &hit) {
+		int triangle;				// index of the closest triangle hit
 		glm::vec2 baryCenter;		// position of intersect point on triangle in barycentric coordinates
-		glm::vec3 v0v1;				// vector from triangle's vertex0 to vertex1
-		glm::vec3 v0v2;				// vector from triangle's vertex0 to vertex2
-		Ray r = ray;				// ray passed into the method
-
-		// iterate through all of the triangles of the mesh
-		for (int i = 0; i < triangles.size(); i++) {
-			// initializes transformed position vertices of current triangle
-			v0 = meshTransMatrix * glm::vec4(verts[triangles[i].vertInd[0]], 1);
-			v1 = meshTransMatrix * glm::vec4(verts[triangles[i].vertInd[1]], 1);
-			v2 = meshTransMatrix * glm::vec4(verts[triangles[i].vertInd[2]], 1);
-
-			// initializes transformed normal verticies of current triangle
-			nV0 = glm::normalize(meshTransMatrix * glm::vec4(nVerts[triangles[i].nVertInd[0]], 1) 
-				- meshTransMatrix * glm::vec4(0, 0, 0, 1));
-			nV1 = glm::normalize(meshTransMatrix * glm::vec4(nVerts[triangles[i].nVertInd[1]], 1)
-				- meshTransMatrix * glm::vec4(0, 0, 0, 1));
-			nV2 = glm::normalize(meshTransMatrix * glm::vec4(nVerts[triangles[i].nVertInd[2]], 1)
-				- meshTransMatrix * glm::vec4(0, 0, 0, 1));
-
-			// check for intersection
-			if (glm::intersectRayTriangle(ray.p, ray.d, v0, v1, v2, baryCenter, currentDistance)) {
-				hit = true;	// set hit to true if intersection occurs
-
-				// record fields of closest triangle
-				if (currentDistance < shortestDistance) {
-					shortestDistance = currentDistance;
-					point = r.evalPoint(shortestDistance);
-					if (smoothShading) {
-						// calculates the average point normal using barycentric coordinates
-						normal = glm::normalize((1 - baryCenter.x - baryCenter.y)*nV0
-							+ baryCenter.x * nV1 + baryCenter.y * nV2);
-					}
-					else {
-						// calculate vectors from vertex0 to both vertex1 and vertex2
-						v0v1 = glm::normalize(v1 - v0);
-						v0v2 = glm::normalize(v2 - v0);
-						// calculates the surface normal using cross product of triangle's vectors
-						normal = glm::cross(v0v1, v0v2);
-					}
-				}
-			}
+		float distance;				// distance along the ray to the intersect point
+
+		// ray in object space (t along it matches t along the world space ray)
+		glm::vec3 localOrigin = inverseTransform * glm::vec4(ray.p, 1);
+		glm::vec3 localDirection = inverseTransform * glm::vec4(ray.d, 0);
+		if (!bvh.intersect(verts, localOrigin, localDirection, hit.tMin, hit.tMax, triangle, baryCenter, distance)) {
+			return false;
 		}
-		// return result
-		return hit;
+		hit.set(distance, this, triangle, baryCenter);
+		return true;
+	}
+
+	// Returns the world space normal of the given triangle at the given barycentric
+	//  coordinates, with the mesh placed by the given transformation
+	glm::vec3 getNormal(const glm::mat4 &transform, int triangle, glm::vec2 baryCenter) {
+		if (smoothShading) return getSmoothNormal(transform, triangle, baryCenter);
+		return getFlatNormal(transform, triangle);
+	}
+
+	// Returns the normal interpolated from the triangle's vertex normals
+	//  (smooth shading)
+	glm::vec3 getSmoothNormal(const glm::mat4 &transform, int triangle, glm::vec2 baryCenter) const {
+		const Triangle &tri = triangles[triangle];
+		// transformed normal verticies of the triangle
+		glm::mat3 normalTransform = glm::mat3(transform);
+		glm::vec3 nV0 = glm::normalize(normalTransform * nVerts[tri.nVertInd[0]]);
+		glm::vec3 nV1 = glm::normalize(normalTransform * nVerts[tri.nVertInd[1]]);
+		glm::vec3 nV2 = glm::normalize(normalTransform * nVerts[tri.nVertInd[2]]);
+		// calculates the average point normal using barycentric coordinates
+		return glm::normalize((1 - baryCenter.x - baryCenter.y)*nV0
+			+ baryCenter.x * nV1 + baryCenter.y * nV2);
+	}
+
+	// Returns the normal of the triangle's face (flat shading)
+	glm::vec3 getFlatNormal(const glm::mat4 &transform, int triangle) const {
+		const Triangle &tri = triangles[triangle];
+		// transformed position vertices of the triangle
+		glm::vec3 v0 = transform * glm::vec4(verts[tri.vertInd[0]], 1);
+		glm::vec3 v1 = transform * glm::vec4(verts[tri.vertInd[1]], 1);
+		glm::vec3 v2 = transform * glm::vec4(verts[tri.vertInd[2]], 1);
+		// calculates the surface normal using cross product of triangle's vectors
+		return glm::cross(glm::normalize(v1 - v0), glm::normalize(v2 - v0));
+	}
+
+	// Sets the transformation matrix of the mesh (and caches its inverse for intersect)
+	void setMeshTransMatrix(const glm::mat4 &m) {
+		if (m == meshTransMatrix) return;
+		meshTransMatrix = m;
+		inverseMeshTransMatrix = glm::inverse(m);
+		markChanged();
+	}
+
+	// Counts a change to the vertices (made after they moved, with the
+	//  hierarchy refit), which is also a change to how the mesh renders
+	void markGeometryChanged() {
+		geometryRevision++;
+		markChanged();
 	}
 
 	// Returns name of the mesh
 	string getName() { return name; }
 
 	int getMeshSize();											// returns size of mesh in KB
+	MeshMemory getMemoryUsage() const;							// returns bytes held by each part of the mesh
 	void draw();												// draws all the triangles of the mesh
+	void drawTriangles();										// draws all the triangles of the mesh in object space
+	void buildBVH();											// builds the bounding volume hierarchy over the mesh's triangles
+	void optimizeOrder(int clusterSize = 256);					// reorders triangles and vertices for the caches (before buildBVH and bindSkin)
+	vector<int> getVertexIndices() const;						// returns the position vertex indices of every triangle
+	void bindSkin(const Skeleton &skeleton);					// binds mesh to skeleton's current pose with proximity weights
 	float getVerticalDistance() { return maxYVal - minYVal; }	// returns height of mesh
 
 	// Fields of Mesh class
@@ -148,10 +204,80 @@ public:
 	vector<Triangle> triangles;									// holds all triangles of the mesh
 	float maxYVal = -std::numeric_limits<float>::infinity();	// holds a vector with the maximum value in the y axis
 	float minYVal = std::numeric_limits<float>::infinity();		// holds a vector with the minimum value in the y axis
-	glm::mat4 meshTransMatrix;									// contains transformation matrix to be stored for mesh
+	glm::mat4 meshTransMatrix = glm::mat4(1.0);					// contains transformation matrix to be stored for mesh
+	glm::mat4 inverseMeshTransMatrix = glm::mat4(1.0);			// inverse of meshTransMatrix
+	MeshBVH bvh;												// object space hierarchy over the triangles (shared by all placements)
+	unique_ptr<Skin> skin;										// deforms the mesh with a skeleton (NULL if mesh is rigid)
+	uint32_t geometryRevision = 0;								// incremented whenever the vertices change (see markGeometryChanged)
+	vector<int> vertexRemap;									// index of each vertex of the loaded file after optimizeOrder (empty if not reordered)
+	vector<int> collidingTriangles;								// triangles intersecting another attatched mesh in the pose last checked (drawn red)
 
 };
 
+// MeshInstance class: one placement of a shared mesh. The mesh's
+//  vertices and hierarchy are not copied; the instance only stores
+//  its transformation (used to place meshes on crowd instances).
+//
+class MeshInstance : public SceneObject {
+public:
+	// Defined constructor of MeshInstance class
+	MeshInstance(Mesh *mesh, string n) {
+		this->mesh = mesh;
+		name = n;
+	}
+
+	// Detects intersection between the placed mesh and ray
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+		return mesh->intersect(ray, transform, inverseTransform, point, normal);
+	}
+
+	// Records the closest triangle of the placed mesh hit by the ray (the
+	//  instance, not the shared mesh, is recorded as the object hit)
+	bool intersect(const Ray &ray, HitRecord &hit) {
+		if (!mesh->intersect(ray, inverseTransform, hit)) return false;
+		hit.object = this;
+		return true;
+	}
+
+	// Returns the normal of the placed mesh at a hit recorded by intersect(ray, hit)
+	glm::vec3 getHitNormal(const Ray &ray, const HitRecord &hit) {
+		return mesh->getNormal(transform, hit.primIndex, hit.bary);
+	}
+
+	// Gets the box around the placed mesh
+	bool getWorldBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+		if (mesh->bvh.empty()) return false;
+		mesh->bvh.getPlacedBounds(transform, boundsMin, boundsMax);
+		return true;
+	}
+
+	// Draws the shared mesh with the instance's transformation applied
+	void draw() {
+		PROFILE_ZONE("MeshInstance::draw");
+		ofPushMatrix();
+		ofMultMatrix(transform);
+		mesh->drawTriangles();
+		ofPopMatrix();
+	}
+
+	// Returns name of the instance
+	string getName() { return name; }
+
+	// Sets the transformation of the instance (and caches its inverse for intersect)
+	void setTransform(const glm::mat4 &m) {
+		if (m == transform) return;
+		transform = m;
+		inverseTransform = glm::inverse(m);
+		markChanged();
+	}
+
+	// Fields of MeshInstance class
+	//
+	Mesh *mesh;										// shared mesh drawn by the instance
+	glm::mat4 transform = glm::mat4(1.0);			// places the mesh in the world
+	glm::mat4 inverseTransform = glm::mat4(1.0);	// inverse of transform
+};
+
 // Joint class
 //
 class Joint : public Sphere {
@@ -197,6 +323,7 @@ public:
 
 	// Draws joint and bone connecting it to its parent (if joint has a parent)
 	void draw() {
+		PROFILE_ZONE("Joint::draw");
 		// Calls the super class version of the draw method in order to draw
 		//  the sphere
 		Sphere::draw();
@@ -245,38 +372,50 @@ public:
 			ofDrawCone(coneRadius, coneHeight);
 			ofPopMatrix();
 
-			// Checks if the current joint has a mesh attatched to it and if it does draw that mesh
+			// Checks if the current joint has a mesh attatched to it and if it does place that mesh
 			//  over the cone representing the bone
 			if (hasMesh) {
-				// Specifies default direction that the mesh faces
-				glm::vec3 meshDir = glm::vec3(0, -1, 0);
-				
-				// Rotation matrix to be applied to mesh
-				glm::mat4 meshRotate;
-				// sets the rotation matrix to be applied to the mesh
-				if (jointToParent.x == 0 && jointToParent.z == 0 && jointToParent.y <= -0.999) {
-					// sets meshRotate matrix to parent's rotation if jointToParent vector is parallel to the mesh's default direction
-					meshRotate = glm::eulerAngleYXZ(glm::radians(parent->rotation.y), glm::radians(parent->rotation.x),
-						glm::radians(parent->rotation.z));
-				}
-				else if (jointToParent.x == 0 && jointToParent.z == 0 && jointToParent.y >= 0.999) {
-					// sets meshRotate matrix to parent's rotation (plus 180 in z-axis) if jointToParent vector is parallel 
-					// and opposite of the mesh's default direction
-					meshRotate = glm::eulerAngleYXZ(glm::radians(parent->rotation.y), glm::radians(parent->rotation.x),
-						glm::radians(parent->rotation.z + 180.0f));
-				}
-				else {
-					// sets meshRotate matrix to align with jointToParent vector
-					meshRotate = rotateToVector(meshDir, jointToParent);
-				}
-
 				// Increments/Decrements position of attatchedMesh by yOffset in y direction
-				attatchedMesh->position.y = yOffset;
+				attatchedMesh->setLocalPosition(glm::vec3(attatchedMesh->position.x, yOffset, attatchedMesh->position.z));
 				// Stores new transformation matrix of mesh
-				attatchedMesh->meshTransMatrix = translate * meshRotate * attatchedMesh->getMatrix();
+				attatchedMesh->setMeshTransMatrix(boneMeshMatrix(this->getPosition(), parent->getPosition(), parent->rotation)
+					* attatchedMesh->getMatrix());
 			}
 		}
 	}
+
+	// Returns the matrix placing a mesh over the bone from a parent joint to a joint
+	//  (halfway between the joints, facing from the joint to its parent) given both
+	//  joints' world positions and the parent's rotation
+	static glm::mat4 boneMeshMatrix(glm::vec3 jointPosition, glm::vec3 parentPosition, glm::vec3 parentRotation) {
+		// vector pointing from the joint to the parent
+		glm::vec3 jointToParent = glm::normalize(parentPosition - jointPosition);
+		// translation matrix: sends mesh to halfway between joint and parent
+		glm::mat4 translate = glm::translate(glm::mat4(1.0), (jointPosition + parentPosition) / 2.0f);
+		// Specifies default direction that the mesh faces
+		glm::vec3 meshDir = glm::vec3(0, -1, 0);
+
+		// Rotation matrix to be applied to mesh
+		glm::mat4 meshRotate;
+		// sets the rotation matrix to be applied to the mesh
+		if (jointToParent.x == 0 && jointToParent.z == 0 && jointToParent.y <= -0.999) {
+			// sets meshRotate matrix to parent's rotation if jointToParent vector is parallel to the mesh's default direction
+			meshRotate = glm::eulerAngleYXZ(glm::radians(parentRotation.y), glm::radians(parentRotation.x),
+				glm::radians(parentRotation.z));
+		}
+		else if (jointToParent.x == 0 && jointToParent.z == 0 && jointToParent.y >= 0.999) {
+			// sets meshRotate matrix to parent's rotation (plus 180 in z-axis) if jointToParent vector is parallel 
+			// and opposite of the mesh's default direction
+			meshRotate = glm::eulerAngleYXZ(glm::radians(parentRotation.y), glm::radians(parentRotation.x),
+				glm::radians(parentRotation.z + 180.0f));
+		}
+		else {
+			// sets meshRotate matrix to align with jointToParent vector
+			meshRotate = rotateToVector(meshDir, jointToParent);
+		}
+		return translate * meshRotate;
+	}
+
 	// defines offset in y direction to change attatched mesh
 	float yOffset = 0.0;
 	// defines default name of a Joint instance
@@ -287,10 +426,48 @@ public:
 	Mesh* attatchedMesh;
 };
 
+// CrowdPart: a mesh attatched to a joint of the skeleton, placed on every crowd instance
+//
+struct CrowdPart {
+	int joint;				// skeleton index of the joint the mesh is attatched to
+	int parent;				// skeleton index of the joint's parent
+	PoolHandle<Mesh> mesh;	// shared mesh
+	glm::mat4 meshMatrix;	// the mesh's own transformation (offset along the bone)
+};
+
+// CollisionCache: where each attatched mesh was placed in the last
+//  collision check and the result of each pair tested, so the next check
+//  only re-tests the pairs with a mesh that moved or changed (dragging a
+//  joint only moves the meshes below it)
+//
+struct CollisionCache {
+	struct Placement {
+		glm::mat4 matrix;						// meshTransMatrix the mesh was checked with
+		uint32_t geometryRevision = 0;			// the mesh's geometryRevision then
+		glm::vec3 boundsMin, boundsMax;			// the mesh's world box then
+		uint32_t check = 0;						// number of the last check that placed the mesh
+	};
+	struct PairResult {
+		bool bColliding = false;
+		vector<pair<int, int>> triangles;		// intersecting triangles of the first and second mesh
+		uint32_t check = 0;						// number of the last check that needed the pair
+	};
+
+	// Forgets every placement and result
+	void clear() { placements.clear(); pairs.clear(); }
+
+	// Fields of CollisionCache struct
+	//
+	unordered_map<uint64_t, Placement> placements;		// by mesh serial
+	map<pair<uint64_t, uint64_t>, PairResult> pairs;	// by the serials of the meshes tested, in the order tested
+	uint32_t checks = 0;								// number of checks made with the cache
+};
+
 class ofApp : public ofBaseApp {
 
 public:
 	// default openframeworks methods
+	~ofApp();
 	void setup();
 	void update();
 	void draw();
@@ -311,8 +488,10 @@ public:
 	bool mouseToDragPlane(int x, int y, glm::vec3 &point);				// projects a mouse point in screen space to a 3D point on a plane normal to view axis of camera
 	static void drawAxis(glm::mat4 transform = glm::mat4(1.0), float len = 1.0);// draws 1 unit length lines at origin in postive direction of each axis
 	void printChannels(SceneObject *);									// prints out specified scene object's position, rotation, and scale fields
-	bool objSelected() { return (selected.size() ? true : false); };	// returns boolean value detailing if a scene object is currently selected
+	bool objSelected() { return getSelected() != NULL; };	// returns boolean value detailing if a scene object is currently selected
+	Joint *getSelected() { return jointPool.get(selected); }	// returns the selected joint (NULL if none is selected or it was freed)
 	void printCurrentObjRot();											// prints current local rotation field of object
+	void printMemoryReport();											// prints the memory held by the meshes, skeleton, clips and images
 
 	// Joint Related Methods
 	//
@@ -320,21 +499,58 @@ public:
 	void loadObjFile(string fileName);			// loads mesh obj file into scene
 	string getNewName(string newName);			// selects name for joint to be added
 	void deleteJoint();							// deletes selected joint
-	void createFile();							// creates script file for current set of joints
-	void loadScriptFile(string fileName);		// loads specified script file
+	void removeAttatchedMesh(SceneObject *joint);	// removes the mesh attatched to the joint from the scene
+	void freeAttatchedMesh(Joint *joint);		// removes the mesh attatched to the joint from the scene and frees it
+	void freeReferenceMesh();					// frees the reference mesh
+
+	// Picking Related Methods
+	//
+	void updatePickTree();						// moves the boxes of the joints and attatched meshes in the picking tree
+	void removePickProxy(vector<int> &proxies, SceneObject *object);	// removes the object from the picking tree
+	Joint *pickJoint(const Ray &ray);			// returns the joint whose sphere or attatched mesh the ray hits first
+	void createFile();							// creates script (or binary skeleton) file for current set of joints
+	void loadScriptFile(string fileName);		// loads specified script (or binary skeleton) file
+	void skinReferenceMesh();					// binds the reference mesh to the skeleton as a skinned mesh
+	void loadSkinWeights(string fileName);		// loads weights file for the most recently skinned mesh
+	void addAnimationKey();						// keys the pose of every joint at the current clip time
+	void loadAnimationFile(string fileName);	// loads specified animation clip file
+	void toggleClipCompression();				// switches playback between the raw and the compressed clip
+	void loadCompressedAnimationFile(string fileName);	// loads specified compressed animation clip file
+
+	// Collision Related Methods
+	//
+	// places the attatched meshes over their bones and finds the pairs whose triangles intersect, keeping
+	//  each mesh's intersecting triangles to highlight (meshes on bones that share a joint are not tested);
+	//  pairs of meshes that didn't move since the last check with the cache reuse its results
+	static void findCollisions(const vector<Joint *> &joints, vector<pair<Mesh *, Mesh *>> &collisions,
+		CollisionCache *cache = NULL);
+	bool checkCollisions();		// finds the collisions of the current pose, returns true if a pair collides that didn't before
+	void clearCollisions();		// forgets the collisions and their highlights
+
+	// IK Related Methods
+	//
+	void startIKDrag();		// makes the selected joint the end-effector of a chain solved while dragging
+	void solveDragIK();		// solves the dragged chain toward the IK target
+	void setupCrowdIK();	// creates the foot and hand chains solved on every crowd instance
+
+	// Crowd Related Methods
+	//
+	void toggleCrowd();		// places crowdSize instances of the skeleton in the scene or removes them
+	void spawnCrowd();		// (re)creates the crowd instances and their mesh placements
+	void clearCrowd();		// removes the crowd instances and their mesh placements
+	void updateCrowd();		// poses the crowd instances and places their meshes
 
 	// Ray Tracing and Lighting Related Methods
 	//
-	// adds phong shading to given pixel in scene
-	ofColor phong(Ray ray, const glm::vec3 & point, const glm::vec3 & normal, const ofColor diffuse, const ofColor specular, float power);
-	// adds lambert shading to given pixel in scene
-	ofColor lambert(Ray ray, const glm::vec3 &point, const glm::vec3 &normal, const ofColor diffuse);
 	// adds Light instances to lights vector
-	void addLight(PointLight* newLight) { lights.push_back(newLight); }
-	// checks ray fired from object to light for intersction with other SceneObjects
-	bool shadowCheck(Ray ray, glm::vec3 intersection, glm::vec3 normal, glm::vec3 lightPosition);
-	// draws RenderCam view to ofImage instance
-	void rayTrace();
+	void addLight(Light* newLight) { lights.push_back(newLight); }
+	// returns the objects, lights, camera and settings rendered by rayTrace
+	RenderScene getRenderScene();
+	// starts drawing the RenderCam view to the ofImage instance in the background
+	//  (re-tracing only what changed unless bFull)
+	void rayTrace(bool bFull = false);
+	// starts drawing the RenderCam view with worker processes in the background (see RenderFarm.h)
+	void rayTraceDistributed();
 
 	// Camera and View Related Fields
 	//
@@ -343,6 +559,8 @@ public:
 	// toggles preview of rendered image on and off
 	// only shows image if render has been called
 	bool bShowImage = false;
+	// toggles the profiler and its overlay of the last frame's zones
+	bool bShowProfile = false;
 	// camera that can move about the scene starting from RenderCam POV
 	ofEasyCam  mainCam;
 	// shows view of the scene from the side
@@ -378,15 +596,38 @@ public:
 	// dimensions of the textureImage
 	int textureWidth = 1000;
 	int textureHeight = 1000;
-	// variables to be passed into the intersect method calls in raytrace method
-	glm::vec3 intersectPt;
-	glm::vec3 intersectNormal;
+	// takes copy on write copies of the scene for the render thread
+	SceneFreezer sceneFreezer;
+	// traces the image in the background, re-tracing only the tiles that changed
+	RenderThread renderThread;
+	// hands the image out to worker processes in the background
+	std::thread farmThread;
+	ofImage farmImage;						// image the farm renders into (only used by the thread while it runs)
+	atomic<bool> bFarmBusy{ false };		// tracks whether the farm thread is still rendering
+	atomic<bool> bFarmCancel{ false };		// tells the farm thread to stop
+	bool bFarmFinished = false;				// tracks whether the farm render finished (read once it isn't busy)
 	// power of phong shading
 	float phongPower;
+	// size the area lights were last given (radius of the sphere lights)
+	float areaLightSize = 0;
 	// GUI slider
 	ofxFloatSlider power;
 	ofxFloatSlider intensity;
 	ofxToggle smoothMesh;
+	ofxFloatSlider clipTimeSlider;
+	ofxIntSlider crowdSize;
+	ofxIntSlider ikChainLength;
+	ofxToggle ccdIK;
+	ofxToggle crowdIK;
+	ofxToggle binarySkeleton;
+	ofxFloatSlider lightSize;
+	ofxIntSlider lightSamples;
+	ofxToggle sobolSampling;
+	ofxToggle phongHighlights;
+	ofxToggle castShadows;
+	ofxToggle optimizeMeshOrder;
+	ofxToggle collisionChecks;
+	ofxToggle blockCollisions;
 	ofxPanel gui;
 	// states
 	bool bDrag = false;
@@ -400,18 +641,91 @@ public:
 	//
 	// tracks number of joints added to the scene
 	int jointCount = 0;	
-	// holds currently selected Joint
-	vector<Joint *> selected;
+	// holds currently selected Joint (a handle into jointPool, so a freed
+	//  joint is never selected)
+	PoolHandle<Joint> selected;
 	// holds joints to be drawn in viewer
 	vector<Joint *> joints;
+	// gives every joint an ID and finds joints by name
+	SceneRegistry jointRegistry;
+	// boxes of the joints and attatched meshes used to pick them with the mouse
+	AABBTree pickTree;
+	// picking tree leaf of every joint and attatched mesh by registry ID (-1 if none)
+	vector<int> jointProxies;
+	vector<int> meshProxies;
+	// pairs of attatched meshes that interpenetrate in the pose last checked
+	vector<pair<PoolHandle<Mesh>, PoolHandle<Mesh>>> collisions;
+	// placements and pair results of the last collision check
+	CollisionCache collisionCache;
+	// compiled flat copy of the joints used for fast pose evaluation
+	Skeleton skeleton;
+	// set when joints are added, removed, or re-parented so the skeleton is recompiled
+	bool bSkeletonChanged = true;
+
+	// Animation Related Fields
+	//
+	// keyframed animation of the joints
+	AnimationClip clip;
+	// current time of the clip in seconds
+	float clipTime = 0;
+	// clip time slider value in the last update (to detect scrubbing)
+	float lastSliderTime = 0;
+	// toggles playback of the clip
+	bool bPlaying = false;
+	// compressed copy of the clip used for playback when bUseCompressedClip is set
+	CompressedClip compressedClip;
+	bool bUseCompressedClip = false;
+	// largest error (in world units at the joints' end-effectors) allowed by compression
+	float compressionTolerance = 0.001;
+
+	// IK Related Fields
+	//
+	// solves the chain ending at the joint dragged with the 'E' key held
+	IKSolver dragSolver;
+	// world position the dragged chain's end-effector reaches for
+	glm::vec3 ikTarget;
+	// set while the 'E' key is held, so dragging a joint poses its chain with IK
+	bool bIKKeyDown = false;
+	// set while a chain is being dragged
+	bool bIKDrag = false;
+	// keep the crowd instances' feet above the floor
+	IKSolver crowdFootSolver;
+	// reach the crowd instances' hands toward the selected joint
+	IKSolver crowdHandSolver;
+
+	// Crowd Related Fields
+	//
+	// instances of the skeleton sharing its joint table, the clip and the attatched meshes
+	Crowd crowd;
+	// meshes attatched to the skeleton's joints (placed on every instance)
+	vector<CrowdPart> crowdParts;
+	// mesh placements of every instance (crowdParts.size() per instance, also in meshScene)
+	vector<MeshInstance *> crowdMeshes;
+	// toggles the crowd on and off
+	bool bShowCrowd = false;
 
 	// Mesh Related Fields
 	//
 	// holds mesh that is unattatched to a joint to be used
 	//  as a reference for creating a skeleton (not drawn
-	//  by raytracer)
-	Mesh* referenceMesh;
+	//  by raytracer; a handle into meshPool that resolves
+	//  to NULL if there is no reference mesh)
+	PoolHandle<Mesh> referenceMesh;
+	// holds meshes deformed by the skeleton with linear blend skinning
+	vector<PoolHandle<Mesh>> skinnedMeshes;
 	// tracks the number of meshes added to the scene
 	int numMeshes = 0;
+	// gives every loaded mesh an ID and finds meshes by name
+	SceneRegistry meshRegistry;
+	// own the joints, meshes and crowd mesh placements (loading a script
+	//  file clears the joint and mesh pools, keeping their memory for the
+	//  new scene). The hierarchy, joints, meshScene, the registries and the
+	//  picking tree point at the objects and drop them as they are freed;
+	//  what is kept across frames (the selection, skinned meshes, crowd
+	//  parts, collisions) holds handles, and the render caches key objects
+	//  by serial.
+	ObjectPool<Joint> jointPool;
+	ObjectPool<Mesh> meshPool;
+	ObjectPool<MeshInstance> instancePool;
 
 };